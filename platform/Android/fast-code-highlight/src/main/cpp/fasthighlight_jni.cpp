@@ -0,0 +1,236 @@
+#include <cstring>
+#include <iterator>
+#include <jni.h>
+#include <utf8/utf8.h>
+#include "JniUtil.h"
+#include "highlight.h"
+#include "span_packer.h"
+
+using namespace NS_FASTHIGHLIGHT;
+
+static constexpr const char* kIllegalArgumentException = "java/lang/IllegalArgumentException";
+static constexpr const char* kRuntimeException = "java/lang/RuntimeException";
+
+static void throwJavaException(JNIEnv* env, const char* class_name, const char* message) {
+  jclass clazz = env->FindClass(class_name);
+  if (clazz != nullptr) {
+    env->ThrowNew(clazz, message);
+  }
+}
+
+/// Java字符串转为UTF-8。按UTF-16读取，GetStringUTFChars返回的Modified UTF-8会把四字节字符编码为两个代理项
+/// @return 含有不成对的代理项时抛出IllegalArgumentException并返回false
+static bool toUtf8String(JNIEnv* env, jstring str, String& result) {
+  result.clear();
+  if (str == nullptr) {
+    return true;
+  }
+  const jsize length = env->GetStringLength(str);
+  std::u16string utf16(static_cast<size_t>(length), u'\0');
+  env->GetStringRegion(str, 0, length, reinterpret_cast<jchar*>(&utf16[0]));
+  result.reserve(utf16.size());
+  try {
+    utf8::utf16to8(utf16.begin(), utf16.end(), std::back_inserter(result));
+  } catch (const utf8::exception& e) {
+    throwJavaException(env, kIllegalArgumentException, e.what());
+    return false;
+  }
+  return true;
+}
+
+// ===================================== HighlightEngine ============================================
+extern "C" JNIEXPORT jlong JNICALL
+Java_com_fasthighlight_HighlightEngine_nativeCreate(JNIEnv*, jclass) {
+  return makePtrHolderToJavaHandle<HighlightEngine>();
+}
+
+extern "C" JNIEXPORT void JNICALL
+Java_com_fasthighlight_HighlightEngine_nativeRelease(JNIEnv*, jclass, jlong handle) {
+  delete toNativePtrHolder<HighlightEngine>(handle);
+}
+
+extern "C" JNIEXPORT void JNICALL
+Java_com_fasthighlight_HighlightEngine_nativeCompileSyntaxFromJson(JNIEnv* env, jclass, jlong handle,
+  jstring json) {
+  Ptr<HighlightEngine> engine = getNativePtrHolderValue<HighlightEngine>(handle);
+  String json_text;
+  if (engine == nullptr || !toUtf8String(env, json, json_text)) {
+    return;
+  }
+  try {
+    engine->compileSyntaxFromJson(json_text);
+  } catch (const SyntaxRuleParseError& e) {
+    throwJavaException(env, kIllegalArgumentException, e.what());
+  } catch (const std::exception& e) {
+    throwJavaException(env, kRuntimeException, e.what());
+  }
+}
+
+extern "C" JNIEXPORT void JNICALL
+Java_com_fasthighlight_HighlightEngine_nativeCompileSyntaxFromFile(JNIEnv* env, jclass, jlong handle,
+  jstring path) {
+  Ptr<HighlightEngine> engine = getNativePtrHolderValue<HighlightEngine>(handle);
+  String file;
+  if (engine == nullptr || !toUtf8String(env, path, file)) {
+    return;
+  }
+  try {
+    engine->compileSyntaxFromFile(file);
+  } catch (const SyntaxRuleParseError& e) {
+    throwJavaException(env, kIllegalArgumentException, e.what());
+  } catch (const std::exception& e) {
+    throwJavaException(env, kRuntimeException, e.what());
+  }
+}
+
+extern "C" JNIEXPORT jlong JNICALL
+Java_com_fasthighlight_HighlightEngine_nativeLoadDocument(JNIEnv* env, jclass, jlong handle,
+  jlong document_handle) {
+  Ptr<HighlightEngine> engine = getNativePtrHolderValue<HighlightEngine>(handle);
+  Ptr<Document> document = getNativePtrHolderValue<Document>(document_handle);
+  if (engine == nullptr || document == nullptr) {
+    return 0;
+  }
+  try {
+    Ptr<DocumentAnalyzer> analyzer = engine->loadDocument(document);
+    if (analyzer == nullptr) {
+      return 0;
+    }
+    // Java侧每帧通过发布通道无锁读取高亮结果
+    analyzer->setSnapshotEnabled(true);
+    return toJavaHandle(analyzer);
+  } catch (const std::exception& e) {
+    throwJavaException(env, kRuntimeException, e.what());
+    return 0;
+  }
+}
+
+extern "C" JNIEXPORT jboolean JNICALL
+Java_com_fasthighlight_HighlightEngine_nativeCloseDocument(JNIEnv* env, jclass, jlong handle, jstring uri) {
+  Ptr<HighlightEngine> engine = getNativePtrHolderValue<HighlightEngine>(handle);
+  String uri_text;
+  if (engine == nullptr || !toUtf8String(env, uri, uri_text)) {
+    return JNI_FALSE;
+  }
+  return engine->closeDocument(uri_text) ? JNI_TRUE : JNI_FALSE;
+}
+
+// ===================================== Document ============================================
+extern "C" JNIEXPORT jlong JNICALL
+Java_com_fasthighlight_Document_nativeCreate(JNIEnv* env, jclass, jstring uri, jstring text) {
+  String uri_text;
+  String content;
+  if (!toUtf8String(env, uri, uri_text) || !toUtf8String(env, text, content)) {
+    return 0;
+  }
+  return makePtrHolderToJavaHandle<Document>(std::move(uri_text), content);
+}
+
+extern "C" JNIEXPORT void JNICALL
+Java_com_fasthighlight_Document_nativeRelease(JNIEnv*, jclass, jlong handle) {
+  delete toNativePtrHolder<Document>(handle);
+}
+
+extern "C" JNIEXPORT jint JNICALL
+Java_com_fasthighlight_Document_nativeGetLineCount(JNIEnv*, jclass, jlong handle) {
+  Ptr<Document> document = getNativePtrHolderValue<Document>(handle);
+  return document == nullptr ? 0 : static_cast<jint>(document->getLineCount());
+}
+
+// ===================================== DocumentAnalyzer ============================================
+extern "C" JNIEXPORT void JNICALL
+Java_com_fasthighlight_DocumentAnalyzer_nativeRelease(JNIEnv*, jclass, jlong handle) {
+  delete toNativePtrHolder<DocumentAnalyzer>(handle);
+}
+
+extern "C" JNIEXPORT jboolean JNICALL
+Java_com_fasthighlight_DocumentAnalyzer_nativeAnalyzeFully(JNIEnv* env, jclass, jlong handle) {
+  Ptr<DocumentAnalyzer> analyzer = getNativePtrHolderValue<DocumentAnalyzer>(handle);
+  if (analyzer == nullptr) {
+    return JNI_FALSE;
+  }
+  try {
+    return analyzer->analyzeFully() != nullptr ? JNI_TRUE : JNI_FALSE;
+  } catch (const std::exception& e) {
+    throwJavaException(env, kRuntimeException, e.what());
+    return JNI_FALSE;
+  }
+}
+
+extern "C" JNIEXPORT jboolean JNICALL
+Java_com_fasthighlight_DocumentAnalyzer_nativeUpdateHighlight(JNIEnv* env, jclass, jlong handle,
+  jint start_line, jint start_column, jint end_line, jint end_column, jstring new_text) {
+  Ptr<DocumentAnalyzer> analyzer = getNativePtrHolderValue<DocumentAnalyzer>(handle);
+  if (start_line < 0 || start_column < 0 || end_line < 0 || end_column < 0
+    || start_line > end_line || (start_line == end_line && start_column > end_column)) {
+    throwJavaException(env, kIllegalArgumentException, "invalid text range");
+    return JNI_FALSE;
+  }
+  String text;
+  if (analyzer == nullptr || !toUtf8String(env, new_text, text)) {
+    return JNI_FALSE;
+  }
+  TextRange range {{static_cast<size_t>(start_line), static_cast<size_t>(start_column)},
+    {static_cast<size_t>(end_line), static_cast<size_t>(end_column)}};
+  try {
+    return analyzer->updateHighlight(range, text) != nullptr ? JNI_TRUE : JNI_FALSE;
+  } catch (const std::exception& e) {
+    throwJavaException(env, kRuntimeException, e.what());
+    return JNI_FALSE;
+  }
+}
+
+extern "C" JNIEXPORT void JNICALL
+Java_com_fasthighlight_DocumentAnalyzer_nativeSetViewport(JNIEnv* env, jclass, jlong handle,
+  jint start_line, jint end_line) {
+  if (start_line < 0 || end_line < start_line) {
+    throwJavaException(env, kIllegalArgumentException, "invalid viewport");
+    return;
+  }
+  Ptr<DocumentAnalyzer> analyzer = getNativePtrHolderValue<DocumentAnalyzer>(handle);
+  if (analyzer != nullptr) {
+    analyzer->setViewport(static_cast<size_t>(start_line), static_cast<size_t>(end_line));
+  }
+}
+
+/// 把[start_line, end_line)行的高亮块按SpanPacker的格式写入direct ByteBuffer(本机字节序)，整段只做一次memcpy
+/// @return 写入的int数量；缓冲区不足时不写入，返回所需int数量的相反数；还没有分析结果时返回0
+extern "C" JNIEXPORT jint JNICALL
+Java_com_fasthighlight_DocumentAnalyzer_nativeGetSpans(JNIEnv* env, jclass, jlong handle,
+  jint start_line, jint end_line, jobject buffer) {
+  Ptr<DocumentAnalyzer> analyzer = getNativePtrHolderValue<DocumentAnalyzer>(handle);
+  if (analyzer == nullptr || start_line < 0 || end_line <= start_line) {
+    return 0;
+  }
+  void* address = env->GetDirectBufferAddress(buffer);
+  if (address == nullptr) {
+    throwJavaException(env, kIllegalArgumentException, "buffer must be a direct ByteBuffer");
+    return 0;
+  }
+  // 打包用的数组按线程复用，稳定后不再分配
+  thread_local SpanPacker packer;
+  if (!packer.packPublished(*analyzer, static_cast<size_t>(start_line), static_cast<size_t>(end_line))) {
+    return 0;
+  }
+  const size_t bytes = packer.size() * sizeof(jint);
+  if (static_cast<jlong>(bytes) > env->GetDirectBufferCapacity(buffer)) {
+    return -static_cast<jint>(packer.size());
+  }
+  std::memcpy(address, packer.data(), bytes);
+  return static_cast<jint>(packer.size());
+}
+
+extern "C" JNIEXPORT jstring JNICALL
+Java_com_fasthighlight_DocumentAnalyzer_nativeGetStyleName(JNIEnv* env, jclass, jlong handle, jint style_id) {
+  Ptr<DocumentAnalyzer> analyzer = getNativePtrHolderValue<DocumentAnalyzer>(handle);
+  if (analyzer == nullptr) {
+    return nullptr;
+  }
+  return env->NewStringUTF(analyzer->getSyntaxRule()->getStyleName(style_id).c_str());
+}
+
+extern "C" JNIEXPORT jint JNICALL
+Java_com_fasthighlight_DocumentAnalyzer_nativeGetStyleCount(JNIEnv*, jclass, jlong handle) {
+  Ptr<DocumentAnalyzer> analyzer = getNativePtrHolderValue<DocumentAnalyzer>(handle);
+  return analyzer == nullptr ? 0 : static_cast<jint>(analyzer->getSyntaxRule()->getStyleCount());
+}
@@ -0,0 +1,43 @@
+package com.fasthighlight;
+
+/**
+ * 文本内容，对应native的Document，使用完需要调用{@link #close()}释放
+ */
+public class Document implements AutoCloseable {
+    static {
+        System.loadLibrary("fast-highlight");
+    }
+
+    private long handle;
+
+    /**
+     * @param uri 文件路径，根据扩展名选择语法规则
+     * @param text 文本内容
+     */
+    public Document(String uri, String text) {
+        handle = nativeCreate(uri, text);
+    }
+
+    /**
+     * 获取行数
+     */
+    public int getLineCount() {
+        return nativeGetLineCount(handle);
+    }
+
+    long getHandle() {
+        return handle;
+    }
+
+    @Override
+    public void close() {
+        if (handle != 0) {
+            nativeRelease(handle);
+            handle = 0;
+        }
+    }
+
+    private static native long nativeCreate(String uri, String text);
+    private static native void nativeRelease(long handle);
+    private static native int nativeGetLineCount(long handle);
+}
@@ -0,0 +1,87 @@
+package com.fasthighlight;
+
+/**
+ * 高亮分析器，由{@link HighlightEngine#loadDocument(Document)}创建，使用完需要调用{@link #close()}释放。
+ * 分析结果通过{@link #getSpans(int, int, SpanBuffer)}批量读取，可以在分析进行时从UI线程调用
+ */
+public class DocumentAnalyzer implements AutoCloseable {
+    private long handle;
+
+    DocumentAnalyzer(long handle) {
+        this.handle = handle;
+    }
+
+    /**
+     * 对整个文本进行高亮分析
+     * @return 分析完成返回true
+     */
+    public boolean analyzeFully() {
+        return nativeAnalyzeFully(handle);
+    }
+
+    /**
+     * 应用patch并增量更新高亮，行列号按Unicode字符计数
+     * @return 分析完成返回true
+     */
+    public boolean updateHighlight(int startLine, int startColumn, int endLine, int endColumn, String newText) {
+        return nativeUpdateHighlight(handle, startLine, startColumn, endLine, endColumn, newText);
+    }
+
+    /**
+     * 设置可见区域，语法规则热重载时优先重新分析
+     * @param startLine 起始行号
+     * @param endLine 结束行号(不含)
+     */
+    public void setViewport(int startLine, int endLine) {
+        nativeSetViewport(handle, startLine, endLine);
+    }
+
+    /**
+     * 读取最近一次分析完成时[startLine, endLine)行的高亮块，缓冲区不足时自动扩容
+     * @param startLine 起始行号
+     * @param endLine 结束行号(不含)
+     * @param buffer 接收打包结果的缓冲区，格式见{@link SpanBuffer}
+     * @return 写入的int数量，还没有分析结果时为0
+     */
+    public int getSpans(int startLine, int endLine, SpanBuffer buffer) {
+        int count = nativeGetSpans(handle, startLine, endLine, buffer.getByteBuffer());
+        if (count < 0) {
+            buffer.ensureCapacity(-count);
+            count = nativeGetSpans(handle, startLine, endLine, buffer.getByteBuffer());
+        }
+        buffer.setSize(Math.max(count, 0));
+        return count;
+    }
+
+    /**
+     * 获取style编号对应的名称，用于在Java侧建立style编号到颜色的映射
+     * @param styleId style编号
+     */
+    public String getStyleName(int styleId) {
+        return nativeGetStyleName(handle, styleId);
+    }
+
+    /**
+     * 语法规则中所有style的数量，包括编号0的无样式
+     */
+    public int getStyleCount() {
+        return nativeGetStyleCount(handle);
+    }
+
+    @Override
+    public void close() {
+        if (handle != 0) {
+            nativeRelease(handle);
+            handle = 0;
+        }
+    }
+
+    private static native void nativeRelease(long handle);
+    private static native boolean nativeAnalyzeFully(long handle);
+    private static native boolean nativeUpdateHighlight(long handle, int startLine, int startColumn,
+        int endLine, int endColumn, String newText);
+    private static native void nativeSetViewport(long handle, int startLine, int endLine);
+    private static native int nativeGetSpans(long handle, int startLine, int endLine, java.nio.ByteBuffer buffer);
+    private static native String nativeGetStyleName(long handle, int styleId);
+    private static native int nativeGetStyleCount(long handle);
+}
@@ -0,0 +1,68 @@
+package com.fasthighlight;
+
+/**
+ * 高亮引擎，对应native的HighlightEngine，使用完需要调用{@link #close()}释放
+ */
+public class HighlightEngine implements AutoCloseable {
+    static {
+        System.loadLibrary("fast-highlight");
+    }
+
+    private long handle;
+
+    public HighlightEngine() {
+        handle = nativeCreate();
+    }
+
+    /**
+     * 编译语法规则，同名的语法规则已注册时替换，已加载的文本会热重载
+     * @param json 语法规则的json文本
+     * @throws IllegalArgumentException 语法规则有误
+     */
+    public void compileSyntaxFromJson(String json) {
+        nativeCompileSyntaxFromJson(handle, json);
+    }
+
+    /**
+     * 编译语法规则文件
+     * @param path 语法规则文件路径
+     * @throws IllegalArgumentException 语法规则有误
+     */
+    public void compileSyntaxFromFile(String path) {
+        nativeCompileSyntaxFromFile(handle, path);
+    }
+
+    /**
+     * 加载文本，返回的分析器需要单独释放
+     * @param document 文本
+     * @return 没有匹配的语法规则时返回null
+     */
+    public DocumentAnalyzer loadDocument(Document document) {
+        long analyzerHandle = nativeLoadDocument(handle, document.getHandle());
+        return analyzerHandle == 0 ? null : new DocumentAnalyzer(analyzerHandle);
+    }
+
+    /**
+     * 关闭文本，引擎不再持有对应的分析器
+     * @param uri 文本uri
+     * @return 文本未加载时返回false
+     */
+    public boolean closeDocument(String uri) {
+        return nativeCloseDocument(handle, uri);
+    }
+
+    @Override
+    public void close() {
+        if (handle != 0) {
+            nativeRelease(handle);
+            handle = 0;
+        }
+    }
+
+    private static native long nativeCreate();
+    private static native void nativeRelease(long handle);
+    private static native void nativeCompileSyntaxFromJson(long handle, String json);
+    private static native void nativeCompileSyntaxFromFile(long handle, String path);
+    private static native long nativeLoadDocument(long handle, long documentHandle);
+    private static native boolean nativeCloseDocument(long handle, String uri);
+}
@@ -0,0 +1,59 @@
+package com.fasthighlight;
+
+import java.nio.ByteBuffer;
+import java.nio.ByteOrder;
+import java.nio.IntBuffer;
+
+/**
+ * 接收高亮块的direct缓冲区，native侧一次memcpy写入，不为每个高亮块创建Java对象。
+ * 每行依次为: 高亮块数量, (起始列, 长度, style编号) * 数量，列号按Unicode字符计数，
+ * 从上一行延续的跨行高亮块起始列为0。缓冲区可以在每帧之间复用
+ */
+public class SpanBuffer {
+    /** 每个高亮块占用的int数量 */
+    public static final int INTS_PER_SPAN = 3;
+
+    private ByteBuffer byteBuffer;
+    private IntBuffer intBuffer;
+    private int size;
+
+    /**
+     * @param initialInts 初始容量(int数量)
+     */
+    public SpanBuffer(int initialInts) {
+        allocate(Math.max(initialInts, 16));
+    }
+
+    /**
+     * 本次写入的int数量
+     */
+    public int size() {
+        return size;
+    }
+
+    /**
+     * 读取第index个int
+     */
+    public int get(int index) {
+        return intBuffer.get(index);
+    }
+
+    ByteBuffer getByteBuffer() {
+        return byteBuffer;
+    }
+
+    void setSize(int size) {
+        this.size = size;
+    }
+
+    void ensureCapacity(int ints) {
+        if (intBuffer.capacity() < ints) {
+            allocate(Math.max(ints, intBuffer.capacity() * 2));
+        }
+    }
+
+    private void allocate(int ints) {
+        byteBuffer = ByteBuffer.allocateDirect(ints * 4).order(ByteOrder.nativeOrder());
+        intBuffer = byteBuffer.asIntBuffer();
+    }
+}
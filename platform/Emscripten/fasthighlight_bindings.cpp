@@ -1,10 +1,38 @@
 #include <emscripten.h>
 #include <emscripten/bind.h>
+#include "wasm_highlight.h"
 
-extern "C" {
+using namespace NS_FASTHIGHLIGHT;
+using namespace emscripten;
 
-EMSCRIPTEN_BINDINGS(lib) {
-  emscripten::register_vector<String>("StringVector");
+/// 打包[start_line, end_line)行的高亮块，返回直接指向WebAssembly内存的Int32Array，不复制。
+/// 视图在下一次调用getSpans或内存增长前有效，需要保留时由JS自行slice()
+static val getSpans(WasmDocumentAnalyzer& analyzer, uint32_t start_line, uint32_t end_line) {
+  uint32_t size = analyzer.packSpans(start_line, end_line);
+  return val(typed_memory_view(size, analyzer.getPackedData()));
 }
 
-}
\ No newline at end of file
+EMSCRIPTEN_BINDINGS(fasthighlight) {
+  register_vector<String>("StringVector");
+
+  class_<WasmDocument>("Document")
+    .constructor<const String&, const String&>()
+    .function("getUri", &WasmDocument::getUri)
+    .function("getText", &WasmDocument::getText)
+    .function("getLineCount", &WasmDocument::getLineCount);
+
+  class_<WasmDocumentAnalyzer>("DocumentAnalyzer")
+    .smart_ptr<Ptr<WasmDocumentAnalyzer>>("DocumentAnalyzerPtr")
+    .function("analyzeFully", &WasmDocumentAnalyzer::analyzeFully)
+    .function("updateHighlight", &WasmDocumentAnalyzer::updateHighlight)
+    .function("setViewport", &WasmDocumentAnalyzer::setViewport)
+    .function("getSpans", &getSpans)
+    .function("getStyleName", &WasmDocumentAnalyzer::getStyleName)
+    .function("getStyleCount", &WasmDocumentAnalyzer::getStyleCount);
+
+  class_<WasmHighlightEngine>("HighlightEngine")
+    .constructor<>()
+    .function("compileSyntaxFromJson", &WasmHighlightEngine::compileSyntaxFromJson)
+    .function("loadDocument", &WasmHighlightEngine::loadDocument)
+    .function("closeDocument", &WasmHighlightEngine::closeDocument);
+}
@@ -0,0 +1,92 @@
+#include "wasm_highlight.h"
+
+namespace NS_FASTHIGHLIGHT {
+  // ===================================== WasmDocument ============================================
+  WasmDocument::WasmDocument(const String& uri, const String& text): document_(MAKE_PTR<Document>(uri, text)) {
+  }
+
+  String WasmDocument::getUri() const {
+    return document_->getUri();
+  }
+
+  String WasmDocument::getText() const {
+    return document_->getText();
+  }
+
+  uint32_t WasmDocument::getLineCount() const {
+    return static_cast<uint32_t>(document_->getLineCount());
+  }
+
+  const Ptr<Document>& WasmDocument::getDocument() const {
+    return document_;
+  }
+
+  // ===================================== WasmDocumentAnalyzer ============================================
+  WasmDocumentAnalyzer::WasmDocumentAnalyzer(const Ptr<DocumentAnalyzer>& analyzer): analyzer_(analyzer) {
+    // 打包时读取发布的版本，不受后台热重载中的分析影响
+    analyzer_->setSnapshotEnabled(true);
+  }
+
+  bool WasmDocumentAnalyzer::analyzeFully() {
+    return analyzer_->analyzeFully() != nullptr;
+  }
+
+  bool WasmDocumentAnalyzer::updateHighlight(uint32_t start_line, uint32_t start_column, uint32_t end_line,
+    uint32_t end_column, const String& text) {
+    TextRange range {{start_line, start_column}, {end_line, end_column}};
+    if (range.end < range.start) {
+      return false;
+    }
+    return analyzer_->updateHighlight(range, text) != nullptr;
+  }
+
+  void WasmDocumentAnalyzer::setViewport(uint32_t start_line, uint32_t end_line) {
+    analyzer_->setViewport(start_line, end_line);
+  }
+
+  uint32_t WasmDocumentAnalyzer::packSpans(uint32_t start_line, uint32_t end_line) {
+    packer_.packPublished(*analyzer_, start_line, end_line);
+    return getPackedSize();
+  }
+
+  const int32_t* WasmDocumentAnalyzer::getPackedData() const {
+    return packer_.data();
+  }
+
+  uint32_t WasmDocumentAnalyzer::getPackedSize() const {
+    return static_cast<uint32_t>(packer_.size());
+  }
+
+  String WasmDocumentAnalyzer::getStyleName(int32_t style_id) const {
+    return analyzer_->getSyntaxRule()->getStyleName(style_id);
+  }
+
+  uint32_t WasmDocumentAnalyzer::getStyleCount() const {
+    return static_cast<uint32_t>(analyzer_->getSyntaxRule()->getStyleCount());
+  }
+
+  // ===================================== WasmHighlightEngine ============================================
+  WasmHighlightEngine::WasmHighlightEngine(): engine_(MAKE_PTR<HighlightEngine>()) {
+  }
+
+  String WasmHighlightEngine::compileSyntaxFromJson(const String& json) {
+    try {
+      engine_->compileSyntaxFromJson(json);
+    } catch (const SyntaxRuleParseError& e) {
+      return e.message().empty() ? String(e.what()) : String(e.what()) + ": " + e.message();
+    }
+    return "";
+  }
+
+  Ptr<WasmDocumentAnalyzer> WasmHighlightEngine::loadDocument(const WasmDocument& document) {
+    Ptr<DocumentAnalyzer> analyzer = engine_->loadDocument(document.getDocument());
+    if (analyzer == nullptr) {
+      return nullptr;
+    }
+    return MAKE_PTR<WasmDocumentAnalyzer>(analyzer);
+  }
+
+  bool WasmHighlightEngine::closeDocument(const String& uri) {
+    return engine_->closeDocument(uri);
+  }
+}
@@ -0,0 +1,77 @@
+#ifndef FAST_HIGHLIGHT_WASM_HIGHLIGHT_H
+#define FAST_HIGHLIGHT_WASM_HIGHLIGHT_H
+
+#include "highlight.h"
+#include "span_packer.h"
+
+namespace NS_FASTHIGHLIGHT {
+  /// 导出给JS的文本
+  class WasmDocument {
+  public:
+    WasmDocument(const String& uri, const String& text);
+
+    String getUri() const;
+    String getText() const;
+    uint32_t getLineCount() const;
+    const Ptr<Document>& getDocument() const;
+  private:
+    Ptr<Document> document_;
+  };
+
+  /// 导出给JS的分析器，高亮结果按SpanPacker的格式打包在WebAssembly内存中，JS通过Int32Array视图直接读取
+  class WasmDocumentAnalyzer {
+  public:
+    explicit WasmDocumentAnalyzer(const Ptr<DocumentAnalyzer>& analyzer);
+
+    /// 完整分析整个文本
+    bool analyzeFully();
+
+    /// 修改文本并增量更新高亮
+    /// @param text 替换[start, end)范围的新文本
+    bool updateHighlight(uint32_t start_line, uint32_t start_column, uint32_t end_line, uint32_t end_column,
+      const String& text);
+
+    /// 设置可见区域，语法规则热重载时优先重新分析
+    void setViewport(uint32_t start_line, uint32_t end_line);
+
+    /// 打包[start_line, end_line)行最近一次分析完成的高亮块
+    /// @return 打包的int数量，还没有分析结果时为0。结果在下一次打包前有效
+    uint32_t packSpans(uint32_t start_line, uint32_t end_line);
+
+    /// 最近一次打包的结果
+    const int32_t* getPackedData() const;
+
+    /// 最近一次打包的int数量
+    uint32_t getPackedSize() const;
+
+    /// 获取style编号对应的名称，编号无效时返回空字符串
+    String getStyleName(int32_t style_id) const;
+
+    /// 语法规则中所有style的数量，包括无样式
+    uint32_t getStyleCount() const;
+  private:
+    Ptr<DocumentAnalyzer> analyzer_;
+    SpanPacker packer_;
+  };
+
+  /// 导出给JS的引擎，编译错误以返回值的形式交给JS，不向JS抛出C++异常
+  class WasmHighlightEngine {
+  public:
+    WasmHighlightEngine();
+
+    /// 编译语法规则，同名规则已注册时替换
+    /// @return 成功时返回空字符串，失败时返回错误信息
+    String compileSyntaxFromJson(const String& json);
+
+    /// 按文本uri的扩展名选择语法规则并加载到引擎中
+    /// @return 没有匹配的语法规则时返回nullptr
+    Ptr<WasmDocumentAnalyzer> loadDocument(const WasmDocument& document);
+
+    /// 关闭已加载的文本
+    bool closeDocument(const String& uri);
+  private:
+    Ptr<HighlightEngine> engine_;
+  };
+}
+
+#endif //FAST_HIGHLIGHT_WASM_HIGHLIGHT_H
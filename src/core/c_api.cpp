@@ -0,0 +1,307 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include "c_api.h"
+#include "highlight.h"
+
+using namespace NS_FASTHIGHLIGHT;
+
+struct fh_engine {
+  Ptr<HighlightEngine> engine;
+};
+
+struct fh_grammar {
+  Ptr<const SyntaxRule> rule;
+};
+
+struct fh_document {
+  Ptr<Document> document;
+};
+
+struct fh_analyzer {
+  Ptr<DocumentAnalyzer> analyzer;
+};
+
+/// 最近一次失败的详细信息，使用固定缓冲区，记录错误时不会再分配内存
+static thread_local char last_error[256];
+
+static void setLastError(const char* message) {
+  std::snprintf(last_error, sizeof(last_error), "%s", message);
+}
+
+/// 执行接口实现，把异常转换为状态码
+template<typename Func>
+static fh_status invokeNoThrow(Func&& func) noexcept {
+  last_error[0] = '\0';
+  try {
+    return func();
+  } catch (const SyntaxRuleParseError& e) {
+    setLastError(e.message().c_str());
+    return static_cast<fh_status>(e.errorCode());
+  } catch (const std::bad_alloc& e) {
+    setLastError(e.what());
+    return FH_ERROR_OUT_OF_MEMORY;
+  } catch (const std::exception& e) {
+    setLastError(e.what());
+    return FH_ERROR_INTERNAL;
+  } catch (...) {
+    return FH_ERROR_INTERNAL;
+  }
+}
+
+/// 把字符串复制到调用方的缓冲区，以'\0'结尾
+static fh_status copyString(const String& value, char* buffer, size_t capacity, size_t* out_length) {
+  if (out_length != nullptr) {
+    *out_length = value.size();
+  }
+  if (buffer == nullptr) {
+    return FH_OK;
+  }
+  if (capacity <= value.size()) {
+    return FH_ERROR_BUFFER_TOO_SMALL;
+  }
+  std::memcpy(buffer, value.data(), value.size());
+  buffer[value.size()] = '\0';
+  return FH_OK;
+}
+
+static fh_status copyStyleName(const SyntaxRule& rule, int32_t style_id, char* buffer, size_t capacity,
+  size_t* out_length) {
+  if (style_id < 0 || static_cast<size_t>(style_id) >= rule.getStyleCount()) {
+    return FH_ERROR_INVALID_ARGUMENT;
+  }
+  return copyString(rule.getStyleName(style_id), buffer, capacity, out_length);
+}
+
+static fh_status newAnalyzerHandle(const Ptr<DocumentAnalyzer>& analyzer, fh_analyzer** out_analyzer) {
+  // 读取高亮块时通过发布通道获取最近一次分析完成的结果，不受后台热重载影响
+  analyzer->setSnapshotEnabled(true);
+  *out_analyzer = new fh_analyzer {analyzer};
+  return FH_OK;
+}
+
+const char* fh_status_message(int32_t status) {
+  switch (status) {
+  case FH_OK:
+    return "OK";
+  case FH_ERROR_PROPERTY_EXPECTED:
+  case FH_ERROR_PROPERTY_INVALID:
+  case FH_ERROR_PATTERN_INVALID:
+  case FH_ERROR_STATE_INVALID:
+  case FH_ERROR_JSON_INVALID:
+    return SyntaxRuleParseError(status).what();
+  case FH_ERROR_INVALID_ARGUMENT:
+    return "Invalid argument";
+  case FH_ERROR_FILE_NOT_FOUND:
+    return "File not found";
+  case FH_ERROR_NO_SYNTAX_RULE:
+    return "No syntax rule";
+  case FH_ERROR_BUFFER_TOO_SMALL:
+    return "Buffer too small";
+  case FH_ERROR_OUT_OF_MEMORY:
+    return "Out of memory";
+  default:
+    return "Internal error";
+  }
+}
+
+const char* fh_last_error_message(void) {
+  return last_error;
+}
+
+// ===================================== fh_engine ============================================
+fh_status fh_engine_create(fh_engine** out_engine) {
+  if (out_engine == nullptr) {
+    return FH_ERROR_INVALID_ARGUMENT;
+  }
+  return invokeNoThrow([&] {
+    *out_engine = new fh_engine {MAKE_PTR<HighlightEngine>()};
+    return FH_OK;
+  });
+}
+
+void fh_engine_release(fh_engine* engine) {
+  delete engine;
+}
+
+fh_status fh_engine_compile_grammar_json(fh_engine* engine, const char* json, size_t length,
+  fh_grammar** out_grammar) {
+  if (engine == nullptr || json == nullptr) {
+    return FH_ERROR_INVALID_ARGUMENT;
+  }
+  return invokeNoThrow([&] {
+    Ptr<const SyntaxRule> rule = engine->engine->compileSyntaxFromJson(String(json, length));
+    if (out_grammar != nullptr) {
+      *out_grammar = new fh_grammar {rule};
+    }
+    return FH_OK;
+  });
+}
+
+fh_status fh_engine_compile_grammar_file(fh_engine* engine, const char* path, fh_grammar** out_grammar) {
+  if (engine == nullptr || path == nullptr) {
+    return FH_ERROR_INVALID_ARGUMENT;
+  }
+  return invokeNoThrow([&] {
+    Ptr<const SyntaxRule> rule = engine->engine->compileSyntaxFromFile(path);
+    if (rule == nullptr) {
+      return FH_ERROR_FILE_NOT_FOUND;
+    }
+    if (out_grammar != nullptr) {
+      *out_grammar = new fh_grammar {rule};
+    }
+    return FH_OK;
+  });
+}
+
+fh_status fh_engine_load_document(fh_engine* engine, fh_document* document, fh_analyzer** out_analyzer) {
+  if (engine == nullptr || document == nullptr || out_analyzer == nullptr) {
+    return FH_ERROR_INVALID_ARGUMENT;
+  }
+  return invokeNoThrow([&] {
+    Ptr<DocumentAnalyzer> analyzer = engine->engine->loadDocument(document->document);
+    if (analyzer == nullptr) {
+      return FH_ERROR_NO_SYNTAX_RULE;
+    }
+    return newAnalyzerHandle(analyzer, out_analyzer);
+  });
+}
+
+fh_status fh_engine_close_document(fh_engine* engine, const char* uri) {
+  if (engine == nullptr || uri == nullptr) {
+    return FH_ERROR_INVALID_ARGUMENT;
+  }
+  return invokeNoThrow([&] {
+    return engine->engine->closeDocument(uri) ? FH_OK : FH_ERROR_INVALID_ARGUMENT;
+  });
+}
+
+// ===================================== fh_grammar ============================================
+void fh_grammar_release(fh_grammar* grammar) {
+  delete grammar;
+}
+
+fh_status fh_grammar_get_name(const fh_grammar* grammar, char* buffer, size_t capacity, size_t* out_length) {
+  if (grammar == nullptr) {
+    return FH_ERROR_INVALID_ARGUMENT;
+  }
+  return copyString(grammar->rule->name, buffer, capacity, out_length);
+}
+
+uint32_t fh_grammar_get_style_count(const fh_grammar* grammar) {
+  return grammar == nullptr ? 0 : static_cast<uint32_t>(grammar->rule->getStyleCount());
+}
+
+fh_status fh_grammar_get_style_name(const fh_grammar* grammar, int32_t style_id, char* buffer, size_t capacity,
+  size_t* out_length) {
+  if (grammar == nullptr) {
+    return FH_ERROR_INVALID_ARGUMENT;
+  }
+  return copyStyleName(*grammar->rule, style_id, buffer, capacity, out_length);
+}
+
+// ===================================== fh_document ============================================
+fh_status fh_document_create(const char* uri, const char* text, size_t length, fh_document** out_document) {
+  if (uri == nullptr || (text == nullptr && length > 0) || out_document == nullptr) {
+    return FH_ERROR_INVALID_ARGUMENT;
+  }
+  return invokeNoThrow([&] {
+    String content = length > 0 ? String(text, length) : String();
+    *out_document = new fh_document {MAKE_PTR<Document>(uri, content)};
+    return FH_OK;
+  });
+}
+
+void fh_document_release(fh_document* document) {
+  delete document;
+}
+
+uint32_t fh_document_get_line_count(const fh_document* document) {
+  return document == nullptr ? 0 : static_cast<uint32_t>(document->document->getLineCount());
+}
+
+// ===================================== fh_analyzer ============================================
+fh_status fh_analyzer_create(const fh_grammar* grammar, fh_document* document, fh_analyzer** out_analyzer) {
+  if (grammar == nullptr || document == nullptr || out_analyzer == nullptr) {
+    return FH_ERROR_INVALID_ARGUMENT;
+  }
+  return invokeNoThrow([&] {
+    return newAnalyzerHandle(MAKE_PTR<DocumentAnalyzer>(document->document, grammar->rule), out_analyzer);
+  });
+}
+
+void fh_analyzer_release(fh_analyzer* analyzer) {
+  delete analyzer;
+}
+
+fh_status fh_analyzer_analyze(fh_analyzer* analyzer) {
+  if (analyzer == nullptr) {
+    return FH_ERROR_INVALID_ARGUMENT;
+  }
+  return invokeNoThrow([&] {
+    analyzer->analyzer->analyzeFully();
+    return FH_OK;
+  });
+}
+
+fh_status fh_analyzer_update(fh_analyzer* analyzer, uint32_t start_line, uint32_t start_column, uint32_t end_line,
+  uint32_t end_column, const char* text, size_t length) {
+  if (analyzer == nullptr || (text == nullptr && length > 0)) {
+    return FH_ERROR_INVALID_ARGUMENT;
+  }
+  TextRange range {{start_line, start_column}, {end_line, end_column}};
+  if (range.end < range.start) {
+    return FH_ERROR_INVALID_ARGUMENT;
+  }
+  return invokeNoThrow([&] {
+    String new_text = length > 0 ? String(text, length) : String();
+    analyzer->analyzer->updateHighlight(range, new_text);
+    return FH_OK;
+  });
+}
+
+fh_status fh_analyzer_get_spans(fh_analyzer* analyzer, uint32_t start_line, uint32_t end_line, fh_span* spans,
+  size_t capacity, size_t* out_count) {
+  if (analyzer == nullptr || out_count == nullptr || end_line < start_line) {
+    return FH_ERROR_INVALID_ARGUMENT;
+  }
+  *out_count = 0;
+  return invokeNoThrow([&] {
+    PublishChannel<HighlightVersion>::ReadGuard version = analyzer->analyzer->readPublished();
+    if (!version) {
+      return FH_OK;
+    }
+    const DocumentHighlight& highlight = *version->highlight;
+    const size_t last_line = std::min(static_cast<size_t>(end_line), highlight.getLineCount());
+    size_t count = 0;
+    for (size_t line = start_line; line < last_line; ++line) {
+      count += highlight.getLineSpans(line).size();
+    }
+    *out_count = count;
+    if (spans == nullptr) {
+      return FH_OK;
+    }
+    if (capacity < count) {
+      return FH_ERROR_BUFFER_TOO_SMALL;
+    }
+    fh_span* output = spans;
+    for (size_t line = start_line; line < last_line; ++line) {
+      for (const TokenSpan& span : highlight.getLineSpans(line)) {
+        output->line = static_cast<uint32_t>(line);
+        output->start_column = span.range.start.line < line ? 0 : static_cast<uint32_t>(span.range.start.column);
+        output->end_column = static_cast<uint32_t>(span.range.end.column);
+        output->style_id = span.style_id;
+        ++output;
+      }
+    }
+    return FH_OK;
+  });
+}
+
+fh_status fh_analyzer_get_style_name(const fh_analyzer* analyzer, int32_t style_id, char* buffer, size_t capacity,
+  size_t* out_length) {
+  if (analyzer == nullptr) {
+    return FH_ERROR_INVALID_ARGUMENT;
+  }
+  return copyStyleName(*analyzer->analyzer->getSyntaxRule(), style_id, buffer, capacity, out_length);
+}
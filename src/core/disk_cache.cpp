@@ -0,0 +1,226 @@
+#include <cinttypes>
+#include <cstdio>
+#include <cstring>
+#include "disk_cache.h"
+#include "token_stream.h"
+#include "util.h"
+
+namespace NS_FASTHIGHLIGHT {
+  /// 缓存文件头，之后依次为line_count个int32_t的行状态和stream_bytes字节的高亮流，
+  /// 所有字段按本机字节序写入，byte_order不一致时视为无效缓存
+  struct DiskCacheHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t byte_order;
+    uint32_t reserved;
+    uint64_t content_hash;
+    uint64_t grammar_fingerprint;
+    uint64_t content_bytes;
+    uint64_t line_count;
+    uint64_t stream_bytes;
+  };
+
+  /// 行内的字符位置游标，高亮块按列递增排列，按顺序前进即可把列号转换为字节位置
+  struct ColumnCursor {
+    const String& text;
+    size_t char_pos {0};
+    size_t byte_pos {0};
+
+    /// 前进到指定列，列号超出行尾时返回false
+    bool seek(size_t column) {
+      if (column < char_pos) {
+        char_pos = 0;
+        byte_pos = 0;
+      }
+      while (char_pos < column) {
+        if (byte_pos >= text.size()) {
+          return false;
+        }
+        // 跳过UTF-8的后续字节
+        ++byte_pos;
+        while (byte_pos < text.size() && (static_cast<uint8_t>(text[byte_pos]) & 0xC0) == 0x80) {
+          ++byte_pos;
+        }
+        ++char_pos;
+      }
+      return true;
+    }
+  };
+
+  static constexpr char kDiskCacheMagic[4] = {'F', 'H', 'C', '\0'};
+  static constexpr uint32_t kDiskCacheVersion = 1;
+  static constexpr uint32_t kDiskCacheByteOrder = 0x01020304;
+
+  // ===================================== HighlightDiskCache ============================================
+  HighlightDiskCache::HighlightDiskCache(const String& directory): directory_(directory) {
+  }
+
+  bool HighlightDiskCache::load(const Document& document, const SyntaxRule& rule, DocumentHighlight& highlight,
+    List<int32_t>& line_states) {
+    uint64_t content_bytes;
+    uint64_t content_hash = hashContent(document, content_bytes);
+    MappedFile file(getCachePath(content_hash, rule.fingerprint));
+    if (!file.isValid()) {
+      ++misses_;
+      return false;
+    }
+    // 只校验文件头和各段长度，高亮流的结构由解码器检查
+    const size_t line_count = document.getLineCount();
+    const uint64_t states_bytes = static_cast<uint64_t>(line_count) * sizeof(int32_t);
+    if (file.size() < sizeof(DiskCacheHeader) + states_bytes) {
+      ++rejected_;
+      return false;
+    }
+    DiskCacheHeader header {};
+    std::memcpy(&header, file.data(), sizeof(DiskCacheHeader));
+    if (std::memcmp(header.magic, kDiskCacheMagic, sizeof(kDiskCacheMagic)) != 0
+      || header.version != kDiskCacheVersion || header.byte_order != kDiskCacheByteOrder
+      || header.content_hash != content_hash || header.grammar_fingerprint != rule.fingerprint
+      || header.content_bytes != content_bytes || header.line_count != line_count
+      || header.stream_bytes != file.size() - sizeof(DiskCacheHeader) - states_bytes) {
+      ++rejected_;
+      return false;
+    }
+    const char* states_data = file.data() + sizeof(DiskCacheHeader);
+    line_states.resize(line_count);
+    if (line_count > 0) {
+      std::memcpy(line_states.data(), states_data, states_bytes);
+    }
+
+    TokenStreamDecoder decoder(states_data + states_bytes, static_cast<size_t>(header.stream_bytes));
+    if (!decoder.hasSpanStates()) {
+      ++rejected_;
+      return false;
+    }
+    // 流中的style编号映射为语法规则中的编号
+    List<int32_t> style_ids;
+    List<TokenSpan> spans;
+    highlight.resize(0);
+    highlight.resize(line_count);
+    while (decoder.nextLine()) {
+      const size_t line = decoder.getLine();
+      if (line >= line_count || decoder.getSpanCount() > header.stream_bytes) {
+        ++rejected_;
+        return false;
+      }
+      StreamStyle style;
+      while (decoder.nextStyle(style)) {
+        int32_t style_id = rule.getStyleId(String(style.name, style.length));
+        if (style_id < 0) {
+          ++rejected_;
+          return false;
+        }
+        style_ids.push_back(style_id);
+      }
+      ColumnCursor cursor {document.getLine(line)};
+      if (spans.size() < decoder.getSpanCount()) {
+        spans.resize(decoder.getSpanCount());
+      }
+      size_t span_count = 0;
+      StreamSpan stream_span;
+      while (decoder.nextSpan(stream_span)) {
+        size_t start_column = stream_span.start_line < line ? 0 : stream_span.start_column;
+        if (start_column > stream_span.end_column || !cursor.seek(start_column)) {
+          ++rejected_;
+          return false;
+        }
+        size_t start_byte = cursor.byte_pos;
+        if (!cursor.seek(stream_span.end_column)) {
+          ++rejected_;
+          return false;
+        }
+        TokenSpan& span = spans[span_count++];
+        span.range.start = {stream_span.start_line, stream_span.start_column};
+        span.range.end = {line, stream_span.end_column};
+        span.style_id = style_ids[stream_span.style_id];
+        span.style = rule.getStyleName(span.style_id);
+        span.state = stream_span.state;
+        span.goto_state = stream_span.goto_state;
+        span.matched_text.assign(cursor.text, start_byte, cursor.byte_pos - start_byte);
+      }
+      if (decoder.hasError() || span_count != decoder.getSpanCount()) {
+        ++rejected_;
+        return false;
+      }
+      highlight.setLineSpans(line, {spans.data(), span_count});
+    }
+    if (decoder.hasError()) {
+      ++rejected_;
+      return false;
+    }
+    ++hits_;
+    return true;
+  }
+
+  bool HighlightDiskCache::store(const Document& document, const SyntaxRule& rule, const DocumentHighlight& highlight,
+    const List<int32_t>& line_states) {
+    const size_t line_count = document.getLineCount();
+    if (highlight.getLineCount() != line_count || line_states.size() != line_count) {
+      return false;
+    }
+    DiskCacheHeader header {};
+    header.content_hash = hashContent(document, header.content_bytes);
+    String path = getCachePath(header.content_hash, rule.fingerprint);
+    // 缓存文件按内容命名，已存在即为相同的结果
+    if (FileUtil::isFile(path)) {
+      return true;
+    }
+    if (!FileUtil::isDirectory(directory_) && !FileUtil::mkdirs(directory_) && !FileUtil::isDirectory(directory_)) {
+      return false;
+    }
+    std::memcpy(header.magic, kDiskCacheMagic, sizeof(kDiskCacheMagic));
+    header.version = kDiskCacheVersion;
+    header.byte_order = kDiskCacheByteOrder;
+    header.grammar_fingerprint = rule.fingerprint;
+    header.line_count = line_count;
+
+    String content(sizeof(DiskCacheHeader), '\0');
+    content.append(reinterpret_cast<const char*>(line_states.data()), line_count * sizeof(int32_t));
+    const size_t stream_start = content.size();
+    TokenStreamEncoder encoder(content, true);
+    encoder.encodeHighlight(highlight);
+    header.stream_bytes = content.size() - stream_start;
+    std::memcpy(&content[0], &header, sizeof(DiskCacheHeader));
+    if (!FileUtil::writeString(path, content)) {
+      return false;
+    }
+    ++stores_;
+    return true;
+  }
+
+  String HighlightDiskCache::getCachePath(const Document& document, const SyntaxRule& rule) const {
+    uint64_t content_bytes;
+    return getCachePath(hashContent(document, content_bytes), rule.fingerprint);
+  }
+
+  DiskCacheStats HighlightDiskCache::getStats() const {
+    DiskCacheStats stats;
+    stats.hits = hits_.load();
+    stats.misses = misses_.load();
+    stats.rejected = rejected_.load();
+    stats.stores = stores_.load();
+    return stats;
+  }
+
+  uint64_t HighlightDiskCache::hashContent(const Document& document, uint64_t& content_bytes) {
+    uint64_t hash = HashUtil::kFnvOffsetBasis;
+    content_bytes = 0;
+    const size_t line_count = document.getLineCount();
+    for (size_t line = 0; line < line_count; ++line) {
+      if (line > 0) {
+        hash = HashUtil::fnv1a64("\n", 1, hash);
+        ++content_bytes;
+      }
+      const String& line_text = document.getLine(line);
+      hash = HashUtil::fnv1a64(line_text.data(), line_text.size(), hash);
+      content_bytes += line_text.size();
+    }
+    return hash;
+  }
+
+  String HighlightDiskCache::getCachePath(uint64_t content_hash, uint64_t fingerprint) const {
+    char name[64];
+    std::snprintf(name, sizeof(name), "%016" PRIx64 "-%016" PRIx64 ".fhc", content_hash, fingerprint);
+    return directory_ + "/" + name;
+  }
+}
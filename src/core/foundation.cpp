@@ -4,6 +4,31 @@
 #include "util.h"
 
 namespace NS_FASTHIGHLIGHT {
+  // ===================================== MemoryUsage ============================================
+  size_t MemoryUsage::total() const {
+    return line_text + line_states + span_vectors + span_strings + multi_line_contexts + line_cache
+      + compiled_regexes + grammar_data + hash_maps + other;
+  }
+
+  MemoryUsage& MemoryUsage::operator+=(const MemoryUsage& other_usage) {
+    line_text += other_usage.line_text;
+    line_states += other_usage.line_states;
+    span_vectors += other_usage.span_vectors;
+    span_strings += other_usage.span_strings;
+    multi_line_contexts += other_usage.multi_line_contexts;
+    line_cache += other_usage.line_cache;
+    compiled_regexes += other_usage.compiled_regexes;
+    grammar_data += other_usage.grammar_data;
+    hash_maps += other_usage.hash_maps;
+    other += other_usage.other;
+    return *this;
+  }
+
+  size_t MemoryUsage::stringBytes(const String& str) {
+    // 容量不超过对象自身大小时一定使用了短字符串优化的内联缓冲区
+    return str.capacity() >= sizeof(String) ? str.capacity() + 1 : 0;
+  }
+
   // ===================================== TextPosition ============================================
 
   bool TextPosition::operator<(const TextPosition& other) const {
@@ -22,15 +47,16 @@ namespace NS_FASTHIGHLIGHT {
 
   // ===================================== Document ============================================
   Document::Document(const String& uri, const String& initial_text): uri_(uri) {
-    setText(initial_text);
+    splitTextIntoLines(initial_text, lines);
   }
 
   Document::Document(String&& uri, const String& initial_text): uri_(std::move(uri)) {
-    setText(initial_text);
+    splitTextIntoLines(initial_text, lines);
   }
 
   void Document::setText(const String& text) {
     splitTextIntoLines(text, lines);
+    ++revision_;
   }
 
   String Document::getUri() const {
@@ -83,6 +109,20 @@ namespace NS_FASTHIGHLIGHT {
   size_t Document::getLineCount() const {
     return lines.size();
   }
+
+  uint64_t Document::getRevision() const {
+    return revision_;
+  }
+
+  MemoryUsage Document::memoryUsage() const {
+    MemoryUsage usage;
+    usage.line_text = lines.capacity() * sizeof(String);
+    for (const String& line : lines) {
+      usage.line_text += MemoryUsage::stringBytes(line);
+    }
+    usage.other = sizeof(Document) + MemoryUsage::stringBytes(uri_);
+    return usage;
+  }
   
   void Document::patch(const TextRange& range, const String& new_text) {
     if (range.start.line >= lines.size()) {
@@ -90,6 +130,15 @@ namespace NS_FASTHIGHLIGHT {
       appendText(new_text);
       return;
     }
+    ++revision_;
+    // 行内编辑(输入或删除字符)直接原地替换，行字符串容量足够时不需要分配内存
+    if (range.start.line == range.end.line && new_text.find_first_of("\r\n") == String::npos) {
+      String& line = lines[range.start.line];
+      size_t start_byte = Utf8Util::charPosToBytePos(line, range.start.column);
+      size_t end_byte = Utf8Util::charPosToBytePos(line, range.end.column);
+      line.replace(start_byte, end_byte - start_byte, new_text);
+      return;
+    }
     // 将patch的文本按行分割
     std::vector<String> new_lines;
     splitTextIntoLines(new_text, new_lines);
@@ -104,6 +153,7 @@ namespace NS_FASTHIGHLIGHT {
   }
 
   void Document::appendText(const String& text) {
+    ++revision_;
     std::vector<String> new_lines;
     splitTextIntoLines(text, new_lines);
 
@@ -171,7 +221,7 @@ namespace NS_FASTHIGHLIGHT {
     std::stringstream ss(text);
     String line;
     while (std::getline(ss, line)) {
-      if (line.back() == '\r') {
+      if (!line.empty() && line.back() == '\r') {
         line = line.substr(0, line.length() - 1);
       }
       result.push_back(line);
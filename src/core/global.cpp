@@ -14,5 +14,5 @@ namespace NS_FASTHIGHLIGHT {
     }
   };
 
-  static StaticInitializer static_initializer();
+  static StaticInitializer static_initializer;
 }
\ No newline at end of file
@@ -1,8 +1,21 @@
+#include <algorithm>
+#include <cstring>
+#include <limits>
 #include <nlohmann/json.hpp>
+#include "disk_cache.h"
 #include "highlight.h"
+#include "line_cache.h"
+#include "profiler.h"
 #include "util.h"
 
 namespace NS_FASTHIGHLIGHT {
+  /// make_shared时shared_ptr控制块的大小
+  static constexpr size_t kSharedControlBlockBytes = 2 * sizeof(void*);
+  /// Oniguruma没有提供查询编译结果大小的接口，按表达式长度粗略估算：
+  /// 固定部分为regex_t及其字符映射表，可变部分为字节码
+  static constexpr size_t kRegexBaseBytes = 1024;
+  static constexpr size_t kRegexBytesPerPatternByte = 8;
+
   // ===================================== SyntaxRuleParseError ============================================
   SyntaxRuleParseError::SyntaxRuleParseError(int err_code): err_code_(err_code) {
   }
@@ -34,6 +47,10 @@ namespace NS_FASTHIGHLIGHT {
     return message_;
   }
 
+  int SyntaxRuleParseError::errorCode() const noexcept {
+    return err_code_;
+  }
+
   // ===================================== TokenRule ============================================
   const String& TokenRule::getGroupStyle(int32_t group) const {
     auto it = styles.find(group);
@@ -43,6 +60,18 @@ namespace NS_FASTHIGHLIGHT {
     return it->second;
   }
 
+  int32_t TokenRule::getGroupStyleId(int32_t group) const {
+    auto it = style_ids.find(group);
+    if (it == style_ids.end()) {
+      return 0;
+    }
+    return it->second;
+  }
+
+  bool TokenRule::isKeywordRule() const {
+    return !keywords.empty();
+  }
+
   String TokenRule::kDefaultStyle;
   TokenRule TokenRule::kEmpty;
   StateRule StateRule::kEmpty;
@@ -58,21 +87,97 @@ namespace NS_FASTHIGHLIGHT {
     }
   }
 
+  int32_t SyntaxRule::getOrCreateStyleId(const String& style) {
+    auto it = style_id_map_.find(style);
+    if (it != style_id_map_.end()) {
+      return it->second;
+    }
+    int32_t style_id = static_cast<int32_t>(style_names_.size());
+    style_names_.push_back(style);
+    style_id_map_.insert_or_assign(style, style_id);
+    return style_id;
+  }
+
+  int32_t SyntaxRule::getStyleId(const String& style) const {
+    auto it = style_id_map_.find(style);
+    return it == style_id_map_.end() ? -1 : it->second;
+  }
+
+  size_t SyntaxRule::getStyleCount() const {
+    return style_names_.size();
+  }
+
+  const String& SyntaxRule::getStyleName(int32_t style_id) const {
+    if (style_id < 0 || static_cast<size_t>(style_id) >= style_names_.size()) {
+      return TokenRule::kDefaultStyle;
+    }
+    return style_names_[style_id];
+  }
+
   bool SyntaxRule::containsRule(int32_t state_id) const {
     return state_rules_map_.find(state_id) != state_rules_map_.end();
   }
 
-  StateRule& SyntaxRule::getStateRule(int32_t state_id) {
-    return state_rules_map_[state_id];
+  const StateRule& SyntaxRule::getStateRule(int32_t state_id) const {
+    auto it = state_rules_map_.find(state_id);
+    if (it == state_rules_map_.end()) {
+      return StateRule::kEmpty;
+    }
+    return it->second;
+  }
+
+  MemoryUsage SyntaxRule::memoryUsage() const {
+    MemoryUsage usage;
+    usage.hash_maps = MemoryUsage::hashTableBytes(file_extensions_) + MemoryUsage::hashTableBytes(variables_map_)
+      + MemoryUsage::hashTableBytes(state_rules_map_) + MemoryUsage::hashTableBytes(state_id_map_)
+      + MemoryUsage::hashTableBytes(style_id_map_);
+    usage.grammar_data = MemoryUsage::stringBytes(name);
+    for (const String& extension : file_extensions_) {
+      usage.grammar_data += MemoryUsage::stringBytes(extension);
+    }
+    for (const std::pair<const String, String>& pair : variables_map_) {
+      usage.grammar_data += MemoryUsage::stringBytes(pair.first) + MemoryUsage::stringBytes(pair.second);
+    }
+    for (const std::pair<const String, int32_t>& pair : state_id_map_) {
+      usage.grammar_data += MemoryUsage::stringBytes(pair.first);
+    }
+    // 编号到名称和名称到编号各存一份
+    for (const String& style : style_names_) {
+      usage.grammar_data += MemoryUsage::stringBytes(style) * 2;
+    }
+    for (const std::pair<const int32_t, StateRule>& pair : state_rules_map_) {
+      const StateRule& state_rule = pair.second;
+      if (state_rule.regex != nullptr) {
+        usage.compiled_regexes += kRegexBaseBytes + state_rule.merged_pattern.length() * kRegexBytesPerPatternByte;
+      }
+      usage.grammar_data += MemoryUsage::stringBytes(state_rule.name) + MemoryUsage::stringBytes(state_rule.merged_pattern)
+        + state_rule.token_rules.capacity() * sizeof(TokenRule)
+        + state_rule.keyword_rule_indices.capacity() * sizeof(int32_t);
+      for (const TokenRule& token_rule : state_rule.token_rules) {
+        usage.hash_maps += MemoryUsage::hashTableBytes(token_rule.styles) + MemoryUsage::hashTableBytes(token_rule.style_ids);
+        usage.grammar_data += MemoryUsage::stringBytes(token_rule.pattern) + MemoryUsage::stringBytes(token_rule.goto_state_str)
+          + token_rule.keywords.capacity() * sizeof(String) + token_rule.keyword_matcher.memoryBytes();
+        for (const std::pair<const int32_t, String>& style : token_rule.styles) {
+          usage.grammar_data += MemoryUsage::stringBytes(style.second);
+        }
+        for (const String& keyword : token_rule.keywords) {
+          usage.grammar_data += MemoryUsage::stringBytes(keyword);
+        }
+      }
+    }
+    usage.other = sizeof(SyntaxRule);
+    return usage;
   }
 
   SyntaxRule::SyntaxRule() {
     state_id_map_.insert_or_assign(kDefaultStateName, kDefaultStateId);
+    getOrCreateStyleId(TokenRule::kDefaultStyle);
   }
 
   // ===================================== SyntaxRuleManager ============================================
-  Ptr<SyntaxRule> SyntaxRuleManager::compileSyntaxFromJson(const String& json) {
+  Ptr<const SyntaxRule> SyntaxRuleManager::compileSyntaxFromJson(const String& json) {
     Ptr<SyntaxRule> syntax_rule = MAKE_PTR<SyntaxRule>();
+    syntax_rule->fingerprint = HashUtil::fnv1a64(json.data(), json.size());
     nlohmann::json root;
     try {
       root = nlohmann::json::parse(json);
@@ -83,18 +188,21 @@ namespace NS_FASTHIGHLIGHT {
     parseFileExtensions(syntax_rule, root);
     parseVariables(syntax_rule, root);
     parseStates(syntax_rule, root);
-    name_rules_map_.insert_or_assign(syntax_rule->name, syntax_rule);
-    // 每个state都编译成一个大表达式
+    // 每个state都编译成一个大表达式，并计算首字节预过滤集合
     for (std::pair<const int32_t, StateRule>& pair : syntax_rule->state_rules_map_) {
       compileStatePattern(pair.second);
+      compileStatePrefilter(pair.second);
     }
 #ifdef FH_DEBUG
     //syntax_rule->dump();
 #endif
+    // 编译完成后才注册，注册后的语法规则不再修改
+    std::unique_lock<std::shared_mutex> lock(rules_mutex_);
+    name_rules_map_.insert_or_assign(syntax_rule->name, syntax_rule);
     return syntax_rule;
   }
 
-  Ptr<SyntaxRule> SyntaxRuleManager::compileSyntaxFromFile(const String& file) {
+  Ptr<const SyntaxRule> SyntaxRuleManager::compileSyntaxFromFile(const String& file) {
     if (!FileUtil::isFile(file)) {
       return nullptr;
     }
@@ -105,15 +213,16 @@ namespace NS_FASTHIGHLIGHT {
     return compileSyntaxFromJson(content);
   }
 
-  Ptr<SyntaxRule> SyntaxRuleManager::getSyntaxRuleByName(const String& extension) {
-    const HashMap<String, Ptr<SyntaxRule>>::iterator it = name_rules_map_.find(extension);
+  Ptr<const SyntaxRule> SyntaxRuleManager::getSyntaxRuleByName(const String& extension) const {
+    std::shared_lock<std::shared_mutex> lock(rules_mutex_);
+    const HashMap<String, Ptr<const SyntaxRule>>::const_iterator it = name_rules_map_.find(extension);
     if (it == name_rules_map_.end()) {
       return nullptr;
     }
     return it->second;
   }
 
-  Ptr<SyntaxRule> SyntaxRuleManager::getSyntaxRuleByExtension(const String& extension) const {
+  Ptr<const SyntaxRule> SyntaxRuleManager::getSyntaxRuleByExtension(const String& extension) const {
     if (extension.empty()) {
       return nullptr;
     }
@@ -121,7 +230,8 @@ namespace NS_FASTHIGHLIGHT {
     if (fixed_extension[0] != '.') {
       fixed_extension.insert(0, ".");
     }
-    for (const std::pair<const String, Ptr<SyntaxRule>>& pair : name_rules_map_) {
+    std::shared_lock<std::shared_mutex> lock(rules_mutex_);
+    for (const std::pair<const String, Ptr<const SyntaxRule>>& pair : name_rules_map_) {
       if (pair.second->file_extensions_.find(fixed_extension) != pair.second->file_extensions_.end()) {
         return pair.second;
       }
@@ -129,6 +239,17 @@ namespace NS_FASTHIGHLIGHT {
     return nullptr;
   }
 
+  MemoryUsage SyntaxRuleManager::memoryUsage() const {
+    std::shared_lock<std::shared_mutex> lock(rules_mutex_);
+    MemoryUsage usage;
+    usage.hash_maps = MemoryUsage::hashTableBytes(name_rules_map_);
+    for (const std::pair<const String, Ptr<const SyntaxRule>>& pair : name_rules_map_) {
+      usage += pair.second->memoryUsage();
+      usage.other += MemoryUsage::stringBytes(pair.first) + kSharedControlBlockBytes;
+    }
+    return usage;
+  }
+
   void SyntaxRuleManager::parseSyntaxName(const Ptr<SyntaxRule>& rule, nlohmann::json& root) {
     if (!root.contains("name")) {
       throw SyntaxRuleParseError(SyntaxRuleParseError::kErrCodePropertyExpected, "name");
@@ -230,13 +351,16 @@ namespace NS_FASTHIGHLIGHT {
       if (!token_json.is_object()) {
         throw SyntaxRuleParseError(SyntaxRuleParseError::kErrCodePropertyInvalid, "state element");
       }
-      if (!token_json.contains("pattern")) {
-        throw SyntaxRuleParseError(SyntaxRuleParseError::kErrCodePropertyInvalid, "pattern");
-      }
       TokenRule token_rule;
-      token_rule.pattern = token_json["pattern"];
-      // pattern有可能引用变量，进行变量替换
-      replaceVariable(token_rule.pattern, rule->variables_map_);
+      if (token_json.contains("keywords")) {
+        parseKeywords(token_rule, token_json);
+      } else if (token_json.contains("pattern")) {
+        token_rule.pattern = token_json["pattern"];
+        // pattern有可能引用变量，进行变量替换
+        replaceVariable(token_rule.pattern, rule->variables_map_);
+      } else {
+        throw SyntaxRuleParseError(SyntaxRuleParseError::kErrCodePropertyInvalid, "pattern/keywords");
+      }
       // state
       if (token_json.contains("state")) {
         token_rule.goto_state_str = token_json["state"];
@@ -259,8 +383,13 @@ namespace NS_FASTHIGHLIGHT {
       } else {
         throw SyntaxRuleParseError(SyntaxRuleParseError::kErrCodePropertyInvalid, "style/styles");
       }
+      for (const std::pair<const int32_t, String>& style : token_rule.styles) {
+        token_rule.style_ids.insert_or_assign(style.first, rule->getOrCreateStyleId(style.second));
+      }
       // multiLine
-      if (token_json.contains("multiLine")) {
+      if (token_rule.isKeywordRule()) {
+        token_rule.is_multi_line = false;
+      } else if (token_json.contains("multiLine")) {
         const nlohmann::json& multi_line_json = token_json["multiLine"];
         if (!multi_line_json.is_boolean()) {
           throw SyntaxRuleParseError(SyntaxRuleParseError::kErrCodePropertyInvalid, "multiLine");
@@ -273,13 +402,44 @@ namespace NS_FASTHIGHLIGHT {
     }
   }
 
+  void SyntaxRuleManager::parseKeywords(TokenRule& token_rule, const nlohmann::json& token_json) {
+    const nlohmann::json& keywords_json = token_json["keywords"];
+    if (!keywords_json.is_array() || keywords_json.empty()) {
+      throw SyntaxRuleParseError(SyntaxRuleParseError::kErrCodePropertyInvalid, "keywords");
+    }
+    for (const nlohmann::json& keyword_json : keywords_json) {
+      if (!keyword_json.is_string()) {
+        throw SyntaxRuleParseError(SyntaxRuleParseError::kErrCodePropertyInvalid, "keywords");
+      }
+      const String& keyword = keyword_json.get_ref<const String&>();
+      // 关键字按单词边界匹配，只能由单词字符组成
+      if (!KeywordMatcher::isWord(keyword)) {
+        throw SyntaxRuleParseError(SyntaxRuleParseError::kErrCodePropertyInvalid, "keywords: " + keyword);
+      }
+      token_rule.keywords.push_back(keyword);
+    }
+    if (token_json.contains("ignoreCase")) {
+      const nlohmann::json& ignore_case_json = token_json["ignoreCase"];
+      if (!ignore_case_json.is_boolean()) {
+        throw SyntaxRuleParseError(SyntaxRuleParseError::kErrCodePropertyInvalid, "ignoreCase");
+      }
+      token_rule.ignore_case = ignore_case_json;
+    }
+  }
+
   void SyntaxRuleManager::compileStatePattern(StateRule& state_rule) {
     String merged_pattern;
     int32_t total_group_count {0};
     size_t token_size = state_rule.token_rules.size();
-    // 将所有token的表达式合成一个大表达式
+    // 将所有token的表达式合成一个大表达式，关键字规则单独编译为哈希表
     for (size_t i = 0; i < token_size; ++i) {
       TokenRule& token_rule = state_rule.token_rules[i];
+      if (token_rule.isKeywordRule()) {
+        token_rule.keyword_matcher.build(token_rule.keywords, token_rule.ignore_case);
+        token_rule.group_offset = -1;
+        state_rule.keyword_rule_indices.push_back(static_cast<int32_t>(i));
+        continue;
+      }
       // 检测每个token的pattern是否有错误
       String err = PatternUtil::getPatternError(token_rule.pattern);
       if (!err.empty()) {
@@ -289,7 +449,7 @@ namespace NS_FASTHIGHLIGHT {
       token_rule.group_count = PatternUtil::countCaptureGroups(token_rule.pattern);
       token_rule.group_offset = 1 + total_group_count;
       total_group_count += 1 + token_rule.group_count;
-      if (i > 0) {
+      if (!merged_pattern.empty()) {
         merged_pattern += "|";
       }
       merged_pattern += "(";
@@ -297,10 +457,14 @@ namespace NS_FASTHIGHLIGHT {
       merged_pattern += ")";
     }
     state_rule.group_count = total_group_count;
+    if (merged_pattern.empty()) {
+      return;
+    }
     // 编译合并的大表达
     OnigErrorInfo error;
     OnigRegion* region = onig_region_new();
-    int status = onig_new(&state_rule.regex,
+    OnigRegex regex = nullptr;
+    int status = onig_new(&regex,
       (OnigUChar*)merged_pattern.c_str(),
       (OnigUChar*)(merged_pattern.c_str() + merged_pattern.length()),
       ONIG_OPTION_DEFAULT,
@@ -312,9 +476,41 @@ namespace NS_FASTHIGHLIGHT {
       throw SyntaxRuleParseError(SyntaxRuleParseError::kErrCodePatternInvalid, merged_pattern);
     }
     onig_region_free(region, 1);
+    state_rule.regex.reset(regex);
     state_rule.merged_pattern = std::move(merged_pattern);
   }
 
+  void SyntaxRuleManager::compileStatePrefilter(StateRule& state_rule) {
+    state_rule.first_bytes.reset();
+    state_rule.has_prefilter = false;
+    state_rule.prefilter_byte = -1;
+    for (const TokenRule& token_rule : state_rule.token_rules) {
+      if (token_rule.isKeywordRule()) {
+        for (int c = 0; c < 256; ++c) {
+          if (KeywordMatcher::isWordStartByte(static_cast<unsigned char>(c))) {
+            state_rule.first_bytes.set(c);
+          }
+        }
+      } else if (!PatternUtil::computeFirstByteSet(token_rule.pattern, state_rule.first_bytes)) {
+        // 只要有一个token无法确定首字节，整个state都不能预过滤
+        state_rule.first_bytes.reset();
+        return;
+      }
+    }
+    if (state_rule.first_bytes.none() || state_rule.first_bytes.all()) {
+      return;
+    }
+    state_rule.has_prefilter = true;
+    if (state_rule.first_bytes.count() == 1) {
+      for (int c = 0; c < 256; ++c) {
+        if (state_rule.first_bytes.test(c)) {
+          state_rule.prefilter_byte = c;
+          break;
+        }
+      }
+    }
+  }
+
   void SyntaxRuleManager::replaceVariable(String& text, HashMap<String, String>& variables_map) {
     for (const std::pair<const String, String>& pair : variables_map) {
       text = StrUtil::replaceAll(text, "${" + pair.first + "}", pair.second);
@@ -322,42 +518,488 @@ namespace NS_FASTHIGHLIGHT {
   }
 
   // ===================================== DocumentHighlight ============================================
-  void DocumentHighlight::addLine(const Ptr<LineHighlight>& line) {
-    lines.push_back(line);
+  size_t DocumentHighlight::getLineCount() const {
+    return line_count_;
+  }
+
+  size_t DocumentHighlight::getBlockCount() const {
+    return block_count_;
+  }
+
+  LineSpans DocumentHighlight::getLineSpans(size_t line) const {
+    if (line >= line_count_) {
+      return {};
+    }
+    BlockLocation location = locateLine(line);
+    const HighlightBlock& block = *chunks_[location.chunk]->blocks[location.block];
+    const LineRecord& record = block.lines[location.line];
+    return {block.spans.data() + record.span_start, record.span_count};
+  }
+
+  void DocumentHighlight::setLineSpans(size_t line, const LineSpans& spans) {
+    BlockLocation location = locateLine(line);
+    HighlightBlock& block = mutableBlock(mutableChunk(location.chunk), location.block);
+    LineRecord& record = block.lines[location.line];
+    const size_t old_count = record.span_count;
+    const size_t new_count = spans.size();
+    auto span_begin = block.spans.begin() + record.span_start;
+    // 数量变化时只在块内移动后面行的高亮块，其余位置原地赋值
+    if (new_count > old_count) {
+      block.spans.insert(span_begin + static_cast<std::ptrdiff_t>(old_count), new_count - old_count, TokenSpan());
+    } else if (new_count < old_count) {
+      block.spans.erase(span_begin + static_cast<std::ptrdiff_t>(new_count),
+        span_begin + static_cast<std::ptrdiff_t>(old_count));
+    }
+    std::copy(spans.begin(), spans.end(), block.spans.begin() + record.span_start);
+    record.span_count = static_cast<uint32_t>(new_count);
+    if (new_count != old_count) {
+      for (size_t i = location.line + 1; i < block.lines.size(); ++i) {
+        block.lines[i].span_start = static_cast<uint32_t>(block.lines[i].span_start + new_count - old_count);
+      }
+    }
+  }
+
+  void DocumentHighlight::insertLines(size_t line, size_t count) {
+    if (count == 0) {
+      return;
+    }
+    if (chunks_.empty()) {
+      Ptr<HighlightBlockChunk> chunk = MAKE_PTR<HighlightBlockChunk>();
+      chunk->blocks.push_back(MAKE_PTR<HighlightBlock>());
+      chunk->block_first_lines.push_back(0);
+      chunks_.push_back(chunk);
+      chunk_first_lines_.push_back(0);
+      block_count_ = 1;
+    }
+    BlockLocation location = locateLine(line);
+    HighlightBlockChunk& chunk = mutableChunk(location.chunk);
+    HighlightBlock& block = mutableBlock(chunk, location.block);
+    uint32_t span_start = location.line < block.lines.size()
+      ? block.lines[location.line].span_start : static_cast<uint32_t>(block.spans.size());
+    block.lines.insert(block.lines.begin() + static_cast<std::ptrdiff_t>(location.line), count,
+      LineRecord {span_start, 0});
+    line_count_ += count;
+    splitBlock(chunk, location.block);
+    updateBlockFirstLines(chunk, location.block + 1);
+    splitChunk(location.chunk);
+    updateChunkFirstLines(location.chunk + 1);
+  }
+
+  void DocumentHighlight::removeLines(size_t line, size_t count) {
+    count = std::min(count, line_count_ - std::min(line, line_count_));
+    if (count == 0) {
+      return;
+    }
+    BlockLocation location = locateLine(line);
+    size_t chunk_idx = location.chunk;
+    size_t block_idx = location.block;
+    size_t line_idx = location.line;
+    line_count_ -= count;
+    while (count > 0) {
+      HighlightBlockChunk& chunk = mutableChunk(chunk_idx);
+      while (count > 0 && block_idx < chunk.blocks.size()) {
+        HighlightBlock& block = mutableBlock(chunk, block_idx);
+        size_t remove_count = std::min(count, block.lines.size() - line_idx);
+        uint32_t span_begin = block.lines[line_idx].span_start;
+        const LineRecord& last_record = block.lines[line_idx + remove_count - 1];
+        uint32_t span_end = last_record.span_start + last_record.span_count;
+        block.spans.erase(block.spans.begin() + span_begin, block.spans.begin() + span_end);
+        block.lines.erase(block.lines.begin() + static_cast<std::ptrdiff_t>(line_idx),
+          block.lines.begin() + static_cast<std::ptrdiff_t>(line_idx + remove_count));
+        for (size_t i = line_idx; i < block.lines.size(); ++i) {
+          block.lines[i].span_start -= span_end - span_begin;
+        }
+        count -= remove_count;
+        if (block.lines.empty()) {
+          chunk.blocks.erase(chunk.blocks.begin() + static_cast<std::ptrdiff_t>(block_idx));
+          chunk.block_first_lines.erase(chunk.block_first_lines.begin() + static_cast<std::ptrdiff_t>(block_idx));
+          --block_count_;
+        } else {
+          ++block_idx;
+        }
+        line_idx = 0;
+      }
+      if (chunk.blocks.empty()) {
+        chunks_.erase(chunks_.begin() + static_cast<std::ptrdiff_t>(chunk_idx));
+        chunk_first_lines_.erase(chunk_first_lines_.begin() + static_cast<std::ptrdiff_t>(chunk_idx));
+      } else {
+        updateBlockFirstLines(chunk, 0);
+        ++chunk_idx;
+      }
+      block_idx = 0;
+    }
+    // 删除后过小的块与段内的后一个块合并，过小的段与后一段合并，避免大量删除后留下许多零散的小块
+    if (location.chunk < chunks_.size()) {
+      const size_t merge_idx = location.block;
+      const HighlightBlockChunk& merge_chunk = *chunks_[location.chunk];
+      if (merge_idx + 1 < merge_chunk.blocks.size()
+        && merge_chunk.blocks[merge_idx]->lines.size() + merge_chunk.blocks[merge_idx + 1]->lines.size()
+          <= kMaxBlockLines / 2) {
+        HighlightBlockChunk& chunk = mutableChunk(location.chunk);
+        const HighlightBlock& next_block = *chunk.blocks[merge_idx + 1];
+        HighlightBlock& block = mutableBlock(chunk, merge_idx);
+        uint32_t span_offset = static_cast<uint32_t>(block.spans.size());
+        block.spans.insert(block.spans.end(), next_block.spans.begin(), next_block.spans.end());
+        for (const LineRecord& record : next_block.lines) {
+          block.lines.push_back({record.span_start + span_offset, record.span_count});
+        }
+        chunk.blocks.erase(chunk.blocks.begin() + static_cast<std::ptrdiff_t>(merge_idx + 1));
+        chunk.block_first_lines.erase(chunk.block_first_lines.begin() + static_cast<std::ptrdiff_t>(merge_idx + 1));
+        --block_count_;
+        updateBlockFirstLines(chunk, merge_idx);
+      }
+      if (location.chunk + 1 < chunks_.size()
+        && chunks_[location.chunk]->blocks.size() + chunks_[location.chunk + 1]->blocks.size() <= kMaxChunkBlocks / 2) {
+        HighlightBlockChunk& chunk = mutableChunk(location.chunk);
+        const HighlightBlockChunk& next_chunk = *chunks_[location.chunk + 1];
+        chunk.blocks.insert(chunk.blocks.end(), next_chunk.blocks.begin(), next_chunk.blocks.end());
+        chunk.block_first_lines.resize(chunk.blocks.size());
+        chunks_.erase(chunks_.begin() + static_cast<std::ptrdiff_t>(location.chunk + 1));
+        chunk_first_lines_.erase(chunk_first_lines_.begin() + static_cast<std::ptrdiff_t>(location.chunk + 1));
+        updateBlockFirstLines(chunk, 0);
+      }
+    }
+    updateChunkFirstLines(location.chunk);
+  }
+
+  void DocumentHighlight::resize(size_t line_count) {
+    if (line_count > line_count_) {
+      insertLines(line_count_, line_count - line_count_);
+    } else if (line_count < line_count_) {
+      removeLines(line_count, line_count_ - line_count);
+    }
+  }
+
+  void DocumentHighlight::offsetLineNumbers(size_t from_line, std::ptrdiff_t delta) {
+    if (delta == 0 || from_line >= line_count_) {
+      return;
+    }
+    BlockLocation location = locateLine(from_line);
+    for (size_t chunk_idx = location.chunk; chunk_idx < chunks_.size(); ++chunk_idx) {
+      HighlightBlockChunk& chunk = mutableChunk(chunk_idx);
+      size_t block_begin = chunk_idx == location.chunk ? location.block : 0;
+      for (size_t block_idx = block_begin; block_idx < chunk.blocks.size(); ++block_idx) {
+        HighlightBlock& block = mutableBlock(chunk, block_idx);
+        size_t span_begin = chunk_idx == location.chunk && block_idx == location.block
+          ? block.lines[location.line].span_start : 0;
+        for (size_t i = span_begin; i < block.spans.size(); ++i) {
+          TextRange& range = block.spans[i].range;
+          range.start.line = static_cast<size_t>(static_cast<std::ptrdiff_t>(range.start.line) + delta);
+          range.end.line = static_cast<size_t>(static_cast<std::ptrdiff_t>(range.end.line) + delta);
+        }
+      }
+    }
+  }
+
+  void DocumentHighlight::remapRule(const SyntaxRule& rule, const HashMap<int32_t, int32_t>& state_mapping) {
+    auto map_state = [&state_mapping](int32_t state) {
+      auto it = state_mapping.find(state);
+      return it == state_mapping.end() ? SyntaxRule::kDefaultStateId : it->second;
+    };
+    for (size_t chunk_idx = 0; chunk_idx < chunks_.size(); ++chunk_idx) {
+      HighlightBlockChunk& chunk = mutableChunk(chunk_idx);
+      for (size_t block_idx = 0; block_idx < chunk.blocks.size(); ++block_idx) {
+        for (TokenSpan& span : mutableBlock(chunk, block_idx).spans) {
+          span.state = map_state(span.state);
+          if (span.goto_state >= 0) {
+            span.goto_state = map_state(span.goto_state);
+          }
+          int32_t style_id = span.style.empty() ? -1 : rule.getStyleId(span.style);
+          span.style_id = style_id < 0 ? SyntaxRule::kNoStyleId : style_id;
+        }
+      }
+    }
+  }
+
+  MemoryUsage DocumentHighlight::memoryUsage() const {
+    MemoryUsage usage;
+    usage.span_vectors = sizeof(DocumentHighlight) + chunks_.capacity() * sizeof(Ptr<HighlightBlockChunk>)
+      + chunk_first_lines_.capacity() * sizeof(size_t);
+    for (const Ptr<HighlightBlockChunk>& chunk : chunks_) {
+      usage.span_vectors += sizeof(HighlightBlockChunk) + kSharedControlBlockBytes
+        + chunk->blocks.capacity() * sizeof(Ptr<HighlightBlock>) + chunk->block_first_lines.capacity() * sizeof(size_t);
+      for (const Ptr<HighlightBlock>& block : chunk->blocks) {
+        // 每个块与shared_ptr控制块一起分配
+        usage.span_vectors += sizeof(HighlightBlock) + kSharedControlBlockBytes
+          + block->lines.capacity() * sizeof(LineRecord) + block->spans.capacity() * sizeof(TokenSpan);
+        for (const TokenSpan& span : block->spans) {
+          usage.span_strings += MemoryUsage::stringBytes(span.matched_text) + MemoryUsage::stringBytes(span.style);
+        }
+      }
+    }
+    return usage;
+  }
+
+  Ptr<const DocumentHighlight> DocumentHighlight::snapshot() const {
+    // 只复制段指针，开销与段数成正比
+    return MAKE_PTR<const DocumentHighlight>(*this);
   }
 
   void DocumentHighlight::reset() {
-    lines.clear();
+    chunks_.clear();
+    chunks_.shrink_to_fit();
+    chunk_first_lines_.clear();
+    chunk_first_lines_.shrink_to_fit();
+    line_count_ = 0;
+    block_count_ = 0;
+  }
+
+  DocumentHighlight::BlockLocation DocumentHighlight::locateLine(size_t line) const {
+    if (line >= line_count_) {
+      const HighlightBlockChunk& last_chunk = *chunks_.back();
+      return {chunks_.size() - 1, last_chunk.blocks.size() - 1, last_chunk.blocks.back()->lines.size()};
+    }
+    auto chunk_it = std::upper_bound(chunk_first_lines_.begin(), chunk_first_lines_.end(), line);
+    size_t chunk_idx = static_cast<size_t>(chunk_it - chunk_first_lines_.begin()) - 1;
+    const HighlightBlockChunk& chunk = *chunks_[chunk_idx];
+    size_t chunk_line = line - chunk_first_lines_[chunk_idx];
+    auto block_it = std::upper_bound(chunk.block_first_lines.begin(), chunk.block_first_lines.end(), chunk_line);
+    size_t block_idx = static_cast<size_t>(block_it - chunk.block_first_lines.begin()) - 1;
+    return {chunk_idx, block_idx, chunk_line - chunk.block_first_lines[block_idx]};
+  }
+
+  HighlightBlockChunk& DocumentHighlight::mutableChunk(size_t chunk_idx) {
+    Ptr<HighlightBlockChunk>& chunk = chunks_[chunk_idx];
+    if (chunk.use_count() > 1) {
+      chunk = MAKE_PTR<HighlightBlockChunk>(*chunk);
+    } else {
+      // 快照可能刚在其他线程释放，与其引用计数递减同步后才能安全修改
+      std::atomic_thread_fence(std::memory_order_acquire);
+    }
+    return *chunk;
+  }
+
+  HighlightBlock& DocumentHighlight::mutableBlock(HighlightBlockChunk& chunk, size_t block_idx) {
+    Ptr<HighlightBlock>& block = chunk.blocks[block_idx];
+    if (block.use_count() > 1) {
+      block = MAKE_PTR<HighlightBlock>(*block);
+    } else {
+      std::atomic_thread_fence(std::memory_order_acquire);
+    }
+    return *block;
+  }
+
+  void DocumentHighlight::splitBlock(HighlightBlockChunk& chunk, size_t block_idx) {
+    HighlightBlock& block = mutableBlock(chunk, block_idx);
+    if (block.lines.size() <= kMaxBlockLines) {
+      return;
+    }
+    // 拆分成若干半满的块，给之后的插入留出空间
+    constexpr size_t kSplitLines = kMaxBlockLines / 2;
+    List<Ptr<HighlightBlock>> new_blocks;
+    for (size_t line_idx = kSplitLines; line_idx < block.lines.size(); line_idx += kSplitLines) {
+      size_t line_end = std::min(line_idx + kSplitLines, block.lines.size());
+      uint32_t span_begin = block.lines[line_idx].span_start;
+      const LineRecord& last_record = block.lines[line_end - 1];
+      uint32_t span_end = last_record.span_start + last_record.span_count;
+      Ptr<HighlightBlock> new_block = MAKE_PTR<HighlightBlock>();
+      new_block->spans.assign(std::make_move_iterator(block.spans.begin() + span_begin),
+        std::make_move_iterator(block.spans.begin() + span_end));
+      for (size_t i = line_idx; i < line_end; ++i) {
+        new_block->lines.push_back({block.lines[i].span_start - span_begin, block.lines[i].span_count});
+      }
+      new_blocks.push_back(new_block);
+    }
+    const LineRecord& last_kept = block.lines[kSplitLines - 1];
+    block.spans.erase(block.spans.begin() + last_kept.span_start + last_kept.span_count, block.spans.end());
+    block.lines.erase(block.lines.begin() + kSplitLines, block.lines.end());
+    chunk.blocks.insert(chunk.blocks.begin() + static_cast<std::ptrdiff_t>(block_idx + 1),
+      new_blocks.begin(), new_blocks.end());
+    chunk.block_first_lines.insert(chunk.block_first_lines.begin() + static_cast<std::ptrdiff_t>(block_idx + 1),
+      new_blocks.size(), 0);
+    block_count_ += new_blocks.size();
+  }
+
+  void DocumentHighlight::splitChunk(size_t chunk_idx) {
+    HighlightBlockChunk& chunk = mutableChunk(chunk_idx);
+    if (chunk.blocks.size() <= kMaxChunkBlocks) {
+      return;
+    }
+    // 与块一样拆分成若干半满的段
+    constexpr size_t kSplitBlocks = kMaxChunkBlocks / 2;
+    List<Ptr<HighlightBlockChunk>> new_chunks;
+    for (size_t block_idx = kSplitBlocks; block_idx < chunk.blocks.size(); block_idx += kSplitBlocks) {
+      size_t block_end = std::min(block_idx + kSplitBlocks, chunk.blocks.size());
+      Ptr<HighlightBlockChunk> new_chunk = MAKE_PTR<HighlightBlockChunk>();
+      new_chunk->blocks.assign(chunk.blocks.begin() + static_cast<std::ptrdiff_t>(block_idx),
+        chunk.blocks.begin() + static_cast<std::ptrdiff_t>(block_end));
+      new_chunk->block_first_lines.resize(new_chunk->blocks.size());
+      updateBlockFirstLines(*new_chunk, 0);
+      new_chunks.push_back(new_chunk);
+    }
+    chunk.blocks.erase(chunk.blocks.begin() + kSplitBlocks, chunk.blocks.end());
+    chunk.block_first_lines.erase(chunk.block_first_lines.begin() + kSplitBlocks, chunk.block_first_lines.end());
+    updateBlockFirstLines(chunk, kSplitBlocks);
+    chunks_.insert(chunks_.begin() + static_cast<std::ptrdiff_t>(chunk_idx + 1), new_chunks.begin(), new_chunks.end());
+    chunk_first_lines_.insert(chunk_first_lines_.begin() + static_cast<std::ptrdiff_t>(chunk_idx + 1),
+      new_chunks.size(), 0);
+  }
+
+  void DocumentHighlight::updateBlockFirstLines(HighlightBlockChunk& chunk, size_t from_block) {
+    size_t first_line = from_block == 0 ? 0
+      : chunk.block_first_lines[from_block - 1] + chunk.blocks[from_block - 1]->lines.size();
+    for (size_t i = from_block; i < chunk.blocks.size(); ++i) {
+      chunk.block_first_lines[i] = first_line;
+      first_line += chunk.blocks[i]->lines.size();
+    }
+    chunk.line_count = first_line;
+  }
+
+  void DocumentHighlight::updateChunkFirstLines(size_t from_chunk) {
+    size_t first_line = from_chunk == 0 ? 0
+      : chunk_first_lines_[from_chunk - 1] + chunks_[from_chunk - 1]->line_count;
+    for (size_t i = from_chunk; i < chunks_.size(); ++i) {
+      chunk_first_lines_[i] = first_line;
+      first_line += chunks_[i]->line_count;
+    }
+  }
+
+  // ===================================== MatchResult ============================================
+  void MatchResult::reset() {
+    matched = false;
+    start = 0;
+    length = 0;
+    state = -1;
+    token_rule_idx = -1;
+    is_potential_multi_line = false;
+    matched_group = -1;
+    style.clear();
+    style_id = 0;
+    goto_state = -1;
+    matched_text.clear();
+    exhausted = false;
+    limit_exceeded = false;
+  }
+
+  // ===================================== MatchScratch ============================================
+  /// 每个线程独立的正则匹配暂存数据，编译后的正则表达式只读，可被多个线程共享
+  struct MatchScratch {
+    OnigRegion* region;
+    OnigMatchParam* match_param;
+
+    MatchScratch() {
+      region = onig_region_new();
+      match_param = onig_new_match_param();
+      onig_initialize_match_param(match_param);
+    }
+
+    ~MatchScratch() {
+      onig_region_free(region, 1);
+      onig_free_match_param(match_param);
+    }
+
+    static MatchScratch& current() {
+      thread_local MatchScratch scratch;
+      return scratch;
+    }
+  };
+
+  // ===================================== CancellationToken ============================================
+  void CancellationToken::cancel() {
+    cancelled_.store(true, std::memory_order_release);
+  }
+
+  bool CancellationToken::isCancelled() const {
+    return cancelled_.load(std::memory_order_acquire);
   }
 
   // ===================================== DocumentAnalyzer ============================================
-  DocumentAnalyzer::DocumentAnalyzer(const Ptr<Document>& document, const Ptr<SyntaxRule>& rule)
-    : document_(document), rule_(rule) {
+  /// 所有分析器的异步任务共享的线程池，分析器没有异步调用时不占用线程
+  static ThreadPool& getAsyncThreadPool() {
+    static ThreadPool pool;
+    return pool;
+  }
+
+  DocumentAnalyzer::DocumentAnalyzer(const Ptr<Document>& document, const Ptr<const SyntaxRule>& rule)
+    : document_(document), rule_(rule), async_queue_(getAsyncThreadPool()) {
     highlight_ = MAKE_PTR<DocumentHighlight>();
+    memory_bytes_ = memoryUsageLocked().total();
   }
 
-  Ptr<DocumentHighlight> DocumentAnalyzer::analyzeFully() {
+  DocumentAnalyzer::~DocumentAnalyzer() = default;
+
+  Ptr<DocumentHighlight> DocumentAnalyzer::analyzeFully(const Ptr<CancellationToken>& token) {
+    std::lock_guard<std::mutex> lock(analyze_mutex_);
+    return analyzeFullyLocked(token);
+  }
+
+  Ptr<DocumentHighlight> DocumentAnalyzer::analyzeFullyLocked(const Ptr<CancellationToken>& token) {
+    // 首次完整分析先查找磁盘缓存，命中时不执行任何匹配
+    if (disk_cache_ != nullptr && !fully_analyzed_
+      && disk_cache_->load(*document_, *rule_, *highlight_, line_states_)) {
+      fully_analyzed_ = true;
+      dirty_line_ = kNoDirtyLine;
+      stale_line_ = kNoDirtyLine;
+      if (snapshot_enabled_) {
+        publishSnapshot();
+      }
+      return highlight_;
+    }
     int32_t current_state = SyntaxRule::kDefaultStateId;
     const size_t line_count = document_->getLineCount();
     line_states_.resize(line_count, SyntaxRule::kDefaultStateId);
-    highlight_->reset();
+    // 已有的行按行号原地覆盖，高亮块数量不变的行不会重新分配
+    highlight_->resize(line_count);
     for (size_t line_num = 0; line_num < line_count; ++line_num) {
-      Ptr<LineHighlight> line_highlight = analyzeLineWithState(line_num, current_state);
-      highlight_->addLine(line_highlight);
+      if (token != nullptr && token->isCancelled()) {
+        dirty_line_ = std::min(dirty_line_.load(), line_num);
+        return nullptr;
+      }
+      highlight_->setLineSpans(line_num, analyzeLineWithState(line_num, current_state));
       current_state = line_states_[line_num];
     }
+    dirty_line_ = kNoDirtyLine;
+    stale_line_ = kNoDirtyLine;
+    // 未结束的跨行匹配上下文无法从缓存恢复，这样的结果不写入
+    if (disk_cache_ != nullptr && !fully_analyzed_ && multi_line_contexts_.empty()) {
+      disk_cache_->store(*document_, *rule_, *highlight_, line_states_);
+    }
+    fully_analyzed_ = true;
+    if (snapshot_enabled_) {
+      publishSnapshot();
+    }
     return highlight_;
   }
 
-  Ptr<DocumentHighlight> DocumentAnalyzer::updateHighlight(const TextRange& range, const String& new_text) {
+  bool DocumentAnalyzer::analyzeLines(const LineVisitor& visitor, const Ptr<CancellationToken>& token) {
+    std::lock_guard<std::mutex> lock(analyze_mutex_);
+    int32_t current_state = SyntaxRule::kDefaultStateId;
+    const size_t line_count = document_->getLineCount();
+    line_states_.resize(line_count, SyntaxRule::kDefaultStateId);
+    for (size_t line_num = 0; line_num < line_count; ++line_num) {
+      if (token != nullptr && token->isCancelled()) {
+        return false;
+      }
+      visitor(line_num, document_->getLine(line_num), analyzeLineWithState(line_num, current_state));
+      current_state = line_states_[line_num];
+    }
+    return true;
+  }
+
+  Ptr<DocumentHighlight> DocumentAnalyzer::updateHighlight(const TextRange& range, const String& new_text,
+    const Ptr<CancellationToken>& token) {
+    std::unique_lock<std::mutex> lock = lockForEdit();
+    const size_t old_line_count = document_->getLineCount();
     document_->patch(range, new_text);
     size_t new_line_count = document_->getLineCount();
+    // 增删的行都紧跟在修改的起始行之后，只需改动该行所在的块，之后的行保持与文本对齐
+    const std::ptrdiff_t line_delta = static_cast<std::ptrdiff_t>(new_line_count)
+      - static_cast<std::ptrdiff_t>(old_line_count);
+    if (line_delta != 0 && range.start.line < old_line_count && line_states_.size() == old_line_count
+      && highlight_->getLineCount() == old_line_count) {
+      auto states_it = line_states_.begin() + static_cast<std::ptrdiff_t>(range.start.line + 1);
+      if (line_delta > 0) {
+        line_states_.insert(states_it, static_cast<size_t>(line_delta), SyntaxRule::kDefaultStateId);
+        highlight_->insertLines(range.start.line + 1, static_cast<size_t>(line_delta));
+      } else {
+        line_states_.erase(states_it, states_it - line_delta);
+        highlight_->removeLines(range.start.line + 1, static_cast<size_t>(-line_delta));
+      }
+    }
     if (line_states_.size() != new_line_count) {
       line_states_.resize(new_line_count, SyntaxRule::kDefaultStateId);
     }
-    if (highlight_->lines.size() != new_line_count) {
-      highlight_->lines.resize(new_line_count);
-    }
+    highlight_->resize(new_line_count);
     // 清理受影响的跨行上下文
     List<int32_t> contexts_to_remove;
     for (const std::pair<const int32_t, MultiLineContext>& context : multi_line_contexts_) {
@@ -368,123 +1010,508 @@ namespace NS_FASTHIGHLIGHT {
     for (int32_t state : contexts_to_remove) {
       multi_line_contexts_.erase(state);
     }
+    // 热重载的后台分析尚未到达的行随修改整体移动
+    const size_t stale_line = stale_line_;
+    if (stale_line != kNoDirtyLine && range.start.line < stale_line) {
+      stale_line_ = static_cast<size_t>(std::max<std::ptrdiff_t>(static_cast<std::ptrdiff_t>(stale_line) + line_delta,
+        static_cast<std::ptrdiff_t>(range.start.line)));
+    }
 
-    size_t start_line = range.start.line;
-    size_t end_line = computeAffectedLines(range, new_text);
+    // 上次分析被取消时，从未完成的行开始一直分析到文本末尾，不再提前结束
+    const bool has_dirty_lines = dirty_line_ != kNoDirtyLine;
+    size_t start_line = std::min(range.start.line, std::min(dirty_line_.load(), new_line_count));
+    size_t end_line = has_dirty_lines ? new_line_count : computeAffectedLines(range, new_text);
     int32_t current_state = (start_line > 0) ? line_states_[start_line - 1] : SyntaxRule::kDefaultStateId;
 
     bool state_stabilized = false;
+    size_t analyzed_end = start_line;
     for (size_t line_num = start_line; line_num < new_line_count && !state_stabilized; ++line_num) {
+      if (token != nullptr && token->isCancelled()) {
+        dirty_line_ = line_num;
+        return nullptr;
+      }
       auto old_state = line_states_[line_num];
-      auto line_highlight = analyzeLineWithState(line_num, current_state);
-      highlight_->lines[line_num] = line_highlight;
+      highlight_->setLineSpans(line_num, analyzeLineWithState(line_num, current_state));
       current_state = line_states_[line_num];
+      analyzed_end = line_num + 1;
 
       if (line_num > end_line && old_state == current_state) {
         state_stabilized = true;
         for (size_t check_line = line_num + 1; check_line < new_line_count; ++check_line) {
-          if (line_states_[check_line] != highlight_->lines[check_line]->spans.back().state) {
+          LineSpans check_spans = highlight_->getLineSpans(check_line);
+          // 空行没有高亮块，无需比较；最后一个高亮块跳转了state时(如"*/"结尾)，行尾state为跳转后的state
+          if (check_spans.empty()) {
+            continue;
+          }
+          const TokenSpan& last_span = check_spans.back();
+          int32_t span_end_state = last_span.goto_state >= 0 ? last_span.goto_state : last_span.state;
+          if (line_states_[check_line] != span_end_state) {
             state_stabilized = false;
             break;
           }
         }
+        // 没有重新分析的行整体移动了位置，修正高亮块中记录的行号
+        if (state_stabilized) {
+          highlight_->offsetLineNumbers(line_num + 1, line_delta);
+        }
       }
     }
+    // 从尚未重新分析的行之前连续分析过去时，这些行已经按新规则分析
+    if (start_line <= stale_line_ && analyzed_end > stale_line_) {
+      stale_line_ = analyzed_end;
+    }
+    dirty_line_ = kNoDirtyLine;
+    if (snapshot_enabled_) {
+      publishSnapshot();
+    }
     return highlight_;
   }
 
+  std::future<Ptr<DocumentHighlight>> DocumentAnalyzer::analyzeFullyAsync(const Ptr<CancellationToken>& token) {
+    Ptr<std::promise<Ptr<DocumentHighlight>>> promise = MAKE_PTR<std::promise<Ptr<DocumentHighlight>>>();
+    analyzeFullyAsync(token, [promise](const Ptr<DocumentHighlight>& highlight) {
+      promise->set_value(highlight);
+    });
+    return promise->get_future();
+  }
+
+  void DocumentAnalyzer::analyzeFullyAsync(const Ptr<CancellationToken>& token, const AnalyzeCallback& callback) {
+    postAsyncTask([this, token, callback]() {
+      Ptr<DocumentHighlight> highlight = analyzeFully(token);
+      callback(highlight);
+    });
+  }
+
+  std::future<Ptr<DocumentHighlight>> DocumentAnalyzer::updateHighlightAsync(const TextRange& range,
+    const String& new_text, const Ptr<CancellationToken>& token) {
+    Ptr<std::promise<Ptr<DocumentHighlight>>> promise = MAKE_PTR<std::promise<Ptr<DocumentHighlight>>>();
+    updateHighlightAsync(range, new_text, token, [promise](const Ptr<DocumentHighlight>& highlight) {
+      promise->set_value(highlight);
+    });
+    return promise->get_future();
+  }
+
+  void DocumentAnalyzer::updateHighlightAsync(const TextRange& range, const String& new_text,
+    const Ptr<CancellationToken>& token, const AnalyzeCallback& callback) {
+    postAsyncTask([this, range, new_text, token, callback]() {
+      Ptr<DocumentHighlight> highlight = updateHighlight(range, new_text, token);
+      callback(highlight);
+    });
+  }
+
+  bool DocumentAnalyzer::hasDirtyLines() const {
+    return dirty_line_ != kNoDirtyLine || stale_line_ != kNoDirtyLine;
+  }
+
+  MemoryUsage DocumentAnalyzer::memoryUsage() {
+    std::lock_guard<std::mutex> lock(analyze_mutex_);
+    MemoryUsage usage = memoryUsageLocked();
+    memory_bytes_ = usage.total();
+    return usage;
+  }
+
+  size_t DocumentAnalyzer::estimateMemoryBytes() {
+    std::unique_lock<std::mutex> lock(analyze_mutex_, std::try_to_lock);
+    if (lock.owns_lock()) {
+      memory_bytes_ = memoryUsageLocked().total();
+    }
+    return memory_bytes_;
+  }
+
+  bool DocumentAnalyzer::releaseHighlightCache() {
+    std::unique_lock<std::mutex> lock(analyze_mutex_, std::try_to_lock);
+    if (!lock.owns_lock()) {
+      return false;
+    }
+    // 释放后所有行都视为未分析，行状态仍然有效，可以直接从任意行开始分析
+    highlight_->reset();
+    line_spans_.clear();
+    line_spans_.shrink_to_fit();
+    multi_line_contexts_.clear();
+    if (line_cache_ != nullptr) {
+      line_cache_->clear();
+    }
+    dirty_line_ = 0;
+    memory_bytes_ = memoryUsageLocked().total();
+    return true;
+  }
+
   Ptr<LineHighlight> DocumentAnalyzer::analyzeLine(size_t line) {
+    std::unique_lock<std::mutex> lock = lockForEdit();
     int32_t start_state = (line > 0) ? line_states_[line - 1] : SyntaxRule::kDefaultStateId;
-    return analyzeLineWithState(line, start_state);
+    LineSpans spans = analyzeLineWithState(line, start_state);
+    Ptr<LineHighlight> highlight = MAKE_PTR<LineHighlight>();
+    highlight->spans.assign(spans.begin(), spans.end());
+    return highlight;
   }
 
-  Ptr<LineHighlight> DocumentAnalyzer::analyzeLineWithState(size_t line, int32_t start_state) {
-    Ptr<LineHighlight> highlight = MAKE_PTR<LineHighlight>();
-    const String& line_text = document_->getLine(line);
+  void DocumentAnalyzer::setProfilingEnabled(bool enabled) {
+    // 分析线程在matchAtPosition中使用profiler_，不能在分析过程中替换
+    std::lock_guard<std::mutex> lock(analyze_mutex_);
+    profiler_ = enabled ? MAKE_PTR<GrammarProfiler>(rule_) : nullptr;
+  }
+
+  Ptr<const SyntaxRule> DocumentAnalyzer::getSyntaxRule() const {
+    // 热重载可能在其他线程中替换规则
+    return std::atomic_load(&rule_);
+  }
+
+  Ptr<GrammarProfiler> DocumentAnalyzer::getProfiler() {
+    std::lock_guard<std::mutex> lock(analyze_mutex_);
+    return profiler_;
+  }
+
+  void DocumentAnalyzer::setSnapshotEnabled(bool enabled) {
+    std::lock_guard<std::mutex> lock(analyze_mutex_);
+    snapshot_enabled_ = enabled;
+    if (enabled && highlight_->getLineCount() > 0 && dirty_line_ == kNoDirtyLine) {
+      publishSnapshot();
+    } else if (!enabled) {
+      published_.publish(nullptr);
+    }
+  }
+
+  Ptr<const DocumentHighlight> DocumentAnalyzer::getSnapshot() const {
+    PublishChannel<HighlightVersion>::ReadGuard guard = published_.read();
+    return guard ? guard->highlight : nullptr;
+  }
+
+  PublishChannel<HighlightVersion>::ReadGuard DocumentAnalyzer::readPublished() const {
+    return published_.read();
+  }
+
+  void DocumentAnalyzer::setAnalyzeOptions(const AnalyzeOptions& options) {
+    // 匹配过程中会读取options_，等待正在进行的分析完成后再修改
+    std::lock_guard<std::mutex> lock(analyze_mutex_);
+    options_ = options;
+    has_match_limits_ = options.retry_limit_in_search > 0 || options.retry_limit_in_match > 0
+      || options.line_time_budget_us > 0;
+  }
+
+  void DocumentAnalyzer::setLineCacheCapacity(size_t capacity_bytes) {
+    std::lock_guard<std::mutex> lock(analyze_mutex_);
+    if (capacity_bytes == 0) {
+      line_cache_ = nullptr;
+    } else if (line_cache_ == nullptr) {
+      line_cache_ = MAKE_UPTR<LineResultCache>(capacity_bytes);
+    } else {
+      line_cache_->setCapacity(capacity_bytes);
+    }
+  }
+
+  LineCacheStats DocumentAnalyzer::getLineCacheStats() {
+    std::lock_guard<std::mutex> lock(analyze_mutex_);
+    return line_cache_ == nullptr ? LineCacheStats() : line_cache_->getStats();
+  }
+
+  void DocumentAnalyzer::setViewport(size_t start_line, size_t end_line) {
+    std::lock_guard<std::mutex> lock(analyze_mutex_);
+    viewport_start_ = start_line;
+    viewport_end_ = end_line;
+  }
+
+  void DocumentAnalyzer::reloadSyntaxRule(const Ptr<const SyntaxRule>& rule, const AnalyzeCallback& callback) {
+    Ptr<CancellationToken> token = MAKE_PTR<CancellationToken>();
+    {
+      std::lock_guard<std::mutex> lock(analyze_mutex_);
+      if (reload_token_ != nullptr) {
+        reload_token_->cancel();
+      }
+      reload_token_ = token;
+      // 旧规则的state编号按名称映射到新规则，大部分行的起始state在编辑语法规则后仍然正确
+      HashMap<int32_t, int32_t> state_mapping;
+      for (const std::pair<const String, int32_t>& pair : rule_->state_id_map_) {
+        auto it = rule->state_id_map_.find(pair.first);
+        state_mapping.emplace(pair.second, it == rule->state_id_map_.end() ? SyntaxRule::kDefaultStateId : it->second);
+      }
+      for (int32_t& state : line_states_) {
+        auto it = state_mapping.find(state);
+        state = it == state_mapping.end() ? SyntaxRule::kDefaultStateId : it->second;
+      }
+      // 可见区域之外的行在后台重新分析之前保留原有高亮，编号先映射到新规则，与getSyntaxRule()一致
+      highlight_->remapRule(*rule, state_mapping);
+      std::atomic_store(&rule_, rule);
+      // 跨行上下文和行缓存中的state、style编号都属于旧规则
+      multi_line_contexts_.clear();
+      if (line_cache_ != nullptr) {
+        line_cache_->clear();
+      }
+      if (profiler_ != nullptr) {
+        profiler_ = MAKE_PTR<GrammarProfiler>(rule_);
+      }
+      fully_analyzed_ = false;
+      stale_line_ = 0;
+
+      size_t start_line = viewport_end_ > 0 ? viewport_start_ : 0;
+      size_t end_line = viewport_end_ > 0 ? viewport_end_ : DocumentHighlight::kMaxBlockLines;
+      analyzeRangeLocked(start_line, end_line);
+      // 之后的完整分析从第一行开始，可见区域分析中产生的跨行上下文不再需要
+      multi_line_contexts_.clear();
+      if (snapshot_enabled_) {
+        publishSnapshot();
+      }
+    }
+    postAsyncTask([this, token, callback]() {
+      continueReload(token, callback);
+    });
+  }
+
+  void DocumentAnalyzer::continueReload(const Ptr<CancellationToken>& token, const AnalyzeCallback& callback) {
+    Ptr<DocumentHighlight> highlight;
+    {
+      std::unique_lock<std::mutex> lock(analyze_mutex_);
+      // 等待锁的编辑先执行，后台分析每次最多占用锁一段的时间
+      edit_cv_.wait(lock, [this]() { return waiting_edits_ == 0; });
+      // 已被之后的热重载取代时由新的后台任务重新分析
+      if (!token->isCancelled()) {
+        // 期间的完整分析已经清除了标记时不需要再分析
+        const size_t line_count = document_->getLineCount();
+        const size_t start_line = std::min(stale_line_.load(), line_count);
+        const size_t end_line = std::min(start_line + kReloadChunkLines, line_count);
+        analyzeRangeLocked(start_line, end_line);
+        if (end_line < line_count) {
+          stale_line_ = end_line;
+          if (snapshot_enabled_) {
+            publishSnapshot();
+          }
+          postAsyncTask([this, token, callback]() {
+            continueReload(token, callback);
+          });
+          return;
+        }
+        stale_line_ = kNoDirtyLine;
+        // 因取消而未完成的行仍需要之后的分析补上
+        if (dirty_line_ == kNoDirtyLine) {
+          if (disk_cache_ != nullptr && !fully_analyzed_ && multi_line_contexts_.empty()) {
+            disk_cache_->store(*document_, *rule_, *highlight_, line_states_);
+          }
+          fully_analyzed_ = true;
+        }
+        if (snapshot_enabled_) {
+          publishSnapshot();
+        }
+        highlight = highlight_;
+      }
+    }
+    if (callback != nullptr) {
+      callback(highlight);
+    }
+  }
+
+  std::unique_lock<std::mutex> DocumentAnalyzer::lockForEdit() {
+    ++waiting_edits_;
+    std::unique_lock<std::mutex> lock(analyze_mutex_);
+    --waiting_edits_;
+    edit_cv_.notify_all();
+    return lock;
+  }
+
+  void DocumentAnalyzer::setDiskCache(const Ptr<HighlightDiskCache>& cache) {
+    std::lock_guard<std::mutex> lock(analyze_mutex_);
+    disk_cache_ = cache;
+  }
+
+  uint64_t DocumentAnalyzer::getLimitExceededCount() const {
+    return limit_exceeded_count_;
+  }
+
+  MemoryUsage DocumentAnalyzer::memoryUsageLocked() const {
+    MemoryUsage usage = document_->memoryUsage();
+    usage.line_states = line_states_.capacity() * sizeof(int32_t);
+    usage += highlight_->memoryUsage();
+    usage.span_vectors += line_spans_.capacity() * sizeof(TokenSpan);
+    for (const TokenSpan& span : line_spans_) {
+      usage.span_strings += MemoryUsage::stringBytes(span.matched_text) + MemoryUsage::stringBytes(span.style);
+    }
+    usage.hash_maps += MemoryUsage::hashTableBytes(multi_line_contexts_);
+    if (line_cache_ != nullptr) {
+      usage.line_cache = line_cache_->memoryBytes();
+    }
+    for (const std::pair<const int32_t, MultiLineContext>& pair : multi_line_contexts_) {
+      usage.multi_line_contexts += MemoryUsage::stringBytes(pair.second.style)
+        + MemoryUsage::stringBytes(pair.second.accumulated_text);
+    }
+    usage.other += sizeof(DocumentAnalyzer);
+    return usage;
+  }
+
+  void DocumentAnalyzer::analyzeRangeLocked(size_t start_line, size_t end_line) {
+    const size_t line_count = document_->getLineCount();
+    end_line = std::min(end_line, line_count);
+    if (start_line >= end_line) {
+      return;
+    }
+    line_states_.resize(line_count, SyntaxRule::kDefaultStateId);
+    highlight_->resize(line_count);
+    int32_t current_state = start_line > 0 ? line_states_[start_line - 1] : SyntaxRule::kDefaultStateId;
+    for (size_t line_num = start_line; line_num < end_line; ++line_num) {
+      highlight_->setLineSpans(line_num, analyzeLineWithState(line_num, current_state));
+      current_state = line_states_[line_num];
+    }
+  }
+
+  void DocumentAnalyzer::publishSnapshot() {
+    UPtr<HighlightVersion> version = MAKE_UPTR<HighlightVersion>();
+    version->revision = document_->getRevision();
+    version->highlight = highlight_->snapshot();
+    published_.publish(std::move(version));
+  }
 
+  void DocumentAnalyzer::postAsyncTask(std::function<void()> task) {
+    // 析构时丢弃尚未执行的任务，对应的future会得到broken_promise异常
+    async_queue_.post(std::move(task));
+  }
+
+  TokenSpan& DocumentAnalyzer::SpanWriter::next() {
+    if (count == spans.size()) {
+      spans.emplace_back();
+    }
+    return spans[count++];
+  }
+
+  LineSpans DocumentAnalyzer::SpanWriter::finish() const {
+    return {spans.data(), count};
+  }
+
+  LineSpans DocumentAnalyzer::analyzeLineWithState(size_t line, int32_t start_state) {
+    return analyzeLineText(line, document_->getLine(line), start_state, line_states_[line]);
+  }
+
+  LineSpans DocumentAnalyzer::analyzeLineText(size_t line, const String& line_text, int32_t start_state,
+    int32_t& end_state) {
+    // 跨行匹配中的行还依赖跨行上下文，性能分析时需要真实执行匹配，都不使用缓存
+    if (line_cache_ == nullptr || line_text.empty() || profiler_ != nullptr
+      || multi_line_contexts_.find(start_state) != multi_line_contexts_.end()) {
+      return tokenizeLine(line, line_text, start_state, end_state);
+    }
+    if (const LineResultCache::Entry* entry = line_cache_->find(start_state, line_text)) {
+      SpanWriter writer {line_spans_};
+      for (const TokenSpan& cached_span : entry->spans) {
+        TokenSpan& span = writer.next();
+        span = cached_span;
+        span.range.start.line = line;
+        span.range.end.line = line;
+      }
+      end_state = entry->end_state;
+      return writer.finish();
+    }
+    uint64_t multi_line_start_count = multi_line_start_count_;
+    uint64_t limit_exceeded_count = limit_exceeded_count_;
+    LineSpans spans = tokenizeLine(line, line_text, start_state, end_state);
+    // 开始了跨行匹配或触发了匹配限制的结果不只取决于行文本，不缓存
+    if (multi_line_start_count == multi_line_start_count_ && limit_exceeded_count == limit_exceeded_count_) {
+      line_cache_->insert(start_state, line_text, spans, end_state);
+    }
+    return spans;
+  }
+
+  LineSpans DocumentAnalyzer::tokenizeLine(size_t line, const String& line_text, int32_t start_state,
+    int32_t& end_state) {
+    SpanWriter writer {line_spans_};
     if (line_text.empty()) {
-      line_states_[line] = start_state;
-      return highlight;
+      end_state = start_state;
+      return writer.finish();
     }
 
     size_t current_char_pos = 0;
     int32_t current_state = start_state;
     size_t line_char_count = Utf8Util::countChars(line_text);
+    line_cursor_.reset(line_text);
+    if (options_.line_time_budget_us > 0) {
+      line_deadline_ = std::chrono::steady_clock::now() + std::chrono::microseconds(options_.line_time_budget_us);
+    }
 
     // 检查跨行上下文
     auto context_it = multi_line_contexts_.find(current_state);
     if (context_it != multi_line_contexts_.end()) {
       MultiLineContext& context = context_it->second;
-      MultiLineContinueResult result = continueMultiLineMatch(line, current_char_pos, context);
+      MultiLineContinueResult result = continueMultiLineMatch(line, line_text, current_char_pos, context);
       // 跨行匹配结束
       if (result.completed) {
-        highlight->spans.push_back(result.span);
+        writer.next() = result.span;
         current_char_pos = result.span.range.end.column;
         current_state = result.new_state;
         multi_line_contexts_.erase(context_it);
       } else {
         // 整行都属于当前状态下的跨行匹配，继续当前状态和style
-        TokenSpan span;
+        TokenSpan& span = writer.next();
         span.range.start = {line, 0};
         span.range.end = {line, line_char_count};
         span.state = current_state;
         span.style = context.style;
+        span.style_id = context.style_id;
         span.matched_text = line_text;
-        highlight->spans.push_back(span);
-        line_states_[line] = current_state;
-        return highlight;
+        span.goto_state = -1;
+        end_state = current_state;
+        return writer.finish();
       }
     }
 
     // 正常单行匹配
+    MatchResult& match_result = match_result_;
     while (current_char_pos < line_char_count) {
-      MatchResult match_result = matchAtPosition(line_text, current_char_pos, current_state);
+      bool budget_exceeded = options_.line_time_budget_us > 0 && std::chrono::steady_clock::now() >= line_deadline_;
+      if (budget_exceeded) {
+        match_result.reset();
+      } else {
+        matchAtPosition(line_text, current_char_pos, current_state, match_result);
+      }
+      if (budget_exceeded || match_result.limit_exceeded) {
+        // 触发匹配限制，该行剩余文本降级为无样式输出
+        processUnmatchedText(writer, line, line_text, current_char_pos, line_char_count - current_char_pos, current_state);
+        current_char_pos = line_char_count;
+        limit_exceeded_count_++;
+        break;
+      }
       if (!match_result.matched) {
-        TokenSpan span;
-        span.range.start = {line, current_char_pos};
-        span.range.end = {line, current_char_pos + 1};
-        span.state = current_state;
-        span.style = "";
-        span.matched_text = Utf8Util::utf8Substr(line_text, current_char_pos, 1);
-        highlight->spans.push_back(span);
-        current_char_pos++;
+        // 剩余文本已不存在任何匹配时整体作为一个无样式的高亮块，否则只跳过一个字符
+        size_t unmatched_count = match_result.exhausted ? line_char_count - current_char_pos : 1;
+        processUnmatchedText(writer, line, line_text, current_char_pos, unmatched_count, current_state);
+        current_char_pos += unmatched_count;
         continue;
       }
+      // 匹配位置之前的文本没有规则能匹配
+      if (match_result.start > current_char_pos) {
+        processUnmatchedText(writer, line, line_text, current_char_pos,
+          match_result.start - current_char_pos, current_state);
+        current_char_pos = match_result.start;
+      }
       // 检查跨行匹配
-      if (isPotentialMultiLineMatch(match_result, line_text, current_char_pos)) {
+      if (isPotentialMultiLineMatch(match_result, line_char_count, current_char_pos)) {
         MultiLineStartResult multi_line_result = startMultiLineMatch(line, current_char_pos, current_state, match_result);
         if (multi_line_result.started) {
           // 开始跨行匹配
-          TokenSpan span;
+          TokenSpan& span = writer.next();
           span.range.start = {line, current_char_pos};
           span.range.end = {line, line_char_count};
           span.state = current_state;
           span.style = match_result.style;
-          span.matched_text = Utf8Util::utf8Substr(line_text, current_char_pos, line_char_count - current_char_pos);
-          highlight->spans.push_back(span);
+          span.style_id = match_result.style_id;
+          span.matched_text.assign(line_text, line_cursor_.charPosToBytePos(current_char_pos), String::npos);
+          span.goto_state = -1;
 
           current_char_pos = line_char_count;
           current_state = multi_line_result.new_state;
         } else {
           // 正常处理
-          processSingleLineMatch(highlight, line, current_char_pos, current_state, match_result);
+          processSingleLineMatch(writer, line, current_char_pos, current_state, match_result);
           current_char_pos += match_result.length;
-          if (match_result.goto_state > 0) {
+          if (match_result.goto_state >= 0) {
             current_state = match_result.goto_state;
           }
         }
       } else {
         // 正常单行匹配
-        processSingleLineMatch(highlight, line, current_char_pos, current_state, match_result);
+        processSingleLineMatch(writer, line, current_char_pos, current_state, match_result);
         current_char_pos += match_result.length;
-        if (match_result.goto_state > 0) {
+        if (match_result.goto_state >= 0) {
           current_state = match_result.goto_state;
         }
       }
     }
 
-    line_states_[line] = current_state;
-    return highlight;
+    end_state = current_state;
+    return writer.finish();
   }
 
   MultiLineStartResult DocumentAnalyzer::startMultiLineMatch(size_t line, size_t char_pos, int32_t current_state,
@@ -499,15 +1526,21 @@ namespace NS_FASTHIGHLIGHT {
     context.state = current_state;
     context.start_line = line;
     context.start_column = char_pos;
-    context.accumulated_text = match_result.matched_text;
+    if (accumulate_multi_line_text_) {
+      context.accumulated_text = match_result.matched_text;
+    }
     multi_line_contexts_[match_result.goto_state] = context;
+    ++multi_line_start_count_;
     return {true, match_result.goto_state};
   }
 
-  MultiLineContinueResult DocumentAnalyzer::continueMultiLineMatch(size_t line, size_t char_pos,
-                                                                   MultiLineContext& context) {
-    const String& line_text = document_->getLine(line);
-    MatchResult match_result = matchAtPosition(line_text, char_pos, context.state);
+  MultiLineContinueResult DocumentAnalyzer::continueMultiLineMatch(size_t line, const String& line_text,
+    size_t char_pos, MultiLineContext& context) {
+    MatchResult& match_result = match_result_;
+    matchAtPosition(line_text, char_pos, context.state, match_result);
+    if (match_result.limit_exceeded) {
+      limit_exceeded_count_++;
+    }
     if (match_result.matched) {
       MultiLineContinueResult result;
       result.completed = true;
@@ -515,18 +1548,25 @@ namespace NS_FASTHIGHLIGHT {
       result.span.range.end = {line, char_pos + match_result.length};
       result.span.state = context.state;
       result.span.style = context.style;
-      result.span.matched_text = context.accumulated_text + match_result.matched_text;
+      result.span.style_id = context.style_id;
+      if (accumulate_multi_line_text_) {
+        result.span.matched_text = context.accumulated_text + match_result.matched_text;
+      } else {
+        result.span.matched_text.assign(line_text, 0, line_cursor_.charPosToBytePos(char_pos + match_result.length));
+      }
       result.span.goto_state = match_result.goto_state;
       result.new_state = match_result.goto_state;
       return result;
     } else {
       // 继续累积
-      context.accumulated_text += line_text;
+      if (accumulate_multi_line_text_) {
+        context.accumulated_text += line_text;
+      }
       return {false, {}, -1};
     }
   }
 
-  bool DocumentAnalyzer::isPotentialMultiLineMatch(const MatchResult& match_result, const String& line_text,
+  bool DocumentAnalyzer::isPotentialMultiLineMatch(const MatchResult& match_result, size_t line_char_count,
     size_t current_pos) {
     if (match_result.token_rule_idx < 0) {
       return false;
@@ -534,68 +1574,207 @@ namespace NS_FASTHIGHLIGHT {
     if (match_result.is_potential_multi_line) {
       return true;
     }
-    size_t line_char_count = Utf8Util::countChars(line_text);
     if (current_pos + match_result.length >= line_char_count) {
       return match_result.goto_state > 0;
     }
     return false;
   }
 
-  void DocumentAnalyzer::processSingleLineMatch(Ptr<LineHighlight> highlight, size_t line_num, size_t char_pos,
+  void DocumentAnalyzer::processSingleLineMatch(SpanWriter& writer, size_t line_num, size_t char_pos,
     int32_t state, const MatchResult& match_result) {
-    TokenSpan span;
+    TokenSpan& span = writer.next();
     span.range.start = {line_num, char_pos};
     span.range.end = {line_num, char_pos + match_result.length};
     span.state = state;
     span.matched_text = match_result.matched_text;
     span.style = match_result.style;
+    span.style_id = match_result.style_id;
     span.goto_state = match_result.goto_state;
-    highlight->spans.push_back(span);
   }
 
-  MatchResult DocumentAnalyzer::matchAtPosition(const String& text, size_t start_char_pos, int32_t state) {
-    MatchResult result;
+  void DocumentAnalyzer::processUnmatchedText(SpanWriter& writer, size_t line_num, const String& line_text,
+    size_t char_pos, size_t char_count, int32_t state) {
+    TokenSpan& span = writer.next();
+    span.range.start = {line_num, char_pos};
+    span.range.end = {line_num, char_pos + char_count};
+    span.state = state;
+    size_t start_byte = line_cursor_.charPosToBytePos(char_pos);
+    size_t end_byte = line_cursor_.charPosToBytePos(char_pos + char_count);
+    span.matched_text.assign(line_text, start_byte, end_byte - start_byte);
+    span.style.clear();
+    span.style_id = SyntaxRule::kNoStyleId;
+    span.goto_state = -1;
+  }
+
+  /// 通过首字节预过滤找到下一个可能匹配的字节位置，找不到时返回文本长度
+  static size_t findCandidateBytePos(const StateRule& state_rule, const String& text, size_t start_byte_pos) {
+    const size_t text_length = text.length();
+    if (start_byte_pos >= text_length) {
+      return text_length;
+    }
+    if (state_rule.prefilter_byte >= 0) {
+      const void* found = std::memchr(text.data() + start_byte_pos, state_rule.prefilter_byte,
+        text_length - start_byte_pos);
+      return found == nullptr ? text_length : static_cast<const char*>(found) - text.data();
+    }
+    size_t byte_pos = start_byte_pos;
+    while (byte_pos < text_length && !state_rule.first_bytes.test(static_cast<unsigned char>(text[byte_pos]))) {
+      ++byte_pos;
+    }
+    return byte_pos;
+  }
+
+  void DocumentAnalyzer::matchAtPosition(const String& text, size_t start_char_pos, int32_t state, MatchResult& result) {
+    if (profiler_ == nullptr) {
+      searchAtPosition(text, start_char_pos, state, result);
+      return;
+    }
+    size_t start_byte = line_cursor_.charPosToBytePos(start_char_pos);
+    GrammarProfiler::Clock::time_point begin = GrammarProfiler::Clock::now();
+    searchAtPosition(text, start_char_pos, state, result);
+    GrammarProfiler::Clock::duration elapsed = GrammarProfiler::Clock::now() - begin;
+    size_t match_start_byte = result.matched ? line_cursor_.charPosToBytePos(result.start) : text.length();
+    profiler_->recordStateSearch(state, match_start_byte - start_byte, elapsed, result.matched);
+    profiler_->replayTokenRules(state, text, start_byte, result.matched ? result.token_rule_idx : -1, match_start_byte);
+  }
+
+  void DocumentAnalyzer::searchAtPosition(const String& text, size_t start_char_pos, int32_t state, MatchResult& result) {
+    result.reset();
     if (!rule_->containsRule(state)) {
-      return result;
+      result.exhausted = true;
+      return;
+    }
+    const StateRule& state_rule = rule_->getStateRule(state);
+    size_t start_byte_pos = line_cursor_.charPosToBytePos(start_char_pos);
+    // 跳过首字节不可能匹配任何token的位置
+    if (state_rule.has_prefilter) {
+      start_byte_pos = findCandidateBytePos(state_rule, text, start_byte_pos);
+      if (start_byte_pos >= text.length()) {
+        result.exhausted = true;
+        return;
+      }
     }
-    StateRule& state_rule = rule_->getStateRule(state);
-    size_t start_byte_pos = Utf8Util::charPosToBytePos(text, start_char_pos);
+    // 关键字只需要在正则匹配位置之前(含)查找
+    size_t keyword_limit_byte = text.length();
+    bool regex_found = false;
 
-    OnigRegion* region = onig_region_new();
-    const OnigUChar* start = (const OnigUChar*)(text.c_str() + start_byte_pos);
-    const OnigUChar* end = (const OnigUChar*)(text.c_str() + text.length());
-    const OnigUChar* range_end = end;
+    if (state_rule.regex != nullptr) {
+      MatchScratch& scratch = MatchScratch::current();
+      OnigRegion* region = scratch.region;
+      const OnigUChar* start = (const OnigUChar*)(text.c_str() + start_byte_pos);
+      const OnigUChar* end = (const OnigUChar*)(text.c_str() + text.length());
+      const OnigUChar* range_end = end;
 
-    int match_byte_pos = onig_search(state_rule.regex, (OnigUChar*)text.c_str(),
-      end, start, range_end, region, ONIG_OPTION_NONE);
-    if (match_byte_pos >= 0) {
-      size_t match_start_byte = match_byte_pos;
-      size_t match_end_byte = region->end[0];
-      if (match_end_byte <= match_start_byte) {
-        return result;
+      int match_byte_pos;
+      if (!has_match_limits_) {
+        match_byte_pos = onig_search(state_rule.regex.get(), (OnigUChar*)text.c_str(),
+          end, start, range_end, region, ONIG_OPTION_NONE);
+      } else {
+        OnigMatchParam* match_param = scratch.match_param;
+        onig_initialize_match_param(match_param);
+        if (options_.retry_limit_in_search > 0) {
+          onig_set_retry_limit_in_search_of_match_param(match_param, options_.retry_limit_in_search);
+        }
+        if (options_.retry_limit_in_match > 0) {
+          onig_set_retry_limit_in_match_of_match_param(match_param, options_.retry_limit_in_match);
+        }
+        if (options_.line_time_budget_us > 0) {
+          // 整行的剩余预算在每次匹配前按微秒检查，这里再限制单次搜索。Oniguruma按毫秒计时，不足1毫秒时取1毫秒
+          auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(
+            line_deadline_ - std::chrono::steady_clock::now()).count();
+          onig_set_time_limit_of_match_param(match_param, static_cast<unsigned long>(std::max<int64_t>(remaining, 1)));
+        }
+        match_byte_pos = onig_search_with_param(state_rule.regex.get(), (OnigUChar*)text.c_str(),
+          end, start, range_end, region, ONIG_OPTION_NONE, match_param);
+      }
+      if (match_byte_pos == ONIGERR_RETRY_LIMIT_IN_SEARCH_OVER || match_byte_pos == ONIGERR_RETRY_LIMIT_IN_MATCH_OVER ||
+        match_byte_pos == ONIGERR_TIME_LIMIT_OVER || match_byte_pos == ONIGERR_MATCH_STACK_LIMIT_OVER) {
+        result.limit_exceeded = true;
+        return;
       }
-      size_t match_length_bytes = match_end_byte - match_start_byte;
+      if (match_byte_pos >= 0) {
+        size_t match_start_byte = match_byte_pos;
+        size_t match_end_byte = region->end[0];
+        keyword_limit_byte = match_start_byte;
+        regex_found = true;
+        if (match_end_byte > match_start_byte) {
+          size_t match_start_char = line_cursor_.bytePosToCharPos(match_start_byte);
+          size_t match_end_char = line_cursor_.bytePosToCharPos(match_end_byte);
+          size_t match_length_chars = match_end_char - match_start_char;
 
-      size_t match_start_char = Utf8Util::bytePosToCharPos(text, match_start_byte);
-      size_t match_end_char = Utf8Util::bytePosToCharPos(text, match_end_byte);
-      size_t match_length_chars = match_end_char - match_start_char;
+          result.matched = true;
+          result.start = match_start_char;
+          result.length = match_length_chars;
+          result.state = state;
+          result.matched_text.assign(text, match_start_byte, match_end_byte - match_start_byte);
+
+          findMatchedRuleAndGroup(state_rule, region, match_start_byte, match_end_byte, result);
+        }
+      }
+    }
 
-      result.matched = true;
-      result.start = match_start_char;
-      result.length = match_length_chars;
-      result.state = state;
-      result.matched_text = Utf8Util::utf8Substr(text, match_start_char, match_length_chars);
+    if (!state_rule.keyword_rule_indices.empty()) {
+      int32_t max_rule_idx = result.matched ? result.token_rule_idx : std::numeric_limits<int32_t>::max();
+      if (matchKeyword(state_rule, text, start_byte_pos, keyword_limit_byte, max_rule_idx, result)) {
+        result.state = state;
+      }
+    }
+    result.exhausted = !result.matched && !regex_found;
+  }
 
-      findMatchedRuleAndGroup(state_rule, region, match_start_byte, match_end_byte, result);
+  bool DocumentAnalyzer::matchKeyword(const StateRule& state_rule, const String& text, size_t start_byte,
+    size_t limit_byte, int32_t max_rule_idx, MatchResult& result) {
+    const size_t text_length = text.length();
+    size_t byte_pos = start_byte;
+    while (byte_pos <= limit_byte && byte_pos < text_length) {
+      size_t char_length = KeywordMatcher::wordCharLength(text, byte_pos);
+      if (char_length == 0) {
+        ++byte_pos;
+        continue;
+      }
+      size_t word_length = KeywordMatcher::scanWord(text, byte_pos);
+      if (word_length == 0) {
+        // 起始位置处于单词中间，跳到单词末尾
+        while (byte_pos < text_length && (char_length = KeywordMatcher::wordCharLength(text, byte_pos)) > 0) {
+          byte_pos += char_length;
+        }
+        continue;
+      }
+      for (int32_t rule_idx : state_rule.keyword_rule_indices) {
+        // 与正则匹配起始位置相同时，按规则顺序决定优先级
+        if (byte_pos == limit_byte && rule_idx >= max_rule_idx) {
+          break;
+        }
+        const TokenRule& token_rule = state_rule.token_rules[rule_idx];
+        if (!token_rule.keyword_matcher.contains(text.data() + byte_pos, word_length)) {
+          continue;
+        }
+        size_t match_start_char = line_cursor_.bytePosToCharPos(byte_pos);
+        size_t match_end_char = line_cursor_.bytePosToCharPos(byte_pos + word_length);
+        result.matched = true;
+        result.start = match_start_char;
+        result.length = match_end_char - match_start_char;
+        result.token_rule_idx = rule_idx;
+        result.is_potential_multi_line = false;
+        result.matched_group = 0;
+        result.style = token_rule.getGroupStyle(0);
+        result.style_id = token_rule.getGroupStyleId(0);
+        result.goto_state = token_rule.goto_state;
+        result.matched_text.assign(text, byte_pos, word_length);
+        return true;
+      }
+      byte_pos += word_length;
     }
-    onig_region_free(region, 1);
-    return result;
+    return false;
   }
 
   void DocumentAnalyzer::findMatchedRuleAndGroup(const StateRule& state_rule, OnigRegion* region,
     size_t match_start_byte, size_t match_end_byte, MatchResult& result) {
     for (int32_t rule_idx = 0; rule_idx < static_cast<int32_t>(state_rule.token_rules.size()); ++rule_idx) {
       const TokenRule& token_rule = state_rule.token_rules[rule_idx];
+      if (token_rule.isKeywordRule()) {
+        continue;
+      }
       int32_t rule_group_offset = token_rule.group_offset;
 
       if (region->beg[rule_group_offset] == static_cast<int>(match_start_byte) &&
@@ -604,6 +1783,7 @@ namespace NS_FASTHIGHLIGHT {
         result.is_potential_multi_line = token_rule.is_multi_line;
         result.goto_state = token_rule.goto_state;
         result.style = token_rule.getGroupStyle(0);
+        result.style_id = token_rule.getGroupStyleId(0);
         result.matched_group = rule_group_offset;
 
         for (int32_t group = rule_group_offset + 1;group < rule_group_offset + token_rule.group_count;++group) {
@@ -611,6 +1791,7 @@ namespace NS_FASTHIGHLIGHT {
             region->end[group] == static_cast<int>(match_end_byte)) {
             result.matched_group = group;
             result.style = token_rule.getGroupStyle(group);
+            result.style_id = token_rule.getGroupStyleId(group);
             break;
           }
         }
@@ -631,32 +1812,317 @@ namespace NS_FASTHIGHLIGHT {
     return std::max(range.start.line + new_line_count, range.end.line + line_change);
   }
 
+  // ===================================== StreamTokenizer ============================================
+  StreamTokenizer::StreamTokenizer(const Ptr<const SyntaxRule>& rule, const LineVisitor& visitor)
+    : visitor_(visitor) {
+    // 分析器只用于复用分析逻辑和跨行上下文，文本本身不存入Document
+    analyzer_ = MAKE_UPTR<DocumentAnalyzer>(MAKE_PTR<Document>(""), rule);
+    analyzer_->accumulate_multi_line_text_ = false;
+  }
+
+  void StreamTokenizer::feed(const char* data, size_t size) {
+    if (size == 0) {
+      return;
+    }
+    has_input_ = true;
+    const char* end = data + size;
+    while (data < end) {
+      const char* newline = static_cast<const char*>(std::memchr(data, '\n', end - data));
+      if (newline == nullptr) {
+        line_.append(data, end - data);
+        return;
+      }
+      line_.append(data, newline - data);
+      if (!line_.empty() && line_.back() == '\r') {
+        line_.pop_back();
+      }
+      emitLine();
+      data = newline + 1;
+    }
+  }
+
+  void StreamTokenizer::feed(const String& chunk) {
+    feed(chunk.data(), chunk.length());
+  }
+
+  void StreamTokenizer::finish() {
+    if (has_input_) {
+      if (!line_.empty() && line_.back() == '\r') {
+        line_.pop_back();
+      }
+      emitLine();
+    }
+    has_input_ = false;
+  }
+
+  void StreamTokenizer::reset() {
+    line_.clear();
+    line_count_ = 0;
+    state_ = SyntaxRule::kDefaultStateId;
+    has_input_ = false;
+    analyzer_->multi_line_contexts_.clear();
+  }
+
+  size_t StreamTokenizer::getLineCount() const {
+    return line_count_;
+  }
+
+  int32_t StreamTokenizer::getState() const {
+    return state_;
+  }
+
+  void StreamTokenizer::setAnalyzeOptions(const AnalyzeOptions& options) {
+    analyzer_->setAnalyzeOptions(options);
+  }
+
+  void StreamTokenizer::setLineCacheCapacity(size_t capacity_bytes) {
+    analyzer_->setLineCacheCapacity(capacity_bytes);
+  }
+
+  void StreamTokenizer::emitLine() {
+    LineSpans spans = analyzer_->analyzeLineText(line_count_, line_, state_, state_);
+    visitor_(line_count_, line_, spans);
+    ++line_count_;
+    // 保留容量给下一行复用
+    line_.clear();
+  }
+
   HighlightEngine::HighlightEngine() {
     syntax_rule_manager_ = MAKE_PTR<SyntaxRuleManager>();
   }
 
   // ===================================== HighlightEngine ============================================
-  void HighlightEngine::compileSyntaxFromJson(const String& json) const {
-    syntax_rule_manager_->compileSyntaxFromJson(json);
+  Ptr<const SyntaxRule> HighlightEngine::compileSyntaxFromJson(const String& json) const {
+    Ptr<const SyntaxRule> rule = syntax_rule_manager_->compileSyntaxFromJson(json);
+    reloadAnalyzers(rule);
+    return rule;
+  }
+
+  Ptr<const SyntaxRule> HighlightEngine::compileSyntaxFromFile(const String& file) const {
+    Ptr<const SyntaxRule> rule = syntax_rule_manager_->compileSyntaxFromFile(file);
+    if (rule != nullptr) {
+      reloadAnalyzers(rule);
+    }
+    return rule;
   }
 
-  void HighlightEngine::compileSyntaxFromFile(const String& file) const {
-    syntax_rule_manager_->compileSyntaxFromFile(file);
+  void HighlightEngine::setSyntaxReloadCallback(const SyntaxReloadCallback& callback) {
+    std::lock_guard<std::mutex> lock(analyzer_mutex_);
+    reload_callback_ = callback;
   }
 
   Ptr<DocumentAnalyzer> HighlightEngine::loadDocument(const Ptr<Document>& document) {
+    std::lock_guard<std::mutex> lock(analyzer_mutex_);
     auto it = analyzer_map_.find(document->getUri());
     if (it == analyzer_map_.end()) {
       String uri = document->getUri();
-      Ptr<SyntaxRule> rule = syntax_rule_manager_->getSyntaxRuleByExtension(FileUtil::getExtension(uri));
+      Ptr<const SyntaxRule> rule = syntax_rule_manager_->getSyntaxRuleByExtension(FileUtil::getExtension(uri));
       if (rule == nullptr) {
         return nullptr;
       }
       Ptr<DocumentAnalyzer> analyzer = MAKE_PTR<DocumentAnalyzer>(document, rule);
-      analyzer_map_.insert_or_assign(uri, analyzer);
+      analyzer->setAnalyzeOptions(analyze_options_);
+      analyzer->setDiskCache(disk_cache_);
+      lru_list_.push_front(uri);
+      analyzer_map_.insert_or_assign(uri, AnalyzerEntry {analyzer, lru_list_.begin()});
+      if (memory_budget_ > 0) {
+        trimMemoryLocked();
+      }
       return analyzer;
     } else {
-      return it->second;
+      lru_list_.splice(lru_list_.begin(), lru_list_, it->second.lru_it);
+      return it->second.analyzer;
+    }
+  }
+
+  Ptr<DocumentAnalyzer> HighlightEngine::createAnalyzer(const Ptr<Document>& document) const {
+    Ptr<const SyntaxRule> rule = syntax_rule_manager_->getSyntaxRuleByExtension(FileUtil::getExtension(document->getUri()));
+    if (rule == nullptr) {
+      return nullptr;
+    }
+    Ptr<DocumentAnalyzer> analyzer = MAKE_PTR<DocumentAnalyzer>(document, rule);
+    std::lock_guard<std::mutex> lock(analyzer_mutex_);
+    analyzer->setAnalyzeOptions(analyze_options_);
+    analyzer->setDiskCache(disk_cache_);
+    return analyzer;
+  }
+
+  UPtr<StreamTokenizer> HighlightEngine::createStreamTokenizer(const String& uri, const LineVisitor& visitor) const {
+    Ptr<const SyntaxRule> rule = syntax_rule_manager_->getSyntaxRuleByExtension(FileUtil::getExtension(uri));
+    if (rule == nullptr) {
+      return nullptr;
+    }
+    UPtr<StreamTokenizer> tokenizer = MAKE_UPTR<StreamTokenizer>(rule, visitor);
+    std::lock_guard<std::mutex> lock(analyzer_mutex_);
+    tokenizer->setAnalyzeOptions(analyze_options_);
+    return tokenizer;
+  }
+
+  bool HighlightEngine::hasSyntaxRule(const String& uri) const {
+    return syntax_rule_manager_->getSyntaxRuleByExtension(FileUtil::getExtension(uri)) != nullptr;
+  }
+
+  void HighlightEngine::setAnalyzeOptions(const AnalyzeOptions& options) {
+    List<Ptr<DocumentAnalyzer>> analyzers;
+    {
+      std::lock_guard<std::mutex> lock(analyzer_mutex_);
+      analyze_options_ = options;
+      for (std::pair<const String, AnalyzerEntry>& pair : analyzer_map_) {
+        analyzers.push_back(pair.second.analyzer);
+      }
+    }
+    // 分析器会等待各自正在进行的分析完成，不能持有引擎的锁等待
+    for (const Ptr<DocumentAnalyzer>& analyzer : analyzers) {
+      analyzer->setAnalyzeOptions(options);
+    }
+  }
+
+  void HighlightEngine::setDiskCache(const Ptr<HighlightDiskCache>& cache) {
+    std::lock_guard<std::mutex> lock(analyzer_mutex_);
+    disk_cache_ = cache;
+  }
+
+  bool HighlightEngine::closeDocument(const String& uri) {
+    std::lock_guard<std::mutex> lock(analyzer_mutex_);
+    auto it = analyzer_map_.find(uri);
+    if (it == analyzer_map_.end()) {
+      return false;
+    }
+    lru_list_.erase(it->second.lru_it);
+    analyzer_map_.erase(it);
+    return true;
+  }
+
+  void HighlightEngine::setMemoryBudget(size_t bytes) {
+    std::lock_guard<std::mutex> lock(analyzer_mutex_);
+    memory_budget_ = bytes;
+    trimMemoryLocked();
+  }
+
+  size_t HighlightEngine::trimMemory() {
+    std::lock_guard<std::mutex> lock(analyzer_mutex_);
+    return trimMemoryLocked();
+  }
+
+  size_t HighlightEngine::getLoadedDocumentCount() const {
+    std::lock_guard<std::mutex> lock(analyzer_mutex_);
+    return analyzer_map_.size();
+  }
+
+  MemoryUsage HighlightEngine::memoryUsage() const {
+    MemoryUsage usage = syntax_rule_manager_->memoryUsage();
+    std::lock_guard<std::mutex> lock(analyzer_mutex_);
+    usage.hash_maps += MemoryUsage::hashTableBytes(analyzer_map_);
+    for (const std::pair<const String, AnalyzerEntry>& pair : analyzer_map_) {
+      usage += pair.second.analyzer->memoryUsage();
+      // key与lru_list_中各存一份uri
+      usage.other += 2 * MemoryUsage::stringBytes(pair.first) + sizeof(String) + 2 * sizeof(void*) + kSharedControlBlockBytes;
+    }
+    usage.other += sizeof(HighlightEngine);
+    return usage;
+  }
+
+  void HighlightEngine::setBatchThreadCount(size_t count) {
+    std::lock_guard<std::mutex> lock(analyzer_mutex_);
+    batch_thread_count_ = count;
+  }
+
+  List<Ptr<DocumentHighlight>> HighlightEngine::highlightBatch(const List<HighlightJob>& jobs) {
+    List<Ptr<DocumentHighlight>> results(jobs.size());
+    // 每个结果槽位只被一个任务写入，无需加锁
+    highlightBatch(jobs, [&results](size_t index, const Ptr<DocumentHighlight>& highlight) {
+      results[index] = highlight;
+    });
+    return results;
+  }
+
+  void HighlightEngine::highlightBatch(const List<HighlightJob>& jobs, const BatchCallback& callback) {
+    AnalyzeOptions options;
+    Ptr<HighlightDiskCache> disk_cache;
+    {
+      std::lock_guard<std::mutex> lock(analyzer_mutex_);
+      options = analyze_options_;
+      disk_cache = disk_cache_;
+    }
+    // 语法规则编译后只读，所有任务共享；匹配用的暂存数据由每个工作线程各自复用
+    getThreadPool().parallelFor(jobs.size(), [this, &jobs, &callback, &options, &disk_cache](size_t index) {
+      const HighlightJob& job = jobs[index];
+      Ptr<const SyntaxRule> rule = syntax_rule_manager_->getSyntaxRuleByExtension(FileUtil::getExtension(job.uri));
+      if (rule == nullptr) {
+        callback(index, nullptr);
+        return;
+      }
+      DocumentAnalyzer analyzer(MAKE_PTR<Document>(job.uri, job.text), rule);
+      analyzer.setAnalyzeOptions(options);
+      analyzer.setDiskCache(disk_cache);
+      callback(index, analyzer.analyzeFully());
+    });
+  }
+
+  void HighlightEngine::reloadAnalyzers(const Ptr<const SyntaxRule>& rule) const {
+    List<std::pair<String, Ptr<DocumentAnalyzer>>> analyzers;
+    SyntaxReloadCallback reload_callback;
+    {
+      std::lock_guard<std::mutex> lock(analyzer_mutex_);
+      for (const std::pair<const String, AnalyzerEntry>& pair : analyzer_map_) {
+        Ptr<const SyntaxRule> old_rule = pair.second.analyzer->getSyntaxRule();
+        if (old_rule != rule && old_rule->name == rule->name) {
+          analyzers.emplace_back(pair.first, pair.second.analyzer);
+        }
+      }
+      reload_callback = reload_callback_;
+    }
+    // 可见区域的分析在当前线程中进行，不持有引擎的锁
+    for (const std::pair<String, Ptr<DocumentAnalyzer>>& pair : analyzers) {
+      AnalyzeCallback callback;
+      if (reload_callback != nullptr) {
+        const String& uri = pair.first;
+        callback = [uri, reload_callback](const Ptr<DocumentHighlight>& highlight) {
+          if (highlight != nullptr) {
+            reload_callback(uri, highlight);
+          }
+        };
+      }
+      pair.second->reloadSyntaxRule(rule, callback);
+    }
+  }
+
+  size_t HighlightEngine::trimMemoryLocked() {
+    // 持有引擎的锁，不能等待各分析器正在进行的分析，分析中的文本按上一次统计的结果计算
+    size_t total_bytes = 0;
+    HashMap<String, size_t> usages;
+    for (std::pair<const String, AnalyzerEntry>& pair : analyzer_map_) {
+      size_t bytes = pair.second.analyzer->estimateMemoryBytes();
+      usages.insert_or_assign(pair.first, bytes);
+      total_bytes += bytes;
+    }
+    if (memory_budget_ == 0 || total_bytes <= memory_budget_ || lru_list_.size() <= 1) {
+      return total_bytes;
+    }
+    // 第一轮从最久未使用的文本开始释放高亮结果缓存，行状态和文本保留
+    for (auto it = std::prev(lru_list_.end()); it != lru_list_.begin() && total_bytes > memory_budget_; --it) {
+      const Ptr<DocumentAnalyzer>& analyzer = analyzer_map_.at(*it).analyzer;
+      if (analyzer->releaseHighlightCache()) {
+        size_t bytes = analyzer->estimateMemoryBytes();
+        total_bytes -= usages[*it] - bytes;
+        usages[*it] = bytes;
+      }
+    }
+    // 仍然超出时关闭最久未使用的文本，最近使用的文本始终保留
+    while (total_bytes > memory_budget_ && lru_list_.size() > 1) {
+      const String& uri = lru_list_.back();
+      total_bytes -= usages[uri];
+      analyzer_map_.erase(uri);
+      lru_list_.pop_back();
+    }
+    return total_bytes;
+  }
+
+  ThreadPool& HighlightEngine::getThreadPool() {
+    std::lock_guard<std::mutex> lock(analyzer_mutex_);
+    if (thread_pool_ == nullptr) {
+      thread_pool_ = MAKE_UPTR<ThreadPool>(batch_thread_count_);
     }
+    return *thread_pool_;
   }
 }
@@ -0,0 +1,164 @@
+#include <algorithm>
+#include <cstring>
+#include "html_renderer.h"
+
+namespace NS_FASTHIGHLIGHT {
+  static constexpr const char* kCodeBlockBegin = "<pre class=\"fh-code\"><code>";
+  static constexpr const char* kCodeBlockEnd = "</code></pre>\n";
+  static constexpr const char* kSpanEnd = "</span>";
+
+  /// 从byte_pos开始跳过char_count个UTF-8字符
+  /// @return 跳过后的字节位置，不超过文本长度
+  static size_t advanceChars(const String& text, size_t byte_pos, size_t char_count) {
+    while (char_count > 0 && byte_pos < text.length()) {
+      ++byte_pos;
+      // 跳过后续字节
+      while (byte_pos < text.length() && (static_cast<uint8_t>(text[byte_pos]) & 0xC0) == 0x80) {
+        ++byte_pos;
+      }
+      --char_count;
+    }
+    return byte_pos;
+  }
+
+  // ===================================== HtmlRenderer ============================================
+  HtmlRenderer::HtmlRenderer(HtmlSink sink, const HtmlRenderOptions& options)
+    : sink_(std::move(sink)), options_(options) {
+    if (options_.chunk_size == 0) {
+      options_.chunk_size = 1;
+    }
+    buffer_.reserve(options_.chunk_size);
+  }
+
+  void HtmlRenderer::setClassName(const String& style, const String& class_name) {
+    String& open_tag = open_tags_[style];
+    open_tag = "<span class=\"";
+    open_tag += class_name;
+    open_tag += "\">";
+  }
+
+  void HtmlRenderer::begin() {
+    if (options_.wrap_code_block) {
+      append(kCodeBlockBegin, std::strlen(kCodeBlockBegin));
+    }
+  }
+
+  void HtmlRenderer::renderLine(const String& line_text, const LineSpans& spans) {
+    size_t char_pos = 0;
+    size_t byte_pos = 0;
+    for (const TokenSpan& span : spans) {
+      // 跨行匹配结束时的高亮块起始于之前的行，在本行从行首开始
+      size_t start_column = span.range.start.line < span.range.end.line ? 0 : span.range.start.column;
+      if (start_column > char_pos) {
+        size_t gap_end = advanceChars(line_text, byte_pos, start_column - char_pos);
+        appendEscaped(line_text.data() + byte_pos, gap_end - byte_pos);
+        byte_pos = gap_end;
+        char_pos = start_column;
+      }
+      if (span.range.end.column <= char_pos) {
+        continue;
+      }
+      size_t span_end = advanceChars(line_text, byte_pos, span.range.end.column - char_pos);
+      if (span.style.empty()) {
+        appendEscaped(line_text.data() + byte_pos, span_end - byte_pos);
+      } else {
+        const String& open_tag = getOpenTag(span.style);
+        append(open_tag.data(), open_tag.length());
+        appendEscaped(line_text.data() + byte_pos, span_end - byte_pos);
+        append(kSpanEnd, std::strlen(kSpanEnd));
+      }
+      byte_pos = span_end;
+      char_pos = span.range.end.column;
+    }
+    if (byte_pos < line_text.length()) {
+      appendEscaped(line_text.data() + byte_pos, line_text.length() - byte_pos);
+    }
+    append("\n", 1);
+  }
+
+  void HtmlRenderer::end() {
+    if (options_.wrap_code_block) {
+      append(kCodeBlockEnd, std::strlen(kCodeBlockEnd));
+    }
+    flush();
+  }
+
+  bool HtmlRenderer::renderDocument(DocumentAnalyzer& analyzer, const Ptr<CancellationToken>& token) {
+    begin();
+    bool completed = analyzer.analyzeLines([this](size_t, const String& line_text, const LineSpans& spans) {
+      renderLine(line_text, spans);
+    }, token);
+    if (!completed) {
+      flush();
+      return false;
+    }
+    end();
+    return true;
+  }
+
+  void HtmlRenderer::renderHighlight(const Document& document, const DocumentHighlight& highlight) {
+    begin();
+    highlight.forEachLine([this, &document](size_t line, const LineSpans& spans) {
+      renderLine(document.getLine(line), spans);
+    });
+    end();
+  }
+
+  void HtmlRenderer::flush() {
+    if (buffer_.empty()) {
+      return;
+    }
+    sink_(buffer_.data(), buffer_.size());
+    flushed_bytes_ += buffer_.size();
+    buffer_.clear();
+  }
+
+  size_t HtmlRenderer::getBytesWritten() const {
+    return flushed_bytes_ + buffer_.size();
+  }
+
+  const String& HtmlRenderer::getOpenTag(const String& style) {
+    auto it = open_tags_.find(style);
+    if (it != open_tags_.end()) {
+      return it->second;
+    }
+    String class_name = options_.class_prefix;
+    for (char c : style) {
+      class_name += (c == '.' || c == ' ' || c == '\t') ? '-' : c;
+    }
+    setClassName(style, class_name);
+    return open_tags_[style];
+  }
+
+  void HtmlRenderer::append(const char* data, size_t size) {
+    while (size > 0) {
+      size_t writable = std::min(size, options_.chunk_size - buffer_.size());
+      buffer_.append(data, writable);
+      data += writable;
+      size -= writable;
+      if (buffer_.size() >= options_.chunk_size) {
+        flush();
+      }
+    }
+  }
+
+  void HtmlRenderer::appendEscaped(const char* data, size_t size) {
+    // 连续的普通字符整段写入，只有遇到需要转义的字符时才分段
+    size_t run_start = 0;
+    for (size_t i = 0; i < size; ++i) {
+      const char* entity;
+      switch (data[i]) {
+        case '&': entity = "&amp;"; break;
+        case '<': entity = "&lt;"; break;
+        case '>': entity = "&gt;"; break;
+        case '"': entity = "&quot;"; break;
+        case '\'': entity = "&#39;"; break;
+        default: continue;
+      }
+      append(data + run_start, i - run_start);
+      append(entity, std::strlen(entity));
+      run_start = i + 1;
+    }
+    append(data + run_start, size - run_start);
+  }
+}
@@ -0,0 +1,165 @@
+#include <algorithm>
+#include <oniguruma/oniguruma.h>
+#include "foundation.h"
+#include "keyword_matcher.h"
+
+namespace NS_FASTHIGHLIGHT {
+  static inline unsigned char toLowerAscii(unsigned char c) {
+    return (c >= 'A' && c <= 'Z') ? static_cast<unsigned char>(c - 'A' + 'a') : c;
+  }
+
+  static inline bool isAsciiWordByte(unsigned char c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_';
+  }
+
+  /// 字节位置之前的一个字符是否为单词字符
+  static bool isWordCharBefore(const String& text, size_t byte_pos) {
+    if (byte_pos == 0) {
+      return false;
+    }
+    // 向前跳过UTF-8后续字节找到字符的首字节
+    size_t start = byte_pos - 1;
+    while (start > 0 && byte_pos - start < 4 && (static_cast<unsigned char>(text[start]) & 0xC0) == 0x80) {
+      --start;
+    }
+    return KeywordMatcher::wordCharLength(text, start) == byte_pos - start;
+  }
+
+  // ===================================== KeywordMatcher ============================================
+  void KeywordMatcher::build(const std::vector<String>& keywords, bool ignore_case) {
+    ignore_case_ = ignore_case;
+    keywords_.clear();
+    min_length_ = SIZE_MAX;
+    max_length_ = 0;
+    // 表容量取2的幂并保证装载因子不超过0.5，绝大多数查询一次探测即可命中或落空
+    size_t capacity = 4;
+    while (capacity < keywords.size() * 2) {
+      capacity <<= 1;
+    }
+    mask_ = capacity - 1;
+    slots_.assign(capacity, -1);
+    for (const String& keyword : keywords) {
+      if (keyword.empty() || contains(keyword.data(), keyword.length())) {
+        continue;
+      }
+      size_t slot = hash(keyword.data(), keyword.length()) & mask_;
+      while (slots_[slot] >= 0) {
+        slot = (slot + 1) & mask_;
+      }
+      slots_[slot] = static_cast<int32_t>(keywords_.size());
+      keywords_.push_back(keyword);
+      min_length_ = std::min(min_length_, keyword.length());
+      max_length_ = std::max(max_length_, keyword.length());
+    }
+  }
+
+  bool KeywordMatcher::contains(const char* word, size_t length) const {
+    if (keywords_.empty() || length < min_length_ || length > max_length_) {
+      return false;
+    }
+    size_t slot = hash(word, length) & mask_;
+    while (slots_[slot] >= 0) {
+      if (equals(keywords_[slots_[slot]], word, length)) {
+        return true;
+      }
+      slot = (slot + 1) & mask_;
+    }
+    return false;
+  }
+
+  size_t KeywordMatcher::size() const {
+    return keywords_.size();
+  }
+
+  bool KeywordMatcher::empty() const {
+    return keywords_.empty();
+  }
+
+  size_t KeywordMatcher::memoryBytes() const {
+    size_t bytes = keywords_.capacity() * sizeof(String) + slots_.capacity() * sizeof(int32_t);
+    for (const String& keyword : keywords_) {
+      bytes += MemoryUsage::stringBytes(keyword);
+    }
+    return bytes;
+  }
+
+  bool KeywordMatcher::isWordStartByte(unsigned char c) {
+    return isAsciiWordByte(c) || c >= 0xC0;
+  }
+
+  size_t KeywordMatcher::wordCharLength(const String& text, size_t byte_pos) {
+    const unsigned char c = static_cast<unsigned char>(text[byte_pos]);
+    if (c < 0x80) {
+      return isAsciiWordByte(c) ? 1 : 0;
+    }
+    size_t length = c >= 0xF0 ? 4 : c >= 0xE0 ? 3 : c >= 0xC0 ? 2 : 0;
+    if (length == 0 || c > 0xF4 || byte_pos + length > text.length()) {
+      return 0;
+    }
+    for (size_t i = 1; i < length; ++i) {
+      if ((static_cast<unsigned char>(text[byte_pos + i]) & 0xC0) != 0x80) {
+        return 0;
+      }
+    }
+    const OnigUChar* start = reinterpret_cast<const OnigUChar*>(text.data() + byte_pos);
+    OnigCodePoint code = ONIGENC_MBC_TO_CODE(ONIG_ENCODING_UTF8, start, start + length);
+    return ONIGENC_IS_CODE_WORD(ONIG_ENCODING_UTF8, code) ? length : 0;
+  }
+
+  bool KeywordMatcher::isWord(const String& text) {
+    if (text.empty()) {
+      return false;
+    }
+    size_t byte_pos = 0;
+    while (byte_pos < text.length()) {
+      size_t char_length = wordCharLength(text, byte_pos);
+      if (char_length == 0) {
+        return false;
+      }
+      byte_pos += char_length;
+    }
+    return true;
+  }
+
+  size_t KeywordMatcher::scanWord(const String& text, size_t byte_pos) {
+    const size_t text_length = text.length();
+    if (byte_pos >= text_length || isWordCharBefore(text, byte_pos)) {
+      return 0;
+    }
+    size_t end = byte_pos;
+    while (end < text_length) {
+      size_t char_length = wordCharLength(text, end);
+      if (char_length == 0) {
+        break;
+      }
+      end += char_length;
+    }
+    return end - byte_pos;
+  }
+
+  uint64_t KeywordMatcher::hash(const char* word, size_t length) const {
+    // FNV-1a
+    uint64_t value = 14695981039346656037ULL;
+    for (size_t i = 0; i < length; ++i) {
+      unsigned char c = static_cast<unsigned char>(word[i]);
+      value ^= ignore_case_ ? toLowerAscii(c) : c;
+      value *= 1099511628211ULL;
+    }
+    return value;
+  }
+
+  bool KeywordMatcher::equals(const String& keyword, const char* word, size_t length) const {
+    if (keyword.length() != length) {
+      return false;
+    }
+    if (!ignore_case_) {
+      return keyword.compare(0, length, word, length) == 0;
+    }
+    for (size_t i = 0; i < length; ++i) {
+      if (toLowerAscii(static_cast<unsigned char>(keyword[i])) != toLowerAscii(static_cast<unsigned char>(word[i]))) {
+        return false;
+      }
+    }
+    return true;
+  }
+}
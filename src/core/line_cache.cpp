@@ -0,0 +1,96 @@
+#include "line_cache.h"
+
+namespace NS_FASTHIGHLIGHT {
+  // ===================================== LineCacheStats ============================================
+  double LineCacheStats::hitRate() const {
+    uint64_t total = hits + misses;
+    return total == 0 ? 0 : static_cast<double>(hits) / static_cast<double>(total);
+  }
+
+  // ===================================== LineResultCache ============================================
+  /// 链表节点和索引节点的额外开销
+  static constexpr size_t kEntryOverheadBytes = 4 * sizeof(void*);
+
+  LineResultCache::LineResultCache(size_t capacity_bytes): capacity_bytes_(capacity_bytes) {
+  }
+
+  const LineResultCache::Entry* LineResultCache::find(int32_t start_state, const String& line_text) {
+    auto it = index_.find({start_state, std::hash<String>()(line_text)});
+    // 哈希相同但文本不同时视为未命中，之后的insert会覆盖该条目
+    if (it == index_.end() || it->second->text != line_text) {
+      ++misses_;
+      return nullptr;
+    }
+    ++hits_;
+    entries_.splice(entries_.begin(), entries_, it->second);
+    return &*it->second;
+  }
+
+  void LineResultCache::insert(int32_t start_state, const String& line_text, const LineSpans& spans,
+    int32_t end_state) {
+    size_t bytes = sizeof(Entry) + kEntryOverheadBytes + MemoryUsage::stringBytes(line_text)
+      + spans.size() * sizeof(TokenSpan);
+    for (const TokenSpan& span : spans) {
+      bytes += MemoryUsage::stringBytes(span.matched_text) + MemoryUsage::stringBytes(span.style);
+    }
+    if (bytes > capacity_bytes_) {
+      return;
+    }
+    Key key {start_state, std::hash<String>()(line_text)};
+    auto it = index_.find(key);
+    if (it != index_.end()) {
+      memory_bytes_ -= it->second->bytes;
+      entries_.erase(it->second);
+      index_.erase(it);
+    }
+    evict(capacity_bytes_ - bytes);
+
+    Entry& entry = entries_.emplace_front();
+    entry.start_state = start_state;
+    entry.end_state = end_state;
+    entry.text_hash = key.text_hash;
+    entry.text = line_text;
+    entry.spans.assign(spans.begin(), spans.end());
+    for (TokenSpan& span : entry.spans) {
+      span.range.start.line = 0;
+      span.range.end.line = 0;
+    }
+    entry.bytes = bytes;
+    memory_bytes_ += bytes;
+    index_.emplace(key, entries_.begin());
+  }
+
+  void LineResultCache::setCapacity(size_t capacity_bytes) {
+    capacity_bytes_ = capacity_bytes;
+    evict(capacity_bytes_);
+  }
+
+  void LineResultCache::clear() {
+    entries_.clear();
+    index_.clear();
+    memory_bytes_ = 0;
+  }
+
+  LineCacheStats LineResultCache::getStats() const {
+    LineCacheStats stats;
+    stats.hits = hits_;
+    stats.misses = misses_;
+    stats.entry_count = entries_.size();
+    stats.memory_bytes = memoryBytes();
+    stats.capacity_bytes = capacity_bytes_;
+    return stats;
+  }
+
+  size_t LineResultCache::memoryBytes() const {
+    return memory_bytes_ + index_.bucket_count() * sizeof(void*);
+  }
+
+  void LineResultCache::evict(size_t capacity_bytes) {
+    while (memory_bytes_ > capacity_bytes && !entries_.empty()) {
+      const Entry& entry = entries_.back();
+      index_.erase({entry.start_state, entry.text_hash});
+      memory_bytes_ -= entry.bytes;
+      entries_.pop_back();
+    }
+  }
+}
@@ -0,0 +1,191 @@
+#include <algorithm>
+#include <nlohmann/json.hpp>
+#include "profiler.h"
+#include "util.h"
+
+namespace NS_FASTHIGHLIGHT {
+  // ===================================== GrammarProfiler ============================================
+  GrammarProfiler::GrammarProfiler(const Ptr<const SyntaxRule>& rule): rule_(rule) {
+    region_ = onig_region_new();
+    for (const std::pair<const int32_t, StateRule>& pair : rule_->state_rules_map_) {
+      const StateRule& state_rule = pair.second;
+      state_offsets_.insert_or_assign(pair.first, profiles_.size());
+      RuleProfile state_profile;
+      state_profile.state = pair.first;
+      state_profile.state_name = state_rule.name;
+      state_profile.pattern = state_rule.merged_pattern;
+      profiles_.push_back(std::move(state_profile));
+      token_regexes_.push_back(nullptr);
+
+      for (size_t i = 0; i < state_rule.token_rules.size(); ++i) {
+        const TokenRule& token_rule = state_rule.token_rules[i];
+        RuleProfile token_profile;
+        token_profile.state = pair.first;
+        token_profile.state_name = state_rule.name;
+        token_profile.token_rule_idx = static_cast<int32_t>(i);
+        token_profile.style = token_rule.getGroupStyle(0);
+        OnigRegex regex = nullptr;
+        if (token_rule.isKeywordRule()) {
+          for (const String& keyword : token_rule.keywords) {
+            if (!token_profile.pattern.empty()) {
+              token_profile.pattern += "|";
+            }
+            token_profile.pattern += keyword;
+          }
+        } else {
+          token_profile.pattern = token_rule.pattern;
+          OnigErrorInfo error;
+          int status = onig_new(&regex,
+            (OnigUChar*)token_rule.pattern.c_str(),
+            (OnigUChar*)(token_rule.pattern.c_str() + token_rule.pattern.length()),
+            ONIG_OPTION_DEFAULT, ONIG_ENCODING_UTF8, ONIG_SYNTAX_DEFAULT, &error);
+          if (status != ONIG_NORMAL) {
+            regex = nullptr;
+          }
+        }
+        profiles_.push_back(std::move(token_profile));
+        token_regexes_.push_back(regex);
+      }
+    }
+  }
+
+  GrammarProfiler::~GrammarProfiler() {
+    for (OnigRegex regex : token_regexes_) {
+      if (regex != nullptr) {
+        onig_free(regex);
+      }
+    }
+    onig_region_free(region_, 1);
+  }
+
+  void GrammarProfiler::recordStateSearch(int32_t state, size_t bytes_scanned, Clock::duration elapsed, bool matched) {
+    auto it = state_offsets_.find(state);
+    if (it == state_offsets_.end()) {
+      return;
+    }
+    RuleProfile& profile = profiles_[it->second];
+    profile.invocations++;
+    if (matched) {
+      profile.hits++;
+    } else {
+      profile.misses++;
+    }
+    profile.bytes_scanned += bytes_scanned;
+    profile.time_ns += std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count();
+  }
+
+  void GrammarProfiler::replayTokenRules(int32_t state, const String& text, size_t start_byte,
+    int32_t winner_rule_idx, size_t winner_start_byte) {
+    auto it = state_offsets_.find(state);
+    if (it == state_offsets_.end()) {
+      return;
+    }
+    const StateRule& state_rule = rule_->state_rules_map_.at(state);
+    const OnigUChar* str = (const OnigUChar*)text.c_str();
+    const OnigUChar* end = str + text.length();
+    // 胜出规则之前的规则只需要搜索到胜出位置即可，与合并表达式的实际工作量一致
+    size_t range_byte = winner_rule_idx >= 0 ? std::min(winner_start_byte + 1, text.length()) : text.length();
+    for (size_t i = 0; i < state_rule.token_rules.size(); ++i) {
+      size_t profile_idx = it->second + 1 + i;
+      RuleProfile& profile = profiles_[profile_idx];
+      const TokenRule& token_rule = state_rule.token_rules[i];
+      int64_t match_start = -1;
+      Clock::time_point begin = Clock::now();
+      if (token_rule.isKeywordRule()) {
+        match_start = searchKeywordRule(token_rule, text, start_byte, range_byte);
+      } else if (token_regexes_[profile_idx] != nullptr) {
+        int status = onig_search(token_regexes_[profile_idx], str, end, str + start_byte, str + range_byte,
+          region_, ONIG_OPTION_NONE);
+        if (status >= 0 && region_->end[0] > region_->beg[0]) {
+          match_start = status;
+        }
+      }
+      profile.time_ns += std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - begin).count();
+      profile.invocations++;
+      profile.bytes_scanned += (match_start >= 0 ? static_cast<size_t>(match_start) : range_byte) - start_byte;
+      if (static_cast<int32_t>(i) == winner_rule_idx) {
+        profile.hits++;
+      } else {
+        profile.misses++;
+        if (winner_rule_idx >= 0 && match_start == static_cast<int64_t>(winner_start_byte)) {
+          profile.shadowed++;
+        }
+      }
+    }
+  }
+
+  void GrammarProfiler::reset() {
+    for (RuleProfile& profile : profiles_) {
+      profile.invocations = 0;
+      profile.hits = 0;
+      profile.misses = 0;
+      profile.shadowed = 0;
+      profile.bytes_scanned = 0;
+      profile.time_ns = 0;
+    }
+  }
+
+  List<RuleProfile> GrammarProfiler::report() const {
+    List<RuleProfile> result = profiles_;
+    std::stable_sort(result.begin(), result.end(), [](const RuleProfile& left, const RuleProfile& right) {
+      return left.time_ns > right.time_ns;
+    });
+    return result;
+  }
+
+  String GrammarProfiler::toTable() const {
+    List<RuleProfile> profiles = report();
+    String table = StrUtil::formatString("%-16s %6s %10s %10s %10s %10s %12s %10s  %s\n",
+      "state", "rule", "calls", "hits", "misses", "shadowed", "bytes", "time(ms)", "pattern");
+    for (const RuleProfile& profile : profiles) {
+      String rule_name = profile.token_rule_idx < 0 ? "*" : std::to_string(profile.token_rule_idx);
+      String pattern = profile.pattern.length() > 60 ? profile.pattern.substr(0, 57) + "..." : profile.pattern;
+      table += StrUtil::formatString("%-16s %6s %10llu %10llu %10llu %10llu %12llu %10.3f  %s\n",
+        profile.state_name.c_str(), rule_name.c_str(),
+        static_cast<unsigned long long>(profile.invocations),
+        static_cast<unsigned long long>(profile.hits),
+        static_cast<unsigned long long>(profile.misses),
+        static_cast<unsigned long long>(profile.shadowed),
+        static_cast<unsigned long long>(profile.bytes_scanned),
+        static_cast<double>(profile.time_ns) / 1e6,
+        pattern.c_str());
+    }
+    return table;
+  }
+
+  String GrammarProfiler::toJson() const {
+    nlohmann::json json = nlohmann::json::array();
+    for (const RuleProfile& profile : report()) {
+      json.push_back({
+        {"state", profile.state_name},
+        {"rule", profile.token_rule_idx},
+        {"pattern", profile.pattern},
+        {"style", profile.style},
+        {"invocations", profile.invocations},
+        {"hits", profile.hits},
+        {"misses", profile.misses},
+        {"shadowed", profile.shadowed},
+        {"bytesScanned", profile.bytes_scanned},
+        {"timeNs", profile.time_ns},
+      });
+    }
+    return json.dump(2);
+  }
+
+  int64_t GrammarProfiler::searchKeywordRule(const TokenRule& token_rule, const String& text, size_t start_byte,
+    size_t range_byte) const {
+    size_t byte_pos = start_byte;
+    while (byte_pos < range_byte) {
+      size_t word_length = KeywordMatcher::scanWord(text, byte_pos);
+      if (word_length == 0) {
+        ++byte_pos;
+        continue;
+      }
+      if (token_rule.keyword_matcher.contains(text.data() + byte_pos, word_length)) {
+        return static_cast<int64_t>(byte_pos);
+      }
+      byte_pos += word_length;
+    }
+    return -1;
+  }
+}
@@ -0,0 +1,38 @@
+#include <algorithm>
+#include "span_packer.h"
+
+namespace NS_FASTHIGHLIGHT {
+  // ===================================== SpanPacker ============================================
+  void SpanPacker::pack(const DocumentHighlight& highlight, size_t start_line, size_t end_line) {
+    packed_.clear();
+    end_line = std::min(end_line, highlight.getLineCount());
+    for (size_t line = start_line; line < end_line; ++line) {
+      LineSpans spans = highlight.getLineSpans(line);
+      packed_.push_back(static_cast<int32_t>(spans.size()));
+      for (const TokenSpan& span : spans) {
+        size_t start_column = span.range.start.line < line ? 0 : span.range.start.column;
+        packed_.push_back(static_cast<int32_t>(start_column));
+        packed_.push_back(static_cast<int32_t>(span.range.end.column - start_column));
+        packed_.push_back(span.style_id);
+      }
+    }
+  }
+
+  bool SpanPacker::packPublished(const DocumentAnalyzer& analyzer, size_t start_line, size_t end_line) {
+    PublishChannel<HighlightVersion>::ReadGuard version = analyzer.readPublished();
+    if (!version) {
+      packed_.clear();
+      return false;
+    }
+    pack(*version->highlight, start_line, end_line);
+    return true;
+  }
+
+  const int32_t* SpanPacker::data() const {
+    return packed_.data();
+  }
+
+  size_t SpanPacker::size() const {
+    return packed_.size();
+  }
+}
@@ -0,0 +1,203 @@
+#include <algorithm>
+#include <sstream>
+#include <nlohmann/json.hpp>
+#include "theme.h"
+
+namespace NS_FASTHIGHLIGHT {
+  /// 解析#RRGGBB或#AARRGGBB格式的颜色，#RRGGBB的透明度为FF
+  static uint32_t parseColor(const String& text, const char* property) {
+    if ((text.length() != 7 && text.length() != 9) || text[0] != '#') {
+      throw SyntaxRuleParseError(SyntaxRuleParseError::kErrCodePropertyInvalid, String(property) + ": " + text);
+    }
+    uint32_t value = 0;
+    for (size_t i = 1; i < text.length(); ++i) {
+      char c = text[i];
+      uint32_t digit;
+      if (c >= '0' && c <= '9') {
+        digit = c - '0';
+      } else if (c >= 'a' && c <= 'f') {
+        digit = c - 'a' + 10;
+      } else if (c >= 'A' && c <= 'F') {
+        digit = c - 'A' + 10;
+      } else {
+        throw SyntaxRuleParseError(SyntaxRuleParseError::kErrCodePropertyInvalid, String(property) + ": " + text);
+      }
+      value = value << 4 | digit;
+    }
+    return text.length() == 7 ? (0xFF000000 | value) : value;
+  }
+
+  static uint32_t parseFontStyle(const String& text) {
+    uint32_t font_style = kFontStyleNone;
+    std::istringstream stream(text);
+    String word;
+    while (stream >> word) {
+      if (word == "bold") {
+        font_style |= kFontStyleBold;
+      } else if (word == "italic") {
+        font_style |= kFontStyleItalic;
+      } else if (word == "underline") {
+        font_style |= kFontStyleUnderline;
+      } else if (word == "strikethrough") {
+        font_style |= kFontStyleStrikethrough;
+      } else {
+        throw SyntaxRuleParseError(SyntaxRuleParseError::kErrCodePropertyInvalid, "fontStyle: " + word);
+      }
+    }
+    return font_style;
+  }
+
+  static ThemeRule parseThemeRule(const nlohmann::json& rule_json) {
+    if (!rule_json.is_object()) {
+      throw SyntaxRuleParseError(SyntaxRuleParseError::kErrCodePropertyInvalid, "style");
+    }
+    ThemeRule rule;
+    if (rule_json.contains("foreground")) {
+      rule.style.foreground = parseColor(rule_json["foreground"].get<String>(), "foreground");
+      rule.has_foreground = true;
+    }
+    if (rule_json.contains("background")) {
+      rule.style.background = parseColor(rule_json["background"].get<String>(), "background");
+      rule.has_background = true;
+    }
+    if (rule_json.contains("fontStyle")) {
+      rule.style.font_style = parseFontStyle(rule_json["fontStyle"].get<String>());
+      rule.has_font_style = true;
+    }
+    return rule;
+  }
+
+  static void applyRule(const ThemeRule& rule, ThemeStyle& style) {
+    if (rule.has_foreground) {
+      style.foreground = rule.style.foreground;
+    }
+    if (rule.has_background) {
+      style.background = rule.style.background;
+    }
+    if (rule.has_font_style) {
+      style.font_style = rule.style.font_style;
+    }
+  }
+
+  // ===================================== Theme ============================================
+  Ptr<Theme> Theme::parseFromJson(const String& json) {
+    nlohmann::json root;
+    try {
+      root = nlohmann::json::parse(json);
+    } catch (const nlohmann::json::exception& error) {
+      throw SyntaxRuleParseError(SyntaxRuleParseError::kErrCodeJsonInvalid, error.what());
+    }
+    if (!root.is_object()) {
+      throw SyntaxRuleParseError(SyntaxRuleParseError::kErrCodeJsonInvalid, "theme");
+    }
+    Ptr<Theme> theme = MAKE_PTR<Theme>();
+    try {
+      if (root.contains("name")) {
+        theme->name_ = root["name"].get<String>();
+      }
+      if (root.contains("default")) {
+        applyRule(parseThemeRule(root["default"]), theme->default_style_);
+      }
+      if (root.contains("styles")) {
+        const nlohmann::json& styles_json = root["styles"];
+        if (!styles_json.is_object()) {
+          throw SyntaxRuleParseError(SyntaxRuleParseError::kErrCodePropertyInvalid, "styles");
+        }
+        for (const auto& item : styles_json.items()) {
+          theme->rules_.insert_or_assign(item.key(), parseThemeRule(item.value()));
+        }
+      }
+    } catch (const nlohmann::json::exception& error) {
+      throw SyntaxRuleParseError(SyntaxRuleParseError::kErrCodePropertyInvalid, error.what());
+    }
+    return theme;
+  }
+
+  const String& Theme::getName() const {
+    return name_;
+  }
+
+  void Theme::setDefaultStyle(const ThemeStyle& style) {
+    default_style_ = style;
+  }
+
+  const ThemeStyle& Theme::getDefaultStyle() const {
+    return default_style_;
+  }
+
+  void Theme::setRule(const String& style, const ThemeRule& rule) {
+    rules_.insert_or_assign(style, rule);
+  }
+
+  ThemeStyle Theme::resolve(const String& style) const {
+    ThemeStyle result = default_style_;
+    if (style.empty()) {
+      return result;
+    }
+    // 从最上级开始应用，下级的设置覆盖上级
+    size_t dot_pos = 0;
+    while (true) {
+      dot_pos = style.find('.', dot_pos);
+      auto it = rules_.find(dot_pos == String::npos ? style : style.substr(0, dot_pos));
+      if (it != rules_.end()) {
+        applyRule(it->second, result);
+      }
+      if (dot_pos == String::npos) {
+        break;
+      }
+      ++dot_pos;
+    }
+    return result;
+  }
+
+  Ptr<const CompiledTheme> Theme::compile(const SyntaxRule& rule) const {
+    List<ThemeStyle> styles;
+    styles.reserve(rule.getStyleCount());
+    for (size_t style_id = 0; style_id < rule.getStyleCount(); ++style_id) {
+      styles.push_back(resolve(rule.getStyleName(static_cast<int32_t>(style_id))));
+    }
+    return MAKE_PTR<CompiledTheme>(default_style_, std::move(styles));
+  }
+
+  // ===================================== CompiledTheme ============================================
+  CompiledTheme::CompiledTheme(const ThemeStyle& default_style, List<ThemeStyle> styles)
+    : default_style_(default_style), styles_(std::move(styles)) {
+  }
+
+  size_t CompiledTheme::getStyleCount() const {
+    return styles_.size();
+  }
+
+  const List<ThemeStyle>& CompiledTheme::getStyles() const {
+    return styles_;
+  }
+
+  void CompiledTheme::buildColorRuns(const LineSpans& spans, List<ColorRun>& runs) const {
+    runs.clear();
+    uint32_t column = 0;
+    auto append_run = [&runs](uint32_t start, uint32_t end, const ThemeStyle& style) {
+      if (!runs.empty()) {
+        ColorRun& last = runs.back();
+        if (last.end_column == start && last.foreground == style.foreground
+          && last.background == style.background && last.font_style == style.font_style) {
+          last.end_column = end;
+          return;
+        }
+      }
+      runs.push_back({start, end, style.foreground, style.background, style.font_style});
+    };
+    for (const TokenSpan& span : spans) {
+      // 从上一行延续的跨行高亮块在本行从第0列开始
+      uint32_t start = span.range.start.line < span.range.end.line ? 0
+        : static_cast<uint32_t>(span.range.start.column);
+      uint32_t end = static_cast<uint32_t>(span.range.end.column);
+      if (start > column) {
+        append_run(column, start, default_style_);
+      }
+      if (end > start) {
+        append_run(start, end, getStyle(span.style_id));
+      }
+      column = std::max(column, end);
+    }
+  }
+}
@@ -0,0 +1,172 @@
+#include <algorithm>
+#include "thread_pool.h"
+
+namespace NS_FASTHIGHLIGHT {
+  /// 当前线程所属的线程池和队列索引，非工作线程为nullptr
+  static thread_local const ThreadPool* current_pool = nullptr;
+  static thread_local size_t current_queue_idx = 0;
+
+  // ===================================== ThreadPool ============================================
+  ThreadPool::ThreadPool(size_t thread_count) {
+    if (thread_count == 0) {
+      thread_count = std::max<size_t>(std::thread::hardware_concurrency(), 1);
+    }
+    for (size_t i = 0; i < thread_count; ++i) {
+      queues_.push_back(MAKE_UPTR<WorkQueue>());
+    }
+    for (size_t i = 0; i < thread_count; ++i) {
+      workers_.emplace_back(&ThreadPool::workerLoop, this, i);
+    }
+  }
+
+  ThreadPool::~ThreadPool() {
+    {
+      std::lock_guard<std::mutex> lock(wake_mutex_);
+      stopped_ = true;
+    }
+    wake_cv_.notify_all();
+    for (std::thread& worker : workers_) {
+      worker.join();
+    }
+  }
+
+  void ThreadPool::submit(Task task) {
+    size_t queue_idx = current_pool == this ? current_queue_idx : submit_index_++ % queues_.size();
+    pushTask(queue_idx, std::move(task));
+  }
+
+  void ThreadPool::parallelFor(size_t count, const std::function<void(size_t)>& func) {
+    if (count == 0) {
+      return;
+    }
+    std::atomic<size_t> remaining {count};
+    std::mutex done_mutex;
+    std::condition_variable done_cv;
+    for (size_t i = 0; i < count; ++i) {
+      submit([&, i]() {
+        func(i);
+        // 计数与通知都在锁内完成，保证等待方返回时不再有任务访问这些局部变量
+        std::lock_guard<std::mutex> lock(done_mutex);
+        if (--remaining == 0) {
+          done_cv.notify_all();
+        }
+      });
+    }
+    // 调用线程一起窃取任务执行，队列取空后剩余任务都已在工作线程中运行，只需等待完成
+    Task task;
+    size_t start_idx = current_pool == this ? current_queue_idx : 0;
+    while (remaining > 0 && popTask(start_idx, task)) {
+      task();
+      task = nullptr;
+    }
+    std::unique_lock<std::mutex> lock(done_mutex);
+    done_cv.wait(lock, [&remaining]() { return remaining == 0; });
+  }
+
+  size_t ThreadPool::getThreadCount() const {
+    return workers_.size();
+  }
+
+  void ThreadPool::pushTask(size_t queue_idx, Task task) {
+    {
+      WorkQueue& queue = *queues_[queue_idx];
+      std::lock_guard<std::mutex> lock(queue.mutex);
+      queue.tasks.push_back(std::move(task));
+    }
+    {
+      std::lock_guard<std::mutex> lock(wake_mutex_);
+      ++queued_count_;
+    }
+    wake_cv_.notify_one();
+  }
+
+  bool ThreadPool::popTask(size_t queue_idx, Task& task) {
+    // 先从自己队列的尾部取，保持局部性
+    {
+      WorkQueue& queue = *queues_[queue_idx];
+      std::lock_guard<std::mutex> lock(queue.mutex);
+      if (!queue.tasks.empty()) {
+        task = std::move(queue.tasks.back());
+        queue.tasks.pop_back();
+        --queued_count_;
+        return true;
+      }
+    }
+    // 再从其他队列的头部窃取
+    for (size_t i = 1; i < queues_.size(); ++i) {
+      WorkQueue& queue = *queues_[(queue_idx + i) % queues_.size()];
+      std::lock_guard<std::mutex> lock(queue.mutex);
+      if (!queue.tasks.empty()) {
+        task = std::move(queue.tasks.front());
+        queue.tasks.pop_front();
+        --queued_count_;
+        return true;
+      }
+    }
+    return false;
+  }
+
+  void ThreadPool::workerLoop(size_t queue_idx) {
+    current_pool = this;
+    current_queue_idx = queue_idx;
+    Task task;
+    while (true) {
+      if (popTask(queue_idx, task)) {
+        task();
+        task = nullptr;
+        continue;
+      }
+      std::unique_lock<std::mutex> lock(wake_mutex_);
+      wake_cv_.wait(lock, [this]() { return stopped_ || queued_count_ > 0; });
+      if (stopped_ && queued_count_ == 0) {
+        break;
+      }
+    }
+    current_pool = nullptr;
+  }
+
+  // ===================================== SerialTaskQueue ============================================
+  SerialTaskQueue::SerialTaskQueue(ThreadPool& pool) : pool_(pool) {
+  }
+
+  SerialTaskQueue::~SerialTaskQueue() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    stopped_ = true;
+    tasks_.clear();
+    // 已提交到线程池但还没开始的任务仍会执行一次，看到stopped_后立即返回
+    idle_cv_.wait(lock, [this]() { return !running_; });
+  }
+
+  void SerialTaskQueue::post(ThreadPool::Task task) {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (stopped_) {
+        return;
+      }
+      tasks_.push_back(std::move(task));
+      if (running_) {
+        return;
+      }
+      running_ = true;
+    }
+    pool_.submit([this]() { drain(); });
+  }
+
+  void SerialTaskQueue::drain() {
+    while (true) {
+      ThreadPool::Task task;
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (stopped_ || tasks_.empty()) {
+          // 通知在锁内完成，保证析构方返回时不再访问成员
+          running_ = false;
+          idle_cv_.notify_all();
+          return;
+        }
+        task = std::move(tasks_.front());
+        tasks_.pop_front();
+      }
+      task();
+    }
+  }
+}
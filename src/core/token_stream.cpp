@@ -0,0 +1,237 @@
+#include <cstring>
+#include "token_stream.h"
+
+namespace NS_FASTHIGHLIGHT {
+  static void appendVarint(String& output, uint64_t value) {
+    while (value >= 0x80) {
+      output.push_back(static_cast<char>((value & 0x7F) | 0x80));
+      value >>= 7;
+    }
+    output.push_back(static_cast<char>(value));
+  }
+
+  // ===================================== TokenStreamEncoder ============================================
+  TokenStreamEncoder::TokenStreamEncoder(String& output, bool include_states)
+    : output_(output), include_states_(include_states) {
+  }
+
+  void TokenStreamEncoder::begin() {
+    output_.append(TokenStreamFormat::kMagic, sizeof(TokenStreamFormat::kMagic));
+    output_.push_back(static_cast<char>(TokenStreamFormat::kVersion));
+    output_.push_back(static_cast<char>(include_states_ ? TokenStreamFormat::kFlagSpanStates : 0));
+  }
+
+  void TokenStreamEncoder::encodeLine(size_t line, const LineSpans& spans) {
+    frame_.clear();
+    appendVarint(frame_, line - next_line_);
+    next_line_ = line + 1;
+    appendVarint(frame_, spans.size());
+
+    new_styles_.clear();
+    for (const TokenSpan& span : spans) {
+      if (style_ids_.emplace(span.style, static_cast<uint32_t>(style_ids_.size())).second) {
+        new_styles_.push_back(&span.style);
+      }
+    }
+    appendVarint(frame_, new_styles_.size());
+    for (const String* style : new_styles_) {
+      appendVarint(frame_, style->length());
+      frame_ += *style;
+    }
+
+    size_t last_column = 0;
+    for (const TokenSpan& span : spans) {
+      bool multi_line = span.range.start.line < line;
+      size_t start_column = multi_line ? 0 : span.range.start.column;
+      appendVarint(frame_, start_column - last_column);
+      appendVarint(frame_, span.range.end.column - start_column);
+      appendVarint(frame_, static_cast<uint64_t>(style_ids_[span.style]) << 1 | (multi_line ? 1 : 0));
+      if (multi_line) {
+        appendVarint(frame_, line - span.range.start.line);
+        appendVarint(frame_, span.range.start.column);
+      }
+      if (include_states_) {
+        appendVarint(frame_, static_cast<uint32_t>(span.state));
+        appendVarint(frame_, static_cast<uint32_t>(span.goto_state + 1));
+      }
+      last_column = span.range.end.column;
+    }
+    appendVarint(output_, frame_.length());
+    output_ += frame_;
+  }
+
+  void TokenStreamEncoder::encodeHighlight(const DocumentHighlight& highlight) {
+    begin();
+    highlight.forEachLine([this](size_t line, const LineSpans& spans) {
+      encodeLine(line, spans);
+    });
+  }
+
+  bool TokenStreamEncoder::encodeDocument(DocumentAnalyzer& analyzer, const Ptr<CancellationToken>& token) {
+    begin();
+    return analyzer.analyzeLines([this](size_t line, const String&, const LineSpans& spans) {
+      encodeLine(line, spans);
+    }, token);
+  }
+
+  void TokenStreamEncoder::reset() {
+    style_ids_.clear();
+    next_line_ = 0;
+  }
+
+  // ===================================== TokenStreamDecoder ============================================
+  TokenStreamDecoder::TokenStreamDecoder(const char* data, size_t size)
+    : pos_(reinterpret_cast<const uint8_t*>(data)), end_(pos_ + size), frame_end_(pos_) {
+    if (size < TokenStreamFormat::kHeaderSize
+      || std::memcmp(data, TokenStreamFormat::kMagic, sizeof(TokenStreamFormat::kMagic)) != 0
+      || static_cast<uint8_t>(data[sizeof(TokenStreamFormat::kMagic)]) != TokenStreamFormat::kVersion) {
+      error_ = true;
+      return;
+    }
+    has_span_states_ = (static_cast<uint8_t>(data[sizeof(TokenStreamFormat::kMagic) + 1])
+      & TokenStreamFormat::kFlagSpanStates) != 0;
+    pos_ += TokenStreamFormat::kHeaderSize;
+    frame_end_ = pos_;
+  }
+
+  bool TokenStreamDecoder::nextLine() {
+    if (error_) {
+      return false;
+    }
+    // 跳过当前帧未读的部分
+    pos_ = frame_end_;
+    in_frame_ = false;
+    if (pos_ >= end_) {
+      return false;
+    }
+    uint64_t frame_length;
+    if (!readVarint(frame_length)) {
+      return false;
+    }
+    if (frame_length > static_cast<uint64_t>(end_ - pos_)) {
+      error_ = true;
+      return false;
+    }
+    frame_end_ = pos_ + frame_length;
+    in_frame_ = true;
+    uint64_t line_delta;
+    uint64_t span_count;
+    uint64_t style_count;
+    if (!readVarint(line_delta) || !readVarint(span_count) || !readVarint(style_count)) {
+      return false;
+    }
+    line_ = next_line_ + static_cast<size_t>(line_delta);
+    next_line_ = line_ + 1;
+    span_count_ = static_cast<size_t>(span_count);
+    pending_spans_ = span_count_;
+    pending_styles_ = static_cast<uint32_t>(style_count);
+    last_column_ = 0;
+    return true;
+  }
+
+  size_t TokenStreamDecoder::getLine() const {
+    return line_;
+  }
+
+  size_t TokenStreamDecoder::getSpanCount() const {
+    return span_count_;
+  }
+
+  bool TokenStreamDecoder::nextStyle(StreamStyle& style) {
+    if (error_ || !in_frame_ || pending_styles_ == 0) {
+      return false;
+    }
+    uint64_t length;
+    if (!readVarint(length)) {
+      return false;
+    }
+    if (length > static_cast<uint64_t>(frame_end_ - pos_)) {
+      error_ = true;
+      return false;
+    }
+    style.id = style_count_++;
+    style.name = reinterpret_cast<const char*>(pos_);
+    style.length = static_cast<size_t>(length);
+    pos_ += length;
+    --pending_styles_;
+    return true;
+  }
+
+  bool TokenStreamDecoder::nextSpan(StreamSpan& span) {
+    if (error_ || !in_frame_) {
+      return false;
+    }
+    skipStyles();
+    if (error_ || pending_spans_ == 0) {
+      return false;
+    }
+    uint64_t column_delta;
+    uint64_t length;
+    uint64_t style_and_flag;
+    if (!readVarint(column_delta) || !readVarint(length) || !readVarint(style_and_flag)) {
+      return false;
+    }
+    size_t start_column = last_column_ + static_cast<size_t>(column_delta);
+    span.end_column = start_column + static_cast<size_t>(length);
+    span.style_id = static_cast<uint32_t>(style_and_flag >> 1);
+    if (span.style_id >= style_count_) {
+      error_ = true;
+      return false;
+    }
+    if ((style_and_flag & 1) != 0) {
+      uint64_t line_delta;
+      uint64_t original_column;
+      if (!readVarint(line_delta) || !readVarint(original_column)) {
+        return false;
+      }
+      span.start_line = line_ - static_cast<size_t>(line_delta);
+      span.start_column = static_cast<size_t>(original_column);
+    } else {
+      span.start_line = line_;
+      span.start_column = start_column;
+    }
+    if (has_span_states_) {
+      uint64_t state;
+      uint64_t goto_state;
+      if (!readVarint(state) || !readVarint(goto_state)) {
+        return false;
+      }
+      span.state = static_cast<int32_t>(state);
+      span.goto_state = static_cast<int32_t>(goto_state) - 1;
+    }
+    last_column_ = span.end_column;
+    --pending_spans_;
+    return true;
+  }
+
+  bool TokenStreamDecoder::hasError() const {
+    return error_;
+  }
+
+  bool TokenStreamDecoder::hasSpanStates() const {
+    return has_span_states_;
+  }
+
+  bool TokenStreamDecoder::readVarint(uint64_t& value) {
+    const uint8_t* limit = in_frame_ ? frame_end_ : end_;
+    value = 0;
+    for (uint32_t shift = 0; shift < 64; shift += 7) {
+      if (pos_ >= limit) {
+        break;
+      }
+      uint8_t byte = *pos_++;
+      value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+      if ((byte & 0x80) == 0) {
+        return true;
+      }
+    }
+    error_ = true;
+    return false;
+  }
+
+  void TokenStreamDecoder::skipStyles() {
+    StreamStyle style;
+    while (nextStyle(style)) {
+    }
+  }
+}
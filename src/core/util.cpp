@@ -1,10 +1,17 @@
+#include <cctype>
+#include <chrono>
 #include <filesystem>
+#include <thread>
 #include <vector>
 #include <utf8/utf8.h>
 #ifdef _WIN32
 #include <windows.h>
 #else
 #include <iconv.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 #endif
 #include <fstream>
 #include <oniguruma/oniguruma.h>
@@ -126,6 +133,55 @@ namespace NS_FASTHIGHLIGHT {
     return utf8::is_valid(str.begin(), str.end());
   }
 
+  // ===================================== Utf8PositionCursor ============================================
+  void Utf8PositionCursor::reset(const String& str) {
+    str_ = &str;
+    byte_pos_ = 0;
+    char_pos_ = 0;
+  }
+
+  size_t Utf8PositionCursor::charPosToBytePos(size_t char_pos) {
+    if (char_pos < char_pos_) {
+      rewind(char_pos, true);
+    }
+    auto it = str_->begin() + static_cast<ptrdiff_t>(byte_pos_);
+    while (char_pos_ < char_pos && it != str_->end()) {
+      utf8::next(it, str_->end());
+      ++char_pos_;
+    }
+    byte_pos_ = it - str_->begin();
+    return byte_pos_;
+  }
+
+  size_t Utf8PositionCursor::bytePosToCharPos(size_t byte_pos) {
+    if (byte_pos < byte_pos_) {
+      rewind(byte_pos, false);
+    }
+    // 字节位置在字符中间时与Utf8Util一致，计入该字符
+    auto it = str_->begin() + static_cast<ptrdiff_t>(byte_pos_);
+    while (it != str_->end() && byte_pos_ < byte_pos) {
+      utf8::next(it, str_->end());
+      byte_pos_ = it - str_->begin();
+      ++char_pos_;
+    }
+    return char_pos_;
+  }
+
+  void Utf8PositionCursor::rewind(size_t target, bool by_char) {
+    size_t current = by_char ? char_pos_ : byte_pos_;
+    if (target <= current - target) {
+      byte_pos_ = 0;
+      char_pos_ = 0;
+      return;
+    }
+    auto it = str_->begin() + static_cast<ptrdiff_t>(byte_pos_);
+    while ((by_char ? char_pos_ : byte_pos_) > target) {
+      utf8::prior(it, str_->begin());
+      byte_pos_ = it - str_->begin();
+      --char_pos_;
+    }
+  }
+
   // ======================================== StrUtil =================================================
   std::wstring StrUtil::toWString(const std::string& s) {
 #ifdef _WIN32
@@ -337,6 +393,388 @@ namespace NS_FASTHIGHLIGHT {
     return {};
   }
 
+  /// 首字节集合分析器，对Pattern做保守的递归下降分析，遇到不确定的语法直接放弃
+  class FirstByteSetParser {
+  public:
+    using ByteSet = std::bitset<256>;
+
+    explicit FirstByteSetParser(const String& pattern): pattern_(pattern) {
+    }
+
+    bool parse(ByteSet& first_bytes) {
+      ByteSet result;
+      bool nullable = false;
+      if (!parseAlternation(result, nullable) || pos_ != pattern_.length() || nullable) {
+        return false;
+      }
+      first_bytes |= result;
+      return true;
+    }
+  private:
+    const String& pattern_;
+    size_t pos_ {0};
+
+    bool atEnd() const {
+      return pos_ >= pattern_.length();
+    }
+
+    unsigned char peek() const {
+      return static_cast<unsigned char>(pattern_[pos_]);
+    }
+
+    static void addRange(ByteSet& set, unsigned char from, unsigned char to) {
+      for (int c = from; c <= to; ++c) {
+        set.set(c);
+      }
+    }
+
+    static void addNonAscii(ByteSet& set) {
+      addRange(set, 0x80, 0xFF);
+    }
+
+    static void addWord(ByteSet& set) {
+      addRange(set, 'a', 'z');
+      addRange(set, 'A', 'Z');
+      addRange(set, '0', '9');
+      set.set('_');
+      addNonAscii(set);
+    }
+
+    static void addSpace(ByteSet& set) {
+      addRange(set, '\t', '\r');
+      set.set(' ');
+      addNonAscii(set);
+    }
+
+    static void addDigit(ByteSet& set) {
+      addRange(set, '0', '9');
+      addNonAscii(set);
+    }
+
+    static void addHexDigit(ByteSet& set) {
+      addRange(set, '0', '9');
+      addRange(set, 'a', 'f');
+      addRange(set, 'A', 'F');
+    }
+
+    static bool controlEscape(unsigned char c, unsigned char& out) {
+      switch (c) {
+      case 't': out = '\t'; return true;
+      case 'n': out = '\n'; return true;
+      case 'r': out = '\r'; return true;
+      case 'f': out = '\f'; return true;
+      case 'v': out = '\v'; return true;
+      case 'a': out = '\a'; return true;
+      case 'e': out = 0x1B; return true;
+      default: return false;
+      }
+    }
+
+    bool parseAlternation(ByteSet& set, bool& nullable) {
+      nullable = false;
+      while (true) {
+        bool sequence_nullable = true;
+        if (!parseSequence(set, sequence_nullable)) {
+          return false;
+        }
+        nullable = nullable || sequence_nullable;
+        if (!atEnd() && peek() == '|') {
+          ++pos_;
+          continue;
+        }
+        return true;
+      }
+    }
+
+    bool parseSequence(ByteSet& set, bool& nullable) {
+      nullable = true;
+      while (!atEnd() && peek() != '|' && peek() != ')') {
+        ByteSet atom_set;
+        bool atom_nullable = false;
+        if (!parseAtom(atom_set, atom_nullable)) {
+          return false;
+        }
+        bool quantifier_nullable = false;
+        if (!parseQuantifier(quantifier_nullable)) {
+          return false;
+        }
+        // 前面的元素都可能为空时，当前元素的首字节才会成为整体的首字节
+        if (nullable) {
+          set |= atom_set;
+          nullable = atom_nullable || quantifier_nullable;
+        }
+      }
+      return true;
+    }
+
+    bool parseQuantifier(bool& nullable) {
+      while (!atEnd()) {
+        unsigned char c = peek();
+        if (c == '*' || c == '?') {
+          nullable = true;
+        } else if (c == '+') {
+        } else if (c == '{') {
+          size_t end = pattern_.find('}', pos_);
+          if (end == String::npos) {
+            return true;
+          }
+          String interval = pattern_.substr(pos_ + 1, end - pos_ - 1);
+          if (interval.empty() || interval.find_first_not_of("0123456789,") != String::npos) {
+            // 不是区间量词，'{'按普通字符处理
+            return true;
+          }
+          size_t min_end = interval.find(',');
+          String min_count = interval.substr(0, min_end);
+          // 只需判断下限是否为0，不转换为数值，超长的数字也不会溢出
+          if (min_count.find_first_not_of('0') == String::npos) {
+            nullable = true;
+          }
+          pos_ = end;
+        } else {
+          return true;
+        }
+        ++pos_;
+        // 惰性/占有量词后缀
+        if (!atEnd() && (peek() == '?' || peek() == '+')) {
+          ++pos_;
+        }
+      }
+      return true;
+    }
+
+    bool parseAtom(ByteSet& set, bool& nullable) {
+      unsigned char c = peek();
+      switch (c) {
+      case '(':
+        return parseGroup(set, nullable);
+      case '[':
+        return parseClass(set);
+      case '.':
+        ++pos_;
+        set.set();
+        return true;
+      case '^':
+      case '$':
+        ++pos_;
+        nullable = true;
+        return true;
+      case '\\':
+        return parseEscape(set, nullable);
+      case '*':
+      case '+':
+      case '?':
+        return false;
+      default:
+        set.set(c);
+        pos_ += utf8SequenceLength(c);
+        return true;
+      }
+    }
+
+    static size_t utf8SequenceLength(unsigned char lead) {
+      if (lead >= 0xF0) return 4;
+      if (lead >= 0xE0) return 3;
+      if (lead >= 0xC0) return 2;
+      return 1;
+    }
+
+    bool parseGroup(ByteSet& set, bool& nullable) {
+      ++pos_;
+      bool lookaround = false;
+      if (!atEnd() && peek() == '?') {
+        ++pos_;
+        if (atEnd()) {
+          return false;
+        }
+        unsigned char kind = peek();
+        if (kind == ':' || kind == '>') {
+          ++pos_;
+        } else if (kind == '=' || kind == '!') {
+          ++pos_;
+          lookaround = true;
+        } else if (kind == '<') {
+          ++pos_;
+          if (atEnd()) {
+            return false;
+          }
+          if (peek() == '=' || peek() == '!') {
+            ++pos_;
+            lookaround = true;
+          } else {
+            // 命名捕获组
+            size_t name_end = pattern_.find('>', pos_);
+            if (name_end == String::npos) {
+              return false;
+            }
+            pos_ = name_end + 1;
+          }
+        } else {
+          // 选项、注释、条件等语法不做分析
+          return false;
+        }
+      }
+      ByteSet group_set;
+      bool group_nullable = false;
+      if (!parseAlternation(group_set, group_nullable) || atEnd() || peek() != ')') {
+        return false;
+      }
+      ++pos_;
+      if (lookaround) {
+        // 环视不消耗字符
+        nullable = true;
+        return true;
+      }
+      set |= group_set;
+      nullable = group_nullable;
+      return true;
+    }
+
+    bool parseEscape(ByteSet& set, bool& nullable) {
+      ++pos_;
+      if (atEnd()) {
+        return false;
+      }
+      unsigned char c = peek();
+      ++pos_;
+      unsigned char control;
+      switch (c) {
+      case 'w': addWord(set); return true;
+      case 's': addSpace(set); return true;
+      case 'd': addDigit(set); return true;
+      case 'h': addHexDigit(set); return true;
+      case 'W': case 'S': case 'D': case 'H':
+      case 'p': case 'P': case 'R': case 'X': case 'N': case 'O':
+        // 范围过大或需要解析属性名，直接视为任意字节
+        if ((c == 'p' || c == 'P') && !atEnd() && peek() == '{') {
+          size_t end = pattern_.find('}', pos_);
+          if (end == String::npos) {
+            return false;
+          }
+          pos_ = end + 1;
+        }
+        set.set();
+        return true;
+      case 'b': case 'B': case 'A': case 'z': case 'Z':
+        nullable = true;
+        return true;
+      default:
+        break;
+      }
+      if (controlEscape(c, control)) {
+        set.set(control);
+        return true;
+      }
+      // 转义的标点符号按字面字符处理，其余(反向引用、\G、\x等)不做分析
+      if (c < 0x80 && std::ispunct(c)) {
+        set.set(c);
+        return true;
+      }
+      return false;
+    }
+
+    bool parseClass(ByteSet& set) {
+      ++pos_;
+      if (atEnd()) {
+        return false;
+      }
+      // 取反的字符类只解析语法，首字节视为任意字节
+      bool negated = peek() == '^';
+      if (negated) {
+        ++pos_;
+      }
+      ByteSet class_set;
+      bool first = true;
+      while (!atEnd()) {
+        unsigned char c = peek();
+        if (c == ']' && !first) {
+          ++pos_;
+          if (negated) {
+            set.set();
+          } else {
+            set |= class_set;
+          }
+          return true;
+        }
+        first = false;
+        if (c == '[' || (c == '&' && pos_ + 1 < pattern_.length() && pattern_[pos_ + 1] == '&')) {
+          // 嵌套字符类、POSIX字符类、交集
+          return false;
+        }
+        int from;
+        if (!parseClassChar(class_set, from)) {
+          return false;
+        }
+        if (from < 0) {
+          continue;
+        }
+        if (!atEnd() && peek() == '-' && pos_ + 1 < pattern_.length() && pattern_[pos_ + 1] != ']') {
+          ++pos_;
+          int to;
+          ByteSet ignored;
+          if (!parseClassChar(ignored, to) || to < 0) {
+            return false;
+          }
+          if (from >= 0x80 || to >= 0x80) {
+            addNonAscii(class_set);
+            if (from < 0x80) {
+              addRange(class_set, static_cast<unsigned char>(from), 0x7F);
+            }
+          } else if (from <= to) {
+            addRange(class_set, static_cast<unsigned char>(from), static_cast<unsigned char>(to));
+          }
+          continue;
+        }
+        if (from >= 0x80) {
+          addNonAscii(class_set);
+        } else {
+          class_set.set(from);
+        }
+      }
+      return false;
+    }
+
+    /// 解析字符类中的一个元素，单个字符通过from返回字符值(非ASCII返回0x80以上的首字节)，字符集合直接加入set并返回-1
+    bool parseClassChar(ByteSet& set, int& from) {
+      unsigned char c = peek();
+      if (c != '\\') {
+        size_t length = utf8SequenceLength(c);
+        pos_ += length;
+        from = c;
+        return true;
+      }
+      ++pos_;
+      if (atEnd()) {
+        return false;
+      }
+      c = peek();
+      ++pos_;
+      from = -1;
+      unsigned char control;
+      switch (c) {
+      case 'w': addWord(set); return true;
+      case 's': addSpace(set); return true;
+      case 'd': addDigit(set); return true;
+      case 'h': addHexDigit(set); return true;
+      default:
+        break;
+      }
+      if (controlEscape(c, control)) {
+        from = control;
+        return true;
+      }
+      if (c < 0x80 && std::ispunct(c)) {
+        from = c;
+        return true;
+      }
+      return false;
+    }
+  };
+
+  bool PatternUtil::computeFirstByteSet(const String& pattern_str, std::bitset<256>& first_bytes) {
+    FirstByteSetParser parser(pattern_str);
+    return parser.parse(first_bytes);
+  }
+
   // ======================================== FileUtil =================================================
 #ifdef _WIN32
   constexpr static char kPathSeparator = '\\';
@@ -450,7 +888,7 @@ namespace NS_FASTHIGHLIGHT {
     fs::path fs_path = fs::u8path(path);
     std::ifstream in(fs_path, std::ios::binary);
 #else
-    std::ifstream in(path_, std::ios::binary);
+    std::ifstream in(path, std::ios::binary);
 #endif
     if (!in) {
       return "";
@@ -465,4 +903,121 @@ namespace NS_FASTHIGHLIGHT {
     in.close();
     return content;
   }
+
+  bool FileUtil::writeString(const String& path, const String& content) {
+    // 临时文件名带上线程和时间，避免多个线程或进程同时写入同一路径时互相覆盖
+    String temp_path = path + ".tmp" + std::to_string(std::hash<std::thread::id>()(std::this_thread::get_id()))
+      + "_" + std::to_string(std::chrono::steady_clock::now().time_since_epoch().count());
+    try {
+#ifdef _WIN32
+      fs::path fs_path = fs::u8path(path);
+      fs::path fs_temp_path = fs::u8path(temp_path);
+#else
+      fs::path fs_path(path);
+      fs::path fs_temp_path(temp_path);
+#endif
+      {
+        std::ofstream out(fs_temp_path, std::ios::binary | std::ios::trunc);
+        if (!out) {
+          return false;
+        }
+        out.write(content.data(), static_cast<std::streamsize>(content.size()));
+        if (!out) {
+          out.close();
+          fs::remove(fs_temp_path);
+          return false;
+        }
+      }
+      fs::rename(fs_temp_path, fs_path);
+      return true;
+    } catch (const fs::filesystem_error& ex) {
+      std::error_code error;
+      fs::remove(fs::path(temp_path), error);
+      return false;
+    }
+  }
+
+  // ======================================== HashUtil =================================================
+  uint64_t HashUtil::fnv1a64(const char* data, size_t size, uint64_t seed) {
+    constexpr uint64_t kFnvPrime = 0x100000001B3ULL;
+    uint64_t hash = seed;
+    for (size_t i = 0; i < size; ++i) {
+      hash ^= static_cast<uint8_t>(data[i]);
+      hash *= kFnvPrime;
+    }
+    return hash;
+  }
+
+  // ======================================== MappedFile =================================================
+  MappedFile::MappedFile(const String& path) {
+#ifdef _WIN32
+    std::wstring wide_path = StrUtil::toWString(path);
+    HANDLE file = CreateFileW(wide_path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, nullptr,
+      OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+      return;
+    }
+    file_handle_ = file;
+    LARGE_INTEGER file_size;
+    if (!GetFileSizeEx(file, &file_size) || file_size.QuadPart == 0) {
+      return;
+    }
+    HANDLE mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (mapping == nullptr) {
+      return;
+    }
+    mapping_handle_ = mapping;
+    void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if (view == nullptr) {
+      return;
+    }
+    data_ = static_cast<const char*>(view);
+    size_ = static_cast<size_t>(file_size.QuadPart);
+#else
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+      return;
+    }
+    struct stat file_stat {};
+    if (::fstat(fd, &file_stat) == 0 && file_stat.st_size > 0) {
+      void* view = ::mmap(nullptr, static_cast<size_t>(file_stat.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+      if (view != MAP_FAILED) {
+        data_ = static_cast<const char*>(view);
+        size_ = static_cast<size_t>(file_stat.st_size);
+      }
+    }
+    // 映射建立后即可关闭文件描述符
+    ::close(fd);
+#endif
+  }
+
+  MappedFile::~MappedFile() {
+#ifdef _WIN32
+    if (data_ != nullptr) {
+      UnmapViewOfFile(data_);
+    }
+    if (mapping_handle_ != nullptr) {
+      CloseHandle(mapping_handle_);
+    }
+    if (file_handle_ != nullptr) {
+      CloseHandle(file_handle_);
+    }
+#else
+    if (data_ != nullptr) {
+      ::munmap(const_cast<char*>(data_), size_);
+    }
+#endif
+  }
+
+  bool MappedFile::isValid() const {
+    return data_ != nullptr;
+  }
+
+  const char* MappedFile::data() const {
+    return data_;
+  }
+
+  size_t MappedFile::size() const {
+    return size_;
+  }
 }
@@ -0,0 +1,159 @@
+#ifndef FAST_HIGHLIGHT_C_API_H
+#define FAST_HIGHLIGHT_C_API_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/// 供Rust、Go、Python等通过FFI调用的C接口。
+/// 引擎、语法规则、文本和分析器均为不透明句柄，由对应的create/compile/load函数创建，必须调用对应的release函数释放。
+/// 所有函数都不抛出异常，返回FH_OK或FH_ERROR_*状态码，结果写入调用方提供的输出参数和缓冲区，
+/// 不会把库内分配的内存交给调用方。输出缓冲区为NULL时只查询所需的大小。
+/// 文本均为UTF-8，行号和列号从0开始，列号按Unicode字符计数。
+/// 同一个句柄不能同时在多个线程中使用，不同句柄之间互不影响
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct fh_engine fh_engine;
+typedef struct fh_grammar fh_grammar;
+typedef struct fh_document fh_document;
+typedef struct fh_analyzer fh_analyzer;
+
+typedef enum fh_status {
+  FH_OK = 0,
+  /// 语法规则缺少属性，与SyntaxRuleParseError的错误码一致
+  FH_ERROR_PROPERTY_EXPECTED = -1,
+  /// 语法规则属性内容错误
+  FH_ERROR_PROPERTY_INVALID = -2,
+  /// 语法规则正则表达式错误
+  FH_ERROR_PATTERN_INVALID = -3,
+  /// 语法规则state错误
+  FH_ERROR_STATE_INVALID = -4,
+  /// 语法规则json存在语法错误
+  FH_ERROR_JSON_INVALID = -5,
+  /// 参数为NULL或超出范围
+  FH_ERROR_INVALID_ARGUMENT = -16,
+  /// 文件不存在或为空
+  FH_ERROR_FILE_NOT_FOUND = -17,
+  /// 没有与文本uri匹配的语法规则
+  FH_ERROR_NO_SYNTAX_RULE = -18,
+  /// 输出缓冲区不足，所需的大小已写入输出参数，缓冲区内容未修改
+  FH_ERROR_BUFFER_TOO_SMALL = -19,
+  /// 内存不足
+  FH_ERROR_OUT_OF_MEMORY = -20,
+  /// 其他内部错误
+  FH_ERROR_INTERNAL = -21
+} fh_status;
+
+/// 一个高亮块在一行中的部分，跨行的高亮块在之后每一行都有一项，起始列为0
+typedef struct fh_span {
+  /// 所在行
+  uint32_t line;
+  /// 起始列
+  uint32_t start_column;
+  /// 结束列(不含)
+  uint32_t end_column;
+  /// style编号，见fh_grammar_get_style_name，0为无样式
+  int32_t style_id;
+} fh_span;
+
+/// 获取状态码的说明，返回静态字符串
+const char* fh_status_message(int32_t status);
+
+/// 获取当前线程最近一次失败调用的详细信息(如语法规则缺少的属性名)，没有时返回空字符串。
+/// 返回的字符串在当前线程下一次调用本接口前有效
+const char* fh_last_error_message(void);
+
+// ===================================== fh_engine ============================================
+/// 创建引擎
+/// @param out_engine 输出引擎句柄
+fh_status fh_engine_create(fh_engine** out_engine);
+
+/// 释放引擎，已加载的分析器句柄仍可继续使用
+void fh_engine_release(fh_engine* engine);
+
+/// 编译并注册语法规则，同名规则已注册时替换，已加载的文本会热重载
+/// @param json 语法规则json文本
+/// @param length json的字节数
+/// @param out_grammar 输出语法规则句柄，可为NULL
+fh_status fh_engine_compile_grammar_json(fh_engine* engine, const char* json, size_t length,
+  fh_grammar** out_grammar);
+
+/// 编译并注册语法规则文件
+/// @param path 语法规则文件路径
+/// @param out_grammar 输出语法规则句柄，可为NULL
+fh_status fh_engine_compile_grammar_file(fh_engine* engine, const char* path, fh_grammar** out_grammar);
+
+/// 按文本uri的扩展名选择语法规则并加载到引擎中，同一uri已加载时返回已有的分析器
+/// @param out_analyzer 输出分析器句柄
+fh_status fh_engine_load_document(fh_engine* engine, fh_document* document, fh_analyzer** out_analyzer);
+
+/// 关闭已加载的文本
+fh_status fh_engine_close_document(fh_engine* engine, const char* uri);
+
+// ===================================== fh_grammar ============================================
+void fh_grammar_release(fh_grammar* grammar);
+
+/// 获取语法规则名称，写入以'\0'结尾的字符串
+/// @param buffer 输出缓冲区，为NULL时只查询大小
+/// @param capacity 缓冲区字节数
+/// @param out_length 输出名称的字节数，不含'\0'
+fh_status fh_grammar_get_name(const fh_grammar* grammar, char* buffer, size_t capacity, size_t* out_length);
+
+/// 获取所有style的数量，包括无样式
+uint32_t fh_grammar_get_style_count(const fh_grammar* grammar);
+
+/// 获取style名称，写入以'\0'结尾的字符串
+/// @param buffer 输出缓冲区，为NULL时只查询大小
+/// @param capacity 缓冲区字节数
+/// @param out_length 输出名称的字节数，不含'\0'
+fh_status fh_grammar_get_style_name(const fh_grammar* grammar, int32_t style_id, char* buffer, size_t capacity,
+  size_t* out_length);
+
+// ===================================== fh_document ============================================
+/// 创建文本，内容会被复制
+/// @param uri 文件路径，以'\0'结尾
+/// @param text 文本内容
+/// @param length 文本字节数
+/// @param out_document 输出文本句柄
+fh_status fh_document_create(const char* uri, const char* text, size_t length, fh_document** out_document);
+
+/// 释放文本句柄，已创建的分析器仍持有文本
+void fh_document_release(fh_document* document);
+
+/// 获取行数
+uint32_t fh_document_get_line_count(const fh_document* document);
+
+// ===================================== fh_analyzer ============================================
+/// 使用指定的语法规则创建不加载到引擎中的分析器
+/// @param out_analyzer 输出分析器句柄
+fh_status fh_analyzer_create(const fh_grammar* grammar, fh_document* document, fh_analyzer** out_analyzer);
+
+void fh_analyzer_release(fh_analyzer* analyzer);
+
+/// 完整分析整个文本
+fh_status fh_analyzer_analyze(fh_analyzer* analyzer);
+
+/// 修改文本并增量更新高亮，修改会同时作用于创建分析器的文本
+/// @param text 替换[start, end)范围的新文本
+/// @param length 新文本字节数
+fh_status fh_analyzer_update(fh_analyzer* analyzer, uint32_t start_line, uint32_t start_column, uint32_t end_line,
+  uint32_t end_column, const char* text, size_t length);
+
+/// 读取[start_line, end_line)行最近一次分析完成的高亮块，按行和列有序写入spans，超出行数的部分忽略
+/// @param spans 输出缓冲区，为NULL时只查询数量
+/// @param capacity 缓冲区可容纳的高亮块数量
+/// @param out_count 输出高亮块数量，缓冲区不足时为所需数量；还没有分析结果时为0
+fh_status fh_analyzer_get_spans(fh_analyzer* analyzer, uint32_t start_line, uint32_t end_line, fh_span* spans,
+  size_t capacity, size_t* out_count);
+
+/// 获取分析器当前使用的语法规则中style的名称，语义同fh_grammar_get_style_name
+fh_status fh_analyzer_get_style_name(const fh_analyzer* analyzer, int32_t style_id, char* buffer, size_t capacity,
+  size_t* out_length);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //FAST_HIGHLIGHT_C_API_H
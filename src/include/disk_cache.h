@@ -0,0 +1,71 @@
+#ifndef FAST_HIGHLIGHT_DISK_CACHE_H
+#define FAST_HIGHLIGHT_DISK_CACHE_H
+
+#include <atomic>
+#include "highlight.h"
+
+namespace NS_FASTHIGHLIGHT {
+  /// 磁盘高亮缓存的统计
+  struct DiskCacheStats {
+    /// 命中次数
+    uint64_t hits {0};
+    /// 缓存文件不存在的次数
+    uint64_t misses {0};
+    /// 缓存文件存在但校验失败(格式版本、文本长度、行数或内容不一致)的次数
+    uint64_t rejected {0};
+    /// 写入缓存文件的次数
+    uint64_t stores {0};
+  };
+
+  /// 持久化的高亮结果缓存，每个文件的高亮结果以(文本内容哈希, 语法规则指纹)命名保存在缓存目录中，
+  /// 内容包括每行结束时的state和带state的二进制高亮流(见TokenStreamFormat)。
+  /// 加载时内存映射缓存文件，只校验文件头和各段长度，命中后直接恢复高亮结果和行状态，不执行任何正则匹配。
+  /// 恢复的跨行高亮块在结束行的matched_text只包含该行的部分。
+  /// 缓存文件写入后不再修改，多个分析器、线程和进程可以共享同一个缓存目录
+  class HighlightDiskCache {
+  public:
+    /// @param directory 缓存目录，首次写入时创建
+    explicit HighlightDiskCache(const String& directory);
+
+    /// 查找文本的缓存，命中时覆盖highlight和line_states
+    /// @param document 文本
+    /// @param rule 分析文本使用的语法规则
+    /// @param highlight 恢复的高亮结果，未命中时内容不确定，需要重新分析
+    /// @param line_states 恢复的每行结束时的state，未命中时内容不确定
+    /// @return 命中返回true
+    bool load(const Document& document, const SyntaxRule& rule, DocumentHighlight& highlight,
+      List<int32_t>& line_states);
+
+    /// 保存文本的完整分析结果，缓存文件已存在时不重复写入
+    /// @param document 文本
+    /// @param rule 分析文本使用的语法规则
+    /// @param highlight 整个文本的高亮结果
+    /// @param line_states 每行结束时的state
+    /// @return 写入成功或已存在返回true
+    bool store(const Document& document, const SyntaxRule& rule, const DocumentHighlight& highlight,
+      const List<int32_t>& line_states);
+
+    /// 获取文本对应的缓存文件路径
+    /// @param document 文本
+    /// @param rule 语法规则
+    String getCachePath(const Document& document, const SyntaxRule& rule) const;
+
+    /// 获取命中率等统计数据
+    DiskCacheStats getStats() const;
+
+    /// 计算文本内容的哈希，与按'\n'拼接后的整个文本的FNV-1a哈希一致
+    /// @param document 文本
+    /// @param content_bytes 输出文本的总字节数
+    static uint64_t hashContent(const Document& document, uint64_t& content_bytes);
+  private:
+    String directory_;
+    std::atomic<uint64_t> hits_ {0};
+    std::atomic<uint64_t> misses_ {0};
+    std::atomic<uint64_t> rejected_ {0};
+    std::atomic<uint64_t> stores_ {0};
+
+    String getCachePath(uint64_t content_hash, uint64_t fingerprint) const;
+  };
+}
+
+#endif //FAST_HIGHLIGHT_DISK_CACHE_H
@@ -44,6 +44,52 @@ namespace NS_FASTHIGHLIGHT {
 #endif
   };
 
+  /// 内存占用统计(字节)，各项为估算值
+  struct MemoryUsage {
+    /// 行文本
+    size_t line_text {0};
+    /// 每行的起始state
+    size_t line_states {0};
+    /// 行高亮对象和高亮块数组
+    size_t span_vectors {0};
+    /// 高亮块中拷贝的匹配文本和样式名称
+    size_t span_strings {0};
+    /// 跨行匹配的上下文
+    size_t multi_line_contexts {0};
+    /// 行分析结果缓存
+    size_t line_cache {0};
+    /// 编译后的正则表达式
+    size_t compiled_regexes {0};
+    /// 语法规则数据：表达式文本、token规则、关键字表等
+    size_t grammar_data {0};
+    /// 哈希表的桶数组和节点开销
+    size_t hash_maps {0};
+    /// 对象自身及其他开销
+    size_t other {0};
+
+    /// 总字节数
+    size_t total() const;
+
+    MemoryUsage& operator+=(const MemoryUsage& other_usage);
+
+    /// 字符串在堆上分配的字节数，短字符串优化时为0
+    static size_t stringBytes(const String& str);
+
+    /// 哈希表桶数组和节点的字节数，不含元素自身持有的堆内存
+    template<typename Map>
+    static size_t hashTableBytes(const Map& map) {
+      return map.bucket_count() * sizeof(void*) + map.size() * (sizeof(typename Map::value_type) + 2 * sizeof(void*));
+    }
+#ifdef FH_DEBUG
+    void dump() const {
+      const nlohmann::json json = *this;
+      std::cout << json.dump(2) << std::endl;
+    }
+    NLOHMANN_DEFINE_TYPE_INTRUSIVE(MemoryUsage, line_text, line_states, span_vectors, span_strings,
+      multi_line_contexts, line_cache, compiled_regexes, grammar_data, hash_maps, other);
+#endif
+  };
+
   /// 支持增量更新的文本
   class Document {
   public:
@@ -79,6 +125,9 @@ namespace NS_FASTHIGHLIGHT {
     /// 获取总行数
     size_t getLineCount() const;
 
+    /// 获取文本版本号，初始为0，每次修改文本后递增
+    uint64_t getRevision() const;
+
     /// 根据指定的行列范围进行增量更新
     /// @param range 更新的范围区间
     /// @param new_text 更新后的文本
@@ -96,9 +145,13 @@ namespace NS_FASTHIGHLIGHT {
     /// 删除指定范围的文本
     /// @param range 范围
     void remove(const TextRange& range);
+
+    /// 统计文本占用的内存
+    MemoryUsage memoryUsage() const;
   private:
     String uri_;
     std::vector<String> lines;
+    uint64_t revision_ {0};
     bool isValidPosition(const TextPosition& pos) const;
     size_t positionToCharIndex(const TextPosition& pos) const;
     TextPosition charIndexToPosition(size_t char_index) const;
@@ -1,13 +1,29 @@
 #ifndef FAST_HIGHLIGHT_ENGINE_H
 #define FAST_HIGHLIGHT_ENGINE_H
 
+#include <atomic>
+#include <bitset>
+#include <chrono>
+#include <condition_variable>
 #include <cstdint>
+#include <deque>
+#include <functional>
+#include <future>
 #include <iostream>
+#include <list>
+#include <mutex>
+#include <shared_mutex>
+#include <thread>
+#include <type_traits>
 #include <unordered_map>
 #include <unordered_set>
 #include <nlohmann/json.hpp>
 #include <oniguruma/oniguruma.h>
 #include "foundation.h"
+#include "keyword_matcher.h"
+#include "publish_channel.h"
+#include "thread_pool.h"
+#include "util.h"
 
 namespace NS_FASTHIGHLIGHT {
   template<typename T>
@@ -37,6 +53,8 @@ namespace NS_FASTHIGHLIGHT {
 
     const char* what() const noexcept override;
     const String& message() const noexcept;
+    /// 错误码，kErrCode*之一
+    int errorCode() const noexcept;
   private:
     int err_code_;
     String message_;
@@ -50,6 +68,8 @@ namespace NS_FASTHIGHLIGHT {
     bool is_multi_line {false};
     /// 按捕获组区分的高亮样式
     HashMap<int32_t, String> styles;
+    /// 按捕获组区分的高亮样式在语法规则中的编号
+    HashMap<int32_t, int32_t> style_ids;
     /// Json解析到的跳转state文本
     String goto_state_str;
     /// token包含的正则表达式捕获组数量
@@ -58,9 +78,21 @@ namespace NS_FASTHIGHLIGHT {
     int32_t group_offset {0};
     /// 要跳转的state
     int32_t goto_state {-1};
+    /// 关键字列表，不为空时该token为关键字规则，不参与正则合并
+    List<String> keywords;
+    /// 关键字是否忽略大小写
+    bool ignore_case {false};
+    /// 关键字列表编译后的匹配器
+    KeywordMatcher keyword_matcher;
 
     const String& getGroupStyle(int32_t group) const;
 
+    /// 捕获组的高亮样式编号，没有样式时返回0(SyntaxRule::kNoStyleId)
+    int32_t getGroupStyleId(int32_t group) const;
+
+    /// 是否为关键字规则
+    bool isKeywordRule() const;
+
     static String kDefaultStyle;
     static TokenRule kEmpty;
 #ifdef FH_DEBUG
@@ -68,11 +100,21 @@ namespace NS_FASTHIGHLIGHT {
       const nlohmann::json json = *this;
       std::cout << json.dump(2) << std::endl;
     }
-    NLOHMANN_DEFINE_TYPE_INTRUSIVE(TokenRule, pattern, is_multi_line, styles, goto_state_str, group_count, group_offset, goto_state);
+    NLOHMANN_DEFINE_TYPE_INTRUSIVE(TokenRule, pattern, is_multi_line, styles, goto_state_str, group_count, group_offset, goto_state,
+      keywords, ignore_case);
 #endif
   };
 
-  /// 每个state的规则
+  /// 释放编译后的正则表达式
+  struct OnigRegexDeleter {
+    void operator()(OnigRegex regex) const {
+      onig_free(regex);
+    }
+  };
+  /// 独占所有权的正则表达式，语法规则释放时一起释放
+  using OnigRegexPtr = std::unique_ptr<std::remove_pointer_t<OnigRegex>, OnigRegexDeleter>;
+
+  /// 每个state的规则，持有编译后的正则表达式，不可复制
   struct StateRule {
     /// state名称
     String name;
@@ -80,10 +122,18 @@ namespace NS_FASTHIGHLIGHT {
     List<TokenRule> token_rules;
     /// 每个token的表达式合并的大表达式
     String merged_pattern;
-    /// 编译后的正则表达式指针
-    OnigRegex regex;
+    /// 编译后的正则表达式指针，state内只有关键字规则时为空
+    OnigRegexPtr regex;
     /// 合并后大表达式的总捕获组数量
     int32_t group_count {0};
+    /// 关键字规则在token_rules中的索引(按规则顺序)
+    List<int32_t> keyword_rule_indices;
+    /// 所有token可能匹配到的首字节集合，用于正则匹配前的预过滤
+    std::bitset<256> first_bytes;
+    /// 是否启用首字节预过滤(所有token的首字节集合都能确定时启用)
+    bool has_prefilter {false};
+    /// 首字节集合只有一个字节时直接用memchr查找，否则为-1
+    int32_t prefilter_byte {-1};
 
     static StateRule kEmpty;
 #ifdef FH_DEBUG
@@ -95,7 +145,7 @@ namespace NS_FASTHIGHLIGHT {
 #endif
   };
 
-  /// 语法规则
+  /// 语法规则，编译完成后只读，可在多个线程的分析器之间共享
   struct SyntaxRule {
     /// 语法规则的名称
     String name;
@@ -107,13 +157,30 @@ namespace NS_FASTHIGHLIGHT {
     HashMap<int32_t, StateRule> state_rules_map_;
     /// state名称 到 id 的映射
     HashMap<String, int32_t> state_id_map_;
+    /// style编号到名称，编号0为无样式("")
+    List<String> style_names_;
+    /// style名称 到 编号 的映射
+    HashMap<String, int32_t> style_id_map_;
+    /// 语法规则JSON文本的FNV-1a哈希，用于校验持久化的高亮结果是否由同一份语法规则生成
+    uint64_t fingerprint {0};
 
     int32_t getOrCreateStateId(const String& state_name);
+    int32_t getOrCreateStyleId(const String& style);
+    /// 获取style的编号，不存在时返回-1
+    int32_t getStyleId(const String& style) const;
+    /// 语法规则中所有style的数量，包括无样式
+    size_t getStyleCount() const;
+    /// 获取编号对应的style名称，编号无效时返回空字符串
+    const String& getStyleName(int32_t style_id) const;
     bool containsRule(int32_t state_id) const;
-    StateRule& getStateRule(int32_t state_id);
+    /// 获取指定state的规则，不存在时返回StateRule::kEmpty
+    const StateRule& getStateRule(int32_t state_id) const;
+    /// 统计语法规则占用的内存，编译后正则表达式的大小为估算值
+    MemoryUsage memoryUsage() const;
     SyntaxRule();
 
     constexpr static int32_t kDefaultStateId = 0;
+    constexpr static int32_t kNoStyleId = 0;
     constexpr static const char* kDefaultStateName = "default";
 #ifdef FH_DEBUG
     void dump() const {
@@ -126,33 +193,40 @@ namespace NS_FASTHIGHLIGHT {
     int32_t id_counter_ {1};
   };
 
-  /// 语法规则管理器
+  /// 语法规则管理器，编译与查询均为线程安全
   class SyntaxRuleManager {
   public:
-    /// 通过json解析语法规则
+    /// 通过json解析语法规则，同名的语法规则已注册时替换为新规则，已创建的分析器仍使用旧规则，
+    /// 需要调用DocumentAnalyzer::reloadSyntaxRule切换
     /// @param json 语法规则文件的json
-    Ptr<SyntaxRule> compileSyntaxFromJson(const String& json);
+    Ptr<const SyntaxRule> compileSyntaxFromJson(const String& json);
 
     /// 解析语法规则
     /// @param file 语法规则定义文件(json)
-    Ptr<SyntaxRule> compileSyntaxFromFile(const String& file);
+    Ptr<const SyntaxRule> compileSyntaxFromFile(const String& file);
 
     /// 获取指定名称的语法规则(如 java)
     /// @param extension 语法规则名称
-    Ptr<SyntaxRule> getSyntaxRuleByName(const String& extension);
+    Ptr<const SyntaxRule> getSyntaxRuleByName(const String& extension) const;
 
     /// 获取指定后缀名匹配的的语法规则(如 .t)
     /// @param extension 后缀名
-    Ptr<SyntaxRule> getSyntaxRuleByExtension(const String& extension) const;
+    Ptr<const SyntaxRule> getSyntaxRuleByExtension(const String& extension) const;
+
+    /// 统计所有语法规则占用的内存
+    MemoryUsage memoryUsage() const;
   private:
-    HashMap<String, Ptr<SyntaxRule>> name_rules_map_;
+    HashMap<String, Ptr<const SyntaxRule>> name_rules_map_;
+    mutable std::shared_mutex rules_mutex_;
 
     static void parseSyntaxName(const Ptr<SyntaxRule>& rule, nlohmann::json& root);
     static void parseFileExtensions(const Ptr<SyntaxRule>& rule, nlohmann::json& root);
     static void parseVariables(const Ptr<SyntaxRule>& rule, nlohmann::json& root);
     static void parseStates(const Ptr<SyntaxRule>& rule, nlohmann::json& root);
     static void parseState(const Ptr<SyntaxRule>& rule, StateRule& state_rule, const nlohmann::json& state_json);
+    static void parseKeywords(TokenRule& token_rule, const nlohmann::json& token_json);
     static void compileStatePattern(StateRule& state_rule);
+    static void compileStatePrefilter(StateRule& state_rule);
     static void replaceVariable(String& text, HashMap<String, String>& variables_map);
   };
 
@@ -164,6 +238,8 @@ namespace NS_FASTHIGHLIGHT {
     String matched_text;
     /// 高亮块所匹配的style
     String style;
+    /// style在语法规则中的编号，用于按下标查找主题颜色
+    int32_t style_id {0};
     /// 高亮块被匹配时所处的状态
     int32_t state {0};
     /// 高亮块要跳转的别的state
@@ -189,24 +265,157 @@ namespace NS_FASTHIGHLIGHT {
 #endif
   };
 
-  /// 整个文本内容的高亮
+  /// 一行的高亮块在所属块的span池中的位置
+  struct LineRecord {
+    /// 在span池中的起始下标
+    uint32_t span_start {0};
+    /// 高亮块数量
+    uint32_t span_count {0};
+  };
+
+  /// 连续若干行的高亮结果，行记录和高亮块分别连续存储，同一块内各行的高亮块按行号顺序排列
+  struct HighlightBlock {
+    List<LineRecord> lines;
+    List<TokenSpan> spans;
+  };
+
+  /// 块索引中连续若干块组成的一段，按段在快照之间共享
+  struct HighlightBlockChunk {
+    List<Ptr<HighlightBlock>> blocks;
+    /// 每个块第一行在段内的行号，用于二分查找行所在的块
+    List<size_t> block_first_lines;
+    /// 段内的总行数
+    size_t line_count {0};
+  };
+
+  /// 一行高亮块的只读视图，在所属的DocumentHighlight下一次修改前有效
+  struct LineSpans {
+    const TokenSpan* data {nullptr};
+    size_t count {0};
+
+    const TokenSpan* begin() const { return data; }
+    const TokenSpan* end() const { return data + count; }
+    size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+    const TokenSpan& operator[](size_t index) const { return data[index]; }
+    const TokenSpan& front() const { return data[0]; }
+    const TokenSpan& back() const { return data[count - 1]; }
+  };
+
+  /// 整个文本内容的高亮，按固定行数分块存储，插入删除行只需要修改所在的块。块指针再按段分组，
+  /// 拷贝只复制段指针，段和块在修改前如果仍被其他拷贝引用会先复制一份(写时复制)
   struct DocumentHighlight {
-    List<Ptr<LineHighlight>> lines;
+    /// 每个块最多包含的行数
+    static constexpr size_t kMaxBlockLines = 128;
+    /// 每段最多包含的块数
+    static constexpr size_t kMaxChunkBlocks = 64;
+
+    /// 获取行数
+    size_t getLineCount() const;
+
+    /// 获取块数量
+    size_t getBlockCount() const;
+
+    /// 获取某一行的高亮块
+    /// @param line 行号
+    LineSpans getLineSpans(size_t line) const;
+
+    /// 替换某一行的高亮块，行内高亮块数量不变时原地覆盖，复用字符串的容量
+    /// @param line 行号
+    /// @param spans 新的高亮块
+    void setLineSpans(size_t line, const LineSpans& spans);
+
+    /// 在指定位置插入空行，行所在的块超出kMaxBlockLines时拆分
+    /// @param line 插入位置的行号
+    /// @param count 插入的行数
+    void insertLines(size_t line, size_t count);
+
+    /// 删除指定位置开始的若干行
+    /// @param line 起始行号
+    /// @param count 删除的行数
+    void removeLines(size_t line, size_t count);
+
+    /// 在末尾追加空行或删除末尾的行，使总行数为line_count
+    /// @param line_count 新的行数
+    void resize(size_t line_count);
+
+    /// 把from_line及之后所有高亮块范围的行号加上delta，用于插入删除行之后修正未重新分析的行
+    /// @param from_line 起始行号
+    /// @param delta 行号偏移量
+    void offsetLineNumbers(size_t from_line, std::ptrdiff_t delta);
+
+    /// 把所有高亮块的state编号和style编号映射到新的语法规则，用于热重载后尚未重新分析的行。
+    /// style按名称查找，新规则中不存在的style变为SyntaxRule::kNoStyleId
+    /// @param rule 新的语法规则
+    /// @param state_mapping 旧state编号到新state编号的映射，不在其中的state变为默认state
+    void remapRule(const SyntaxRule& rule, const HashMap<int32_t, int32_t>& state_mapping);
+
+    /// 按行号顺序遍历所有行，块内的行记录和高亮块都连续存储
+    /// @param visitor 参数为(size_t line, const LineSpans& spans)
+    template<typename Visitor>
+    void forEachLine(Visitor&& visitor) const {
+      size_t line = 0;
+      for (const Ptr<HighlightBlockChunk>& chunk : chunks_) {
+        for (const Ptr<HighlightBlock>& block : chunk->blocks) {
+          for (const LineRecord& record : block->lines) {
+            visitor(line++, LineSpans {block->spans.data() + record.span_start, record.span_count});
+          }
+        }
+      }
+    }
+
+    /// 统计高亮结果占用的内存
+    MemoryUsage memoryUsage() const;
+
+    /// 创建当前高亮的不可变快照，与当前对象共享所有块，
+    /// 之后的修改只会复制被改动的块，快照可以在其他线程中读取
+    Ptr<const DocumentHighlight> snapshot() const;
 
-    void addLine(const Ptr<LineHighlight>& line);
     void reset();
 
 #ifdef FH_DEBUG
     void dump() const {
       nlohmann::json json = nlohmann::json::array();
-      for (const Ptr<LineHighlight>& line : lines) {
+      forEachLine([&json](size_t, const LineSpans& spans) {
         nlohmann::json line_obj;
-        to_json(line_obj, *line);
+        line_obj["spans"] = List<TokenSpan>(spans.begin(), spans.end());
         json.push_back(line_obj);
-      }
+      });
       std::cout << json.dump(2) << std::endl;
     }
 #endif
+  private:
+    /// 行在块索引中的位置
+    struct BlockLocation {
+      size_t chunk {0};
+      size_t block {0};
+      size_t line {0};
+    };
+
+    List<Ptr<HighlightBlockChunk>> chunks_;
+    /// 每段第一行的行号
+    List<size_t> chunk_first_lines_;
+    size_t line_count_ {0};
+    size_t block_count_ {0};
+
+    /// 查找行所在的段和块，line等于行数时返回最后一个块的末尾
+    BlockLocation locateLine(size_t line) const;
+    /// 获取可修改的段，段被快照共享时先复制
+    HighlightBlockChunk& mutableChunk(size_t chunk_idx);
+    /// 获取可修改的块，块被快照共享时先复制，chunk需要已经是可修改的段
+    static HighlightBlock& mutableBlock(HighlightBlockChunk& chunk, size_t block_idx);
+    void splitBlock(HighlightBlockChunk& chunk, size_t block_idx);
+    void splitChunk(size_t chunk_idx);
+    /// 从from_block开始重新计算段内各块的起始行和段的总行数
+    static void updateBlockFirstLines(HighlightBlockChunk& chunk, size_t from_block);
+    void updateChunkFirstLines(size_t from_chunk);
+  };
+
+  /// 发布给读线程的高亮版本
+  struct HighlightVersion {
+    /// 高亮对应的文本版本号，见Document::getRevision
+    uint64_t revision {0};
+    Ptr<const DocumentHighlight> highlight;
   };
 
   /// 正则匹配结果
@@ -227,16 +436,37 @@ namespace NS_FASTHIGHLIGHT {
     int32_t matched_group {-1};
     /// 高亮样式
     String style;
+    /// 高亮样式的编号
+    int32_t style_id {0};
     /// 要切换的state
     int32_t goto_state {-1};
     /// 匹配到的文本内容
     String matched_text;
+    /// 未匹配时，剩余文本中是否已不存在任何匹配
+    bool exhausted {false};
+    /// 是否因触发回溯次数或时间限制而中止
+    bool limit_exceeded {false};
+
+    /// 重置为未匹配状态，保留字符串的容量以便复用
+    void reset();
+  };
+
+  /// 分析时的匹配限制，防止病态的正则表达式或输入导致长时间卡顿
+  struct AnalyzeOptions {
+    /// 单次搜索的回溯重试次数上限，0表示使用Oniguruma的默认值
+    uint64_t retry_limit_in_search {0};
+    /// 单个起始位置匹配的回溯重试次数上限，0表示使用Oniguruma的默认值
+    uint64_t retry_limit_in_match {0};
+    /// 每行分析的时间预算(微秒)，0表示不限制。每次匹配前按微秒精度检查整行的剩余预算，用完后该行剩余文本不再高亮。
+    /// Oniguruma只能按毫秒限制单次搜索，剩余预算不足1毫秒时该次搜索最多运行1毫秒，一行的实际耗时因此最多超出预算约1毫秒
+    uint64_t line_time_budget_us {0};
   };
 
   /// 跨行匹配时的上下文
   struct MultiLineContext {
     int32_t state {-1};
     String style;
+    int32_t style_id {0};
     size_t start_line {0};
     size_t start_column {0};
     String accumulated_text;
@@ -251,65 +481,428 @@ namespace NS_FASTHIGHLIGHT {
     int32_t new_state {-1};
   };
 
-  /// 高亮分析器
+  /// 取消令牌，由发起方调用cancel，分析过程在行与行之间检查，被取消的分析会尽快停止
+  class CancellationToken {
+  public:
+    /// 请求取消
+    void cancel();
+
+    /// 是否已请求取消
+    bool isCancelled() const;
+  private:
+    std::atomic<bool> cancelled_ {false};
+  };
+
+  /// 异步分析的结果回调，在分析器的后台线程中调用
+  /// @param highlight 整个文本的高亮结果，分析被取消时为nullptr
+  using AnalyzeCallback = std::function<void(const Ptr<DocumentHighlight>& highlight)>;
+  /// 逐行分析的回调，spans只在回调期间有效
+  using LineVisitor = std::function<void(size_t line, const String& line_text, const LineSpans& spans)>;
+
+  class GrammarProfiler;
+  class LineResultCache;
+  struct LineCacheStats;
+  class HighlightDiskCache;
+
+  /// 高亮分析器，同一个分析器的分析调用会被串行执行，不同分析器可共享语法规则并发分析
   class DocumentAnalyzer {
   public:
-    explicit DocumentAnalyzer(const Ptr<Document>& document, const Ptr<SyntaxRule>& rule);
+    explicit DocumentAnalyzer(const Ptr<Document>& document, const Ptr<const SyntaxRule>& rule);
+    ~DocumentAnalyzer();
+    DocumentAnalyzer(const DocumentAnalyzer&) = delete;
+    DocumentAnalyzer& operator=(const DocumentAnalyzer&) = delete;
 
     /// 对整个文本进行高亮分析
-    /// @return 整个文本的高亮结果
-    Ptr<DocumentHighlight> analyzeFully();
+    /// @param token 取消令牌，可为nullptr
+    /// @return 整个文本的高亮结果，被取消时返回nullptr，未分析的行会在下次分析时补上
+    Ptr<DocumentHighlight> analyzeFully(const Ptr<CancellationToken>& token = nullptr);
+
+    /// 逐行分析整个文本，每行分析完立即回调，不保存整个文本的高亮结果，
+    /// 用于渲染或导出等只需要顺序遍历一次的场景
+    /// @param visitor 每行的回调
+    /// @param token 取消令牌，可为nullptr
+    /// @return 被取消时返回false
+    bool analyzeLines(const LineVisitor& visitor, const Ptr<CancellationToken>& token = nullptr);
 
     /// 根据patch内容重新分析整个文本的高亮结果
     /// @param range patch的变更范围
     /// @param new_text patch的文本
-    /// @return 整个文本的高亮结果
-    Ptr<DocumentHighlight> updateHighlight(const TextRange& range, const String& new_text);
+    /// @param token 取消令牌，可为nullptr
+    /// @return 整个文本的高亮结果，被取消时返回nullptr，未分析的行会在下次分析时补上
+    Ptr<DocumentHighlight> updateHighlight(const TextRange& range, const String& new_text,
+      const Ptr<CancellationToken>& token = nullptr);
+
+    /// 在后台线程中对整个文本进行高亮分析，多个异步调用按提交顺序依次执行
+    /// @param token 取消令牌，可为nullptr
+    /// @return 整个文本的高亮结果，被取消时为nullptr
+    std::future<Ptr<DocumentHighlight>> analyzeFullyAsync(const Ptr<CancellationToken>& token = nullptr);
+
+    /// 在后台线程中对整个文本进行高亮分析，完成或取消后回调
+    /// @param token 取消令牌，可为nullptr
+    /// @param callback 结果回调
+    void analyzeFullyAsync(const Ptr<CancellationToken>& token, const AnalyzeCallback& callback);
+
+    /// 在后台线程中应用patch并重新分析，多个异步调用按提交顺序依次执行，被取消时patch仍然会应用到文本
+    /// @param range patch的变更范围
+    /// @param new_text patch的文本
+    /// @param token 取消令牌，可为nullptr
+    /// @return 整个文本的高亮结果，被取消时为nullptr
+    std::future<Ptr<DocumentHighlight>> updateHighlightAsync(const TextRange& range, const String& new_text,
+      const Ptr<CancellationToken>& token = nullptr);
+
+    /// 在后台线程中应用patch并重新分析，完成或取消后回调
+    /// @param range patch的变更范围
+    /// @param new_text patch的文本
+    /// @param token 取消令牌，可为nullptr
+    /// @param callback 结果回调
+    void updateHighlightAsync(const TextRange& range, const String& new_text,
+      const Ptr<CancellationToken>& token, const AnalyzeCallback& callback);
+
+    /// 是否有因取消或语法规则热重载而尚未重新分析的行
+    bool hasDirtyLines() const;
+
+    /// 统计分析器占用的内存，包括文本、高亮结果、行状态和跨行上下文，不含共享的语法规则
+    MemoryUsage memoryUsage();
+
+    /// 估算分析器占用的内存(字节)，不等待正在进行的分析，分析进行中时返回上一次统计的结果
+    size_t estimateMemoryBytes();
+
+    /// 释放高亮结果缓存，保留行状态，之后的updateHighlight会重新生成所有行的高亮，analyzeLine不受影响
+    /// @return 分析正在进行时不释放并返回false
+    bool releaseHighlightCache();
 
     /// 分析一行的高亮结果
     /// @param line 行号
     /// @return 一行的高亮结果
     Ptr<LineHighlight> analyzeLine(size_t line);
+
+    /// 开启或关闭语法规则性能分析，开启时会清空之前的统计数据
+    /// @param enabled 是否开启
+    void setProfilingEnabled(bool enabled);
+
+    /// 获取分析使用的语法规则
+    Ptr<const SyntaxRule> getSyntaxRule() const;
+
+    /// 获取语法规则性能分析器，会等待正在进行的分析完成
+    /// @return 未开启性能分析时返回nullptr
+    Ptr<GrammarProfiler> getProfiler();
+
+    /// 开启或关闭高亮快照，开启后每次完整分析或增量更新成功后都会发布新的快照
+    /// @param enabled 是否开启
+    void setSnapshotEnabled(bool enabled);
+
+    /// 获取最近一次分析完成时的高亮快照，可以在任意线程调用，不加锁也不会等待正在进行的分析
+    /// @return 未开启快照或还没有分析完成时返回nullptr
+    Ptr<const DocumentHighlight> getSnapshot() const;
+
+    /// 读取最近发布的高亮版本，不加锁，也不修改快照的引用计数，适合UI线程每帧调用。
+    /// 守卫存活期间版本不会被回收，读取完应尽快释放
+    /// @return 未开启快照或还没有分析完成时守卫为空
+    PublishChannel<HighlightVersion>::ReadGuard readPublished() const;
+
+    /// 设置匹配限制，触发限制的行剩余部分以无样式输出。会等待正在进行的分析完成，新的限制从下一次分析开始生效
+    /// @param options 匹配限制
+    void setAnalyzeOptions(const AnalyzeOptions& options);
+
+    /// 设置行分析结果缓存的容量，以(行起始state, 行文本)为键，命中的行不执行正则匹配，
+    /// 撤销、重新加载或粘贴重复代码后的分析因此几乎没有开销。处于跨行匹配中的行不缓存
+    /// @param capacity_bytes 容量(字节)，0表示关闭并释放缓存
+    void setLineCacheCapacity(size_t capacity_bytes);
+
+    /// 获取行分析结果缓存的命中率和内存统计，未开启时均为0
+    LineCacheStats getLineCacheStats();
+
+    /// 设置可见区域，语法规则热重载时优先重新分析这些行
+    /// @param start_line 起始行号
+    /// @param end_line 结束行号(不含)
+    void setViewport(size_t start_line, size_t end_line);
+
+    /// 热重载语法规则，不重新加载文本。已有的行状态按state名称、高亮块的style按名称映射到新规则，可见区域(未设置时为
+    /// 文本开头的DocumentHighlight::kMaxBlockLines行)立即在调用线程中重新分析，其余行在后台线程中分段重新分析，
+    /// 每段之间释放锁，等待中的编辑和单行分析先执行。完成前hasDirtyLines()返回true。再次热重载时未完成的后台分析会被取消
+    /// @param rule 新的语法规则
+    /// @param callback 后台完整分析完成或被取消后回调，被取消时结果为nullptr，可为nullptr
+    void reloadSyntaxRule(const Ptr<const SyntaxRule>& rule, const AnalyzeCallback& callback = nullptr);
+
+    /// 设置磁盘高亮缓存，首次完整分析前先查找缓存，命中时直接恢复高亮结果和行状态而不执行分析，
+    /// 首次完整分析完成后写入缓存。文本结束时仍处于跨行匹配中的结果不写入
+    /// @param cache 磁盘缓存，nullptr表示关闭
+    void setDiskCache(const Ptr<HighlightDiskCache>& cache);
+
+    /// 获取因触发匹配限制而降级处理的次数
+    uint64_t getLimitExceededCount() const;
   private:
     Ptr<Document> document_;
     Ptr<DocumentHighlight> highlight_;
-    Ptr<SyntaxRule> rule_;
+    Ptr<const SyntaxRule> rule_;
     HashMap<int32_t, MultiLineContext> multi_line_contexts_;
+    /// 跨行匹配是否累积从起始行开始的文本，流式分析时之前的行已经回调，结束行只输出本行的部分
+    bool accumulate_multi_line_text_ {true};
     List<int32_t> line_states_;
-
-    Ptr<LineHighlight> analyzeLineWithState(size_t line, int32_t start_state);
+    Ptr<GrammarProfiler> profiler_;
+    AnalyzeOptions options_;
+    bool has_match_limits_ {false};
+    std::chrono::steady_clock::time_point line_deadline_;
+    /// 分析线程中累加，getLimitExceededCount不加锁读取
+    std::atomic<uint64_t> limit_exceeded_count_ {0};
+    /// 因取消而未完成分析的起始行，没有时为kNoDirtyLine。加锁修改，hasDirtyLines不加锁读取
+    std::atomic<size_t> dirty_line_ {kNoDirtyLine};
+    /// 热重载后尚未按新规则重新分析的起始行，后台完整分析完成后为kNoDirtyLine。
+    /// 这些行的高亮已映射到新规则，与dirty_line_不同，增量更新不需要一直分析到文本末尾
+    std::atomic<size_t> stale_line_ {kNoDirtyLine};
+    /// 上一次统计的内存占用，分析进行中时estimateMemoryBytes返回该值
+    std::atomic<size_t> memory_bytes_ {0};
+    std::mutex analyze_mutex_;
+    /// 正在等待analyze_mutex_的编辑调用数量，热重载的后台分析在两段之间先让编辑执行
+    std::atomic<uint32_t> waiting_edits_ {0};
+    /// 编辑调用拿到锁后通知，与analyze_mutex_配合使用
+    std::condition_variable edit_cv_;
+    /// 开启快照后，每次分析完成时的快照通过发布通道交给读线程
+    bool snapshot_enabled_ {false};
+    PublishChannel<HighlightVersion> published_;
+
+    /// 分析单行时写入高亮块的暂存区，只增不减以复用字符串的容量
+    List<TokenSpan> line_spans_;
+    /// 分析过程中复用的匹配结果
+    MatchResult match_result_;
+    /// 当前分析行的字符/字节位置换算，匹配相关的函数只能用于tokenizeLine正在分析的行
+    Utf8PositionCursor line_cursor_;
+    /// 行分析结果缓存，未开启时为nullptr
+    UPtr<LineResultCache> line_cache_;
+    /// 开始跨行匹配的次数，用于判断一行的结果是否可以缓存
+    uint64_t multi_line_start_count_ {0};
+    /// 磁盘高亮缓存，未开启时为nullptr
+    Ptr<HighlightDiskCache> disk_cache_;
+    /// 是否已完成过一次完整分析(或从磁盘缓存恢复)
+    bool fully_analyzed_ {false};
+    /// 可见区域[viewport_start_, viewport_end_)，未设置时viewport_end_为0
+    size_t viewport_start_ {0};
+    size_t viewport_end_ {0};
+    /// 热重载后台完整分析的取消令牌
+    Ptr<CancellationToken> reload_token_;
+
+    /// 异步分析任务队列，在所有分析器共享的线程池上按提交顺序执行。
+    /// 最后声明，析构时最先等待正在执行的任务，任务中用到的其他成员此时仍然有效
+    SerialTaskQueue async_queue_;
+
+    static constexpr size_t kNoDirtyLine = SIZE_MAX;
+    /// 热重载后台分析每段的行数，每段之间释放analyze_mutex_
+    static constexpr size_t kReloadChunkLines = 1024;
+    friend class StreamTokenizer;
+
+    /// 按顺序覆盖写入一行的高亮块，复用已有TokenSpan中字符串的容量
+    struct SpanWriter {
+      List<TokenSpan>& spans;
+      size_t count {0};
+
+      /// 取下一个要写入的高亮块，调用方需要设置全部字段
+      TokenSpan& next();
+      /// 本次写入的高亮块，超出count的旧高亮块保留给之后的行复用
+      LineSpans finish() const;
+    };
+
+    MemoryUsage memoryUsageLocked() const;
+    Ptr<DocumentHighlight> analyzeFullyLocked(const Ptr<CancellationToken>& token);
+    /// 重新分析[start_line, end_line)的行，起始state取上一行的结束state
+    void analyzeRangeLocked(size_t start_line, size_t end_line);
+    /// 从stale_line_开始按新规则分析一段，未到文本末尾时提交下一段
+    void continueReload(const Ptr<CancellationToken>& token, const AnalyzeCallback& callback);
+    /// 编辑调用获取analyze_mutex_，热重载的后台分析会让出
+    std::unique_lock<std::mutex> lockForEdit();
+    void publishSnapshot();
+    void postAsyncTask(std::function<void()> task);
+    LineSpans analyzeLineWithState(size_t line, int32_t start_state);
+    /// 分析不属于document_的一行文本，跨行上下文与其他行共享
+    /// @param end_state 分析结束时的状态
+    LineSpans analyzeLineText(size_t line, const String& line_text, int32_t start_state, int32_t& end_state);
+    LineSpans tokenizeLine(size_t line, const String& line_text, int32_t start_state, int32_t& end_state);
     MultiLineStartResult startMultiLineMatch(size_t line, size_t char_pos,
       int32_t current_state, const MatchResult& match_result);
-    MultiLineContinueResult continueMultiLineMatch(size_t line, size_t char_pos, MultiLineContext& context);
-    bool isPotentialMultiLineMatch(const MatchResult& match_result, const String& line_text, size_t current_pos);
-    void processSingleLineMatch(Ptr<LineHighlight> highlight, size_t line_num,
+    MultiLineContinueResult continueMultiLineMatch(size_t line, const String& line_text, size_t char_pos,
+      MultiLineContext& context);
+    bool isPotentialMultiLineMatch(const MatchResult& match_result, size_t line_char_count, size_t current_pos);
+    void processSingleLineMatch(SpanWriter& writer, size_t line_num,
       size_t char_pos, int32_t state, const MatchResult& match_result);
-    MatchResult matchAtPosition(const String& text, size_t start_char_pos, int32_t state);
+    void processUnmatchedText(SpanWriter& writer, size_t line_num, const String& line_text,
+      size_t char_pos, size_t char_count, int32_t state);
+    void matchAtPosition(const String& text, size_t start_char_pos, int32_t state, MatchResult& result);
+    void searchAtPosition(const String& text, size_t start_char_pos, int32_t state, MatchResult& result);
+    bool matchKeyword(const StateRule& state_rule, const String& text, size_t start_byte, size_t limit_byte,
+      int32_t max_rule_idx, MatchResult& result);
     void findMatchedRuleAndGroup(const StateRule& state_rule, OnigRegion* region,
       size_t match_start_byte, size_t match_end_byte, MatchResult& result);
     size_t computeAffectedLines(const TextRange& range, const String& new_text);
   };
 
-  /// 高亮引擎
+  /// 流式分析器，按块接收文本(例如来自管道或socket)，遇到换行符时分析并回调一行，
+  /// 只在内存中保留当前未结束的一行，行状态和跨行上下文在块之间延续。非线程安全
+  class StreamTokenizer {
+  public:
+    /// @param rule 语法规则
+    /// @param visitor 每行分析完成后的回调，行号从0开始
+    StreamTokenizer(const Ptr<const SyntaxRule>& rule, const LineVisitor& visitor);
+
+    /// 写入一块文本，块的边界可以在行中间甚至UTF-8字符中间
+    /// @param data 文本数据
+    /// @param size 字节数
+    void feed(const char* data, size_t size);
+
+    /// 写入一块文本
+    /// @param chunk 文本数据
+    void feed(const String& chunk);
+
+    /// 输入结束，分析最后一行。与Document的分行规则一致，以换行符结尾的输入最后还有一个空行
+    void finish();
+
+    /// 清空当前行、行号和分析状态，用于开始新的输入
+    void reset();
+
+    /// 已回调的行数
+    size_t getLineCount() const;
+
+    /// 下一行开始时的分析状态
+    int32_t getState() const;
+
+    /// 设置匹配限制，触发限制的行剩余部分以无样式输出。会等待正在进行的分析完成，新的限制从下一次分析开始生效
+    /// @param options 匹配限制
+    void setAnalyzeOptions(const AnalyzeOptions& options);
+
+    /// 设置行分析结果缓存的容量，日志等大量重复行的输入可以跳过正则匹配
+    /// @param capacity_bytes 容量(字节)，0表示关闭
+    void setLineCacheCapacity(size_t capacity_bytes);
+  private:
+    UPtr<DocumentAnalyzer> analyzer_;
+    LineVisitor visitor_;
+    /// 尚未遇到换行符的当前行
+    String line_;
+    size_t line_count_ {0};
+    int32_t state_ {SyntaxRule::kDefaultStateId};
+    /// 是否收到过任何输入，空输入在finish时不产生行
+    bool has_input_ {false};
+
+    void emitLine();
+  };
+
+  /// 批量高亮的单个文本
+  struct HighlightJob {
+    /// 文本uri，根据扩展名选择语法规则
+    String uri;
+    /// 文本内容
+    String text;
+  };
+
+  /// 批量高亮的结果回调，在工作线程中调用
+  /// @param index 任务在批量列表中的索引
+  /// @param highlight 高亮结果，没有匹配的语法规则时为nullptr
+  using BatchCallback = std::function<void(size_t index, const Ptr<DocumentHighlight>& highlight)>;
+
+  /// 语法规则热重载后文本重新分析完成的回调，在分析器的后台线程中调用
+  /// @param uri 热重载了语法规则的文本uri
+  /// @param highlight 后台重新分析完成后的高亮结果
+  using SyntaxReloadCallback = std::function<void(const String& uri, const Ptr<DocumentHighlight>& highlight)>;
+
+  /// 高亮引擎，所有接口均为线程安全，一个引擎可服务多个分析线程
   class HighlightEngine {
   public:
     HighlightEngine();
 
-    /// 编译语法规则
+    /// 编译语法规则，同名的语法规则已注册时替换，已加载的使用该规则的文本会热重载(见DocumentAnalyzer::reloadSyntaxRule)
     /// @param json 语法规则的json文本
-    void compileSyntaxFromJson(const String& json) const;
+    /// @return 编译后的语法规则
+    Ptr<const SyntaxRule> compileSyntaxFromJson(const String& json) const;
 
-    /// 编译语法规则
+    /// 编译语法规则，同名的语法规则已注册时替换，已加载的使用该规则的文本会热重载
     /// @param file 语法规则文件
-    void compileSyntaxFromFile(const String& file) const;
+    /// @return 编译后的语法规则，文件不存在或为空时返回nullptr
+    Ptr<const SyntaxRule> compileSyntaxFromFile(const String& file) const;
+
+    /// 设置语法规则热重载后每个文本后台重新分析完成时的回调，在分析器的后台线程中调用
+    /// @param callback 回调，可为nullptr
+    void setSyntaxReloadCallback(const SyntaxReloadCallback& callback);
 
     /// 加载文本并进行首次分析
     /// @param document 文本内容
     /// @return 整个文本的高亮结果
     Ptr<DocumentAnalyzer> loadDocument(const Ptr<Document>& document);
+
+    /// 创建不加载到引擎中的分析器，不参与内存预算，用于一次性的分析任务
+    /// @param document 文本内容
+    /// @return 没有匹配的语法规则时返回nullptr
+    Ptr<DocumentAnalyzer> createAnalyzer(const Ptr<Document>& document) const;
+
+    /// 创建流式分析器
+    /// @param uri 文件路径，根据扩展名选择语法规则
+    /// @param visitor 每行分析完成后的回调
+    /// @return 没有匹配的语法规则时返回nullptr
+    UPtr<StreamTokenizer> createStreamTokenizer(const String& uri, const LineVisitor& visitor) const;
+
+    /// 是否有与文件后缀名匹配的语法规则
+    /// @param uri 文件路径
+    bool hasSyntaxRule(const String& uri) const;
+
+    /// 设置匹配限制，对已加载和之后加载的文本都生效
+    /// @param options 匹配限制
+    void setAnalyzeOptions(const AnalyzeOptions& options);
+
+    /// 设置磁盘高亮缓存，对之后加载、创建和批量高亮的文本生效
+    /// @param cache 磁盘缓存，nullptr表示关闭
+    void setDiskCache(const Ptr<HighlightDiskCache>& cache);
+
+    /// 关闭文本，释放对应的分析器，外部仍持有的分析器可以继续使用
+    /// @param uri 文本uri
+    /// @return 文本未加载时返回false
+    bool closeDocument(const String& uri);
+
+    /// 设置已加载文本的内存预算，超出时按最近最少使用的顺序先释放高亮结果缓存，仍超出时关闭整个文本，
+    /// 最近使用的文本始终保留。每次加载文本后检查
+    /// @param bytes 内存预算字节数，0表示不限制
+    void setMemoryBudget(size_t bytes);
+
+    /// 立即按内存预算回收
+    /// @return 回收后已加载文本的估算内存字节数
+    size_t trimMemory();
+
+    /// 已加载的文本数量
+    size_t getLoadedDocumentCount() const;
+
+    /// 统计引擎占用的内存，包括所有已加载文本的分析器和语法规则
+    MemoryUsage memoryUsage() const;
+
+    /// 设置批量高亮使用的工作线程数量，首次批量高亮前调用才生效
+    /// @param count 线程数量，为0时取硬件并发数
+    void setBatchThreadCount(size_t count);
+
+    /// 在线程池上批量高亮多个文本，文本不会被加载到引擎中
+    /// @param jobs 要高亮的文本列表
+    /// @return 与jobs顺序一致的高亮结果，没有匹配的语法规则时为nullptr
+    List<Ptr<DocumentHighlight>> highlightBatch(const List<HighlightJob>& jobs);
+
+    /// 在线程池上批量高亮多个文本，每个文本完成后立即回调，全部完成后返回
+    /// @param jobs 要高亮的文本列表
+    /// @param callback 结果回调，在工作线程中调用，调用顺序不固定
+    void highlightBatch(const List<HighlightJob>& jobs, const BatchCallback& callback);
   private:
-    HashMap<String, Ptr<DocumentAnalyzer>> analyzer_map_;
+    struct AnalyzerEntry {
+      Ptr<DocumentAnalyzer> analyzer;
+      /// 在lru_list_中的位置
+      std::list<String>::iterator lru_it;
+    };
+    HashMap<String, AnalyzerEntry> analyzer_map_;
+    /// 已加载文本的uri，头部为最近使用
+    std::list<String> lru_list_;
+    size_t memory_budget_ {0};
     Ptr<SyntaxRuleManager> syntax_rule_manager_;
+    AnalyzeOptions analyze_options_;
+    Ptr<HighlightDiskCache> disk_cache_;
+    mutable std::mutex analyzer_mutex_;
+    UPtr<ThreadPool> thread_pool_;
+    size_t batch_thread_count_ {0};
+
+    SyntaxReloadCallback reload_callback_;
+
+    ThreadPool& getThreadPool();
+    size_t trimMemoryLocked();
+    void reloadAnalyzers(const Ptr<const SyntaxRule>& rule) const;
   };
 }
 
@@ -0,0 +1,75 @@
+#ifndef FAST_HIGHLIGHT_HTML_RENDERER_H
+#define FAST_HIGHLIGHT_HTML_RENDERER_H
+
+#include <functional>
+#include "highlight.h"
+
+namespace NS_FASTHIGHLIGHT {
+  /// 接收HTML输出的回调，每次传入一块连续的输出
+  using HtmlSink = std::function<void(const char* data, size_t size)>;
+
+  /// HTML渲染选项
+  struct HtmlRenderOptions {
+    /// style转换为CSS类名时添加的前缀，style中的'.'和空白字符会替换为'-'
+    String class_prefix {"fh-"};
+    /// 输出缓冲区大小，缓冲区写满后才调用一次sink
+    size_t chunk_size {64 * 1024};
+    /// 是否输出外层的<pre><code>标签
+    bool wrap_code_block {true};
+  };
+
+  /// 流式HTML渲染器，逐行把高亮块写成带CSS类名的<span>，转义和输出都只遍历一次文本，
+  /// 输出先写入固定大小的缓冲区再分块交给sink，内存占用与文本大小无关
+  class HtmlRenderer {
+  public:
+    /// @param sink 接收输出的回调
+    /// @param options 渲染选项
+    explicit HtmlRenderer(HtmlSink sink, const HtmlRenderOptions& options = {});
+
+    /// 指定某个style使用的CSS类名，替代默认的前缀转换规则
+    /// @param style 高亮块的style
+    /// @param class_name CSS类名
+    void setClassName(const String& style, const String& class_name);
+
+    /// 输出开始标签
+    void begin();
+
+    /// 渲染一行，高亮块之间没有覆盖的文本按无样式输出
+    /// @param line_text 行文本
+    /// @param spans 该行的高亮块
+    void renderLine(const String& line_text, const LineSpans& spans);
+
+    /// 输出结束标签并把缓冲区剩余内容交给sink
+    void end();
+
+    /// 边分析边渲染整个文本，不保存整个文本的高亮结果
+    /// @param analyzer 文本分析器
+    /// @param token 取消标记
+    /// @return 被取消时返回false，此时已输出的内容不完整
+    bool renderDocument(DocumentAnalyzer& analyzer, const Ptr<CancellationToken>& token = nullptr);
+
+    /// 渲染已有的高亮结果
+    /// @param document 文本
+    /// @param highlight 文本的高亮结果
+    void renderHighlight(const Document& document, const DocumentHighlight& highlight);
+
+    /// 把缓冲区内容交给sink
+    void flush();
+
+    /// 已经输出的总字节数，包含还在缓冲区中的内容
+    size_t getBytesWritten() const;
+  private:
+    HtmlSink sink_;
+    HtmlRenderOptions options_;
+    String buffer_;
+    size_t flushed_bytes_ {0};
+    /// style到class属性开始标签的缓存，如 <span class="fh-keyword">
+    HashMap<String, String> open_tags_;
+
+    const String& getOpenTag(const String& style);
+    void append(const char* data, size_t size);
+    void appendEscaped(const char* data, size_t size);
+  };
+}
+
+#endif //FAST_HIGHLIGHT_HTML_RENDERER_H
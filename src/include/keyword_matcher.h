@@ -0,0 +1,63 @@
+#ifndef FAST_HIGHLIGHT_KEYWORD_MATCHER_H
+#define FAST_HIGHLIGHT_KEYWORD_MATCHER_H
+
+#include <cstdint>
+#include <vector>
+
+#include "macro.h"
+
+namespace NS_FASTHIGHLIGHT {
+  /// 关键字匹配器，编译时将关键字列表构建为开放寻址的哈希表，
+  /// 匹配时只需要一次标识符扫描和一次哈希探测，不经过正则回溯
+  class KeywordMatcher {
+  public:
+    /// 构建关键字表
+    /// @param keywords 关键字列表
+    /// @param ignore_case 是否忽略大小写(仅ASCII字符)
+    void build(const std::vector<String>& keywords, bool ignore_case);
+
+    /// 判断单词是否为关键字
+    /// @param word 单词起始指针
+    /// @param length 单词字节长度
+    bool contains(const char* word, size_t length) const;
+
+    /// 关键字数量
+    size_t size() const;
+
+    /// 是否没有任何关键字
+    bool empty() const;
+
+    /// 关键字表占用的内存字节数
+    size_t memoryBytes() const;
+
+    /// 判断字节是否可能是单词字符的第一个字节(ASCII单词字符或多字节字符的首字节)，用于首字节预过滤
+    static bool isWordStartByte(unsigned char c);
+
+    /// 获取指定字节位置上单词字符的字节长度，与正则中\w一致，多字节字符按Unicode字符类别判断
+    /// @param text 文本
+    /// @param byte_pos 字节位置
+    /// @return 不是单词字符(包括无效的UTF-8)时返回0
+    static size_t wordCharLength(const String& text, size_t byte_pos);
+
+    /// 判断关键字文本是否全部由单词字符组成
+    static bool isWord(const String& text);
+
+    /// 从指定字节位置扫描一个完整单词，单词边界与正则中的\b一致
+    /// @param text 文本
+    /// @param byte_pos 起始字节位置
+    /// @return 单词字节长度，起始位置不在单词边界上时返回0
+    static size_t scanWord(const String& text, size_t byte_pos);
+  private:
+    std::vector<String> keywords_;
+    std::vector<int32_t> slots_;
+    size_t mask_ {0};
+    size_t min_length_ {0};
+    size_t max_length_ {0};
+    bool ignore_case_ {false};
+
+    uint64_t hash(const char* word, size_t length) const;
+    bool equals(const String& keyword, const char* word, size_t length) const;
+  };
+}
+
+#endif //FAST_HIGHLIGHT_KEYWORD_MATCHER_H
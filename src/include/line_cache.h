@@ -0,0 +1,94 @@
+#ifndef FAST_HIGHLIGHT_LINE_CACHE_H
+#define FAST_HIGHLIGHT_LINE_CACHE_H
+
+#include <list>
+#include "highlight.h"
+
+namespace NS_FASTHIGHLIGHT {
+  /// 行分析结果缓存的统计
+  struct LineCacheStats {
+    /// 命中次数
+    uint64_t hits {0};
+    /// 未命中次数(不含因跨行匹配等原因而跳过缓存的行)
+    uint64_t misses {0};
+    /// 当前缓存的行数
+    size_t entry_count {0};
+    /// 当前占用的估算字节数
+    size_t memory_bytes {0};
+    /// 容量上限(字节)
+    size_t capacity_bytes {0};
+
+    /// 命中率，没有查询时为0
+    double hitRate() const;
+  };
+
+  /// 按(行起始state, 行文本)缓存单行的分析结果，容量按估算字节数限制，超出时淘汰最近最少使用的行。
+  /// 行的分析结果只取决于起始state和行文本(不在跨行匹配中时)，命中后无需执行任何正则匹配。
+  /// 缓存的高亮块行号统一为0，取出时由调用方改写。非线程安全
+  class LineResultCache {
+  public:
+    /// 缓存的一行
+    struct Entry {
+      int32_t start_state {0};
+      int32_t end_state {0};
+      size_t text_hash {0};
+      String text;
+      List<TokenSpan> spans;
+      /// 估算占用的字节数
+      size_t bytes {0};
+    };
+
+    /// @param capacity_bytes 容量上限(字节)
+    explicit LineResultCache(size_t capacity_bytes);
+
+    /// 查找行的分析结果，命中时移到最近使用的位置
+    /// @param start_state 行起始state
+    /// @param line_text 行文本
+    /// @return 未命中时返回nullptr，返回的条目在下一次insert前有效
+    const Entry* find(int32_t start_state, const String& line_text);
+
+    /// 缓存行的分析结果，已存在时覆盖
+    /// @param start_state 行起始state
+    /// @param line_text 行文本
+    /// @param spans 该行的高亮块
+    /// @param end_state 行结束时的state
+    void insert(int32_t start_state, const String& line_text, const LineSpans& spans, int32_t end_state);
+
+    /// 修改容量上限，超出的部分立即淘汰
+    void setCapacity(size_t capacity_bytes);
+
+    /// 清空缓存，保留统计数据
+    void clear();
+
+    /// 获取统计数据
+    LineCacheStats getStats() const;
+
+    /// 估算占用的字节数，包括哈希表
+    size_t memoryBytes() const;
+  private:
+    struct Key {
+      int32_t start_state;
+      size_t text_hash;
+
+      bool operator==(const Key& other) const {
+        return start_state == other.start_state && text_hash == other.text_hash;
+      }
+    };
+    struct KeyHash {
+      size_t operator()(const Key& key) const {
+        return key.text_hash ^ (static_cast<size_t>(key.start_state) * 0x9E3779B97F4A7C15ULL);
+      }
+    };
+    /// 头部为最近使用
+    std::list<Entry> entries_;
+    HashMap<Key, std::list<Entry>::iterator, KeyHash> index_;
+    size_t capacity_bytes_;
+    size_t memory_bytes_ {0};
+    uint64_t hits_ {0};
+    uint64_t misses_ {0};
+
+    void evict(size_t capacity_bytes);
+  };
+}
+
+#endif //FAST_HIGHLIGHT_LINE_CACHE_H
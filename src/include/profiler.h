@@ -0,0 +1,87 @@
+#ifndef FAST_HIGHLIGHT_PROFILER_H
+#define FAST_HIGHLIGHT_PROFILER_H
+
+#include <chrono>
+#include "highlight.h"
+
+namespace NS_FASTHIGHLIGHT {
+  /// 单个state或token规则的性能统计
+  struct RuleProfile {
+    /// 所属state的id
+    int32_t state {-1};
+    /// 所属state的名称
+    String state_name;
+    /// token规则在state中的索引，-1表示整个state的合并表达式
+    int32_t token_rule_idx {-1};
+    /// 规则的表达式(关键字规则为关键字列表)
+    String pattern;
+    /// 规则的默认样式
+    String style;
+    /// 正则调用次数
+    uint64_t invocations {0};
+    /// 匹配成功(token规则为最终胜出)的次数
+    uint64_t hits {0};
+    /// 未匹配成功的次数
+    uint64_t misses {0};
+    /// token规则在胜出位置也能匹配，但被更靠前的规则遮蔽的次数
+    uint64_t shadowed {0};
+    /// 扫描过的字节数
+    uint64_t bytes_scanned {0};
+    /// 累计耗时(纳秒)
+    uint64_t time_ns {0};
+  };
+
+  /// 语法规则性能分析器，按state和token规则统计正则调用次数、命中、扫描字节数和耗时。
+  /// state的耗时为合并表达式的真实耗时；token规则的耗时通过单独编译每个token的表达式，
+  /// 在相同的起始位置和搜索范围内重放匹配得到，因此开启后分析速度会明显变慢
+  class GrammarProfiler {
+  public:
+    using Clock = std::chrono::steady_clock;
+
+    explicit GrammarProfiler(const Ptr<const SyntaxRule>& rule);
+    ~GrammarProfiler();
+    GrammarProfiler(const GrammarProfiler&) = delete;
+    GrammarProfiler& operator=(const GrammarProfiler&) = delete;
+
+    /// 记录一次state合并表达式的搜索
+    /// @param state state id
+    /// @param bytes_scanned 扫描的字节数
+    /// @param elapsed 耗时
+    /// @param matched 是否匹配成功
+    void recordStateSearch(int32_t state, size_t bytes_scanned, Clock::duration elapsed, bool matched);
+
+    /// 在相同位置逐个重放state下每个token规则的匹配，统计各token规则的耗时、命中与遮蔽
+    /// @param state state id
+    /// @param text 行文本
+    /// @param start_byte 搜索起始字节位置
+    /// @param winner_rule_idx 最终胜出的token规则索引，没有时为-1
+    /// @param winner_start_byte 胜出匹配的起始字节位置
+    void replayTokenRules(int32_t state, const String& text, size_t start_byte,
+      int32_t winner_rule_idx, size_t winner_start_byte);
+
+    /// 清空统计数据
+    void reset();
+
+    /// 生成按耗时从高到低排序的统计结果
+    List<RuleProfile> report() const;
+
+    /// 以文本表格输出统计结果
+    String toTable() const;
+
+    /// 以Json输出统计结果
+    String toJson() const;
+  private:
+    Ptr<const SyntaxRule> rule_;
+    List<RuleProfile> profiles_;
+    /// 每个token规则单独编译的表达式，与profiles_一一对应，state与关键字规则为nullptr
+    List<OnigRegex> token_regexes_;
+    /// state id 到 profiles_ 中state条目索引的映射，token条目紧随其后
+    HashMap<int32_t, size_t> state_offsets_;
+    OnigRegion* region_ {nullptr};
+
+    int64_t searchKeywordRule(const TokenRule& token_rule, const String& text, size_t start_byte,
+      size_t range_byte) const;
+  };
+}
+
+#endif //FAST_HIGHLIGHT_PROFILER_H
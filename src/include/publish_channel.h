@@ -0,0 +1,134 @@
+#ifndef FAST_HIGHLIGHT_PUBLISH_CHANNEL_H
+#define FAST_HIGHLIGHT_PUBLISH_CHANNEL_H
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "macro.h"
+
+namespace NS_FASTHIGHLIGHT {
+  /// 单写多读的发布通道，写线程通过原子指针交换发布新版本，读线程无锁读取。
+  /// 旧版本按纪元(epoch)回收：读线程读取前在读槽中登记当前纪元，
+  /// 写线程只释放比所有登记中的纪元都旧的版本，读线程因此永远不会看到被释放或写了一半的版本
+  template<typename T>
+  class PublishChannel {
+  public:
+    /// 同时持有读守卫的最大数量，超出时新的读取会让出CPU等待空闲读槽
+    static constexpr size_t kMaxReaders = 64;
+
+    /// 读守卫，存活期间指向的版本不会被释放
+    class ReadGuard {
+    public:
+      ReadGuard(ReadGuard&& other) noexcept : slot_(other.slot_), value_(other.value_) {
+        other.slot_ = nullptr;
+        other.value_ = nullptr;
+      }
+      ReadGuard(const ReadGuard&) = delete;
+      ReadGuard& operator=(const ReadGuard&) = delete;
+      ReadGuard& operator=(ReadGuard&&) = delete;
+
+      ~ReadGuard() {
+        if (slot_ != nullptr) {
+          slot_->store(kIdleEpoch, std::memory_order_release);
+        }
+      }
+
+      /// 读取到的版本，还没有发布过时为nullptr
+      const T* get() const { return value_; }
+      const T* operator->() const { return value_; }
+      const T& operator*() const { return *value_; }
+      explicit operator bool() const { return value_ != nullptr; }
+    private:
+      friend class PublishChannel;
+      std::atomic<uint64_t>* slot_;
+      const T* value_;
+
+      ReadGuard(std::atomic<uint64_t>* slot, const T* value) : slot_(slot), value_(value) {
+      }
+    };
+
+    PublishChannel() = default;
+    PublishChannel(const PublishChannel&) = delete;
+    PublishChannel& operator=(const PublishChannel&) = delete;
+
+    /// 析构时调用方需保证已没有存活的读守卫
+    ~PublishChannel() {
+      delete current_.load(std::memory_order_acquire);
+      for (std::pair<uint64_t, T*>& retired : retired_) {
+        delete retired.second;
+      }
+    }
+
+    /// 发布新版本并回收不再被读取的旧版本，同一时刻只能有一个线程调用
+    /// @param value 新版本
+    void publish(UPtr<T> value) {
+      T* old_value = current_.exchange(value.release(), std::memory_order_seq_cst);
+      if (old_value != nullptr) {
+        // 交换之后才推进纪元，仍可能读到旧版本的读线程登记的纪元一定不大于retire_epoch
+        uint64_t retire_epoch = global_epoch_.fetch_add(1, std::memory_order_seq_cst);
+        retired_.emplace_back(retire_epoch, old_value);
+      }
+      reclaim();
+    }
+
+    /// 读取最新发布的版本，不加锁
+    ReadGuard read() const {
+      size_t slot_idx = std::hash<std::thread::id>()(std::this_thread::get_id()) % kMaxReaders;
+      while (true) {
+        for (size_t i = 0; i < kMaxReaders; ++i) {
+          std::atomic<uint64_t>& slot = slots_[(slot_idx + i) % kMaxReaders].epoch;
+          uint64_t expected = kIdleEpoch;
+          if (slot.load(std::memory_order_relaxed) == kIdleEpoch
+            && slot.compare_exchange_strong(expected, global_epoch_.load(std::memory_order_seq_cst),
+              std::memory_order_seq_cst)) {
+            return ReadGuard(&slot, current_.load(std::memory_order_seq_cst));
+          }
+        }
+        std::this_thread::yield();
+      }
+    }
+
+    /// 尚未回收的旧版本数量
+    size_t getRetiredCount() const {
+      return retired_.size();
+    }
+  private:
+    static constexpr uint64_t kIdleEpoch = UINT64_MAX;
+
+    /// 每个读槽独占一条缓存行，避免不同读线程之间的伪共享
+    struct alignas(64) ReaderSlot {
+      std::atomic<uint64_t> epoch {kIdleEpoch};
+    };
+
+    std::atomic<T*> current_ {nullptr};
+    std::atomic<uint64_t> global_epoch_ {0};
+    mutable ReaderSlot slots_[kMaxReaders];
+    /// 已被替换但可能仍在被读取的版本及其退役时的纪元，只由写线程访问
+    std::vector<std::pair<uint64_t, T*>> retired_;
+
+    void reclaim() {
+      uint64_t min_epoch = kIdleEpoch;
+      for (const ReaderSlot& slot : slots_) {
+        uint64_t epoch = slot.epoch.load(std::memory_order_seq_cst);
+        if (epoch < min_epoch) {
+          min_epoch = epoch;
+        }
+      }
+      size_t kept = 0;
+      for (std::pair<uint64_t, T*>& retired : retired_) {
+        if (retired.first < min_epoch) {
+          delete retired.second;
+        } else {
+          retired_[kept++] = retired;
+        }
+      }
+      retired_.resize(kept);
+    }
+  };
+}
+
+#endif //FAST_HIGHLIGHT_PUBLISH_CHANNEL_H
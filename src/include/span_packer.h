@@ -0,0 +1,35 @@
+#ifndef FAST_HIGHLIGHT_SPAN_PACKER_H
+#define FAST_HIGHLIGHT_SPAN_PACKER_H
+
+#include "highlight.h"
+
+namespace NS_FASTHIGHLIGHT {
+  /// 把多行高亮结果打包为连续的int32数组，供JNI、WebAssembly等绑定一次性交给宿主语言，不为每个高亮块创建对象。
+  /// 每行依次为: 高亮块数量, (起始列, 长度, style编号) * 数量。
+  /// 从上一行延续的跨行高亮块起始列为0，列号按Unicode字符计数。打包用的数组在多次打包之间复用，非线程安全
+  class SpanPacker {
+  public:
+    /// 每个高亮块占用的int数量
+    static constexpr size_t kIntsPerSpan = 3;
+
+    /// 打包[start_line, end_line)行，超出行数的部分忽略
+    /// @param highlight 高亮结果
+    /// @param start_line 起始行号
+    /// @param end_line 结束行号(不含)
+    void pack(const DocumentHighlight& highlight, size_t start_line, size_t end_line);
+
+    /// 打包分析器最近发布的高亮版本(见DocumentAnalyzer::readPublished)，不加锁也不等待正在进行的分析
+    /// @return 还没有发布的版本时清空并返回false
+    bool packPublished(const DocumentAnalyzer& analyzer, size_t start_line, size_t end_line);
+
+    /// 打包结果，在下一次打包前有效
+    const int32_t* data() const;
+
+    /// 打包结果的int数量
+    size_t size() const;
+  private:
+    List<int32_t> packed_;
+  };
+}
+
+#endif //FAST_HIGHLIGHT_SPAN_PACKER_H
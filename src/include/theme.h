@@ -0,0 +1,115 @@
+#ifndef FAST_HIGHLIGHT_THEME_H
+#define FAST_HIGHLIGHT_THEME_H
+
+#include "highlight.h"
+
+namespace NS_FASTHIGHLIGHT {
+  /// 字体样式标志，可按位组合
+  enum FontStyle : uint32_t {
+    kFontStyleNone = 0,
+    kFontStyleBold = 1 << 0,
+    kFontStyleItalic = 1 << 1,
+    kFontStyleUnderline = 1 << 2,
+    kFontStyleStrikethrough = 1 << 3,
+  };
+
+  /// 一个style的显示样式，颜色为ARGB
+  struct ThemeStyle {
+    uint32_t foreground {0xFF000000};
+    uint32_t background {0x00000000};
+    uint32_t font_style {kFontStyleNone};
+  };
+
+  /// 主题中为某个style设置的样式，未设置的字段继承上级style或默认样式
+  struct ThemeRule {
+    ThemeStyle style;
+    bool has_foreground {false};
+    bool has_background {false};
+    bool has_font_style {false};
+  };
+
+  /// 一段连续同样式的文本，字段均为32位，绑定层可以直接整体复制为int数组
+  struct ColorRun {
+    /// 起始列(字符)
+    uint32_t start_column;
+    /// 结束列(字符)，不含
+    uint32_t end_column;
+    uint32_t foreground;
+    uint32_t background;
+    uint32_t font_style;
+  };
+  static_assert(sizeof(ColorRun) == 5 * sizeof(uint32_t), "ColorRun must be tightly packed");
+
+  class CompiledTheme;
+
+  /// 配色主题，style名称到显示样式的映射。style按'.'分级，
+  /// 如 keyword.control 没有单独设置时使用 keyword 的样式
+  class Theme {
+  public:
+    /// 解析主题json，格式如下，颜色为#RRGGBB或#AARRGGBB，fontStyle为空格分隔的bold/italic/underline/strikethrough
+    /// {"name": "dark", "default": {"foreground": "#D4D4D4", "background": "#1E1E1E"},
+    ///  "styles": {"keyword": {"foreground": "#569CD6", "fontStyle": "bold"}}}
+    /// @param json 主题的json文本
+    /// @throw SyntaxRuleParseError json格式或属性内容错误
+    static Ptr<Theme> parseFromJson(const String& json);
+
+    /// 主题名称
+    const String& getName() const;
+
+    /// 设置未匹配到任何style时的默认样式
+    void setDefaultStyle(const ThemeStyle& style);
+
+    /// 获取默认样式
+    const ThemeStyle& getDefaultStyle() const;
+
+    /// 设置某个style的样式
+    /// @param style style名称
+    /// @param rule 样式，未设置的字段继承上级style
+    void setRule(const String& style, const ThemeRule& rule);
+
+    /// 按style名称解析样式，依次应用默认样式和从最上级到自身的各级设置
+    /// @param style style名称
+    ThemeStyle resolve(const String& style) const;
+
+    /// 针对语法规则的所有style预先解析样式，生成按style编号索引的样式表
+    /// @param rule 语法规则
+    /// @return 编译后的样式表，只读，可在多个线程共享
+    Ptr<const CompiledTheme> compile(const SyntaxRule& rule) const;
+  private:
+    String name_;
+    ThemeStyle default_style_;
+    HashMap<String, ThemeRule> rules_;
+  };
+
+  /// 针对某个语法规则编译后的主题，样式按style编号存放在连续数组中，渲染时按下标读取，不再查找字符串
+  class CompiledTheme {
+  public:
+    /// @param default_style 编号无效时使用的样式
+    /// @param styles 按style编号排列的样式
+    CompiledTheme(const ThemeStyle& default_style, List<ThemeStyle> styles);
+
+    /// 获取style编号对应的样式，编号无效(例如语法规则已重新编译)时返回默认样式
+    const ThemeStyle& getStyle(int32_t style_id) const {
+      if (style_id < 0 || static_cast<size_t>(style_id) >= styles_.size()) {
+        return default_style_;
+      }
+      return styles_[style_id];
+    }
+
+    /// 样式表的大小，等于编译时语法规则的style数量
+    size_t getStyleCount() const;
+
+    /// 样式表按编号排列的所有样式，供绑定层整体复制
+    const List<ThemeStyle>& getStyles() const;
+
+    /// 把一行高亮块转换为颜色区间，相邻且样式相同的高亮块会合并，高亮块之间的空隙使用默认样式
+    /// @param spans 一行的高亮块
+    /// @param runs 输出的颜色区间，会先被清空，调用方可复用以避免分配
+    void buildColorRuns(const LineSpans& spans, List<ColorRun>& runs) const;
+  private:
+    ThemeStyle default_style_;
+    List<ThemeStyle> styles_;
+  };
+}
+
+#endif //FAST_HIGHLIGHT_THEME_H
@@ -0,0 +1,83 @@
+#ifndef FAST_HIGHLIGHT_THREAD_POOL_H
+#define FAST_HIGHLIGHT_THREAD_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "macro.h"
+
+namespace NS_FASTHIGHLIGHT {
+  /// 工作窃取线程池，每个工作线程拥有独立的任务队列，
+  /// 线程优先从自己队列的尾部取任务，队列为空时从其他线程队列的头部窃取
+  class ThreadPool {
+  public:
+    using Task = std::function<void()>;
+
+    /// @param thread_count 工作线程数量，为0时取硬件并发数
+    explicit ThreadPool(size_t thread_count = 0);
+    ~ThreadPool();
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    /// 提交任务，在工作线程中提交时放入当前线程的队列，否则轮流分配到各个队列
+    /// @param task 任务
+    void submit(Task task);
+
+    /// 并行执行count个任务并等待全部完成，调用线程在等待期间也会参与执行任务
+    /// @param count 任务数量
+    /// @param func 任务函数，参数为任务索引
+    void parallelFor(size_t count, const std::function<void(size_t)>& func);
+
+    /// 工作线程数量
+    size_t getThreadCount() const;
+  private:
+    struct WorkQueue {
+      std::mutex mutex;
+      std::deque<Task> tasks;
+    };
+
+    std::vector<UPtr<WorkQueue>> queues_;
+    std::vector<std::thread> workers_;
+    std::mutex wake_mutex_;
+    std::condition_variable wake_cv_;
+    std::atomic<size_t> queued_count_ {0};
+    std::atomic<size_t> submit_index_ {0};
+    bool stopped_ {false};
+
+    void pushTask(size_t queue_idx, Task task);
+    bool popTask(size_t queue_idx, Task& task);
+    void workerLoop(size_t queue_idx);
+  };
+
+  /// 在线程池上按提交顺序依次执行任务的串行队列，同一时刻最多占用一个工作线程，没有任务时不占用线程
+  class SerialTaskQueue {
+  public:
+    /// @param pool 执行任务的线程池，生命周期需要长于队列
+    explicit SerialTaskQueue(ThreadPool& pool);
+    /// 丢弃尚未执行的任务，并等待正在执行的任务完成
+    ~SerialTaskQueue();
+    SerialTaskQueue(const SerialTaskQueue&) = delete;
+    SerialTaskQueue& operator=(const SerialTaskQueue&) = delete;
+
+    /// 提交任务，在之前提交的任务全部执行完之后执行
+    /// @param task 任务
+    void post(ThreadPool::Task task);
+  private:
+    ThreadPool& pool_;
+    std::mutex mutex_;
+    std::condition_variable idle_cv_;
+    std::deque<ThreadPool::Task> tasks_;
+    /// 是否已有执行任务的线程池任务，同一时刻只有一个
+    bool running_ {false};
+    bool stopped_ {false};
+
+    void drain();
+  };
+}
+
+#endif //FAST_HIGHLIGHT_THREAD_POOL_H
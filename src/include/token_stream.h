@@ -0,0 +1,135 @@
+#ifndef FAST_HIGHLIGHT_TOKEN_STREAM_H
+#define FAST_HIGHLIGHT_TOKEN_STREAM_H
+
+#include "highlight.h"
+
+namespace NS_FASTHIGHLIGHT {
+  /// 紧凑的二进制高亮流，用于在进程间传递高亮结果，只保留渲染需要的范围和style。
+  /// 整数均为LEB128变长编码(varint)，格式如下：
+  ///   文件头: 'F' 'H' 'S' 版本号(1字节) 标志位(1字节)
+  ///   行帧:   帧长度(varint) 帧内容
+  ///   帧内容: 行号增量 高亮块数量 新style数量 [style长度 style字节]... [高亮块]...
+  ///   高亮块: 起始列增量 长度 (style编号 << 1 | 是否跨行) [起始行增量 起始列] [state goto_state+1]
+  /// 行号增量为本行与上一帧行号+1的差，第一帧相对-1，因此连续的行增量均为0，也可以只发送部分行。
+  /// 起始列增量相对上一个高亮块的结束列，跨行高亮块在本行从第0列开始，额外写出与本行的行号差和原始起始列。
+  /// style编号按首次出现的顺序从0分配，首次出现的style在所在行的帧中定义。
+  /// 标志位含kFlagSpanStates时每个高亮块还带有匹配时的state和跳转的state，用于恢复可继续增量分析的高亮结果
+  namespace TokenStreamFormat {
+    static constexpr char kMagic[3] = {'F', 'H', 'S'};
+    static constexpr uint8_t kVersion = 1;
+    static constexpr size_t kHeaderSize = 5;
+    static constexpr uint8_t kFlagSpanStates = 1 << 0;
+  }
+
+  /// 高亮流编码器，输出追加到调用方提供的字符串，style表在整个流中累积
+  class TokenStreamEncoder {
+  public:
+    /// @param output 编码结果追加到该字符串
+    /// @param include_states 是否写出每个高亮块的state和goto_state
+    explicit TokenStreamEncoder(String& output, bool include_states = false);
+
+    /// 写入文件头，每个流开始时调用一次
+    void begin();
+
+    /// 编码一行，行号必须大于上一次编码的行号
+    /// @param line 行号
+    /// @param spans 该行的高亮块，按列有序且互不重叠
+    void encodeLine(size_t line, const LineSpans& spans);
+
+    /// 编码整个高亮结果，包括文件头
+    /// @param highlight 高亮结果
+    void encodeHighlight(const DocumentHighlight& highlight);
+
+    /// 边分析边编码整个文本，包括文件头，不保存整个文本的高亮结果
+    /// @param analyzer 文本分析器
+    /// @param token 取消令牌，可为nullptr
+    /// @return 被取消时返回false
+    bool encodeDocument(DocumentAnalyzer& analyzer, const Ptr<CancellationToken>& token = nullptr);
+
+    /// 清空style表和行号，之后需要重新调用begin开始新的流
+    void reset();
+  private:
+    String& output_;
+    bool include_states_;
+    HashMap<String, uint32_t> style_ids_;
+    /// 上一帧的行号+1
+    size_t next_line_ {0};
+    /// 帧内容的暂存区，写完后才能得到帧长度
+    String frame_;
+    List<const String*> new_styles_;
+  };
+
+  /// 解码出的style定义，名称指向输入数据
+  struct StreamStyle {
+    uint32_t id {0};
+    const char* name {nullptr};
+    size_t length {0};
+  };
+
+  /// 解码出的高亮块
+  struct StreamSpan {
+    size_t start_line {0};
+    size_t start_column {0};
+    size_t end_column {0};
+    uint32_t style_id {0};
+    /// 匹配时的state，流中不含state时为0
+    int32_t state {0};
+    /// 要跳转的state，流中不含state时为-1
+    int32_t goto_state {-1};
+  };
+
+  /// 高亮流解码器，直接读取输入数据，不分配内存。style只以编号出现在高亮块中，
+  /// 调用方通过nextStyle取得定义后自行建立编号到名称(或主题颜色)的映射。
+  /// 用法：while (nextLine()) { while (nextStyle(style)) {...} while (nextSpan(span)) {...} }
+  class TokenStreamDecoder {
+  public:
+    /// @param data 编码数据，解码期间必须有效
+    /// @param size 字节数
+    TokenStreamDecoder(const char* data, size_t size);
+
+    /// 移动到下一行帧，未读完的style和高亮块会被跳过
+    /// @return 没有更多行或数据有误时返回false
+    bool nextLine();
+
+    /// 当前帧的行号
+    size_t getLine() const;
+
+    /// 当前帧的高亮块数量
+    size_t getSpanCount() const;
+
+    /// 读取当前帧中新定义的下一个style
+    /// @return 没有更多style时返回false
+    bool nextStyle(StreamStyle& style);
+
+    /// 读取当前帧的下一个高亮块，未读的style定义会先被跳过
+    /// @return 没有更多高亮块时返回false
+    bool nextSpan(StreamSpan& span);
+
+    /// 数据是否有误(文件头不匹配、varint或帧被截断、style编号越界)
+    bool hasError() const;
+
+    /// 高亮块是否带有state
+    bool hasSpanStates() const;
+  private:
+    const uint8_t* pos_;
+    const uint8_t* end_;
+    /// 当前帧的末尾
+    const uint8_t* frame_end_;
+    bool error_ {false};
+    bool in_frame_ {false};
+    bool has_span_states_ {false};
+    size_t line_ {0};
+    size_t next_line_ {0};
+    uint32_t style_count_ {0};
+    uint32_t pending_styles_ {0};
+    size_t span_count_ {0};
+    size_t pending_spans_ {0};
+    /// 上一个高亮块的结束列
+    size_t last_column_ {0};
+
+    bool readVarint(uint64_t& value);
+    void skipStyles();
+  };
+}
+
+#endif //FAST_HIGHLIGHT_TOKEN_STREAM_H
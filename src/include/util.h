@@ -1,6 +1,8 @@
 #ifndef FAST_HIGHLIGHT_UTIL_H
 #define FAST_HIGHLIGHT_UTIL_H
 
+#include <bitset>
+#include <cstdarg>
 #include <cstdint>
 
 #include "macro.h"
@@ -39,6 +41,31 @@ namespace NS_FASTHIGHLIGHT {
     static bool isValidUTF8(const String& str);
   };
 
+  /// 同一段UTF-8文本上字符位置与字节位置的换算，记住上一次换算到的位置，
+  /// 从该位置向前或向后扫描，逐个token推进时每次换算只扫描相邻两个位置之间的文本。
+  /// 结果与Utf8Util的对应函数一致
+  class Utf8PositionCursor {
+  public:
+    /// 切换到新的文本，文本在下一次reset之前不能修改
+    /// @param str UTF8文本
+    void reset(const String& str);
+
+    /// 将字符位置转换为字节位置
+    /// @param char_pos 字符位置
+    size_t charPosToBytePos(size_t char_pos);
+
+    /// 将字节位置转换为字符位置
+    /// @param byte_pos 字节位置
+    size_t bytePosToCharPos(size_t byte_pos);
+  private:
+    const String* str_ {nullptr};
+    size_t byte_pos_ {0};
+    size_t char_pos_ {0};
+
+    /// 回退到不超过目标位置的字符边界，离文本开头更近时直接从开头开始
+    void rewind(size_t target, bool by_char);
+  };
+
   /// 字符串处理工具
   class StrUtil {
   public:
@@ -130,6 +157,12 @@ namespace NS_FASTHIGHLIGHT {
     /// @param pattern_ptr Pattern字符串
     /// @return 如果有错误返回相应错误，没有错误返回空文本
     static String getPatternError(const String& pattern_ptr);
+
+    /// 计算Pattern所有可能匹配结果的首字节集合，用于匹配前的预过滤
+    /// @param pattern_str Pattern字符串
+    /// @param first_bytes 输出的首字节集合(在原有内容上追加)
+    /// @return 无法确定(如可能匹配空串、包含不支持的语法)时返回false
+    static bool computeFirstByteSet(const String& pattern_str, std::bitset<256>& first_bytes);
   };
 
   /// 文件操作工具类
@@ -182,6 +215,54 @@ namespace NS_FASTHIGHLIGHT {
     /// 读取指定文件的内容
     /// @param path 文件路径
     static String readString(const String& path);
+
+    /// 写入文件内容，先写入同目录下的临时文件再重命名，其他进程不会读到写了一半的文件
+    /// @param path 文件路径
+    /// @param content 文件内容
+    /// @return 写入成功返回true
+    static bool writeString(const String& path, const String& content);
+  };
+
+  /// 哈希工具
+  class HashUtil {
+  public:
+    HashUtil() = delete;
+    HashUtil(const HashUtil&) = delete;
+    HashUtil& operator=(const HashUtil&) = delete;
+
+    static constexpr uint64_t kFnvOffsetBasis = 0xCBF29CE484222325ULL;
+
+    /// 计算64位FNV-1a哈希，结果与平台和标准库实现无关，可以持久化
+    /// @param data 数据
+    /// @param size 数据长度
+    /// @param seed 初始值，传入上一段数据的结果可以分段计算
+    static uint64_t fnv1a64(const char* data, size_t size, uint64_t seed = kFnvOffsetBasis);
+  };
+
+  /// 只读的内存映射文件，映射失败或文件为空时isValid()返回false
+  class MappedFile {
+  public:
+    /// @param path 文件路径
+    explicit MappedFile(const String& path);
+    ~MappedFile();
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    /// 是否映射成功
+    bool isValid() const;
+
+    /// 文件内容的起始地址
+    const char* data() const;
+
+    /// 文件大小
+    size_t size() const;
+  private:
+    const char* data_ {nullptr};
+    size_t size_ {0};
+#ifdef _WIN32
+    void* file_handle_ {nullptr};
+    void* mapping_handle_ {nullptr};
+#endif
   };
 }
 
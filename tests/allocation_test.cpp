@@ -0,0 +1,92 @@
+#include <atomic>
+#include <cstdlib>
+#include <new>
+#include "catch2/catch_amalgamated.hpp"
+#include "highlight.h"
+#include "token_stream.h"
+#include "util.h"
+
+using namespace NS_FASTHIGHLIGHT;
+
+static const char* kSyntaxJavaPath = TESTS_DIR"/syntax/java.json";
+static const char* kViewJavaPath = TESTS_DIR"/syntax/View.java";
+
+/// 只统计开启计数的线程上的分配次数
+static std::atomic<size_t> allocation_count {0};
+static thread_local bool counting_allocations = false;
+
+void* operator new(std::size_t size) {
+  if (counting_allocations) {
+    ++allocation_count;
+  }
+  void* ptr = std::malloc(size == 0 ? 1 : size);
+  if (ptr == nullptr) {
+    throw std::bad_alloc();
+  }
+  return ptr;
+}
+
+void operator delete(void* ptr) noexcept {
+  std::free(ptr);
+}
+
+void operator delete(void* ptr, std::size_t) noexcept {
+  std::free(ptr);
+}
+
+TEST_CASE("Highlight steady typing allocation") {
+  Ptr<HighlightEngine> engine = MAKE_PTR<HighlightEngine>();
+  engine->compileSyntaxFromFile(kSyntaxJavaPath);
+  Ptr<Document> document = MAKE_PTR<Document>("View.java", FileUtil::readString(kViewJavaPath));
+  Ptr<DocumentAnalyzer> analyzer = engine->loadDocument(document);
+  analyzer->analyzeFully();
+
+  // 在类名后反复输入并删除一个字符
+  size_t line = 0;
+  while (document->getLine(line).find("public class View") == String::npos) {
+    ++line;
+  }
+  size_t column = document->getLine(line).find("View") + 4;
+  TextRange insert_range {{line, column}, {line, column}};
+  TextRange remove_range {{line, column}, {line, column + 1}};
+  // 预热：让行字符串、高亮块和匹配暂存数据达到稳定的容量
+  for (int i = 0; i < 3; ++i) {
+    analyzer->updateHighlight(insert_range, "x");
+    analyzer->updateHighlight(remove_range, "");
+  }
+
+  allocation_count = 0;
+  counting_allocations = true;
+  for (int i = 0; i < 50; ++i) {
+    analyzer->updateHighlight(insert_range, "x");
+    analyzer->updateHighlight(remove_range, "");
+  }
+  counting_allocations = false;
+  REQUIRE(allocation_count == 0);
+}
+
+TEST_CASE("Token stream decode allocation") {
+  Ptr<HighlightEngine> engine = MAKE_PTR<HighlightEngine>();
+  engine->compileSyntaxFromFile(kSyntaxJavaPath);
+  Ptr<Document> document = MAKE_PTR<Document>("View.java", FileUtil::readString(kViewJavaPath));
+  String encoded;
+  TokenStreamEncoder(encoded).encodeDocument(*engine->createAnalyzer(document));
+
+  allocation_count = 0;
+  counting_allocations = true;
+  size_t span_count = 0;
+  TokenStreamDecoder decoder(encoded.data(), encoded.length());
+  StreamStyle style;
+  StreamSpan span;
+  while (decoder.nextLine()) {
+    while (decoder.nextStyle(style)) {
+    }
+    while (decoder.nextSpan(span)) {
+      ++span_count;
+    }
+  }
+  counting_allocations = false;
+  REQUIRE(allocation_count == 0);
+  REQUIRE(span_count > 0);
+  REQUIRE_FALSE(decoder.hasError());
+}
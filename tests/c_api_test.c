@@ -0,0 +1,144 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "c_api.h"
+
+static const char* kSyntaxJavaPath = TESTS_DIR"/syntax/java.json";
+
+static int failures = 0;
+
+#define CHECK(expr) do { \
+    if (!(expr)) { \
+      fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #expr); \
+      ++failures; \
+    } \
+  } while (0)
+
+static void testErrors(fh_engine* engine) {
+  fh_grammar* grammar = NULL;
+  CHECK(fh_engine_compile_grammar_json(engine, "{", 1, &grammar) == FH_ERROR_JSON_INVALID);
+  CHECK(grammar == NULL);
+  CHECK(strlen(fh_last_error_message()) > 0);
+  CHECK(fh_engine_compile_grammar_json(engine, "{}", 2, &grammar) == FH_ERROR_PROPERTY_EXPECTED);
+  CHECK(strcmp(fh_last_error_message(), "name") == 0);
+  CHECK(fh_engine_compile_grammar_file(engine, TESTS_DIR"/syntax/missing.json", &grammar) == FH_ERROR_FILE_NOT_FOUND);
+  CHECK(fh_engine_compile_grammar_file(NULL, kSyntaxJavaPath, &grammar) == FH_ERROR_INVALID_ARGUMENT);
+  CHECK(strcmp(fh_status_message(FH_ERROR_BUFFER_TOO_SMALL), "Buffer too small") == 0);
+
+  fh_document* document = NULL;
+  fh_analyzer* analyzer = NULL;
+  CHECK(fh_document_create("notes.txt", "text", 4, &document) == FH_OK);
+  CHECK(fh_engine_load_document(engine, document, &analyzer) == FH_ERROR_NO_SYNTAX_RULE);
+  CHECK(analyzer == NULL);
+  fh_document_release(document);
+}
+
+static void testGrammar(fh_grammar* grammar) {
+  size_t length = 0;
+  char name[8];
+  CHECK(fh_grammar_get_name(grammar, NULL, 0, &length) == FH_OK);
+  CHECK(length == 4);
+  CHECK(fh_grammar_get_name(grammar, name, 4, &length) == FH_ERROR_BUFFER_TOO_SMALL);
+  CHECK(fh_grammar_get_name(grammar, name, sizeof(name), &length) == FH_OK);
+  CHECK(strcmp(name, "java") == 0);
+  CHECK(fh_grammar_get_style_count(grammar) > 1);
+  CHECK(fh_grammar_get_style_name(grammar, 0, name, sizeof(name), &length) == FH_OK);
+  CHECK(length == 0);
+  CHECK(fh_grammar_get_style_name(grammar, -1, name, sizeof(name), &length) == FH_ERROR_INVALID_ARGUMENT);
+}
+
+/// 查找指定列开始的高亮块，返回其style名称是否与期望一致
+static int hasStyleAt(fh_analyzer* analyzer, const fh_span* spans, size_t count, uint32_t line, uint32_t column,
+  uint32_t end_column, const char* style) {
+  char name[64];
+  size_t length = 0;
+  for (size_t i = 0; i < count; ++i) {
+    if (spans[i].line == line && spans[i].start_column == column) {
+      return spans[i].end_column == end_column
+        && fh_analyzer_get_style_name(analyzer, spans[i].style_id, name, sizeof(name), &length) == FH_OK
+        && strcmp(name, style) == 0;
+    }
+  }
+  return 0;
+}
+
+static void testAnalyzer(fh_engine* engine, fh_grammar* grammar) {
+  // 第二行的字符串含有四字节字符，列号按Unicode字符计数
+  const char* code = "public class Main {\n  String s = \"\xF0\x9F\x98\x80\";\n";
+  fh_document* document = NULL;
+  CHECK(fh_document_create("Main.java", code, strlen(code), &document) == FH_OK);
+  CHECK(fh_document_get_line_count(document) == 3);
+
+  fh_analyzer* analyzer = NULL;
+  CHECK(fh_engine_load_document(engine, document, &analyzer) == FH_OK);
+  size_t count = 1;
+  fh_span spans[32];
+  CHECK(fh_analyzer_get_spans(analyzer, 0, 3, spans, 32, &count) == FH_OK);
+  CHECK(count == 0);
+  CHECK(fh_analyzer_analyze(analyzer) == FH_OK);
+
+  // 先查询数量，缓冲区不足时不写入
+  size_t required = 0;
+  CHECK(fh_analyzer_get_spans(analyzer, 0, 3, NULL, 0, &required) == FH_OK);
+  CHECK(required > 2 && required <= 32);
+  spans[0].line = 99;
+  CHECK(fh_analyzer_get_spans(analyzer, 0, 3, spans, 1, &count) == FH_ERROR_BUFFER_TOO_SMALL);
+  CHECK(count == required);
+  CHECK(spans[0].line == 99);
+  CHECK(fh_analyzer_get_spans(analyzer, 0, 100, spans, 32, &count) == FH_OK);
+  CHECK(count == required);
+
+  CHECK(hasStyleAt(analyzer, spans, count, 0, 0, 6, "keyword"));
+  CHECK(hasStyleAt(analyzer, spans, count, 1, 13, 16, "string"));
+
+  // 增量更新后读到新的结果
+  const char* insert = "int a = 1;\n";
+  CHECK(fh_analyzer_update(analyzer, 0, 0, 0, 0, insert, strlen(insert)) == FH_OK);
+  CHECK(fh_document_get_line_count(document) == 4);
+  CHECK(fh_analyzer_get_spans(analyzer, 1, 3, spans, 32, &count) == FH_OK);
+  CHECK(hasStyleAt(analyzer, spans, count, 1, 0, 6, "keyword"));
+  CHECK(hasStyleAt(analyzer, spans, count, 2, 13, 16, "string"));
+  CHECK(fh_analyzer_update(analyzer, 1, 0, 0, 0, "", 0) == FH_ERROR_INVALID_ARGUMENT);
+
+  // 不加载到引擎中的分析器与已加载的结果一致
+  fh_analyzer* standalone = NULL;
+  fh_span standalone_spans[32];
+  size_t standalone_count = 0;
+  CHECK(fh_analyzer_create(grammar, document, &standalone) == FH_OK);
+  CHECK(fh_analyzer_analyze(standalone) == FH_OK);
+  CHECK(fh_analyzer_get_spans(standalone, 1, 3, standalone_spans, 32, &standalone_count) == FH_OK);
+  CHECK(standalone_count == count);
+  CHECK(memcmp(standalone_spans, spans, count * sizeof(fh_span)) == 0);
+  fh_analyzer_release(standalone);
+
+  CHECK(fh_engine_close_document(engine, "Main.java") == FH_OK);
+  CHECK(fh_engine_close_document(engine, "Main.java") == FH_ERROR_INVALID_ARGUMENT);
+  // 关闭后外部持有的分析器仍可使用
+  CHECK(fh_analyzer_analyze(analyzer) == FH_OK);
+  fh_analyzer_release(analyzer);
+  fh_document_release(document);
+}
+
+int main(void) {
+  fh_engine* engine = NULL;
+  CHECK(fh_engine_create(&engine) == FH_OK);
+  testErrors(engine);
+
+  fh_grammar* grammar = NULL;
+  CHECK(fh_engine_compile_grammar_file(engine, kSyntaxJavaPath, &grammar) == FH_OK);
+  CHECK(grammar != NULL);
+  if (grammar == NULL) {
+    return EXIT_FAILURE;
+  }
+  testGrammar(grammar);
+  testAnalyzer(engine, grammar);
+  fh_grammar_release(grammar);
+  fh_engine_release(engine);
+
+  if (failures > 0) {
+    fprintf(stderr, "%d check(s) failed\n", failures);
+    return EXIT_FAILURE;
+  }
+  printf("All C API checks passed\n");
+  return EXIT_SUCCESS;
+}
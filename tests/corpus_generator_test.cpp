@@ -0,0 +1,42 @@
+#include "catch2/catch_amalgamated.hpp"
+#include "corpus_generator.h"
+#include "util.h"
+
+using namespace NS_FASTHIGHLIGHT;
+
+static const char* kBenchmarkSyntaxPath = TESTS_DIR"/../tools/benchmark/java.json";
+
+TEST_CASE("Corpus generator") {
+  for (CorpusKind kind : getAllCorpusKinds()) {
+    CorpusKind parsed_kind;
+    REQUIRE(parseCorpusKind(getCorpusName(kind), parsed_kind));
+    REQUIRE(parsed_kind == kind);
+    // 相同的种子生成相同的文本，长度不小于目标
+    String text = generateCorpus(kind, 64 * 1024, 7);
+    REQUIRE(text.size() >= 64 * 1024);
+    REQUIRE(text == generateCorpus(kind, 64 * 1024, 7));
+    REQUIRE(text != generateCorpus(kind, 64 * 1024, 8));
+    REQUIRE(Utf8Util::isValidUTF8(text));
+  }
+  REQUIRE(generateCorpus(CorpusKind::kMinified, 256 * 1024, 1).find('\n') == String::npos);
+  REQUIRE(StrUtil::contains(generateCorpus(CorpusKind::kCjk, 1024, 1), "\xE7\xBB\x93\xE6\x9E\x9C"));
+
+  // 基准测试的语法规则中注释优先于标点，注释内的"/*"会进入注释state
+  Ptr<const SyntaxRule> rule = MAKE_PTR<SyntaxRuleManager>()->compileSyntaxFromFile(kBenchmarkSyntaxPath);
+  REQUIRE(rule != nullptr);
+  DocumentAnalyzer analyzer(MAKE_PTR<Document>("bench.java", generateCorpus(CorpusKind::kNestedComments, 16 * 1024, 1)),
+    rule);
+  Ptr<DocumentHighlight> highlight = analyzer.analyzeFully();
+  for (size_t line = 0; line < 4; ++line) {
+    for (const TokenSpan& span : highlight->getLineSpans(line)) {
+      REQUIRE(span.style == "comment");
+    }
+  }
+  size_t comment_spans = 0;
+  highlight->forEachLine([&comment_spans](size_t, const LineSpans& spans) {
+    for (const TokenSpan& span : spans) {
+      comment_spans += span.style == "comment" ? 1 : 0;
+    }
+  });
+  REQUIRE(comment_spans > 100);
+}
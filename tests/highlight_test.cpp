@@ -1,14 +1,43 @@
+#include <atomic>
+#include <filesystem>
 #include <iostream>
+#include <thread>
 #include "catch2/catch_amalgamated.hpp"
+#include "disk_cache.h"
 #include "highlight.h"
+#include "line_cache.h"
+#include "profiler.h"
 #include "util.h"
 
 using namespace NS_FASTHIGHLIGHT;
 
 static const char* kSyntaxJavaPath = TESTS_DIR"/syntax/java.json";
+static const char* kSyntaxJavaKeywordsPath = TESTS_DIR"/syntax/java_keywords.json";
 static const char* kTestJavaPath = TESTS_DIR"/syntax/test.java";
 static const char* kViewJavaPath = TESTS_DIR"/syntax/View.java";
 
+static bool isSameHighlight(const Ptr<const DocumentHighlight>& left, const Ptr<const DocumentHighlight>& right) {
+  if (left->getLineCount() != right->getLineCount()) {
+    return false;
+  }
+  for (size_t line = 0; line < left->getLineCount(); ++line) {
+    LineSpans left_spans = left->getLineSpans(line);
+    LineSpans right_spans = right->getLineSpans(line);
+    if (left_spans.size() != right_spans.size()) {
+      return false;
+    }
+    for (size_t i = 0; i < left_spans.size(); ++i) {
+      if (left_spans[i].range.start.line != right_spans[i].range.start.line
+        || left_spans[i].range.start.column != right_spans[i].range.start.column
+        || left_spans[i].range.end.column != right_spans[i].range.end.column
+        || left_spans[i].style != right_spans[i].style || left_spans[i].state != right_spans[i].state) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
 TEST_CASE("Highlight test.ava") {
   Ptr<HighlightEngine> engine = MAKE_PTR<HighlightEngine>();
   try {
@@ -39,6 +68,1036 @@ TEST_CASE("Highlight View.java") {
   highlight->dump();
 }
 
+TEST_CASE("Highlight keywords") {
+  const char* syntax_json = R"({
+    "name": "sql",
+    "fileExtensions": [".sql"],
+    "states": {
+      "default": [
+        {"keywords": ["select", "from", "where"], "ignoreCase": true, "style": "keyword"},
+        {"pattern": "[A-Za-z_][A-Za-z_0-9]*", "style": "identifier"},
+        {"pattern": "\\s+", "style": "space"}
+      ]
+    }
+  })";
+  Ptr<HighlightEngine> engine = MAKE_PTR<HighlightEngine>();
+  engine->compileSyntaxFromJson(syntax_json);
+  Ptr<Document> document = MAKE_PTR<Document>("test.sql", "SELECT selected FROM t_from");
+  Ptr<DocumentAnalyzer> analyzer = engine->loadDocument(document);
+  Ptr<DocumentHighlight> highlight = analyzer->analyzeFully();
+  LineSpans spans = highlight->getLineSpans(0);
+  REQUIRE(spans.size() == 7);
+  REQUIRE(spans[0].style == "keyword");
+  REQUIRE(spans[0].matched_text == "SELECT");
+  REQUIRE(spans[2].style == "identifier");
+  REQUIRE(spans[2].matched_text == "selected");
+  REQUIRE(spans[4].style == "keyword");
+  REQUIRE(spans[6].style == "identifier");
+  REQUIRE(spans[6].matched_text == "t_from");
+}
+
+TEST_CASE("Highlight keywords word boundary") {
+  const char* keyword_json = R"({
+    "name": "keyword",
+    "fileExtensions": [".k"],
+    "states": {
+      "default": [
+        {"keywords": ["if", "名称"], "style": "keyword"},
+        {"pattern": "[0-9]+", "style": "number"}
+      ]
+    }
+  })";
+  const char* regex_json = R"({
+    "name": "regex",
+    "fileExtensions": [".r"],
+    "states": {
+      "default": [
+        {"pattern": "\\b(if|名称)\\b", "style": "keyword"},
+        {"pattern": "[0-9]+", "style": "number"}
+      ]
+    }
+  })";
+  // 单词边界按Unicode字符判断，全角标点和破折号不是单词字符，汉字是单词字符
+  const String text = "if—x if（y） 名if if名 名称，1名称 é if_1 (if)";
+  Ptr<HighlightEngine> keyword_engine = MAKE_PTR<HighlightEngine>();
+  keyword_engine->compileSyntaxFromJson(keyword_json);
+  Ptr<HighlightEngine> regex_engine = MAKE_PTR<HighlightEngine>();
+  regex_engine->compileSyntaxFromJson(regex_json);
+  Ptr<DocumentHighlight> keyword_highlight = keyword_engine->loadDocument(MAKE_PTR<Document>("a.k", text))
+    ->analyzeFully();
+  Ptr<DocumentHighlight> regex_highlight = regex_engine->loadDocument(MAKE_PTR<Document>("a.r", text))
+    ->analyzeFully();
+  REQUIRE(isSameHighlight(keyword_highlight, regex_highlight));
+  size_t keyword_count = 0;
+  for (const TokenSpan& span : keyword_highlight->getLineSpans(0)) {
+    keyword_count += span.style == "keyword" ? 1 : 0;
+  }
+  REQUIRE(keyword_count == 4);
+}
+
+TEST_CASE("Highlight keyword grammar") {
+  // 与java.json相同，只是关键字改用keywords规则
+  Ptr<HighlightEngine> regex_engine = MAKE_PTR<HighlightEngine>();
+  regex_engine->compileSyntaxFromFile(kSyntaxJavaPath);
+  Ptr<HighlightEngine> keyword_engine = MAKE_PTR<HighlightEngine>();
+  keyword_engine->compileSyntaxFromFile(kSyntaxJavaKeywordsPath);
+  for (const char* path : {kTestJavaPath, kViewJavaPath}) {
+    String code_txt = FileUtil::readString(path);
+    Ptr<DocumentHighlight> regex_highlight = regex_engine->loadDocument(MAKE_PTR<Document>("a.java", code_txt))
+      ->analyzeFully();
+    Ptr<DocumentHighlight> keyword_highlight = keyword_engine->loadDocument(MAKE_PTR<Document>("a.java", code_txt))
+      ->analyzeFully();
+    REQUIRE(isSameHighlight(regex_highlight, keyword_highlight));
+  }
+}
+
+TEST_CASE("Highlight comment end at line end") {
+  const char* syntax_json = R"({
+    "name": "c",
+    "fileExtensions": [".c"],
+    "states": {
+      "default": [
+        {"pattern": "/\\*", "style": "comment", "state": "longComment"},
+        {"pattern": "\\w+", "style": "identifier"}
+      ],
+      "longComment": [
+        {"pattern": "\\*/", "style": "comment", "state": "default"},
+        {"pattern": "\\w+", "style": "comment"}
+      ]
+    }
+  })";
+  Ptr<HighlightEngine> engine = MAKE_PTR<HighlightEngine>();
+  engine->compileSyntaxFromJson(syntax_json);
+  Ptr<Document> document = MAKE_PTR<Document>("test.c", "/* a\n b */\nint x;");
+  Ptr<DocumentAnalyzer> analyzer = engine->loadDocument(document);
+  Ptr<DocumentHighlight> highlight = analyzer->analyzeFully();
+  // 行尾的"*/"回到默认state，下一行按默认规则分析
+  LineSpans spans = highlight->getLineSpans(2);
+  REQUIRE_FALSE(spans.empty());
+  REQUIRE(spans[0].matched_text == "int");
+  REQUIRE(spans[0].style == "identifier");
+}
+
+TEST_CASE("Highlight prefilter") {
+  const char* syntax_json = R"({
+    "name": "c",
+    "fileExtensions": [".c"],
+    "states": {
+      "default": [
+        {"pattern": "/\\*", "style": "comment", "state": "longComment"},
+        {"pattern": "//.*", "style": "comment"}
+      ],
+      "longComment": [
+        {"pattern": "\\*/", "style": "comment", "state": "default"}
+      ]
+    }
+  })";
+  SyntaxRuleManager manager;
+  Ptr<const SyntaxRule> rule = manager.compileSyntaxFromJson(syntax_json);
+  // 两个state的token都只能以一个固定字节开头，直接用memchr查找
+  const StateRule& default_rule = rule->getStateRule(SyntaxRule::kDefaultStateId);
+  REQUIRE(default_rule.has_prefilter);
+  REQUIRE(default_rule.prefilter_byte == '/');
+  const StateRule& comment_rule = rule->getStateRule(rule->state_id_map_.at("longComment"));
+  REQUIRE(comment_rule.has_prefilter);
+  REQUIRE(comment_rule.prefilter_byte == '*');
+
+  Ptr<HighlightEngine> engine = MAKE_PTR<HighlightEngine>();
+  engine->compileSyntaxFromJson(syntax_json);
+  Ptr<Document> document = MAKE_PTR<Document>("test.c", "int a; /* 注释 * */ b; // end");
+  Ptr<DocumentAnalyzer> analyzer = engine->loadDocument(document);
+  Ptr<DocumentHighlight> highlight = analyzer->analyzeFully();
+  LineSpans spans = highlight->getLineSpans(0);
+  // 无法匹配的文本整段输出，匹配块的位置与文本保持一致
+  REQUIRE(spans.size() == 6);
+  REQUIRE(spans[0].matched_text == "int a; ");
+  REQUIRE(spans[1].matched_text == "/*");
+  REQUIRE(spans[2].matched_text == " 注释 * ");
+  REQUIRE(spans[2].range.start.column == 9);
+  REQUIRE(spans[3].matched_text == "*/");
+  REQUIRE(spans[3].range.start.column == 15);
+  REQUIRE(spans[3].style == "comment");
+  REQUIRE(spans[4].matched_text == " b; ");
+  REQUIRE(spans[5].matched_text == "// end");
+  REQUIRE(spans[5].style == "comment");
+}
+
+TEST_CASE("Utf8 position cursor") {
+  const String text = "int 名称 = \"你好, world\"; // 结果🙂 end";
+  const size_t char_count = Utf8Util::countChars(text);
+  Utf8PositionCursor cursor;
+  cursor.reset(text);
+  // 顺序、倒序和跳跃换算的结果都与Utf8Util一致
+  List<size_t> char_positions;
+  for (size_t pos = 0; pos <= char_count + 1; ++pos) {
+    char_positions.push_back(pos);
+  }
+  for (size_t pos = char_count + 1; pos > 0; --pos) {
+    char_positions.push_back(pos - 1);
+  }
+  char_positions.insert(char_positions.end(), {30, 2, 17, 5, 31, 0, 12});
+  for (size_t char_pos : char_positions) {
+    REQUIRE(cursor.charPosToBytePos(char_pos) == Utf8Util::charPosToBytePos(text, char_pos));
+  }
+  // 字节位置包括字符中间的位置
+  for (size_t byte_pos = 0; byte_pos <= text.size(); ++byte_pos) {
+    REQUIRE(cursor.bytePosToCharPos(byte_pos) == Utf8Util::bytePosToCharPos(text, byte_pos));
+  }
+  for (size_t byte_pos = text.size() + 1; byte_pos > 0; --byte_pos) {
+    REQUIRE(cursor.bytePosToCharPos(byte_pos - 1) == Utf8Util::bytePosToCharPos(text, byte_pos - 1));
+    REQUIRE(cursor.charPosToBytePos(byte_pos / 2) == Utf8Util::charPosToBytePos(text, byte_pos / 2));
+  }
+}
+
+TEST_CASE("Highlight profiler") {
+  Ptr<HighlightEngine> engine = MAKE_PTR<HighlightEngine>();
+  engine->compileSyntaxFromFile(kSyntaxJavaPath);
+  String code_txt = FileUtil::readString(kTestJavaPath);
+  Ptr<Document> document = MAKE_PTR<Document>("test.java", code_txt);
+  Ptr<DocumentAnalyzer> analyzer = engine->loadDocument(document);
+  REQUIRE(analyzer->getProfiler() == nullptr);
+  analyzer->setProfilingEnabled(true);
+  analyzer->analyzeFully();
+  Ptr<GrammarProfiler> profiler = analyzer->getProfiler();
+  REQUIRE(profiler != nullptr);
+  List<RuleProfile> profiles = profiler->report();
+  REQUIRE_FALSE(profiles.empty());
+  uint64_t state_hits = 0;
+  uint64_t token_hits = 0;
+  for (size_t i = 0; i < profiles.size(); ++i) {
+    if (i > 0) {
+      REQUIRE(profiles[i - 1].time_ns >= profiles[i].time_ns);
+    }
+    REQUIRE(profiles[i].hits + profiles[i].misses == profiles[i].invocations);
+    if (profiles[i].token_rule_idx < 0) {
+      state_hits += profiles[i].hits;
+    } else {
+      token_hits += profiles[i].hits;
+    }
+  }
+  // 每次state匹配成功都对应唯一一个胜出的token规则
+  REQUIRE(state_hits > 0);
+  REQUIRE(state_hits == token_hits);
+  std::cout << profiler->toTable() << std::endl;
+  REQUIRE(nlohmann::json::parse(profiler->toJson()).size() == profiles.size());
+
+  // 后台分析过程中开关性能分析，分析线程不会使用已释放的分析器
+  std::future<Ptr<DocumentHighlight>> future = analyzer->analyzeFullyAsync();
+  for (int i = 0; i < 100; ++i) {
+    analyzer->setProfilingEnabled(i % 2 == 0);
+    analyzer->getProfiler();
+  }
+  REQUIRE(future.get() != nullptr);
+}
+
+TEST_CASE("Highlight retry limit") {
+  const char* syntax_json = R"({
+    "name": "evil",
+    "fileExtensions": [".evil"],
+    "states": {
+      "default": [
+        {"pattern": "(a|aa)+\\d", "style": "number"},
+        {"pattern": "b+", "style": "keyword"}
+      ]
+    }
+  })";
+  Ptr<HighlightEngine> engine = MAKE_PTR<HighlightEngine>();
+  engine->compileSyntaxFromJson(syntax_json);
+  AnalyzeOptions options;
+  options.retry_limit_in_search = 10000;
+  engine->setAnalyzeOptions(options);
+  Ptr<Document> document = MAKE_PTR<Document>("test.evil", "bb aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaa!\nbb");
+  Ptr<DocumentAnalyzer> analyzer = engine->loadDocument(document);
+  Ptr<DocumentHighlight> highlight = analyzer->analyzeFully();
+  // 触发回溯上限的行剩余部分无样式输出，后续行不受影响
+  REQUIRE(analyzer->getLimitExceededCount() == 1);
+  LineSpans spans = highlight->getLineSpans(0);
+  REQUIRE(spans.front().style == "keyword");
+  REQUIRE(spans.back().style.empty());
+  REQUIRE(spans.back().range.end.column == document->getLine(0).length());
+  REQUIRE(highlight->getLineSpans(1).front().style == "keyword");
+
+  // 不足1毫秒的时间预算按整行检查，用完后该行剩余文本无样式输出，下一行重新计算预算
+  AnalyzeOptions budget_options;
+  budget_options.line_time_budget_us = 100;
+  engine->setAnalyzeOptions(budget_options);
+  String long_line;
+  for (size_t i = 0; i < 200000; ++i) {
+    long_line += "b ";
+  }
+  Ptr<Document> budget_document = MAKE_PTR<Document>("budget.evil", long_line + "\nbb");
+  Ptr<DocumentAnalyzer> budget_analyzer = engine->createAnalyzer(budget_document);
+  Ptr<DocumentHighlight> budget_highlight = budget_analyzer->analyzeFully();
+  REQUIRE(budget_analyzer->getLimitExceededCount() == 1);
+  LineSpans budget_spans = budget_highlight->getLineSpans(0);
+  REQUIRE(budget_spans.back().style.empty());
+  REQUIRE(budget_spans.back().range.end.column == long_line.length());
+  REQUIRE(budget_highlight->getLineSpans(1).front().style == "keyword");
+  engine->setAnalyzeOptions(options);
+
+  // 分析过程中修改匹配限制，等到分析完成后才生效
+  std::future<Ptr<DocumentHighlight>> future = analyzer->analyzeFullyAsync();
+  for (int i = 0; i < 100; ++i) {
+    options.line_time_budget_us = i % 2 == 0 ? 1000000 : 0;
+    engine->setAnalyzeOptions(options);
+    analyzer->getLimitExceededCount();
+  }
+  REQUIRE(future.get() != nullptr);
+}
+
+TEST_CASE("Highlight concurrent analyze") {
+  Ptr<HighlightEngine> engine = MAKE_PTR<HighlightEngine>();
+  engine->compileSyntaxFromFile(kSyntaxJavaPath);
+  String code_txt = FileUtil::readString(kViewJavaPath);
+  Ptr<DocumentHighlight> expected = engine->loadDocument(MAKE_PTR<Document>("expected.java", code_txt))->analyzeFully();
+
+  // 多个线程共享同一个引擎和语法规则，各自分析不同的文档
+  constexpr size_t kThreadCount = 4;
+  List<Ptr<DocumentHighlight>> results(kThreadCount);
+  List<std::thread> threads;
+  for (size_t i = 0; i < kThreadCount; ++i) {
+    threads.emplace_back([&engine, &code_txt, &results, i]() {
+      Ptr<Document> document = MAKE_PTR<Document>("View" + std::to_string(i) + ".java", code_txt);
+      results[i] = engine->loadDocument(document)->analyzeFully();
+    });
+  }
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+  for (const Ptr<DocumentHighlight>& result : results) {
+    REQUIRE(isSameHighlight(result, expected));
+  }
+}
+
+TEST_CASE("Highlight batch") {
+  Ptr<HighlightEngine> engine = MAKE_PTR<HighlightEngine>();
+  engine->compileSyntaxFromFile(kSyntaxJavaPath);
+  engine->setBatchThreadCount(4);
+  String view_txt = FileUtil::readString(kViewJavaPath);
+  String test_txt = FileUtil::readString(kTestJavaPath);
+  List<HighlightJob> jobs;
+  for (size_t i = 0; i < 16; ++i) {
+    jobs.push_back({"batch" + std::to_string(i) + ".java", i % 2 == 0 ? view_txt : test_txt});
+  }
+  jobs.push_back({"unknown.txt", "no syntax"});
+
+  List<Ptr<DocumentHighlight>> results = engine->highlightBatch(jobs);
+  REQUIRE(results.size() == jobs.size());
+  REQUIRE(results.back() == nullptr);
+  for (size_t i = 0; i + 1 < jobs.size(); ++i) {
+    Ptr<DocumentHighlight> expected = engine->loadDocument(MAKE_PTR<Document>(jobs[i].uri, jobs[i].text))->analyzeFully();
+    REQUIRE(isSameHighlight(results[i], expected));
+  }
+
+  std::atomic<size_t> callback_count {0};
+  engine->highlightBatch(jobs, [&callback_count](size_t, const Ptr<DocumentHighlight>&) {
+    ++callback_count;
+  });
+  REQUIRE(callback_count == jobs.size());
+}
+
+TEST_CASE("Highlight cancellation") {
+  Ptr<HighlightEngine> engine = MAKE_PTR<HighlightEngine>();
+  engine->compileSyntaxFromFile(kSyntaxJavaPath);
+  String code_txt = FileUtil::readString(kTestJavaPath);
+  Ptr<DocumentAnalyzer> analyzer = engine->loadDocument(MAKE_PTR<Document>("cancel.java", code_txt));
+  analyzer->analyzeFully();
+
+  // 已取消的更新会应用patch，但高亮留到下次分析补上
+  Ptr<CancellationToken> cancelled = MAKE_PTR<CancellationToken>();
+  cancelled->cancel();
+  TextRange range {{0, 0}, {0, 0}};
+  REQUIRE(analyzer->updateHighlight(range, "/* open\n", cancelled) == nullptr);
+  REQUIRE(analyzer->hasDirtyLines());
+  Ptr<DocumentHighlight> highlight = analyzer->updateHighlight(range, " ");
+  REQUIRE_FALSE(analyzer->hasDirtyLines());
+
+  Ptr<DocumentAnalyzer> expected_analyzer = engine->loadDocument(MAKE_PTR<Document>("expected.java", " /* open\n" + code_txt));
+  REQUIRE(isSameHighlight(highlight, expected_analyzer->analyzeFully()));
+}
+
+TEST_CASE("Highlight async") {
+  Ptr<HighlightEngine> engine = MAKE_PTR<HighlightEngine>();
+  engine->compileSyntaxFromFile(kSyntaxJavaPath);
+  String code_txt = FileUtil::readString(kViewJavaPath);
+  Ptr<DocumentAnalyzer> analyzer = engine->loadDocument(MAKE_PTR<Document>("async.java", code_txt));
+  std::future<Ptr<DocumentHighlight>> initial = analyzer->analyzeFullyAsync();
+
+  // 模拟连续输入：每次输入都取消上一次分析，异步任务按提交顺序执行
+  Ptr<CancellationToken> token;
+  std::atomic<size_t> callback_count {0};
+  const String typed = "/* a comment";
+  for (size_t i = 0; i < typed.length(); ++i) {
+    if (token != nullptr) {
+      token->cancel();
+    }
+    token = MAKE_PTR<CancellationToken>();
+    TextRange range {{0, i}, {0, i}};
+    analyzer->updateHighlightAsync(range, typed.substr(i, 1), token,
+      [&callback_count](const Ptr<DocumentHighlight>&) {
+        ++callback_count;
+      });
+  }
+  TextRange range {{0, typed.length()}, {0, typed.length()}};
+  std::future<Ptr<DocumentHighlight>> last = analyzer->updateHighlightAsync(range, " */", token);
+  Ptr<DocumentHighlight> highlight = last.get();
+  REQUIRE(initial.get() != nullptr);
+  REQUIRE(callback_count == typed.length());
+  REQUIRE(highlight != nullptr);
+  REQUIRE_FALSE(analyzer->hasDirtyLines());
+
+  Ptr<DocumentAnalyzer> expected_analyzer = engine->loadDocument(MAKE_PTR<Document>("expected.java", typed + " */" + code_txt));
+  REQUIRE(isSameHighlight(highlight, expected_analyzer->analyzeFully()));
+
+  // 多个分析器的异步任务共享线程池，不会为每个分析器创建一个线程
+  std::mutex thread_mutex;
+  HashSet<std::thread::id> thread_ids;
+  List<Ptr<DocumentAnalyzer>> analyzers;
+  List<std::future<Ptr<DocumentHighlight>>> futures;
+  for (size_t i = 0; i < 64; ++i) {
+    Ptr<DocumentAnalyzer> small_analyzer = engine->createAnalyzer(
+      MAKE_PTR<Document>("async" + std::to_string(i) + ".java", "int a;\n/* b */"));
+    small_analyzer->analyzeFullyAsync(nullptr, [&thread_mutex, &thread_ids](const Ptr<DocumentHighlight>&) {
+      std::lock_guard<std::mutex> lock(thread_mutex);
+      thread_ids.insert(std::this_thread::get_id());
+    });
+    futures.push_back(small_analyzer->analyzeFullyAsync());
+    analyzers.push_back(small_analyzer);
+  }
+  for (std::future<Ptr<DocumentHighlight>>& future : futures) {
+    REQUIRE(future.get() != nullptr);
+  }
+  REQUIRE(thread_ids.size() <= std::max<size_t>(std::thread::hardware_concurrency(), 1));
+}
+
+TEST_CASE("Highlight memory budget") {
+  Ptr<HighlightEngine> engine = MAKE_PTR<HighlightEngine>();
+  engine->compileSyntaxFromFile(kSyntaxJavaPath);
+  String code_txt = FileUtil::readString(kViewJavaPath);
+  List<Ptr<DocumentAnalyzer>> analyzers;
+  for (size_t i = 0; i < 3; ++i) {
+    Ptr<DocumentAnalyzer> analyzer = engine->loadDocument(MAKE_PTR<Document>("View" + std::to_string(i) + ".java", code_txt));
+    analyzer->analyzeFully();
+    analyzers.push_back(analyzer);
+  }
+  REQUIRE(engine->getLoadedDocumentCount() == 3);
+  REQUIRE(engine->closeDocument("View2.java"));
+  REQUIRE_FALSE(engine->closeDocument("View2.java"));
+  REQUIRE(engine->getLoadedDocumentCount() == 2);
+
+  // 访问View0使其成为最近使用，预算只够保留一个完整分析器和一个释放了高亮缓存的分析器
+  size_t full_bytes = analyzers[0]->memoryUsage().total();
+  REQUIRE(engine->loadDocument(MAKE_PTR<Document>("View0.java", "")) == analyzers[0]);
+  engine->setMemoryBudget(full_bytes + full_bytes / 2);
+  REQUIRE(engine->getLoadedDocumentCount() == 2);
+  REQUIRE_FALSE(analyzers[0]->hasDirtyLines());
+  REQUIRE(analyzers[1]->hasDirtyLines());
+  REQUIRE(analyzers[1]->memoryUsage().span_vectors < analyzers[0]->memoryUsage().span_vectors / 100);
+
+  // 行状态仍然保留，单行分析和增量更新都能继续工作
+  Ptr<DocumentHighlight> expected = analyzers[2]->analyzeFully();
+  REQUIRE(analyzers[1]->analyzeLine(100)->spans.size() == expected->getLineSpans(100).size());
+  TextRange range {{0, 0}, {0, 0}};
+  REQUIRE(isSameHighlight(analyzers[1]->updateHighlight(range, ""), expected));
+
+  // 预算不足时关闭最久未使用的文本
+  engine->setMemoryBudget(full_bytes);
+  REQUIRE(engine->getLoadedDocumentCount() == 1);
+  REQUIRE(engine->trimMemory() <= full_bytes);
+
+  // 回收时不等待正在进行的分析，分析中的文本按上一次统计的结果计算
+  std::future<Ptr<DocumentHighlight>> future = analyzers[0]->analyzeFullyAsync();
+  for (int i = 0; i < 100; ++i) {
+    REQUIRE(engine->trimMemory() > 0);
+  }
+  REQUIRE(isSameHighlight(future.get(), expected));
+}
+
+TEST_CASE("Highlight memory usage") {
+  Ptr<HighlightEngine> engine = MAKE_PTR<HighlightEngine>();
+  engine->compileSyntaxFromFile(kSyntaxJavaPath);
+  MemoryUsage grammar_usage = engine->memoryUsage();
+  REQUIRE(grammar_usage.compiled_regexes > 0);
+  REQUIRE(grammar_usage.grammar_data > 0);
+  REQUIRE(grammar_usage.span_vectors == 0);
+
+  String code_txt = FileUtil::readString(kViewJavaPath);
+  Ptr<DocumentAnalyzer> analyzer = engine->loadDocument(MAKE_PTR<Document>("View.java", code_txt));
+  analyzer->analyzeFully();
+  MemoryUsage analyzer_usage = analyzer->memoryUsage();
+  REQUIRE(analyzer_usage.line_text >= code_txt.length() / 2);
+  REQUIRE(analyzer_usage.line_states > 0);
+  REQUIRE(analyzer_usage.span_vectors > 0);
+  REQUIRE(analyzer_usage.span_strings > 0);
+  REQUIRE(analyzer_usage.compiled_regexes == 0);
+
+  // 引擎统计包含语法规则和所有分析器
+  MemoryUsage engine_usage = engine->memoryUsage();
+  REQUIRE(engine_usage.compiled_regexes == grammar_usage.compiled_regexes);
+  REQUIRE(engine_usage.span_vectors == analyzer_usage.span_vectors);
+  REQUIRE(engine_usage.total() > grammar_usage.total() + analyzer_usage.line_text);
+}
+
+TEST_CASE("Highlight block store") {
+  DocumentHighlight highlight;
+  highlight.resize(300);
+  REQUIRE(highlight.getLineCount() == 300);
+  REQUIRE(highlight.getBlockCount() > 1);
+  List<TokenSpan> spans(2);
+  for (size_t line = 0; line < 300; ++line) {
+    spans[0].range.start = {line, 0};
+    spans[1].style = std::to_string(line);
+    highlight.setLineSpans(line, {spans.data(), line % 3});
+  }
+
+  // 插入和删除只影响所在块，之后的行整体移动
+  size_t block_count = highlight.getBlockCount();
+  highlight.insertLines(10, 5);
+  REQUIRE(highlight.getBlockCount() == block_count);
+  REQUIRE(highlight.getLineSpans(12).empty());
+  REQUIRE(highlight.getLineSpans(17).size() == 0);
+  REQUIRE(highlight.getLineSpans(16).size() == 2);
+  REQUIRE(highlight.getLineSpans(16).back().style == "11");
+  highlight.removeLines(10, 5);
+  REQUIRE(highlight.getLineSpans(11).back().style == "11");
+  highlight.removeLines(50, 200);
+  REQUIRE(highlight.getLineCount() == 100);
+  REQUIRE(highlight.getLineSpans(50).size() == 1);
+  REQUIRE(highlight.getLineSpans(50).front().range.start.line == 250);
+
+  size_t visited_lines = 0;
+  size_t visited_spans = 0;
+  highlight.forEachLine([&](size_t line, const LineSpans& line_spans) {
+    REQUIRE(line == visited_lines);
+    ++visited_lines;
+    visited_spans += line_spans.size();
+  });
+  REQUIRE(visited_lines == 100);
+  REQUIRE(visited_spans == 100);
+
+  // 跨越多段的插入删除，快照不受之后修改的影响
+  DocumentHighlight large_highlight;
+  const size_t large_line_count = DocumentHighlight::kMaxBlockLines * DocumentHighlight::kMaxChunkBlocks * 4;
+  large_highlight.resize(large_line_count);
+  for (size_t line = 0; line < large_line_count; ++line) {
+    spans[1].style = std::to_string(line);
+    large_highlight.setLineSpans(line, {spans.data(), 2});
+  }
+  Ptr<const DocumentHighlight> large_snapshot = large_highlight.snapshot();
+  large_highlight.removeLines(100, large_line_count / 2);
+  large_highlight.insertLines(50, 3);
+  REQUIRE(large_highlight.getLineCount() == large_line_count / 2 + 3);
+  REQUIRE(large_highlight.getLineSpans(52).empty());
+  REQUIRE(large_highlight.getLineSpans(53).back().style == "50");
+  REQUIRE(large_highlight.getLineSpans(103).back().style == std::to_string(100 + large_line_count / 2));
+  REQUIRE(large_highlight.getLineSpans(large_line_count / 2 + 2).back().style
+    == std::to_string(large_line_count - 1));
+  REQUIRE(large_snapshot->getLineCount() == large_line_count);
+  for (size_t line = 0; line < large_line_count; line += 97) {
+    REQUIRE(large_snapshot->getLineSpans(line).back().style == std::to_string(line));
+  }
+  large_highlight.removeLines(0, large_highlight.getLineCount());
+  REQUIRE(large_highlight.getLineCount() == 0);
+  REQUIRE(large_highlight.getBlockCount() == 0);
+  large_highlight.resize(10);
+  REQUIRE(large_highlight.getBlockCount() == 1);
+
+  // 增量更新插入删除行后与完整分析的结果一致，包括未重新分析行的行号
+  Ptr<HighlightEngine> engine = MAKE_PTR<HighlightEngine>();
+  engine->compileSyntaxFromFile(kSyntaxJavaPath);
+  String code_txt = FileUtil::readString(kViewJavaPath);
+  Ptr<Document> document = MAKE_PTR<Document>("View.java", code_txt);
+  Ptr<DocumentAnalyzer> analyzer = engine->loadDocument(document);
+  analyzer->analyzeFully();
+  TextRange insert_range {{500, 0}, {500, 0}};
+  Ptr<DocumentHighlight> updated = analyzer->updateHighlight(insert_range, "int a;\nint b;\n");
+  Ptr<DocumentAnalyzer> expected = engine->loadDocument(MAKE_PTR<Document>("expected.java", document->getText()));
+  REQUIRE(isSameHighlight(updated, expected->analyzeFully()));
+  TextRange remove_range {{499, 0}, {502, 0}};
+  updated = analyzer->updateHighlight(remove_range, "");
+  expected = engine->loadDocument(MAKE_PTR<Document>("expected2.java", document->getText()));
+  REQUIRE(isSameHighlight(updated, expected->analyzeFully()));
+
+  // 修改起始行等于原行数时(在文本末尾之后追加)，新增的行追加在末尾
+  Ptr<Document> short_document = MAKE_PTR<Document>("short.java", "int a;\nint b;");
+  analyzer = engine->loadDocument(short_document);
+  analyzer->analyzeFully();
+  TextRange append_range {{2, 0}, {2, 0}};
+  updated = analyzer->updateHighlight(append_range, "\nint c;\nint d;");
+  expected = engine->loadDocument(MAKE_PTR<Document>("expected3.java", short_document->getText()));
+  REQUIRE(isSameHighlight(updated, expected->analyzeFully()));
+}
+
+TEST_CASE("Highlight snapshot") {
+  Ptr<HighlightEngine> engine = MAKE_PTR<HighlightEngine>();
+  engine->compileSyntaxFromFile(kSyntaxJavaPath);
+  String code_txt = FileUtil::readString(kViewJavaPath);
+  Ptr<DocumentAnalyzer> analyzer = engine->loadDocument(MAKE_PTR<Document>("View.java", code_txt));
+  REQUIRE(analyzer->getSnapshot() == nullptr);
+  analyzer->setSnapshotEnabled(true);
+  Ptr<DocumentHighlight> highlight = analyzer->analyzeFully();
+  Ptr<const DocumentHighlight> first = analyzer->getSnapshot();
+  REQUIRE(first != nullptr);
+  REQUIRE(first->getLineCount() == highlight->getLineCount());
+  size_t first_spans = first->getLineSpans(0).size();
+
+  // 快照不受之后修改的影响，只有被修改的块会复制
+  TextRange range {{0, 0}, {0, 0}};
+  analyzer->updateHighlight(range, "/* open */ ");
+  Ptr<const DocumentHighlight> second = analyzer->getSnapshot();
+  REQUIRE(second != first);
+  REQUIRE(first->getLineSpans(0).size() == first_spans);
+  REQUIRE(second->getLineSpans(0).size() > first_spans);
+  size_t last_line = second->getLineCount() - 1;
+  REQUIRE(first->getLineSpans(last_line).data == second->getLineSpans(last_line).data);
+  analyzer->updateHighlight(range, "/* open\n");
+  REQUIRE(analyzer->getSnapshot()->getLineCount() == first->getLineCount() + 1);
+  REQUIRE(second->getLineCount() == first->getLineCount());
+
+  // 读线程遍历快照的同时分析线程持续修改
+  std::atomic<bool> stopped {false};
+  std::atomic<size_t> read_count {0};
+  std::atomic<size_t> mismatch_count {0};
+  std::thread reader([&]() {
+    while (!stopped) {
+      Ptr<const DocumentHighlight> snapshot = analyzer->getSnapshot();
+      size_t line_count = 0;
+      snapshot->forEachLine([&](size_t, const LineSpans& spans) {
+        for (const TokenSpan& span : spans) {
+          if (span.range.start.line != line_count) {
+            ++mismatch_count;
+          }
+        }
+        ++line_count;
+      });
+      if (line_count != snapshot->getLineCount()) {
+        ++mismatch_count;
+      }
+      ++read_count;
+    }
+  });
+  TextRange insert_range {{100, 0}, {100, 0}};
+  TextRange remove_range {{100, 0}, {101, 0}};
+  for (int i = 0; i < 50 || read_count < 2; ++i) {
+    analyzer->updateHighlight(insert_range, "int x;\n");
+    analyzer->updateHighlight(remove_range, "");
+  }
+  stopped = true;
+  reader.join();
+  REQUIRE(mismatch_count == 0);
+  Ptr<DocumentAnalyzer> expected = engine->loadDocument(MAKE_PTR<Document>("expected.java", "/* open\n/* open */ " + code_txt));
+  REQUIRE(isSameHighlight(analyzer->getSnapshot(), expected->analyzeFully()));
+}
+
+TEST_CASE("Highlight publish channel") {
+  // 读守卫存活期间旧版本不会被回收
+  PublishChannel<int> channel;
+  REQUIRE_FALSE(channel.read());
+  channel.publish(MAKE_UPTR<int>(1));
+  {
+    PublishChannel<int>::ReadGuard guard = channel.read();
+    channel.publish(MAKE_UPTR<int>(2));
+    channel.publish(MAKE_UPTR<int>(3));
+    REQUIRE(*guard == 1);
+    REQUIRE(*channel.read() == 3);
+    REQUIRE(channel.getRetiredCount() == 2);
+  }
+  channel.publish(MAKE_UPTR<int>(4));
+  REQUIRE(channel.getRetiredCount() == 0);
+
+  // UI线程读到的始终是完整的版本，版本号单调递增且与高亮内容一致
+  Ptr<HighlightEngine> engine = MAKE_PTR<HighlightEngine>();
+  engine->compileSyntaxFromFile(kSyntaxJavaPath);
+  String code_txt = FileUtil::readString(kViewJavaPath);
+  Ptr<Document> document = MAKE_PTR<Document>("View.java", code_txt);
+  Ptr<DocumentAnalyzer> analyzer = engine->loadDocument(document);
+  analyzer->setSnapshotEnabled(true);
+  analyzer->analyzeFully();
+  REQUIRE(analyzer->readPublished()->revision == document->getRevision());
+  const size_t base_line_count = document->getLineCount();
+
+  std::atomic<bool> stopped {false};
+  std::atomic<size_t> read_count {0};
+  std::atomic<size_t> mismatch_count {0};
+  std::thread ui_thread([&]() {
+    uint64_t last_revision = 0;
+    while (!stopped) {
+      PublishChannel<HighlightVersion>::ReadGuard version = analyzer->readPublished();
+      // 奇数版本号对应插入了一行的文本
+      size_t expected_lines = base_line_count + (version->revision % 2 == 1 ? 1 : 0);
+      if (version->revision < last_revision || version->highlight->getLineCount() != expected_lines) {
+        ++mismatch_count;
+      }
+      last_revision = version->revision;
+      ++read_count;
+    }
+  });
+  TextRange insert_range {{100, 0}, {100, 0}};
+  TextRange remove_range {{100, 0}, {101, 0}};
+  for (int i = 0; i < 50 || read_count < 2; ++i) {
+    analyzer->updateHighlight(insert_range, "int x;\n");
+    analyzer->updateHighlight(remove_range, "");
+  }
+  stopped = true;
+  ui_thread.join();
+  REQUIRE(mismatch_count == 0);
+  REQUIRE(analyzer->readPublished()->revision == document->getRevision());
+}
+
+TEST_CASE("Highlight stream tokenizer") {
+  Ptr<HighlightEngine> engine = MAKE_PTR<HighlightEngine>();
+  engine->compileSyntaxFromFile(kSyntaxJavaPath);
+  String code_txt = FileUtil::readString(kViewJavaPath);
+  Ptr<DocumentHighlight> expected = engine->createAnalyzer(MAKE_PTR<Document>("View.java", code_txt))->analyzeFully();
+  REQUIRE(engine->createStreamTokenizer("build.log", nullptr) == nullptr);
+
+  // 块边界落在行中间、CRLF中间或UTF-8字符中间时，结果与完整分析一致
+  String crlf_txt;
+  for (char c : code_txt) {
+    if (c == '\n') {
+      crlf_txt += '\r';
+    }
+    crlf_txt += c;
+  }
+  for (const String* text : {&code_txt, &crlf_txt}) {
+    for (size_t chunk_size : {1, 13, 4096}) {
+      DocumentHighlight streamed;
+      UPtr<StreamTokenizer> tokenizer = engine->createStreamTokenizer("View.java",
+        [&streamed](size_t line, const String&, const LineSpans& spans) {
+          streamed.resize(line + 1);
+          streamed.setLineSpans(line, spans);
+        });
+      for (size_t pos = 0; pos < text->length(); pos += chunk_size) {
+        tokenizer->feed(text->data() + pos, std::min(chunk_size, text->length() - pos));
+      }
+      tokenizer->finish();
+      REQUIRE(tokenizer->getLineCount() == expected->getLineCount());
+      REQUIRE(isSameHighlight(streamed.snapshot(), expected));
+    }
+  }
+
+  // 跨行注释的状态在块之间延续
+  List<String> styles;
+  UPtr<StreamTokenizer> tokenizer = engine->createStreamTokenizer("Comment.java",
+    [&styles](size_t, const String&, const LineSpans& spans) {
+      styles.push_back(spans.empty() ? "" : spans.front().style);
+    });
+  tokenizer->feed("/* first\n se");
+  tokenizer->feed("cond */\nint a;");
+  REQUIRE(styles.size() == 2);
+  REQUIRE(tokenizer->getState() == SyntaxRule::kDefaultStateId);
+  tokenizer->finish();
+  REQUIRE(styles.size() == 3);
+  REQUIRE(styles[0] == styles[1]);
+  REQUIRE(styles[0] != styles[2]);
+  tokenizer->reset();
+  tokenizer->finish();
+  REQUIRE(tokenizer->getLineCount() == 0);
+
+  // 跨行匹配不累积之前的行，结束行的匹配文本只包含本行的部分
+  Ptr<HighlightEngine> block_engine = MAKE_PTR<HighlightEngine>();
+  block_engine->compileSyntaxFromJson(R"({
+    "name": "block",
+    "fileExtensions": [".blk"],
+    "states": {
+      "default": [
+        {"pattern": "<<", "style": "block", "state": "block"},
+        {"pattern": ">>", "style": "block"}
+      ],
+      "block": [
+        {"pattern": ">>", "style": "block", "state": "default"}
+      ]
+    }
+  })");
+  String last_text;
+  tokenizer = block_engine->createStreamTokenizer("stream.blk",
+    [&last_text](size_t, const String&, const LineSpans& spans) {
+      last_text = spans.empty() ? "" : spans.front().matched_text;
+    });
+  tokenizer->feed("first <<\n");
+  for (int i = 0; i < 1000; ++i) {
+    tokenizer->feed("middle\n");
+  }
+  REQUIRE(last_text == "middle");
+  tokenizer->feed(">> last\n");
+  REQUIRE(last_text == ">>");
+  Ptr<DocumentHighlight> block_highlight = block_engine->createAnalyzer(
+    MAKE_PTR<Document>("document.blk", "first <<\nmiddle\n>> last"))->analyzeFully();
+  REQUIRE(block_highlight->getLineSpans(2).front().matched_text == "<<middle>>");
+}
+
+TEST_CASE("Highlight line cache") {
+  Ptr<HighlightEngine> engine = MAKE_PTR<HighlightEngine>();
+  engine->compileSyntaxFromFile(kSyntaxJavaPath);
+  for (const char* path : {kTestJavaPath, kViewJavaPath}) {
+    String code_txt = FileUtil::readString(path);
+    Ptr<DocumentAnalyzer> expected = engine->createAnalyzer(MAKE_PTR<Document>("Expected.java", code_txt));
+    Ptr<Document> document = MAKE_PTR<Document>("Cached.java", code_txt);
+    Ptr<DocumentAnalyzer> analyzer = engine->createAnalyzer(document);
+    analyzer->setLineCacheCapacity(16 * 1024 * 1024);
+    REQUIRE(isSameHighlight(analyzer->analyzeFully(), expected->analyzeFully()));
+    LineCacheStats first_stats = analyzer->getLineCacheStats();
+    REQUIRE(first_stats.misses > 0);
+    REQUIRE(first_stats.entry_count > 0);
+    REQUIRE(analyzer->memoryUsage().line_cache == first_stats.memory_bytes);
+
+    // 删除一段代码再撤销，恢复的行全部命中缓存，结果与完整分析一致
+    size_t line_count = document->getLineCount();
+    TextRange remove_range {{line_count / 4, 0}, {line_count / 2, 0}};
+    String removed_text;
+    for (size_t line = remove_range.start.line; line < remove_range.end.line; ++line) {
+      removed_text += document->getLine(line) + "\n";
+    }
+    analyzer->updateHighlight(remove_range, "");
+    Ptr<DocumentHighlight> restored = analyzer->updateHighlight({remove_range.start, remove_range.start}, removed_text);
+    REQUIRE(document->getText() == code_txt);
+    REQUIRE(isSameHighlight(restored, expected->analyzeFully()));
+    LineCacheStats undo_stats = analyzer->getLineCacheStats();
+    // 空行和跨行匹配中的行不经过缓存
+    REQUIRE(undo_stats.hits - first_stats.hits >= (remove_range.end.line - remove_range.start.line) / 2);
+    REQUIRE(undo_stats.misses - first_stats.misses <= 4);
+  }
+
+  // 容量不足时淘汰旧的行，关闭后统计清零
+  Ptr<DocumentAnalyzer> analyzer = engine->createAnalyzer(
+    MAKE_PTR<Document>("Small.java", FileUtil::readString(kViewJavaPath)));
+  analyzer->setLineCacheCapacity(64 * 1024);
+  analyzer->analyzeFully();
+  LineCacheStats stats = analyzer->getLineCacheStats();
+  REQUIRE(stats.memory_bytes <= 64 * 1024 + 64 * 1024);
+  REQUIRE(stats.entry_count > 0);
+  analyzer->setLineCacheCapacity(1024);
+  REQUIRE(analyzer->getLineCacheStats().entry_count < stats.entry_count);
+  analyzer->setLineCacheCapacity(0);
+  REQUIRE(analyzer->getLineCacheStats().hits == 0);
+  REQUIRE(analyzer->memoryUsage().line_cache == 0);
+}
+
+static String makeDiskCacheDir(const char* name) {
+  std::filesystem::path dir = std::filesystem::temp_directory_path() / name;
+  std::filesystem::remove_all(dir);
+  return dir.string();
+}
+
+TEST_CASE("Highlight disk cache") {
+  Ptr<HighlightEngine> engine = MAKE_PTR<HighlightEngine>();
+  engine->compileSyntaxFromFile(kSyntaxJavaPath);
+  Ptr<HighlightDiskCache> cache = MAKE_PTR<HighlightDiskCache>(makeDiskCacheDir("fasthighlight_disk_cache_test"));
+  engine->setDiskCache(cache);
+  String code_txt = FileUtil::readString(kViewJavaPath);
+
+  // 首次分析未命中并写入缓存，重新打开时直接恢复，结果与完整分析一致
+  Ptr<DocumentAnalyzer> first = engine->createAnalyzer(MAKE_PTR<Document>("View.java", code_txt));
+  Ptr<DocumentHighlight> expected = first->analyzeFully();
+  DiskCacheStats stats = cache->getStats();
+  REQUIRE(stats.misses == 1);
+  REQUIRE(stats.stores == 1);
+  Ptr<Document> document = MAKE_PTR<Document>("View.java", code_txt);
+  String path = cache->getCachePath(*document, *first->getSyntaxRule());
+  REQUIRE(FileUtil::isFile(path));
+  Ptr<DocumentAnalyzer> reopened = engine->loadDocument(document);
+  REQUIRE(isSameHighlight(reopened->analyzeFully(), expected));
+  stats = cache->getStats();
+  REQUIRE(stats.hits == 1);
+  REQUIRE(stats.stores == 1);
+  LineSpans line_spans = reopened->analyzeFully()->getLineSpans(0);
+  REQUIRE(!line_spans.empty());
+  REQUIRE(line_spans[0].style_id == first->getSyntaxRule()->getStyleId(line_spans[0].style));
+  REQUIRE(line_spans[0].matched_text == expected->getLineSpans(0)[0].matched_text);
+
+  // 恢复的行状态可以继续增量分析
+  TextRange range {{10, 0}, {10, 0}};
+  REQUIRE(isSameHighlight(reopened->updateHighlight(range, "/* open comment\n"),
+    first->updateHighlight(range, "/* open comment\n")));
+
+  // 文本变化后未命中
+  Ptr<DocumentAnalyzer> changed = engine->createAnalyzer(MAKE_PTR<Document>("View.java", code_txt + "\n"));
+  changed->analyzeFully();
+  REQUIRE(cache->getStats().misses == 2);
+
+  // 损坏的缓存文件被拒绝，重新分析
+  String content = FileUtil::readString(path);
+  REQUIRE(FileUtil::writeString(path, content.substr(0, content.size() / 2)));
+  Ptr<DocumentAnalyzer> corrupted = engine->createAnalyzer(MAKE_PTR<Document>("View.java", code_txt));
+  Ptr<DocumentAnalyzer> fresh = MAKE_PTR<DocumentAnalyzer>(MAKE_PTR<Document>("View.java", code_txt),
+    first->getSyntaxRule());
+  REQUIRE(isSameHighlight(corrupted->analyzeFully(), fresh->analyzeFully()));
+  REQUIRE(cache->getStats().rejected == 1);
+}
+
+TEST_CASE("Highlight disk cache Benchmark") {
+  Ptr<HighlightEngine> engine = MAKE_PTR<HighlightEngine>();
+  engine->compileSyntaxFromFile(kSyntaxJavaPath);
+  Ptr<HighlightDiskCache> cache = MAKE_PTR<HighlightDiskCache>(makeDiskCacheDir("fasthighlight_disk_cache_bench"));
+  String code_txt = FileUtil::readString(kViewJavaPath);
+  Ptr<DocumentAnalyzer> warm = engine->createAnalyzer(MAKE_PTR<Document>("View.java", code_txt));
+  warm->setDiskCache(cache);
+  warm->analyzeFully();
+
+  BENCHMARK("Highlight Cold Open") {
+    Ptr<DocumentAnalyzer> analyzer = engine->createAnalyzer(MAKE_PTR<Document>("View.java", code_txt));
+    return analyzer->analyzeFully()->getLineCount();
+  };
+  BENCHMARK("Highlight Disk Cache Open") {
+    Ptr<DocumentAnalyzer> analyzer = engine->createAnalyzer(MAKE_PTR<Document>("View.java", code_txt));
+    analyzer->setDiskCache(cache);
+    return analyzer->analyzeFully()->getLineCount();
+  };
+}
+
+TEST_CASE("Highlight syntax reload") {
+  Ptr<HighlightEngine> engine = MAKE_PTR<HighlightEngine>();
+  String syntax_json = FileUtil::readString(kSyntaxJavaKeywordsPath);
+  engine->compileSyntaxFromJson(syntax_json);
+  String code_txt = FileUtil::readString(kViewJavaPath);
+  Ptr<DocumentAnalyzer> analyzer = engine->loadDocument(MAKE_PTR<Document>("View.java", code_txt));
+  analyzer->setSnapshotEnabled(true);
+  analyzer->analyzeFully();
+  analyzer->setViewport(1000, 1060);
+  Ptr<const SyntaxRule> old_rule = analyzer->getSyntaxRule();
+
+  // 回调在分析器的后台线程中，结果交给测试线程检查
+  auto reloaded = MAKE_PTR<std::promise<std::pair<String, Ptr<DocumentHighlight>>>>();
+  engine->setSyntaxReloadCallback([reloaded](const String& uri, const Ptr<DocumentHighlight>& highlight) {
+    reloaded->set_value({uri, highlight});
+  });
+  // 修改style名称并增加关键字
+  REQUIRE(StrUtil::replaceFirst(syntax_json, "\"style\": \"string\"", "\"style\": \"string.quoted\""));
+  REQUIRE(StrUtil::replaceFirst(syntax_json, "\"do\"]", "\"do\", \"return\"]"));
+  engine->compileSyntaxFromJson(syntax_json);
+  Ptr<const SyntaxRule> new_rule = analyzer->getSyntaxRule();
+  REQUIRE(new_rule != old_rule);
+  REQUIRE(new_rule->fingerprint != old_rule->fingerprint);
+
+  Ptr<DocumentAnalyzer> expected_analyzer = engine->createAnalyzer(MAKE_PTR<Document>("Expected.java", code_txt));
+  REQUIRE(expected_analyzer->getSyntaxRule() == new_rule);
+  Ptr<DocumentHighlight> expected = expected_analyzer->analyzeFully();
+
+  // 可见区域在热重载返回前已按新规则分析
+  Ptr<const DocumentHighlight> snapshot = analyzer->getSnapshot();
+  bool viewport_same = true;
+  for (size_t line = 1000; line < 1060; ++line) {
+    LineSpans spans = snapshot->getLineSpans(line);
+    LineSpans expected_spans = expected->getLineSpans(line);
+    viewport_same = viewport_same && spans.size() == expected_spans.size();
+    for (size_t i = 0; viewport_same && i < spans.size(); ++i) {
+      viewport_same = spans[i].style == expected_spans[i].style && spans[i].style_id == expected_spans[i].style_id
+        && spans[i].range.end.column == expected_spans[i].range.end.column;
+    }
+  }
+  REQUIRE(viewport_same);
+  // 其余行在后台分析完成
+  std::pair<String, Ptr<DocumentHighlight>> result = reloaded->get_future().get();
+  REQUIRE(result.first == "View.java");
+  Ptr<DocumentHighlight> highlight = result.second;
+  REQUIRE(highlight != nullptr);
+  REQUIRE(isSameHighlight(highlight, expected));
+  REQUIRE(isSameHighlight(analyzer->analyzeFully(), expected));
+  REQUIRE(!analyzer->hasDirtyLines());
+  bool has_quoted = false;
+  expected->forEachLine([&has_quoted](size_t, const LineSpans& spans) {
+    for (const TokenSpan& span : spans) {
+      has_quoted = has_quoted || span.style == "string.quoted";
+    }
+  });
+  REQUIRE(has_quoted);
+
+  // 后台分析完成前的增量更新只分析受影响的行，不会一直分析到文本末尾
+  Ptr<DocumentAnalyzer> pending_analyzer = engine->createAnalyzer(MAKE_PTR<Document>("Pending.java", code_txt));
+  pending_analyzer->setSnapshotEnabled(true);
+  pending_analyzer->analyzeFully();
+  pending_analyzer->setLineCacheCapacity(16 * 1024 * 1024);
+  std::promise<void> gate;
+  std::shared_future<void> gate_future = gate.get_future().share();
+  TextRange empty_range {{0, 0}, {0, 0}};
+  // 回调在后台线程中执行，阻塞后台线程使热重载的完整分析排在之后
+  pending_analyzer->updateHighlightAsync(empty_range, "", nullptr, [gate_future](const Ptr<DocumentHighlight>&) {
+    gate_future.wait();
+  });
+  std::promise<void> pending_done;
+  pending_analyzer->reloadSyntaxRule(old_rule, [&pending_done](const Ptr<DocumentHighlight>&) {
+    pending_done.set_value();
+  });
+  REQUIRE(pending_analyzer->hasDirtyLines());
+  // 尚未重新分析的行的style编号也已映射到新规则，新规则中没有的style不再有编号
+  bool style_ids_match = true;
+  pending_analyzer->getSnapshot()->forEachLine([&style_ids_match, &old_rule](size_t, const LineSpans& spans) {
+    for (const TokenSpan& span : spans) {
+      style_ids_match = style_ids_match && (span.style_id == SyntaxRule::kNoStyleId
+        || old_rule->getStyleName(span.style_id) == span.style);
+    }
+  });
+  REQUIRE(style_ids_match);
+  LineCacheStats before_stats = pending_analyzer->getLineCacheStats();
+  TextRange insert_range {{10, 0}, {10, 0}};
+  pending_analyzer->updateHighlight(insert_range, "int a;");
+  LineCacheStats after_stats = pending_analyzer->getLineCacheStats();
+  REQUIRE(after_stats.hits + after_stats.misses - before_stats.hits - before_stats.misses < 10);
+  REQUIRE(pending_analyzer->hasDirtyLines());
+  gate.set_value();
+  pending_done.get_future().wait();
+  REQUIRE_FALSE(pending_analyzer->hasDirtyLines());
+}
+
+TEST_CASE("Highlight syntax reload yields to edits") {
+  Ptr<HighlightEngine> engine = MAKE_PTR<HighlightEngine>();
+  String syntax_json = FileUtil::readString(kSyntaxJavaKeywordsPath);
+  engine->compileSyntaxFromJson(syntax_json);
+  String view_txt = FileUtil::readString(kViewJavaPath);
+  String code_txt;
+  for (size_t i = 0; i < 8; ++i) {
+    code_txt += view_txt;
+  }
+  Ptr<DocumentAnalyzer> analyzer = engine->loadDocument(MAKE_PTR<Document>("View.java", code_txt));
+  analyzer->setSnapshotEnabled(true);
+  analyzer->analyzeFully();
+  auto reloaded = MAKE_PTR<std::promise<Ptr<DocumentHighlight>>>();
+  engine->setSyntaxReloadCallback([reloaded](const String&, const Ptr<DocumentHighlight>& highlight) {
+    reloaded->set_value(highlight);
+  });
+  REQUIRE(StrUtil::replaceFirst(syntax_json, "\"do\"]", "\"do\", \"return\"]"));
+  engine->compileSyntaxFromJson(syntax_json);
+
+  // 后台分析每段之间释放锁，等第一段发布快照后编辑，编辑不需要等整个文本分析完
+  Ptr<const DocumentHighlight> viewport_snapshot = analyzer->getSnapshot();
+  while (analyzer->getSnapshot() == viewport_snapshot) {
+    std::this_thread::yield();
+  }
+  TextRange head_range {{0, 0}, {0, 0}};
+  analyzer->updateHighlight(head_range, "int a;\n");
+  REQUIRE(analyzer->hasDirtyLines());
+  TextRange tail_range {{20000, 0}, {20000, 0}};
+  analyzer->updateHighlight(tail_range, "return b;\n");
+
+  // 编辑前后分析的行与最终结果一致
+  Ptr<DocumentHighlight> highlight = reloaded->get_future().get();
+  REQUIRE(highlight != nullptr);
+  REQUIRE_FALSE(analyzer->hasDirtyLines());
+  Ptr<Document> expected_document = MAKE_PTR<Document>("Expected.java", code_txt);
+  expected_document->patch(head_range, "int a;\n");
+  expected_document->patch(tail_range, "return b;\n");
+  REQUIRE(isSameHighlight(highlight, engine->createAnalyzer(expected_document)->analyzeFully()));
+}
+
+TEST_CASE("Highlight batch Benchmark") {
+  String code_txt = FileUtil::readString(kViewJavaPath);
+  List<HighlightJob> jobs;
+  for (size_t i = 0; i < 32; ++i) {
+    jobs.push_back({"View" + std::to_string(i) + ".java", code_txt});
+  }
+  Ptr<HighlightEngine> single_engine = MAKE_PTR<HighlightEngine>();
+  single_engine->compileSyntaxFromFile(kSyntaxJavaPath);
+  single_engine->setBatchThreadCount(1);
+  Ptr<HighlightEngine> engine = MAKE_PTR<HighlightEngine>();
+  engine->compileSyntaxFromFile(kSyntaxJavaPath);
+  BENCHMARK("Highlight Batch 1 Thread") {
+    return single_engine->highlightBatch(jobs);
+  };
+  BENCHMARK("Highlight Batch All Threads") {
+    return engine->highlightBatch(jobs);
+  };
+}
+
 TEST_CASE("Highlight test.Java Benchmark") {
   Ptr<HighlightEngine> engine = MAKE_PTR<HighlightEngine>();
   engine->compileSyntaxFromFile(kSyntaxJavaPath);
@@ -60,3 +1119,22 @@ TEST_CASE("Highlight View.java Benchmark") {
     Ptr<DocumentHighlight> highlight = analyzer->analyzeFully();
   };
 }
+
+TEST_CASE("Highlight line cache Benchmark") {
+  Ptr<HighlightEngine> engine = MAKE_PTR<HighlightEngine>();
+  engine->compileSyntaxFromFile(kSyntaxJavaPath);
+  String code_txt = FileUtil::readString(kViewJavaPath);
+  Ptr<DocumentAnalyzer> analyzer = engine->createAnalyzer(MAKE_PTR<Document>("View.java", code_txt));
+  Ptr<DocumentAnalyzer> cached_analyzer = engine->createAnalyzer(MAKE_PTR<Document>("View.java", code_txt));
+  cached_analyzer->setLineCacheCapacity(64 * 1024 * 1024);
+  cached_analyzer->analyzeFully();
+  BENCHMARK("Highlight Reanalyze Uncached") {
+    return analyzer->analyzeFully();
+  };
+  BENCHMARK("Highlight Reanalyze Cached") {
+    return cached_analyzer->analyzeFully();
+  };
+  LineCacheStats stats = cached_analyzer->getLineCacheStats();
+  std::cout << "line cache hit rate: " << stats.hitRate() << ", entries: " << stats.entry_count
+    << ", memory: " << stats.memory_bytes << std::endl;
+}
@@ -0,0 +1,84 @@
+#include "catch2/catch_amalgamated.hpp"
+#include "html_renderer.h"
+#include "util.h"
+
+using namespace NS_FASTHIGHLIGHT;
+
+static const char* kSyntaxJavaPath = TESTS_DIR"/syntax/java.json";
+static const char* kViewJavaPath = TESTS_DIR"/syntax/View.java";
+
+TEST_CASE("Html render") {
+  const char* syntax_json = R"({
+    "name": "mini",
+    "fileExtensions": [".mini"],
+    "states": {
+      "default": [
+        {"pattern": "\\bif\\b", "style": "keyword.control"},
+        {"pattern": "\"[^\"]*\"", "style": "string"},
+        {"pattern": "/\\*", "style": "comment", "state": "comment"}
+      ],
+      "comment": [
+        {"pattern": "\\*/", "style": "comment", "state": "default"}
+      ]
+    }
+  })";
+  Ptr<HighlightEngine> engine = MAKE_PTR<HighlightEngine>();
+  engine->compileSyntaxFromJson(syntax_json);
+  Ptr<Document> document = MAKE_PTR<Document>("test.mini", "if a<b && \"汉字\" /* x\n</y> */ if");
+  Ptr<DocumentAnalyzer> analyzer = engine->loadDocument(document);
+
+  String html;
+  HtmlRenderer renderer([&html](const char* data, size_t size) { html.append(data, size); });
+  renderer.setClassName("string", "str");
+  REQUIRE(renderer.renderDocument(*analyzer));
+  REQUIRE(html == "<pre class=\"fh-code\"><code>"
+    "<span class=\"fh-keyword-control\">if</span> a&lt;b &amp;&amp; <span class=\"str\">&quot;汉字&quot;</span> "
+    "<span class=\"fh-comment\">/*</span> x\n"
+    "&lt;/y&gt; <span class=\"fh-comment\">*/</span> <span class=\"fh-keyword-control\">if</span>\n"
+    "</code></pre>\n");
+  REQUIRE(renderer.getBytesWritten() == html.length());
+}
+
+TEST_CASE("Html render chunks") {
+  Ptr<HighlightEngine> engine = MAKE_PTR<HighlightEngine>();
+  engine->compileSyntaxFromFile(kSyntaxJavaPath);
+  Ptr<Document> document = MAKE_PTR<Document>("View.java", FileUtil::readString(kViewJavaPath));
+  Ptr<DocumentAnalyzer> analyzer = engine->loadDocument(document);
+
+  // 边分析边渲染与先分析完再渲染的输出一致
+  String expected;
+  HtmlRenderer full_renderer([&expected](const char* data, size_t size) { expected.append(data, size); });
+  full_renderer.renderHighlight(*document, *analyzer->analyzeFully());
+
+  constexpr size_t kChunkSize = 4096;
+  String streamed;
+  size_t sink_calls = 0;
+  bool chunk_overflow = false;
+  HtmlRenderOptions options;
+  options.chunk_size = kChunkSize;
+  HtmlRenderer renderer([&](const char* data, size_t size) {
+    streamed.append(data, size);
+    chunk_overflow |= size > kChunkSize;
+    ++sink_calls;
+  }, options);
+  REQUIRE(renderer.renderDocument(*analyzer));
+  REQUIRE_FALSE(chunk_overflow);
+  REQUIRE(sink_calls == (streamed.length() + kChunkSize - 1) / kChunkSize);
+  REQUIRE(streamed == expected);
+
+  Ptr<CancellationToken> token = MAKE_PTR<CancellationToken>();
+  token->cancel();
+  REQUIRE_FALSE(renderer.renderDocument(*analyzer, token));
+}
+
+TEST_CASE("Html render Benchmark") {
+  Ptr<HighlightEngine> engine = MAKE_PTR<HighlightEngine>();
+  engine->compileSyntaxFromFile(kSyntaxJavaPath);
+  Ptr<Document> document = MAKE_PTR<Document>("View.java", FileUtil::readString(kViewJavaPath));
+  Ptr<DocumentAnalyzer> analyzer = engine->loadDocument(document);
+  size_t total_bytes = 0;
+  HtmlRenderer renderer([&total_bytes](const char*, size_t size) { total_bytes += size; });
+  BENCHMARK("Html Streaming Render") {
+    return renderer.renderDocument(*analyzer);
+  };
+}
@@ -0,0 +1,42 @@
+#ifndef FAST_HIGHLIGHT_TEST_JNI_H
+#define FAST_HIGHLIGHT_TEST_JNI_H
+
+#include <cstdint>
+
+/// 在主机上测试JNI绑定用的jni.h桩，只声明绑定中用到的类型和JNIEnv方法，
+/// JNIEnv的方法由jni_test.cpp实现，Java对象由测试用普通C++对象模拟
+
+#define JNIEXPORT
+#define JNICALL
+#define JNI_FALSE 0
+#define JNI_TRUE 1
+
+typedef uint8_t jboolean;
+typedef uint16_t jchar;
+typedef int32_t jint;
+typedef int64_t jlong;
+typedef jint jsize;
+
+class _jobject {
+public:
+  virtual ~_jobject() = default;
+};
+class _jclass : public _jobject {};
+class _jstring : public _jobject {};
+
+typedef _jobject* jobject;
+typedef _jclass* jclass;
+typedef _jstring* jstring;
+
+struct _JNIEnv {
+  jclass FindClass(const char* name);
+  jint ThrowNew(jclass clazz, const char* message);
+  jsize GetStringLength(jstring str);
+  void GetStringRegion(jstring str, jsize start, jsize len, jchar* buf);
+  jstring NewStringUTF(const char* bytes);
+  void* GetDirectBufferAddress(jobject buf);
+  jlong GetDirectBufferCapacity(jobject buf);
+};
+typedef _JNIEnv JNIEnv;
+
+#endif //FAST_HIGHLIGHT_TEST_JNI_H
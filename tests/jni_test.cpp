@@ -0,0 +1,226 @@
+#include <iterator>
+#include <jni.h>
+#include <utf8/utf8.h>
+#include "catch2/catch_amalgamated.hpp"
+#include "highlight.h"
+#include "util.h"
+#include "JniUtil.h"
+
+using namespace NS_FASTHIGHLIGHT;
+
+static const char* kSyntaxJavaPath = TESTS_DIR"/syntax/java.json";
+static const char* kViewJavaPath = TESTS_DIR"/syntax/View.java";
+
+// ===================================== JNI桩 ============================================
+struct StubString : public _jstring {
+  std::u16string value;
+};
+
+struct StubClass : public _jclass {
+  String name;
+};
+
+struct StubByteBuffer : public _jobject {
+  List<jint> storage;
+  /// 非direct缓冲区为nullptr
+  void* address {nullptr};
+  jlong capacity {0};
+};
+
+/// 测试创建的Java对象，测试结束前一直存活
+static List<UPtr<_jobject>> local_refs;
+static String pending_exception;
+
+jclass _JNIEnv::FindClass(const char* name) {
+  UPtr<StubClass> clazz = MAKE_UPTR<StubClass>();
+  clazz->name = name;
+  local_refs.push_back(std::move(clazz));
+  return static_cast<jclass>(local_refs.back().get());
+}
+
+jint _JNIEnv::ThrowNew(jclass clazz, const char* message) {
+  pending_exception = static_cast<StubClass*>(clazz)->name + ": " + message;
+  return 0;
+}
+
+jsize _JNIEnv::GetStringLength(jstring str) {
+  return static_cast<jsize>(static_cast<StubString*>(str)->value.size());
+}
+
+void _JNIEnv::GetStringRegion(jstring str, jsize start, jsize len, jchar* buf) {
+  const std::u16string& value = static_cast<StubString*>(str)->value;
+  std::copy(value.begin() + start, value.begin() + start + len, buf);
+}
+
+jstring _JNIEnv::NewStringUTF(const char* bytes) {
+  UPtr<StubString> str = MAKE_UPTR<StubString>();
+  String utf8_text = bytes;
+  utf8::utf8to16(utf8_text.begin(), utf8_text.end(), std::back_inserter(str->value));
+  local_refs.push_back(std::move(str));
+  return static_cast<jstring>(local_refs.back().get());
+}
+
+void* _JNIEnv::GetDirectBufferAddress(jobject buf) {
+  return static_cast<StubByteBuffer*>(buf)->address;
+}
+
+jlong _JNIEnv::GetDirectBufferCapacity(jobject buf) {
+  return static_cast<StubByteBuffer*>(buf)->capacity;
+}
+
+static jstring newJavaString(JNIEnv* env, const String& text) {
+  return env->NewStringUTF(text.c_str());
+}
+
+static StubByteBuffer* newDirectBuffer(size_t ints) {
+  UPtr<StubByteBuffer> buffer = MAKE_UPTR<StubByteBuffer>();
+  buffer->storage.resize(ints);
+  buffer->address = buffer->storage.data();
+  buffer->capacity = static_cast<jlong>(ints * sizeof(jint));
+  local_refs.push_back(std::move(buffer));
+  return static_cast<StubByteBuffer*>(local_refs.back().get());
+}
+
+extern "C" {
+  jlong Java_com_fasthighlight_HighlightEngine_nativeCreate(JNIEnv* env, jclass clazz);
+  void Java_com_fasthighlight_HighlightEngine_nativeRelease(JNIEnv* env, jclass clazz, jlong handle);
+  void Java_com_fasthighlight_HighlightEngine_nativeCompileSyntaxFromJson(JNIEnv* env, jclass clazz, jlong handle,
+    jstring json);
+  void Java_com_fasthighlight_HighlightEngine_nativeCompileSyntaxFromFile(JNIEnv* env, jclass clazz, jlong handle,
+    jstring path);
+  jlong Java_com_fasthighlight_HighlightEngine_nativeLoadDocument(JNIEnv* env, jclass clazz, jlong handle,
+    jlong document_handle);
+  jlong Java_com_fasthighlight_Document_nativeCreate(JNIEnv* env, jclass clazz, jstring uri, jstring text);
+  void Java_com_fasthighlight_Document_nativeRelease(JNIEnv* env, jclass clazz, jlong handle);
+  jint Java_com_fasthighlight_Document_nativeGetLineCount(JNIEnv* env, jclass clazz, jlong handle);
+  void Java_com_fasthighlight_DocumentAnalyzer_nativeRelease(JNIEnv* env, jclass clazz, jlong handle);
+  jboolean Java_com_fasthighlight_DocumentAnalyzer_nativeAnalyzeFully(JNIEnv* env, jclass clazz, jlong handle);
+  jboolean Java_com_fasthighlight_DocumentAnalyzer_nativeUpdateHighlight(JNIEnv* env, jclass clazz, jlong handle,
+    jint start_line, jint start_column, jint end_line, jint end_column, jstring new_text);
+  void Java_com_fasthighlight_DocumentAnalyzer_nativeSetViewport(JNIEnv* env, jclass clazz, jlong handle,
+    jint start_line, jint end_line);
+  jint Java_com_fasthighlight_DocumentAnalyzer_nativeGetSpans(JNIEnv* env, jclass clazz, jlong handle,
+    jint start_line, jint end_line, jobject buffer);
+  jstring Java_com_fasthighlight_DocumentAnalyzer_nativeGetStyleName(JNIEnv* env, jclass clazz, jlong handle,
+    jint style_id);
+}
+
+/// 检查打包结果是否与整个文本的高亮结果一致
+static bool isSamePacked(const List<jint>& packed, const DocumentHighlight& highlight) {
+  size_t index = 0;
+  bool same = true;
+  highlight.forEachLine([&](size_t line, const LineSpans& spans) {
+    same = same && index < packed.size() && packed[index++] == static_cast<jint>(spans.size());
+    for (const TokenSpan& span : spans) {
+      size_t start_column = span.range.start.line < line ? 0 : span.range.start.column;
+      same = same && index + 2 < packed.size() && packed[index] == static_cast<jint>(start_column)
+        && packed[index + 1] == static_cast<jint>(span.range.end.column - start_column)
+        && packed[index + 2] == span.style_id;
+      index += 3;
+    }
+  });
+  return same && index == packed.size();
+}
+
+// ===================================== 测试 ============================================
+TEST_CASE("JNI span transfer") {
+  JNIEnv env;
+  jlong engine = Java_com_fasthighlight_HighlightEngine_nativeCreate(&env, nullptr);
+  Java_com_fasthighlight_HighlightEngine_nativeCompileSyntaxFromFile(&env, nullptr, engine,
+    newJavaString(&env, kSyntaxJavaPath));
+  REQUIRE(pending_exception.empty());
+  Java_com_fasthighlight_HighlightEngine_nativeCompileSyntaxFromJson(&env, nullptr, engine, newJavaString(&env, "{"));
+  REQUIRE(StrUtil::startsWith(pending_exception, "java/lang/IllegalArgumentException"));
+  pending_exception.clear();
+
+  // 四字节字符经过UTF-16传入后仍是正确的UTF-8
+  String code_txt = "String face = \"\xF0\x9F\x98\x80\";\n" + FileUtil::readString(kViewJavaPath);
+  jlong document = Java_com_fasthighlight_Document_nativeCreate(&env, nullptr, newJavaString(&env, "View.java"),
+    newJavaString(&env, code_txt));
+  REQUIRE(getNativePtrHolderValue<Document>(document)->getText() == code_txt);
+  const jint line_count = Java_com_fasthighlight_Document_nativeGetLineCount(&env, nullptr, document);
+  jlong analyzer = Java_com_fasthighlight_HighlightEngine_nativeLoadDocument(&env, nullptr, engine, document);
+  REQUIRE(analyzer != 0);
+  StubByteBuffer* buffer = newDirectBuffer(16);
+  REQUIRE(Java_com_fasthighlight_DocumentAnalyzer_nativeGetSpans(&env, nullptr, analyzer, 0, 60, buffer) == 0);
+  REQUIRE(Java_com_fasthighlight_DocumentAnalyzer_nativeAnalyzeFully(&env, nullptr, analyzer) == JNI_TRUE);
+
+  // 缓冲区不足时返回所需的int数量，不写入
+  jint required = Java_com_fasthighlight_DocumentAnalyzer_nativeGetSpans(&env, nullptr, analyzer, 0, line_count, buffer);
+  REQUIRE(required < 0);
+  buffer = newDirectBuffer(static_cast<size_t>(-required));
+  REQUIRE(Java_com_fasthighlight_DocumentAnalyzer_nativeGetSpans(&env, nullptr, analyzer, 0, line_count, buffer)
+    == -required);
+
+  // 打包结果与分析结果一致
+  Ptr<DocumentAnalyzer> native_analyzer = getNativePtrHolderValue<DocumentAnalyzer>(analyzer);
+  REQUIRE(isSamePacked(buffer->storage, *native_analyzer->analyzeFully()));
+  // 列号按Unicode字符计数，字符串从第14列开始，包括引号共3个字符
+  jint string_style = -1;
+  for (jint i = 0; i < buffer->storage[0]; ++i) {
+    if (buffer->storage[1 + i * 3] == 14) {
+      REQUIRE(buffer->storage[2 + i * 3] == 3);
+      string_style = buffer->storage[3 + i * 3];
+    }
+  }
+  jstring style_name = Java_com_fasthighlight_DocumentAnalyzer_nativeGetStyleName(&env, nullptr, analyzer, string_style);
+  REQUIRE(static_cast<StubString*>(style_name)->value == u"string");
+
+  // 增量更新后读到新的结果，非direct缓冲区抛出异常
+  REQUIRE(Java_com_fasthighlight_DocumentAnalyzer_nativeUpdateHighlight(&env, nullptr, analyzer, 0, 0, 0, 0,
+    newJavaString(&env, "int value = 1;\n")) == JNI_TRUE);
+  required = Java_com_fasthighlight_DocumentAnalyzer_nativeGetSpans(&env, nullptr, analyzer, 0, line_count + 1, buffer);
+  REQUIRE(required < 0);
+  buffer = newDirectBuffer(static_cast<size_t>(-required));
+  REQUIRE(Java_com_fasthighlight_DocumentAnalyzer_nativeGetSpans(&env, nullptr, analyzer, 0, line_count + 1, buffer)
+    == -required);
+  REQUIRE(isSamePacked(buffer->storage, *native_analyzer->analyzeFully()));
+  StubByteBuffer heap_buffer;
+  Java_com_fasthighlight_DocumentAnalyzer_nativeGetSpans(&env, nullptr, analyzer, 0, 1, &heap_buffer);
+  REQUIRE(!pending_exception.empty());
+  pending_exception.clear();
+
+  // 负数或起点在终点之后的范围抛出IllegalArgumentException，不修改文本
+  const String text_before = getNativePtrHolderValue<Document>(document)->getText();
+  REQUIRE(Java_com_fasthighlight_DocumentAnalyzer_nativeUpdateHighlight(&env, nullptr, analyzer, -1, 0, 0, 0,
+    newJavaString(&env, "x")) == JNI_FALSE);
+  REQUIRE(StrUtil::startsWith(pending_exception, "java/lang/IllegalArgumentException"));
+  pending_exception.clear();
+  REQUIRE(Java_com_fasthighlight_DocumentAnalyzer_nativeUpdateHighlight(&env, nullptr, analyzer, 1, 2, 1, 1,
+    newJavaString(&env, "x")) == JNI_FALSE);
+  REQUIRE(StrUtil::startsWith(pending_exception, "java/lang/IllegalArgumentException"));
+  pending_exception.clear();
+  REQUIRE(getNativePtrHolderValue<Document>(document)->getText() == text_before);
+  Java_com_fasthighlight_DocumentAnalyzer_nativeSetViewport(&env, nullptr, analyzer, 10, 5);
+  REQUIRE(StrUtil::startsWith(pending_exception, "java/lang/IllegalArgumentException"));
+  pending_exception.clear();
+  Java_com_fasthighlight_DocumentAnalyzer_nativeSetViewport(&env, nullptr, analyzer, 0, 60);
+  REQUIRE(pending_exception.empty());
+
+  Java_com_fasthighlight_DocumentAnalyzer_nativeRelease(&env, nullptr, analyzer);
+  Java_com_fasthighlight_Document_nativeRelease(&env, nullptr, document);
+  Java_com_fasthighlight_HighlightEngine_nativeRelease(&env, nullptr, engine);
+  local_refs.clear();
+}
+
+TEST_CASE("JNI span transfer Benchmark") {
+  JNIEnv env;
+  jlong engine = Java_com_fasthighlight_HighlightEngine_nativeCreate(&env, nullptr);
+  Java_com_fasthighlight_HighlightEngine_nativeCompileSyntaxFromFile(&env, nullptr, engine,
+    newJavaString(&env, kSyntaxJavaPath));
+  jlong document = Java_com_fasthighlight_Document_nativeCreate(&env, nullptr, newJavaString(&env, "View.java"),
+    newJavaString(&env, FileUtil::readString(kViewJavaPath)));
+  jlong analyzer = Java_com_fasthighlight_HighlightEngine_nativeLoadDocument(&env, nullptr, engine, document);
+  Java_com_fasthighlight_DocumentAnalyzer_nativeAnalyzeFully(&env, nullptr, analyzer);
+  StubByteBuffer* buffer = newDirectBuffer(64 * 1024);
+
+  // 一帧约60行
+  BENCHMARK("JNI Get Viewport Spans") {
+    return Java_com_fasthighlight_DocumentAnalyzer_nativeGetSpans(&env, nullptr, analyzer, 1000, 1060, buffer);
+  };
+
+  Java_com_fasthighlight_DocumentAnalyzer_nativeRelease(&env, nullptr, analyzer);
+  Java_com_fasthighlight_Document_nativeRelease(&env, nullptr, document);
+  Java_com_fasthighlight_HighlightEngine_nativeRelease(&env, nullptr, engine);
+  local_refs.clear();
+}
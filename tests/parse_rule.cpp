@@ -1,3 +1,4 @@
+#include <bitset>
 #include <iostream>
 #include "catch2/catch_amalgamated.hpp"
 #include "highlight.h"
@@ -21,3 +22,44 @@ TEST_CASE("Parse Rule Benchmark") {
     manager->compileSyntaxFromJson(text);
   };
 }
+
+TEST_CASE("Pattern First Byte Set") {
+  std::bitset<256> first_bytes;
+  REQUIRE(PatternUtil::computeFirstByteSet("//.*", first_bytes));
+  REQUIRE(first_bytes.count() == 1);
+  REQUIRE(first_bytes.test('/'));
+
+  first_bytes.reset();
+  REQUIRE(PatternUtil::computeFirstByteSet("\\*/", first_bytes));
+  REQUIRE(first_bytes.count() == 1);
+  REQUIRE(first_bytes.test('*'));
+
+  first_bytes.reset();
+  REQUIRE(PatternUtil::computeFirstByteSet("\\b(?:#include|<!--)|\"(?:[^\"\\\\]|\\\\.)*\"", first_bytes));
+  REQUIRE(first_bytes.count() == 3);
+  REQUIRE(first_bytes.test('#'));
+  REQUIRE(first_bytes.test('<'));
+  REQUIRE(first_bytes.test('"'));
+
+  first_bytes.reset();
+  REQUIRE(PatternUtil::computeFirstByteSet("x?[0-9a-f]+", first_bytes));
+  REQUIRE(first_bytes.count() == 17);
+
+  // 可能匹配空串或包含不支持的语法时无法确定
+  first_bytes.reset();
+  REQUIRE_FALSE(PatternUtil::computeFirstByteSet("a*", first_bytes));
+  REQUIRE_FALSE(PatternUtil::computeFirstByteSet("(?i)select", first_bytes));
+
+  // 区间量词的下限为0时可能匹配空串，超长的计数不会导致异常
+  first_bytes.reset();
+  REQUIRE_FALSE(PatternUtil::computeFirstByteSet("a{00,3}", first_bytes));
+  REQUIRE(PatternUtil::computeFirstByteSet("a{2,}", first_bytes));
+  REQUIRE(first_bytes.test('a'));
+  first_bytes.reset();
+  REQUIRE_NOTHROW(PatternUtil::computeFirstByteSet("a{99999999999999999999999}", first_bytes));
+  REQUIRE_FALSE(PatternUtil::computeFirstByteSet("a{000000000000000000000000,5}", first_bytes));
+
+  // 取反的字符类可以匹配任意首字节
+  REQUIRE(PatternUtil::computeFirstByteSet("[^\"]+", first_bytes));
+  REQUIRE(first_bytes.all());
+}
@@ -11,6 +11,7 @@ const char* text = R"(
 
 TEST_CASE("Patch Text") {
   Document document("test.txt", text);
+  REQUIRE(document.getRevision() == 0);
 
   std::cout << "原始文本:" << std::endl;
   std::cout << document.getText() << std::endl << std::endl;
@@ -38,6 +39,7 @@ TEST_CASE("Patch Text") {
   document.remove(range);
   std::cout << "删除后:" << std::endl;
   std::cout << document.getText() << std::endl;
+  REQUIRE(document.getRevision() == 4);
 }
 
 TEST_CASE("Patch Benchmark") {
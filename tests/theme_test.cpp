@@ -0,0 +1,137 @@
+#include "catch2/catch_amalgamated.hpp"
+#include "theme.h"
+#include "util.h"
+
+using namespace NS_FASTHIGHLIGHT;
+
+static const char* kSyntaxJavaPath = TESTS_DIR"/syntax/java.json";
+static const char* kViewJavaPath = TESTS_DIR"/syntax/View.java";
+
+static const char* kThemeJson = R"({
+  "name": "dark",
+  "default": {"foreground": "#D4D4D4", "background": "#1E1E1E"},
+  "styles": {
+    "keyword": {"foreground": "#569CD6", "fontStyle": "bold"},
+    "keyword.control": {"foreground": "#80C586C0"},
+    "comment": {"foreground": "#6A9955", "fontStyle": "italic underline"},
+    "string": {"foreground": "#CE9178"},
+    "method": {"foreground": "#DCDCAA"}
+  }
+})";
+
+TEST_CASE("Theme resolve") {
+  Ptr<Theme> theme = Theme::parseFromJson(kThemeJson);
+  REQUIRE(theme->getName() == "dark");
+  ThemeStyle text = theme->resolve("identifier");
+  REQUIRE(text.foreground == 0xFFD4D4D4);
+  REQUIRE(text.background == 0xFF1E1E1E);
+  REQUIRE(text.font_style == kFontStyleNone);
+  // 下级style覆盖上级设置的字段，其余字段继承上级
+  ThemeStyle control = theme->resolve("keyword.control.flow");
+  REQUIRE(control.foreground == 0x80C586C0);
+  REQUIRE(control.font_style == kFontStyleBold);
+  REQUIRE(theme->resolve("comment").font_style == (kFontStyleItalic | kFontStyleUnderline));
+  REQUIRE(theme->resolve("keywords").foreground == 0xFFD4D4D4);
+
+  REQUIRE_THROWS_AS(Theme::parseFromJson(R"({"styles": {"keyword": {"foreground": "blue"}}})"), SyntaxRuleParseError);
+  REQUIRE_THROWS_AS(Theme::parseFromJson(R"({"styles": {"keyword": {"fontStyle": "heavy"}}})"), SyntaxRuleParseError);
+  REQUIRE_THROWS_AS(Theme::parseFromJson("{"), SyntaxRuleParseError);
+}
+
+TEST_CASE("Theme color runs") {
+  Ptr<HighlightEngine> engine = MAKE_PTR<HighlightEngine>();
+  engine->compileSyntaxFromFile(kSyntaxJavaPath);
+  Ptr<Document> document = MAKE_PTR<Document>("View.java", FileUtil::readString(kViewJavaPath));
+  Ptr<DocumentAnalyzer> analyzer = engine->createAnalyzer(document);
+  Ptr<DocumentHighlight> highlight = analyzer->analyzeFully();
+  Ptr<Theme> theme = Theme::parseFromJson(kThemeJson);
+  Ptr<const SyntaxRule> rule = analyzer->getSyntaxRule();
+  Ptr<const CompiledTheme> compiled = theme->compile(*rule);
+  REQUIRE(compiled->getStyleCount() == rule->getStyleCount());
+  REQUIRE(rule->getStyleName(SyntaxRule::kNoStyleId).empty());
+  REQUIRE(compiled->getStyle(rule->getStyleId("keyword")).foreground == 0xFF569CD6);
+  REQUIRE(compiled->getStyle(rule->getStyleId("method")).foreground == 0xFFDCDCAA);
+  REQUIRE(compiled->getStyle(-1).foreground == 0xFFD4D4D4);
+
+  // 按编号取到的样式与按名称解析的一致，颜色区间连续覆盖所有高亮块
+  bool same_style = true;
+  bool contiguous = true;
+  size_t run_count = 0;
+  size_t span_count = 0;
+  List<ColorRun> runs;
+  highlight->forEachLine([&](size_t, const LineSpans& spans) {
+    for (const TokenSpan& span : spans) {
+      same_style = same_style && rule->getStyleName(span.style_id) == span.style
+        && compiled->getStyle(span.style_id).foreground == theme->resolve(span.style).foreground;
+    }
+    compiled->buildColorRuns(spans, runs);
+    for (size_t i = 1; i < runs.size(); ++i) {
+      contiguous = contiguous && runs[i].start_column == runs[i - 1].end_column
+        && (runs[i].foreground != runs[i - 1].foreground || runs[i].font_style != runs[i - 1].font_style);
+    }
+    if (!spans.empty()) {
+      contiguous = contiguous && !runs.empty() && runs.back().end_column == spans.back().range.end.column;
+    }
+    run_count += runs.size();
+    span_count += spans.size();
+  });
+  REQUIRE(same_style);
+  REQUIRE(contiguous);
+  REQUIRE(run_count < span_count);
+
+  List<TokenSpan> spans(2);
+  spans[0].range = {{0, 2}, {0, 4}};
+  spans[0].style_id = rule->getStyleId("string");
+  spans[1].range = {{0, 6}, {0, 8}};
+  spans[1].style_id = rule->getStyleId("string");
+  compiled->buildColorRuns({spans.data(), spans.size()}, runs);
+  REQUIRE(runs.size() == 4);
+  REQUIRE(runs[0].start_column == 0);
+  REQUIRE(runs[0].foreground == 0xFFD4D4D4);
+  REQUIRE(runs[1].foreground == 0xFFCE9178);
+  REQUIRE(runs[2].start_column == 4);
+  REQUIRE(runs[2].end_column == 6);
+  REQUIRE(runs[3].end_column == 8);
+}
+
+TEST_CASE("Theme Benchmark") {
+  Ptr<HighlightEngine> engine = MAKE_PTR<HighlightEngine>();
+  engine->compileSyntaxFromFile(kSyntaxJavaPath);
+  Ptr<Document> document = MAKE_PTR<Document>("View.java", FileUtil::readString(kViewJavaPath));
+  Ptr<DocumentAnalyzer> analyzer = engine->createAnalyzer(document);
+  Ptr<DocumentHighlight> highlight = analyzer->analyzeFully();
+  Ptr<Theme> theme = Theme::parseFromJson(kThemeJson);
+  Ptr<const CompiledTheme> compiled = theme->compile(*analyzer->getSyntaxRule());
+  HashMap<String, ThemeStyle> style_map;
+  for (const char* style : {"", "keyword", "comment", "string", "method", "identifier", "punctuation", "text"}) {
+    style_map.emplace(style, theme->resolve(style));
+  }
+
+  BENCHMARK("Theme Hash Lookup") {
+    uint32_t checksum = 0;
+    highlight->forEachLine([&](size_t, const LineSpans& spans) {
+      for (const TokenSpan& span : spans) {
+        checksum += style_map[span.style].foreground;
+      }
+    });
+    return checksum;
+  };
+  BENCHMARK("Theme Compiled Lookup") {
+    uint32_t checksum = 0;
+    highlight->forEachLine([&](size_t, const LineSpans& spans) {
+      for (const TokenSpan& span : spans) {
+        checksum += compiled->getStyle(span.style_id).foreground;
+      }
+    });
+    return checksum;
+  };
+  List<ColorRun> runs;
+  BENCHMARK("Theme Color Runs") {
+    size_t run_count = 0;
+    highlight->forEachLine([&](size_t, const LineSpans& spans) {
+      compiled->buildColorRuns(spans, runs);
+      run_count += runs.size();
+    });
+    return run_count;
+  };
+}
@@ -0,0 +1,145 @@
+#include <iostream>
+#include "catch2/catch_amalgamated.hpp"
+#include "token_stream.h"
+#include "util.h"
+
+using namespace NS_FASTHIGHLIGHT;
+
+static const char* kSyntaxJavaPath = TESTS_DIR"/syntax/java.json";
+static const char* kViewJavaPath = TESTS_DIR"/syntax/View.java";
+
+/// 与FH_DEBUG下DocumentHighlight::dump相同的JSON输出
+static String toJson(const DocumentHighlight& highlight) {
+  nlohmann::json json = nlohmann::json::array();
+  highlight.forEachLine([&json](size_t, const LineSpans& spans) {
+    nlohmann::json line_obj;
+    line_obj["spans"] = List<TokenSpan>(spans.begin(), spans.end());
+    json.push_back(line_obj);
+  });
+  return json.dump();
+}
+
+TEST_CASE("Token stream round trip") {
+  Ptr<HighlightEngine> engine = MAKE_PTR<HighlightEngine>();
+  engine->compileSyntaxFromFile(kSyntaxJavaPath);
+  Ptr<Document> document = MAKE_PTR<Document>("View.java", FileUtil::readString(kViewJavaPath));
+  Ptr<DocumentHighlight> highlight = engine->createAnalyzer(document)->analyzeFully();
+
+  String encoded;
+  TokenStreamEncoder encoder(encoded);
+  encoder.encodeHighlight(*highlight);
+  // 边分析边编码与先分析完再编码的结果一致
+  String streamed;
+  TokenStreamEncoder stream_encoder(streamed);
+  REQUIRE(stream_encoder.encodeDocument(*engine->createAnalyzer(document)));
+  REQUIRE(streamed == encoded);
+
+  List<String> styles;
+  size_t line_count = 0;
+  bool same = true;
+  TokenStreamDecoder decoder(encoded.data(), encoded.length());
+  while (decoder.nextLine()) {
+    REQUIRE(decoder.getLine() == line_count);
+    StreamStyle style;
+    while (decoder.nextStyle(style)) {
+      REQUIRE(style.id == styles.size());
+      styles.emplace_back(style.name, style.length);
+    }
+    LineSpans expected = highlight->getLineSpans(line_count);
+    REQUIRE(decoder.getSpanCount() == expected.size());
+    StreamSpan span;
+    size_t span_idx = 0;
+    while (decoder.nextSpan(span)) {
+      const TokenSpan& expected_span = expected[span_idx++];
+      same = same && span.start_line == expected_span.range.start.line
+        && span.start_column == expected_span.range.start.column
+        && span.end_column == expected_span.range.end.column
+        && styles[span.style_id] == expected_span.style;
+    }
+    REQUIRE(span_idx == expected.size());
+    ++line_count;
+  }
+  REQUIRE_FALSE(decoder.hasError());
+  REQUIRE(same);
+  REQUIRE(line_count == highlight->getLineCount());
+
+  REQUIRE(encoded.length() * 10 < toJson(*highlight).length());
+}
+
+TEST_CASE("Token stream partial lines") {
+  List<TokenSpan> spans(2);
+  spans[0].range = {{3, 4}, {5, 2}};
+  spans[0].style = "comment";
+  spans[1].range = {{5, 3}, {5, 300}};
+  spans[1].style = "string";
+
+  // 只发送部分行，行号增量和跨行高亮块都能还原
+  String encoded;
+  TokenStreamEncoder encoder(encoded);
+  encoder.begin();
+  encoder.encodeLine(5, {spans.data(), 2});
+  encoder.encodeLine(200, {spans.data() + 1, 1});
+  TokenStreamDecoder decoder(encoded.data(), encoded.length());
+  REQUIRE(decoder.nextLine());
+  REQUIRE(decoder.getLine() == 5);
+  // 不读style直接读高亮块
+  StreamSpan span;
+  REQUIRE(decoder.nextSpan(span));
+  REQUIRE(span.start_line == 3);
+  REQUIRE(span.start_column == 4);
+  REQUIRE(span.end_column == 2);
+  REQUIRE(span.style_id == 0);
+  REQUIRE(decoder.nextLine());
+  REQUIRE(decoder.getLine() == 200);
+  REQUIRE(decoder.nextSpan(span));
+  REQUIRE(span.start_line == 5);
+  REQUIRE(span.start_column == 3);
+  REQUIRE(span.end_column == 300);
+  REQUIRE(span.style_id == 1);
+  REQUIRE_FALSE(decoder.nextSpan(span));
+  REQUIRE_FALSE(decoder.nextLine());
+  REQUIRE_FALSE(decoder.hasError());
+
+  // 截断的数据和错误的文件头
+  TokenStreamDecoder truncated(encoded.data(), encoded.length() - 1);
+  REQUIRE(truncated.nextLine());
+  REQUIRE_FALSE(truncated.nextLine());
+  REQUIRE(truncated.hasError());
+  TokenStreamDecoder bad_header("FHT1", 4);
+  REQUIRE_FALSE(bad_header.nextLine());
+  REQUIRE(bad_header.hasError());
+}
+
+TEST_CASE("Token stream Benchmark") {
+  Ptr<HighlightEngine> engine = MAKE_PTR<HighlightEngine>();
+  engine->compileSyntaxFromFile(kSyntaxJavaPath);
+  Ptr<Document> document = MAKE_PTR<Document>("View.java", FileUtil::readString(kViewJavaPath));
+  Ptr<DocumentHighlight> highlight = engine->createAnalyzer(document)->analyzeFully();
+  String encoded;
+  TokenStreamEncoder(encoded).encodeHighlight(*highlight);
+  String json = toJson(*highlight);
+  std::cout << "token stream: " << encoded.length() << " bytes, json: " << json.length() << " bytes" << std::endl;
+
+  BENCHMARK("Token Stream Encode") {
+    String output;
+    TokenStreamEncoder(output).encodeHighlight(*highlight);
+    return output.length();
+  };
+  BENCHMARK("Token Stream Decode") {
+    size_t span_count = 0;
+    TokenStreamDecoder decoder(encoded.data(), encoded.length());
+    StreamSpan span;
+    while (decoder.nextLine()) {
+      while (decoder.nextSpan(span)) {
+        ++span_count;
+      }
+    }
+    return span_count;
+  };
+  BENCHMARK("Json Encode") {
+    return toJson(*highlight).length();
+  };
+  BENCHMARK("Json Decode") {
+    return nlohmann::json::parse(json).size();
+  };
+}
@@ -0,0 +1,90 @@
+#include "catch2/catch_amalgamated.hpp"
+#include "util.h"
+#include "wasm_highlight.h"
+
+using namespace NS_FASTHIGHLIGHT;
+
+static const char* kSyntaxJavaPath = TESTS_DIR"/syntax/java.json";
+static const char* kViewJavaPath = TESTS_DIR"/syntax/View.java";
+
+/// 按打包格式逐行展开，与highlight的结果对比
+static bool isSamePacked(const int32_t* packed, size_t size, const DocumentHighlight& highlight, size_t start_line) {
+  size_t index = 0;
+  for (size_t line = start_line; index < size; ++line) {
+    LineSpans spans = highlight.getLineSpans(line);
+    if (packed[index++] != static_cast<int32_t>(spans.size())) {
+      return false;
+    }
+    for (const TokenSpan& span : spans) {
+      size_t start_column = span.range.start.line < line ? 0 : span.range.start.column;
+      if (index + SpanPacker::kIntsPerSpan > size || packed[index] != static_cast<int32_t>(start_column)
+        || packed[index + 1] != static_cast<int32_t>(span.range.end.column - start_column)
+        || packed[index + 2] != span.style_id) {
+        return false;
+      }
+      index += SpanPacker::kIntsPerSpan;
+    }
+  }
+  return index == size;
+}
+
+TEST_CASE("Span packer") {
+  DocumentHighlight highlight;
+  highlight.resize(3);
+  TokenSpan keyword;
+  keyword.range = {{0, 0}, {0, 6}};
+  keyword.style_id = 2;
+  TokenSpan comment;
+  comment.range = {{0, 7}, {1, 4}};
+  comment.style_id = 5;
+  highlight.setLineSpans(0, {&keyword, 1});
+  highlight.setLineSpans(1, {&comment, 1});
+
+  SpanPacker packer;
+  packer.pack(highlight, 0, 10);
+  // 跨行高亮块在第1行从第0列开始，空行只有数量
+  const List<int32_t> expected {1, 0, 6, 2, 1, 0, 4, 5, 0};
+  REQUIRE(List<int32_t>(packer.data(), packer.data() + packer.size()) == expected);
+  packer.pack(highlight, 1, 2);
+  REQUIRE(List<int32_t>(packer.data(), packer.data() + packer.size()) == List<int32_t> {1, 0, 4, 5});
+  packer.pack(highlight, 5, 10);
+  REQUIRE(packer.size() == 0);
+}
+
+TEST_CASE("Wasm bindings") {
+  WasmHighlightEngine engine;
+  REQUIRE(engine.compileSyntaxFromJson(FileUtil::readString(kSyntaxJavaPath)).empty());
+  REQUIRE(StrUtil::startsWith(engine.compileSyntaxFromJson("{}"), "Miss property"));
+  REQUIRE(engine.loadDocument(WasmDocument("notes.txt", "text")) == nullptr);
+
+  WasmDocument document("View.java", FileUtil::readString(kViewJavaPath));
+  Ptr<WasmDocumentAnalyzer> analyzer = engine.loadDocument(document);
+  REQUIRE(analyzer != nullptr);
+  REQUIRE(analyzer->packSpans(0, 60) == 0);
+  REQUIRE(analyzer->analyzeFully());
+
+  Ptr<const SyntaxRule> rule = MAKE_PTR<SyntaxRuleManager>()->compileSyntaxFromFile(kSyntaxJavaPath);
+  DocumentAnalyzer native_analyzer(MAKE_PTR<Document>("View.java", document.getText()), rule);
+  uint32_t size = analyzer->packSpans(100, 160);
+  REQUIRE(size > 60);
+  REQUIRE(size == analyzer->getPackedSize());
+  REQUIRE(isSamePacked(analyzer->getPackedData(), size, *native_analyzer.analyzeFully(), 100));
+
+  // 增量更新后打包新的结果
+  REQUIRE(analyzer->updateHighlight(0, 0, 0, 0, "String s = \"\xF0\x9F\x98\x80\";\n"));
+  REQUIRE(!analyzer->updateHighlight(1, 0, 0, 0, ""));
+  DocumentAnalyzer updated_analyzer(MAKE_PTR<Document>("View.java", document.getText()), rule);
+  size = analyzer->packSpans(0, document.getLineCount());
+  REQUIRE(isSamePacked(analyzer->getPackedData(), size, *updated_analyzer.analyzeFully(), 0));
+  // 列号按Unicode字符计数，字符串从第11列开始，包括引号共3个字符
+  const int32_t* packed = analyzer->getPackedData();
+  bool found_string = false;
+  for (int32_t i = 0; i < packed[0]; ++i) {
+    if (packed[1 + i * 3] == 11) {
+      found_string = packed[2 + i * 3] == 3 && analyzer->getStyleName(packed[3 + i * 3]) == "string";
+    }
+  }
+  REQUIRE(found_string);
+  REQUIRE(analyzer->getStyleName(-1).empty());
+  REQUIRE(engine.closeDocument("View.java"));
+}
@@ -0,0 +1,263 @@
+#include <algorithm>
+#include "corpus_generator.h"
+
+namespace NS_FASTHIGHLIGHT {
+  /// SplitMix64随机数，标准库的分布在不同平台上的结果不一致，不能用于生成确定性的语料
+  class CorpusRandom {
+  public:
+    explicit CorpusRandom(uint64_t seed): state_(seed) {
+    }
+
+    uint64_t next() {
+      uint64_t z = (state_ += 0x9E3779B97F4A7C15ULL);
+      z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+      z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+      return z ^ (z >> 31);
+    }
+
+    /// [0, bound)内的整数
+    size_t nextInt(size_t bound) {
+      return static_cast<size_t>(next() % bound);
+    }
+
+    /// [min, max]内的整数
+    size_t nextRange(size_t min, size_t max) {
+      return min + nextInt(max - min + 1);
+    }
+
+    const char* pick(const List<const char*>& words) {
+      return words[nextInt(words.size())];
+    }
+  private:
+    uint64_t state_;
+  };
+
+  /// 一组语句使用的词汇
+  struct Vocabulary {
+    List<const char*> names;
+    List<const char*> words;
+  };
+
+  static const Vocabulary kAsciiVocabulary {
+    {"value", "count", "index", "buffer", "result", "listener", "context", "builder", "handler", "offset",
+      "length", "cache", "parent", "child", "width", "height", "state", "token"},
+    {"the", "view", "is", "measured", "before", "layout", "and", "drawn", "after", "scroll", "changes", "text",
+      "cursor", "selection", "line", "span"},
+  };
+
+  static const Vocabulary kCjkVocabulary {
+    {"名称", "数量", "索引", "缓冲区", "结果", "监听器", "上下文", "构建器", "处理器", "偏移量", "长度", "缓存",
+      "用户", "订单", "价格", "宽度"},
+    {"视图", "在布局", "之前", "测量", "绘制", "滚动", "文本", "光标", "选区", "行号", "高亮", "样式", "你好", "世界",
+      "数据", "完成"},
+  };
+
+  static const List<const char*> kTypes {"int", "long", "boolean", "double", "String", "List<String>",
+    "Map<String, Integer>", "View"};
+
+  static void appendWords(CorpusRandom& random, const Vocabulary& vocabulary, size_t count, String& out) {
+    for (size_t i = 0; i < count; ++i) {
+      if (i > 0) {
+        out += ' ';
+      }
+      out += random.pick(vocabulary.words);
+    }
+  }
+
+  /// 追加一条语句，compact为true时省略所有可选的空白
+  static void appendStatement(CorpusRandom& random, const Vocabulary& vocabulary, bool compact, String& out) {
+    const char* sp = compact ? "" : " ";
+    const String a = random.pick(vocabulary.names);
+    const String b = random.pick(vocabulary.names);
+    const String number = std::to_string(random.nextInt(1000));
+    switch (random.nextInt(7)) {
+    case 0:
+      out += String("int ") + a + sp + "=" + sp + b + sp + "*" + sp + "31" + sp + "+" + sp + number + ";";
+      break;
+    case 1:
+      out += a + ".append(\"";
+      appendWords(random, vocabulary, random.nextRange(2, 6), out);
+      out += "\");";
+      break;
+    case 2:
+      out += String("if") + sp + "(" + a + sp + ">" + sp + number + ")" + sp + "{" + sp + b + sp + "=" + sp + a
+        + sp + "-" + sp + "1;" + sp + "}";
+      break;
+    case 3:
+      out += String("for") + sp + "(int i" + sp + "=" + sp + "0;" + sp + "i" + sp + "<" + sp + a + ";" + sp + "i++)"
+        + sp + "{" + sp + b + "[i]" + sp + "=" + sp + "i" + sp + "^" + sp + "0x7f;" + sp + "}";
+      break;
+    case 4:
+      out += String("return ") + a + sp + "==" + sp + "null" + sp + "?" + sp + b + sp + ":" + sp + a + ".get(" + number
+        + ");";
+      break;
+    case 5:
+      out += String("this.") + a + sp + "=" + sp + "new " + random.pick(kTypes) + "(" + b + "," + sp + number + ");";
+      break;
+    default:
+      // 压缩后的文本没有行注释
+      if (compact) {
+        out += a + "++;";
+      } else {
+        out += "// ";
+        appendWords(random, vocabulary, random.nextRange(3, 10), out);
+      }
+      break;
+    }
+  }
+
+  /// 追加一个带文档注释的方法
+  static void appendMethod(CorpusRandom& random, const Vocabulary& vocabulary, size_t id, String& out) {
+    out += "  /**\n   * ";
+    appendWords(random, vocabulary, random.nextRange(4, 12), out);
+    out += "\n   */\n  public static ";
+    out += random.pick(kTypes);
+    out += ' ';
+    out += random.pick(vocabulary.names);
+    out += std::to_string(id);
+    out += "(int ";
+    out += random.pick(vocabulary.names);
+    out += ", String ";
+    out += random.pick(vocabulary.names);
+    out += ") {\n";
+    const size_t statement_count = random.nextRange(3, 12);
+    for (size_t i = 0; i < statement_count; ++i) {
+      out += "    ";
+      appendStatement(random, vocabulary, false, out);
+      out += '\n';
+    }
+    out += "  }\n\n";
+  }
+
+  static void appendSourceFragment(CorpusRandom& random, const Vocabulary& vocabulary, size_t id, String& out) {
+    // 每50个方法开始一个新的类
+    if (id % 50 == 0) {
+      if (id > 0) {
+        out += "}\n\n";
+      }
+      out += "public class ";
+      out += random.pick(vocabulary.names);
+      out += std::to_string(id);
+      out += " extends View implements Runnable {\n";
+    }
+    appendMethod(random, vocabulary, id, out);
+  }
+
+  static void appendLongLine(CorpusRandom& random, size_t id, String& out) {
+    const size_t line_bytes = random.nextRange(2 * 1024, 32 * 1024);
+    const size_t start = out.size();
+    if (id % 2 == 0) {
+      out += "  static final int[] table";
+      out += std::to_string(id);
+      out += " = {";
+      while (out.size() - start < line_bytes) {
+        out += std::to_string(random.nextInt(100000));
+        out += ", ";
+      }
+      out += "0};\n";
+    } else {
+      out += "  String message";
+      out += std::to_string(id);
+      out += " = \"";
+      while (out.size() - start < line_bytes) {
+        appendWords(random, kAsciiVocabulary, 4, out);
+        out += "\" + ";
+        out += random.pick(kAsciiVocabulary.names);
+        out += " + \"";
+      }
+      out += "\";\n";
+    }
+  }
+
+  static void appendNestedComment(CorpusRandom& random, size_t id, String& out) {
+    // 注释内的"/*"和"//"只是普通文本，注释的每一行都从注释state开始分析
+    const size_t depth = random.nextRange(4, 32);
+    out += "/* ";
+    appendWords(random, kAsciiVocabulary, random.nextRange(3, 10), out);
+    out += '\n';
+    for (size_t level = 0; level < depth; ++level) {
+      const size_t indent = std::min<size_t>(level, 16) * 2;
+      out.append(indent, ' ');
+      out += " * /* level ";
+      out += std::to_string(level);
+      out += ": ";
+      appendWords(random, kAsciiVocabulary, random.nextRange(3, 10), out);
+      out += '\n';
+      if (random.nextInt(3) == 0) {
+        out.append(indent, ' ');
+        out += " * // ";
+        appendStatement(random, kAsciiVocabulary, true, out);
+        out += '\n';
+      }
+    }
+    out += " */\n";
+    out += "int field";
+    out += std::to_string(id);
+    out += " = ";
+    out += std::to_string(random.nextInt(1000));
+    out += ";\n";
+  }
+
+  static void appendMinified(CorpusRandom& random, String& out) {
+    appendStatement(random, kAsciiVocabulary, true, out);
+  }
+
+  static const List<std::pair<CorpusKind, const char*>> kCorpusNames {
+    {CorpusKind::kJava, "java"},
+    {CorpusKind::kLongLines, "long-lines"},
+    {CorpusKind::kNestedComments, "nested-comments"},
+    {CorpusKind::kCjk, "cjk"},
+    {CorpusKind::kMinified, "minified"},
+  };
+
+  bool parseCorpusKind(const String& name, CorpusKind& kind) {
+    for (const std::pair<CorpusKind, const char*>& pair : kCorpusNames) {
+      if (name == pair.second) {
+        kind = pair.first;
+        return true;
+      }
+    }
+    return false;
+  }
+
+  const char* getCorpusName(CorpusKind kind) {
+    for (const std::pair<CorpusKind, const char*>& pair : kCorpusNames) {
+      if (kind == pair.first) {
+        return pair.second;
+      }
+    }
+    return "";
+  }
+
+  const List<CorpusKind>& getAllCorpusKinds() {
+    static const List<CorpusKind> kinds {CorpusKind::kJava, CorpusKind::kLongLines, CorpusKind::kNestedComments,
+      CorpusKind::kCjk, CorpusKind::kMinified};
+    return kinds;
+  }
+
+  String generateCorpus(CorpusKind kind, size_t target_bytes, uint64_t seed) {
+    CorpusRandom random(seed ^ static_cast<uint64_t>(kind));
+    String out;
+    out.reserve(target_bytes + 64 * 1024);
+    for (size_t id = 0; out.size() < target_bytes; ++id) {
+      switch (kind) {
+      case CorpusKind::kJava:
+        appendSourceFragment(random, kAsciiVocabulary, id, out);
+        break;
+      case CorpusKind::kLongLines:
+        appendLongLine(random, id, out);
+        break;
+      case CorpusKind::kNestedComments:
+        appendNestedComment(random, id, out);
+        break;
+      case CorpusKind::kCjk:
+        appendSourceFragment(random, kCjkVocabulary, id, out);
+        break;
+      case CorpusKind::kMinified:
+        appendMinified(random, out);
+        break;
+      }
+    }
+    return out;
+  }
+}
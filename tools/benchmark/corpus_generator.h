@@ -0,0 +1,39 @@
+#ifndef FAST_HIGHLIGHT_CORPUS_GENERATOR_H
+#define FAST_HIGHLIGHT_CORPUS_GENERATOR_H
+
+#include "highlight.h"
+
+namespace NS_FASTHIGHLIGHT {
+  /// 基准测试语料的类型
+  enum class CorpusKind {
+    /// 普通的Java源码，包含注释、字符串、数字和各种语句
+    kJava,
+    /// 每行数KB到数十KB的超长行(大数组初始化、长字符串拼接)
+    kLongLines,
+    /// 大段的块注释，注释内层层嵌套注释标记，考验跨行匹配
+    kNestedComments,
+    /// 中文标识符和字符串，考验多字节字符的列号转换
+    kCjk,
+    /// 压缩后的单行文件，整个文本只有一行
+    kMinified,
+  };
+
+  /// 解析语料类型名称(java, long-lines, nested-comments, cjk, minified)
+  /// @return 名称无效时返回false
+  bool parseCorpusKind(const String& name, CorpusKind& kind);
+
+  /// 获取语料类型名称
+  const char* getCorpusName(CorpusKind kind);
+
+  /// 所有语料类型
+  const List<CorpusKind>& getAllCorpusKinds();
+
+  /// 生成确定性的语料，相同的(kind, target_bytes, seed)在任意平台上生成完全相同的文本。
+  /// 文本按完整的片段生成，长度不小于target_bytes，超出部分不超过一个片段
+  /// @param kind 语料类型
+  /// @param target_bytes 目标字节数
+  /// @param seed 随机种子
+  String generateCorpus(CorpusKind kind, size_t target_bytes, uint64_t seed);
+}
+
+#endif //FAST_HIGHLIGHT_CORPUS_GENERATOR_H
@@ -0,0 +1,274 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <random>
+#include "corpus_generator.h"
+#include "highlight.h"
+#include "stats_util.h"
+#include "util.h"
+
+using namespace NS_FASTHIGHLIGHT;
+using Clock = std::chrono::steady_clock;
+
+/// 命令行参数
+struct BenchOptions {
+  String syntax_file {BENCHMARK_SYNTAX_FILE};
+  List<CorpusKind> corpora;
+  List<size_t> sizes;
+  /// 每个语料的编辑次数，每次编辑包括插入和撤销两次增量更新
+  size_t edits {200};
+  /// 每个语料增量编辑的总时长上限(秒)，大文本的单次编辑可能很慢，达到上限后提前结束
+  double edit_time {5.0};
+  /// 完整分析至少重复的总时长(秒)，大文本至少运行一次
+  double min_time {0.5};
+  uint64_t seed {20240601};
+  /// 生成的语料保存到该目录，为空时不保存
+  String dump_dir;
+};
+
+/// 完整分析的统计
+struct AnalyzeStats {
+  size_t lines {0};
+  size_t tokens {0};
+  size_t runs {0};
+  double seconds_per_run {0};
+};
+
+/// 增量编辑延迟的统计(微秒)
+struct EditStats {
+  size_t count {0};
+  double p50 {0};
+  double p99 {0};
+  double max {0};
+};
+
+static void printUsage() {
+  std::cerr << "usage: fasthighlight-bench [-s <syntax.json>] [--corpus <name,...>] [--sizes <size,...>]\n"
+               "                           [--edits <count>] [--edit-time <seconds>] [--min-time <seconds>]\n"
+               "                           [--seed <seed>] [--dump <dir>]\n"
+               "  -s, --syntax   syntax rule file, default the bundled java.json\n"
+               "  --corpus       java, long-lines, nested-comments, cjk, minified, default all\n"
+               "  --sizes        corpus sizes from 1K to 100M, default 1K,100K,1M,10M\n"
+               "  --edits        edits per corpus for latency percentiles, default 200, 0 to skip\n"
+               "  --edit-time    stop editing a corpus after the seconds, default 5\n"
+               "  --min-time     minimum total time of repeated full analysis, default 0.5\n"
+               "  --seed         corpus generator seed\n"
+               "  --dump         write generated corpora into the directory\n";
+}
+
+/// 解析带K/M后缀的大小
+static bool parseSize(const String& text, size_t& size) {
+  if (text.empty()) {
+    return false;
+  }
+  size_t multiplier = 1;
+  String number = text;
+  const char suffix = text.back();
+  if (suffix == 'K' || suffix == 'k') {
+    multiplier = 1024;
+    number.pop_back();
+  } else if (suffix == 'M' || suffix == 'm') {
+    multiplier = 1024 * 1024;
+    number.pop_back();
+  }
+  try {
+    size = std::stoul(number) * multiplier;
+  } catch (const std::exception&) {
+    return false;
+  }
+  return size > 0;
+}
+
+static String formatSize(size_t size) {
+  if (size >= 1024 * 1024 && size % (1024 * 1024) == 0) {
+    return std::to_string(size / (1024 * 1024)) + "M";
+  }
+  if (size >= 1024 && size % 1024 == 0) {
+    return std::to_string(size / 1024) + "K";
+  }
+  return std::to_string(size);
+}
+
+static List<String> splitList(const String& text) {
+  List<String> items;
+  size_t start = 0;
+  while (start <= text.size()) {
+    size_t end = text.find(',', start);
+    if (end == String::npos) {
+      end = text.size();
+    }
+    if (end > start) {
+      items.push_back(text.substr(start, end - start));
+    }
+    start = end + 1;
+  }
+  return items;
+}
+
+static bool parseArguments(int argc, char* argv[], BenchOptions& options) {
+  for (int i = 1; i < argc; ++i) {
+    String arg = argv[i];
+    auto next_value = [&](String& value) {
+      if (i + 1 >= argc) {
+        std::cerr << "missing value for " << arg << std::endl;
+        return false;
+      }
+      value = argv[++i];
+      return true;
+    };
+    String value;
+    if (arg == "-s" || arg == "--syntax") {
+      if (!next_value(options.syntax_file)) return false;
+    } else if (arg == "--corpus") {
+      if (!next_value(value)) return false;
+      for (const String& name : splitList(value)) {
+        CorpusKind kind;
+        if (!parseCorpusKind(name, kind)) {
+          std::cerr << "unknown corpus: " << name << std::endl;
+          return false;
+        }
+        options.corpora.push_back(kind);
+      }
+    } else if (arg == "--sizes") {
+      if (!next_value(value)) return false;
+      for (const String& item : splitList(value)) {
+        size_t size;
+        if (!parseSize(item, size)) {
+          std::cerr << "invalid size: " << item << std::endl;
+          return false;
+        }
+        options.sizes.push_back(size);
+      }
+    } else if (arg == "--edits") {
+      if (!next_value(value)) return false;
+      options.edits = std::stoul(value);
+    } else if (arg == "--edit-time") {
+      if (!next_value(value)) return false;
+      options.edit_time = std::stod(value);
+    } else if (arg == "--min-time") {
+      if (!next_value(value)) return false;
+      options.min_time = std::stod(value);
+    } else if (arg == "--seed") {
+      if (!next_value(value)) return false;
+      options.seed = std::stoull(value);
+    } else if (arg == "--dump") {
+      if (!next_value(options.dump_dir)) return false;
+    } else {
+      std::cerr << "unknown option: " << arg << std::endl;
+      return false;
+    }
+  }
+  if (options.corpora.empty()) {
+    options.corpora = getAllCorpusKinds();
+  }
+  if (options.sizes.empty()) {
+    options.sizes = {1024, 100 * 1024, 1024 * 1024, 10 * 1024 * 1024};
+  }
+  return true;
+}
+
+/// 重复完整分析同一个文本，每次使用新的分析器，只统计analyzeFully的耗时
+static AnalyzeStats benchmarkAnalyze(const Ptr<const SyntaxRule>& rule, const Ptr<Document>& document,
+  double min_time) {
+  AnalyzeStats stats;
+  stats.lines = document->getLineCount();
+  double total_seconds = 0;
+  while (stats.runs == 0 || total_seconds < min_time) {
+    DocumentAnalyzer analyzer(document, rule);
+    Clock::time_point start_time = Clock::now();
+    Ptr<DocumentHighlight> highlight = analyzer.analyzeFully();
+    total_seconds += std::chrono::duration<double>(Clock::now() - start_time).count();
+    if (stats.runs++ == 0) {
+      highlight->forEachLine([&stats](size_t, const LineSpans& spans) {
+        stats.tokens += spans.size();
+      });
+    }
+  }
+  stats.seconds_per_run = total_seconds / static_cast<double>(stats.runs);
+  return stats;
+}
+
+/// 在随机位置模拟输入: 插入一个字符或换行后再删除，统计每次增量更新的延迟
+static EditStats benchmarkEdits(const Ptr<const SyntaxRule>& rule, const Ptr<Document>& document, size_t edits,
+  double edit_time, uint64_t seed) {
+  EditStats stats;
+  if (edits == 0) {
+    return stats;
+  }
+  DocumentAnalyzer analyzer(document, rule);
+  analyzer.analyzeFully();
+  // mt19937_64的输出序列在各平台上一致，取模得到确定的编辑位置
+  std::mt19937_64 random(seed);
+  List<double> latencies_us;
+  latencies_us.reserve(edits * 2);
+  double total_us = 0;
+  auto timedUpdate = [&analyzer, &latencies_us, &total_us](const TextRange& range, const String& text) {
+    Clock::time_point start_time = Clock::now();
+    analyzer.updateHighlight(range, text);
+    latencies_us.push_back(std::chrono::duration<double, std::micro>(Clock::now() - start_time).count());
+    total_us += latencies_us.back();
+  };
+  for (size_t i = 0; i < edits && total_us < edit_time * 1e6; ++i) {
+    const size_t line = static_cast<size_t>(random() % document->getLineCount());
+    const size_t column = static_cast<size_t>(random() % (Utf8Util::countChars(document->getLine(line)) + 1));
+    const bool new_line = i % 8 == 7;
+    const TextPosition position {line, column};
+    timedUpdate({position, position}, new_line ? "\n" : "x");
+    timedUpdate({position, new_line ? TextPosition {line + 1, 0} : TextPosition {line, column + 1}}, "");
+    stats.count++;
+  }
+  std::sort(latencies_us.begin(), latencies_us.end());
+  stats.p50 = percentile(latencies_us, 0.5);
+  stats.p99 = percentile(latencies_us, 0.99);
+  stats.max = latencies_us.back();
+  return stats;
+}
+
+int main(int argc, char* argv[]) {
+  BenchOptions options;
+  if (!parseArguments(argc, argv, options)) {
+    printUsage();
+    return 1;
+  }
+  SyntaxRuleManager manager;
+  Ptr<const SyntaxRule> rule;
+  try {
+    rule = manager.compileSyntaxFromFile(options.syntax_file);
+  } catch (const SyntaxRuleParseError& error) {
+    std::cerr << "invalid syntax rule: " << error.what() << std::endl;
+    return 1;
+  }
+  if (rule == nullptr) {
+    std::cerr << "cannot read syntax rule: " << options.syntax_file << std::endl;
+    return 1;
+  }
+
+  const double kMegabyte = 1024.0 * 1024.0;
+  std::printf("%-16s %6s %9s %10s %5s %10s %12s %8s %9s %6s %12s %12s %12s\n", "corpus", "size", "lines", "tokens",
+    "runs", "ms/run", "lines/s", "MB/s", "ns/token", "edits", "edit p50", "edit p99", "edit max");
+  for (CorpusKind kind : options.corpora) {
+    for (size_t size : options.sizes) {
+      String text = generateCorpus(kind, size, options.seed);
+      const size_t text_bytes = text.size();
+      if (!options.dump_dir.empty()) {
+        FileUtil::mkdirs(options.dump_dir);
+        FileUtil::writeString(options.dump_dir + "/" + getCorpusName(kind) + "-" + formatSize(size) + ".java", text);
+      }
+      Ptr<Document> document = MAKE_PTR<Document>("bench.java", text);
+      String().swap(text);
+
+      AnalyzeStats analyze_stats = benchmarkAnalyze(rule, document, options.min_time);
+      EditStats edit_stats = benchmarkEdits(rule, document, options.edits, options.edit_time, options.seed);
+      const double seconds = analyze_stats.seconds_per_run;
+      std::printf("%-16s %6s %9zu %10zu %5zu %10.3f %12.0f %8.2f %9.1f %6zu %10.1fus %10.1fus %10.1fus\n",
+        getCorpusName(kind), formatSize(size).c_str(), analyze_stats.lines, analyze_stats.tokens, analyze_stats.runs,
+        seconds * 1000.0, static_cast<double>(analyze_stats.lines) / seconds,
+        static_cast<double>(text_bytes) / kMegabyte / seconds,
+        analyze_stats.tokens == 0 ? 0.0 : seconds * 1e9 / static_cast<double>(analyze_stats.tokens),
+        edit_stats.count, edit_stats.p50, edit_stats.p99, edit_stats.max);
+      std::fflush(stdout);
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,64 @@
+#ifndef FAST_HIGHLIGHT_CLI_BOUNDED_QUEUE_H
+#define FAST_HIGHLIGHT_CLI_BOUNDED_QUEUE_H
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+
+#include "macro.h"
+
+namespace NS_FASTHIGHLIGHT {
+  /// 有容量上限的阻塞队列，用于连接流水线的相邻阶段，
+  /// 下游处理不过来时上游在push处等待，各阶段占用的内存因此有上限
+  template<typename T>
+  class BoundedQueue {
+  public:
+    /// @param capacity 队列容量，至少为1
+    explicit BoundedQueue(size_t capacity) : capacity_(capacity == 0 ? 1 : capacity) {
+    }
+
+    /// 放入元素，队列已满时等待
+    /// @return 队列已关闭时返回false
+    bool push(T item) {
+      std::unique_lock<std::mutex> lock(mutex_);
+      not_full_cv_.wait(lock, [this]() { return closed_ || items_.size() < capacity_; });
+      if (closed_) {
+        return false;
+      }
+      items_.push_back(std::move(item));
+      not_empty_cv_.notify_one();
+      return true;
+    }
+
+    /// 取出元素，队列为空时等待
+    /// @return 队列已关闭且取空时返回false
+    bool pop(T& item) {
+      std::unique_lock<std::mutex> lock(mutex_);
+      not_empty_cv_.wait(lock, [this]() { return closed_ || !items_.empty(); });
+      if (items_.empty()) {
+        return false;
+      }
+      item = std::move(items_.front());
+      items_.pop_front();
+      not_full_cv_.notify_one();
+      return true;
+    }
+
+    /// 关闭队列，之后的push失败，pop取完剩余元素后失败
+    void close() {
+      std::lock_guard<std::mutex> lock(mutex_);
+      closed_ = true;
+      not_empty_cv_.notify_all();
+      not_full_cv_.notify_all();
+    }
+  private:
+    size_t capacity_;
+    std::deque<T> items_;
+    std::mutex mutex_;
+    std::condition_variable not_empty_cv_;
+    std::condition_variable not_full_cv_;
+    bool closed_ {false};
+  };
+}
+
+#endif //FAST_HIGHLIGHT_CLI_BOUNDED_QUEUE_H
@@ -0,0 +1,326 @@
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <thread>
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+#include "bounded_queue.h"
+#include "highlight.h"
+#include "output_format.h"
+#include "stats_util.h"
+#include "util.h"
+
+using namespace NS_FASTHIGHLIGHT;
+namespace fs = std::filesystem;
+using Clock = std::chrono::steady_clock;
+
+/// 命令行参数
+struct CliOptions {
+  List<String> syntax_files;
+  List<String> inputs;
+  OutputFormat format {OutputFormat::kHtml};
+  /// 输出目录，为空时写到标准输出
+  String output_dir;
+  /// 只统计不输出，用于测量吞吐
+  bool discard {false};
+  size_t jobs {0};
+  size_t queue_capacity {64};
+  /// 从标准输入读取时用于选择语法规则的文件名
+  String stdin_name;
+};
+
+/// 在流水线中传递的单个文件
+struct FileTask {
+  String path;
+  /// 相对于输入目录的路径，用于生成输出文件路径
+  String relative_path;
+  String text;
+  String output;
+  /// 开始分析的时间，单个文件的延迟为分析、渲染和写出的总耗时
+  Clock::time_point start_time;
+  bool failed {false};
+  /// 分析失败的原因
+  String error;
+};
+
+static void printUsage() {
+  std::cerr << "usage: fasthighlight -s <syntax.json> [-s ...] [-f html|ansi|binary] [-o <dir>] [-j <threads>]\n"
+               "                     [--queue <capacity>] [--discard] <file|dir>...\n"
+               "       fasthighlight -s <syntax.json> [-f html|ansi|binary] --name <file name> -\n"
+               "  -s, --syntax   syntax rule file, can be repeated\n"
+               "  -f, --format   output format, default html\n"
+               "  -o, --output   output directory, default stdout\n"
+               "  -j, --jobs     tokenizer threads, default hardware concurrency\n"
+               "  --queue        capacity of each pipeline queue, default 64\n"
+               "  --discard      highlight without writing output, for benchmarking\n"
+               "  --name         file name used to select the syntax rule when reading stdin\n"
+               "  -              stream stdin to stdout line by line\n";
+}
+
+/// 解析非负整数参数，整个值都必须是十进制数字
+static bool parseCount(const String& value, size_t& count) {
+  const char* end = value.data() + value.size();
+  std::from_chars_result result = std::from_chars(value.data(), end, count);
+  return !value.empty() && result.ec == std::errc() && result.ptr == end;
+}
+
+static bool parseArguments(int argc, char* argv[], CliOptions& options) {
+  for (int i = 1; i < argc; ++i) {
+    String arg = argv[i];
+    auto next_value = [&](String& value) {
+      if (i + 1 >= argc) {
+        std::cerr << "missing value for " << arg << std::endl;
+        return false;
+      }
+      value = argv[++i];
+      return true;
+    };
+    String value;
+    if (arg == "-s" || arg == "--syntax") {
+      if (!next_value(value)) return false;
+      options.syntax_files.push_back(value);
+    } else if (arg == "-f" || arg == "--format") {
+      if (!next_value(value)) return false;
+      if (!parseOutputFormat(value, options.format)) {
+        std::cerr << "unknown format: " << value << std::endl;
+        return false;
+      }
+    } else if (arg == "-o" || arg == "--output") {
+      if (!next_value(options.output_dir)) return false;
+    } else if (arg == "-j" || arg == "--jobs") {
+      if (!next_value(value)) return false;
+      if (!parseCount(value, options.jobs)) {
+        std::cerr << "invalid thread count: " << value << std::endl;
+        return false;
+      }
+    } else if (arg == "--queue") {
+      if (!next_value(value)) return false;
+      if (!parseCount(value, options.queue_capacity) || options.queue_capacity == 0) {
+        std::cerr << "invalid queue capacity: " << value << std::endl;
+        return false;
+      }
+    } else if (arg == "--name") {
+      if (!next_value(options.stdin_name)) return false;
+    } else if (arg == "--discard") {
+      options.discard = true;
+    } else if (arg == "-h" || arg == "--help") {
+      return false;
+    } else if (arg.length() > 1 && arg[0] == '-') {
+      std::cerr << "unknown option: " << arg << std::endl;
+      return false;
+    } else {
+      options.inputs.push_back(arg);
+    }
+  }
+  if (options.syntax_files.empty() || options.inputs.empty()) {
+    return false;
+  }
+  bool read_stdin = std::find(options.inputs.begin(), options.inputs.end(), "-") != options.inputs.end();
+  if (read_stdin && (options.inputs.size() > 1 || options.stdin_name.empty())) {
+    std::cerr << "stdin must be the only input and requires --name" << std::endl;
+    return false;
+  }
+  return true;
+}
+
+/// 流式高亮标准输入，每行分析完立即渲染，适合管道中持续产生的日志或diff
+static int streamStdin(const HighlightEngine& engine, const CliOptions& options) {
+  LineRenderer renderer(options.format, [](const char* data, size_t size) {
+    std::fwrite(data, 1, size, stdout);
+  });
+  UPtr<StreamTokenizer> tokenizer = engine.createStreamTokenizer(options.stdin_name,
+    [&renderer](size_t, const String& line_text, const LineSpans& spans) {
+      renderer.renderLine(line_text, spans);
+    });
+  if (tokenizer == nullptr) {
+    std::cerr << "no syntax rule for: " << options.stdin_name << std::endl;
+    return 2;
+  }
+  renderer.begin();
+  char buffer[64 * 1024];
+  bool failed = false;
+  // 分析出错时停止读取，已输出的内容保持完整的格式
+  try {
+    while (true) {
+#ifdef _WIN32
+      size_t size = std::fread(buffer, 1, sizeof(buffer), stdin);
+      failed = std::ferror(stdin) != 0;
+#else
+      // read在管道有数据时立即返回，不会等待填满缓冲，持续输出的日志可以及时显示
+      ssize_t size = read(STDIN_FILENO, buffer, sizeof(buffer));
+      failed = size < 0;
+#endif
+      if (size <= 0) {
+        break;
+      }
+      tokenizer->feed(buffer, static_cast<size_t>(size));
+      std::fflush(stdout);
+    }
+    tokenizer->finish();
+  } catch (const std::exception& error) {
+    std::cerr << "failed: " << options.stdin_name << " (" << error.what() << ")" << std::endl;
+    failed = true;
+  }
+  renderer.end();
+  std::fflush(stdout);
+  return failed ? 2 : 0;
+}
+
+/// 读取阶段：遍历输入，把有对应语法规则的文件读入内存后交给分析阶段
+static void readStage(const HighlightEngine& engine, const CliOptions& options,
+  BoundedQueue<UPtr<FileTask>>& read_queue) {
+  auto enqueue = [&engine, &read_queue](const fs::path& path, const fs::path& relative_path) {
+    String path_str = path.string();
+    if (!engine.hasSyntaxRule(path_str)) {
+      return;
+    }
+    UPtr<FileTask> task = MAKE_UPTR<FileTask>();
+    task->path = path_str;
+    task->relative_path = relative_path.string();
+    task->text = FileUtil::readString(path_str);
+    read_queue.push(std::move(task));
+  };
+  for (const String& input : options.inputs) {
+    std::error_code error;
+    fs::path input_path(input);
+    if (fs::is_directory(input_path, error)) {
+      for (fs::recursive_directory_iterator it(input_path, error), end; !error && it != end; it.increment(error)) {
+        if (it->is_regular_file(error)) {
+          enqueue(it->path(), fs::relative(it->path(), input_path, error));
+        }
+      }
+    } else if (fs::is_regular_file(input_path, error)) {
+      enqueue(input_path, input_path.filename());
+    } else {
+      std::cerr << "cannot read: " << input << std::endl;
+    }
+  }
+  read_queue.close();
+}
+
+/// 分析阶段：边分析边渲染，原文在渲染完成后立即释放
+static void tokenizeStage(const HighlightEngine& engine, OutputFormat format,
+  BoundedQueue<UPtr<FileTask>>& read_queue, BoundedQueue<UPtr<FileTask>>& write_queue) {
+  UPtr<FileTask> task;
+  while (read_queue.pop(task)) {
+    task->start_time = Clock::now();
+    // 单个文件出错只标记失败，不影响其他文件
+    try {
+      Ptr<DocumentAnalyzer> analyzer = engine.createAnalyzer(MAKE_PTR<Document>(task->path, task->text));
+      String().swap(task->text);
+      if (analyzer == nullptr) {
+        task->failed = true;
+      } else {
+        renderDocument(format, *analyzer, task->output);
+      }
+    } catch (const std::exception& error) {
+      task->failed = true;
+      task->error = error.what();
+      String().swap(task->text);
+      String().swap(task->output);
+    }
+    write_queue.push(std::move(task));
+  }
+}
+
+static bool writeOutput(const CliOptions& options, const FileTask& task) {
+  if (options.discard) {
+    return true;
+  }
+  if (options.output_dir.empty()) {
+    std::cout.write(task.output.data(), static_cast<std::streamsize>(task.output.size()));
+    return static_cast<bool>(std::cout);
+  }
+  fs::path output_path = fs::path(options.output_dir) / task.relative_path;
+  output_path += getOutputExtension(options.format);
+  std::error_code error;
+  fs::create_directories(output_path.parent_path(), error);
+  std::ofstream out(output_path, std::ios::binary);
+  out.write(task.output.data(), static_cast<std::streamsize>(task.output.size()));
+  return static_cast<bool>(out);
+}
+
+int main(int argc, char* argv[]) {
+  CliOptions options;
+  if (!parseArguments(argc, argv, options)) {
+    printUsage();
+    return 1;
+  }
+  HighlightEngine engine;
+  try {
+    for (const String& syntax_file : options.syntax_files) {
+      engine.compileSyntaxFromFile(syntax_file);
+    }
+  } catch (const SyntaxRuleParseError& error) {
+    std::cerr << "invalid syntax rule: " << error.what() << std::endl;
+    return 1;
+  }
+  if (options.inputs.front() == "-") {
+    return streamStdin(engine, options);
+  }
+  if (options.jobs == 0) {
+    options.jobs = std::max<size_t>(std::thread::hardware_concurrency(), 1);
+  }
+
+  // 读取、分析、写出三个阶段通过有界队列连接，分析阶段多线程并行
+  BoundedQueue<UPtr<FileTask>> read_queue(options.queue_capacity);
+  BoundedQueue<UPtr<FileTask>> write_queue(options.queue_capacity);
+  Clock::time_point start_time = Clock::now();
+  std::thread reader(readStage, std::cref(engine), std::cref(options), std::ref(read_queue));
+  std::atomic<size_t> running_workers {options.jobs};
+  List<std::thread> workers;
+  for (size_t i = 0; i < options.jobs; ++i) {
+    workers.emplace_back([&]() {
+      tokenizeStage(engine, options.format, read_queue, write_queue);
+      if (--running_workers == 0) {
+        write_queue.close();
+      }
+    });
+  }
+
+  size_t file_count = 0;
+  size_t failed_count = 0;
+  size_t output_bytes = 0;
+  size_t input_bytes = 0;
+  List<double> latencies_ms;
+  UPtr<FileTask> task;
+  while (write_queue.pop(task)) {
+    if (task->failed || !writeOutput(options, *task)) {
+      std::cerr << "failed: " << task->path;
+      if (!task->error.empty()) {
+        std::cerr << " (" << task->error << ")";
+      }
+      std::cerr << std::endl;
+      ++failed_count;
+      continue;
+    }
+    std::error_code error;
+    input_bytes += static_cast<size_t>(fs::file_size(task->path, error));
+    output_bytes += task->output.size();
+    ++file_count;
+    latencies_ms.push_back(std::chrono::duration<double, std::milli>(Clock::now() - task->start_time).count());
+  }
+  reader.join();
+  for (std::thread& worker : workers) {
+    worker.join();
+  }
+  std::cout.flush();
+
+  double seconds = std::chrono::duration<double>(Clock::now() - start_time).count();
+  std::sort(latencies_ms.begin(), latencies_ms.end());
+  const double kMegabyte = 1024.0 * 1024.0;
+  std::fprintf(stderr, "files: %zu, failed: %zu, input: %.2f MB, output: %.2f MB, time: %.3f s, threads: %zu\n",
+    file_count, failed_count, static_cast<double>(input_bytes) / kMegabyte,
+    static_cast<double>(output_bytes) / kMegabyte, seconds, options.jobs);
+  std::fprintf(stderr, "throughput: %.1f files/s, %.2f MB/s\n", static_cast<double>(file_count) / seconds,
+    static_cast<double>(input_bytes) / kMegabyte / seconds);
+  std::fprintf(stderr, "latency(ms): p50 %.2f, p90 %.2f, p99 %.2f, max %.2f\n", percentile(latencies_ms, 0.5),
+    percentile(latencies_ms, 0.9), percentile(latencies_ms, 0.99), latencies_ms.empty() ? 0 : latencies_ms.back());
+  return failed_count == 0 ? 0 : 2;
+}
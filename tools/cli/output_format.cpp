@@ -0,0 +1,156 @@
+#include <cstring>
+#include "output_format.h"
+
+namespace NS_FASTHIGHLIGHT {
+  static constexpr const char* kAnsiReset = "\x1b[0m";
+  /// ansi和binary格式缓冲超过该大小时交给sink
+  static constexpr size_t kFlushThreshold = 64 * 1024;
+
+  /// 从byte_pos开始跳过char_count个UTF-8字符
+  static size_t advanceChars(const String& text, size_t byte_pos, size_t char_count) {
+    while (char_count > 0 && byte_pos < text.length()) {
+      ++byte_pos;
+      while (byte_pos < text.length() && (static_cast<uint8_t>(text[byte_pos]) & 0xC0) == 0x80) {
+        ++byte_pos;
+      }
+      --char_count;
+    }
+    return byte_pos;
+  }
+
+  /// 按style名称中的常见关键字选择终端颜色，其余style按哈希分配
+  static String makeAnsiColor(const String& style) {
+    static const std::pair<const char*, const char*> kKnownColors[] = {
+      {"comment", "90"}, {"string", "32"}, {"keyword", "35"}, {"number", "36"}, {"constant", "36"},
+      {"type", "33"}, {"class", "33"}, {"function", "34"}, {"method", "34"}, {"operator", "37"},
+    };
+    for (const std::pair<const char*, const char*>& known : kKnownColors) {
+      if (style.find(known.first) != String::npos) {
+        return String("\x1b[") + known.second + "m";
+      }
+    }
+    static const char* kFallbackColors[] = {"31", "33", "34", "35", "36"};
+    size_t index = std::hash<String>()(style) % (sizeof(kFallbackColors) / sizeof(kFallbackColors[0]));
+    return String("\x1b[") + kFallbackColors[index] + "m";
+  }
+
+  LineRenderer::LineRenderer(OutputFormat format, const HtmlSink& sink): format_(format), sink_(sink) {
+    if (format_ == OutputFormat::kHtml) {
+      html_renderer_ = MAKE_UPTR<HtmlRenderer>(sink_);
+    } else if (format_ == OutputFormat::kBinary) {
+      stream_encoder_ = MAKE_UPTR<TokenStreamEncoder>(buffer_);
+    }
+  }
+
+  void LineRenderer::begin() {
+    switch (format_) {
+      case OutputFormat::kHtml:
+        html_renderer_->begin();
+        break;
+      case OutputFormat::kAnsi:
+        break;
+      case OutputFormat::kBinary:
+        stream_encoder_->begin();
+        break;
+    }
+  }
+
+  void LineRenderer::renderLine(const String& line_text, const LineSpans& spans) {
+    switch (format_) {
+      case OutputFormat::kHtml:
+        html_renderer_->renderLine(line_text, spans);
+        return;
+      case OutputFormat::kAnsi:
+        renderAnsiLine(line_text, spans);
+        break;
+      case OutputFormat::kBinary:
+        stream_encoder_->encodeLine(line_count_, spans);
+        break;
+    }
+    ++line_count_;
+    if (buffer_.length() >= kFlushThreshold) {
+      flushBuffer();
+    }
+  }
+
+  void LineRenderer::end() {
+    if (format_ == OutputFormat::kHtml) {
+      html_renderer_->end();
+    } else {
+      flushBuffer();
+    }
+  }
+
+  void LineRenderer::renderAnsiLine(const String& line_text, const LineSpans& spans) {
+    size_t char_pos = 0;
+    size_t byte_pos = 0;
+    for (const TokenSpan& span : spans) {
+      size_t start_column = span.range.start.line < span.range.end.line ? 0 : span.range.start.column;
+      if (start_column > char_pos) {
+        size_t gap_end = advanceChars(line_text, byte_pos, start_column - char_pos);
+        buffer_.append(line_text, byte_pos, gap_end - byte_pos);
+        byte_pos = gap_end;
+        char_pos = start_column;
+      }
+      if (span.range.end.column <= char_pos) {
+        continue;
+      }
+      size_t span_end = advanceChars(line_text, byte_pos, span.range.end.column - char_pos);
+      if (span.style.empty()) {
+        buffer_.append(line_text, byte_pos, span_end - byte_pos);
+      } else {
+        auto it = ansi_colors_.find(span.style);
+        if (it == ansi_colors_.end()) {
+          it = ansi_colors_.emplace(span.style, makeAnsiColor(span.style)).first;
+        }
+        buffer_ += it->second;
+        buffer_.append(line_text, byte_pos, span_end - byte_pos);
+        buffer_ += kAnsiReset;
+      }
+      byte_pos = span_end;
+      char_pos = span.range.end.column;
+    }
+    if (byte_pos < line_text.length()) {
+      buffer_.append(line_text, byte_pos, String::npos);
+    }
+    buffer_ += '\n';
+  }
+
+  void LineRenderer::flushBuffer() {
+    if (!buffer_.empty()) {
+      sink_(buffer_.data(), buffer_.length());
+      buffer_.clear();
+    }
+  }
+
+  bool parseOutputFormat(const String& name, OutputFormat& format) {
+    if (name == "html") {
+      format = OutputFormat::kHtml;
+    } else if (name == "ansi") {
+      format = OutputFormat::kAnsi;
+    } else if (name == "binary") {
+      format = OutputFormat::kBinary;
+    } else {
+      return false;
+    }
+    return true;
+  }
+
+  const char* getOutputExtension(OutputFormat format) {
+    switch (format) {
+      case OutputFormat::kHtml: return ".html";
+      case OutputFormat::kAnsi: return ".ansi";
+      case OutputFormat::kBinary: return ".fhs";
+    }
+    return "";
+  }
+
+  void renderDocument(OutputFormat format, DocumentAnalyzer& analyzer, String& output) {
+    LineRenderer renderer(format, [&output](const char* data, size_t size) { output.append(data, size); });
+    renderer.begin();
+    analyzer.analyzeLines([&renderer](size_t, const String& line_text, const LineSpans& spans) {
+      renderer.renderLine(line_text, spans);
+    });
+    renderer.end();
+  }
+}
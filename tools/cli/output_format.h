@@ -0,0 +1,65 @@
+#ifndef FAST_HIGHLIGHT_CLI_OUTPUT_FORMAT_H
+#define FAST_HIGHLIGHT_CLI_OUTPUT_FORMAT_H
+
+#include "highlight.h"
+#include "html_renderer.h"
+#include "token_stream.h"
+
+namespace NS_FASTHIGHLIGHT {
+  /// 命令行工具的输出格式
+  enum class OutputFormat {
+    kHtml,
+    kAnsi,
+    kBinary,
+  };
+
+  /// 解析输出格式名称(html/ansi/binary)
+  /// @param name 格式名称
+  /// @param format 解析结果
+  /// @return 名称无效时返回false
+  bool parseOutputFormat(const String& name, OutputFormat& format);
+
+  /// 输出文件的后缀名
+  const char* getOutputExtension(OutputFormat format);
+
+  /// 按行渲染为指定格式，用于整个文本或流式输入
+  class LineRenderer {
+  public:
+    /// @param format 输出格式
+    /// @param sink 渲染结果的输出，按块调用
+    LineRenderer(OutputFormat format, const HtmlSink& sink);
+
+    /// 写入文件头
+    void begin();
+
+    /// 渲染一行
+    /// @param line_text 行文本
+    /// @param spans 该行的高亮块
+    void renderLine(const String& line_text, const LineSpans& spans);
+
+    /// 写入文件尾并输出剩余内容
+    void end();
+  private:
+    OutputFormat format_;
+    HtmlSink sink_;
+    UPtr<HtmlRenderer> html_renderer_;
+    /// ansi和binary格式的输出缓冲，超过一定大小后交给sink
+    String buffer_;
+    /// ansi格式中style对应的颜色
+    HashMap<String, String> ansi_colors_;
+    /// binary格式使用紧凑的二进制高亮流
+    UPtr<TokenStreamEncoder> stream_encoder_;
+    size_t line_count_ {0};
+
+    void renderAnsiLine(const String& line_text, const LineSpans& spans);
+    void flushBuffer();
+  };
+
+  /// 边分析边把整个文本渲染为指定格式
+  /// @param format 输出格式
+  /// @param analyzer 文本分析器
+  /// @param output 渲染结果
+  void renderDocument(OutputFormat format, DocumentAnalyzer& analyzer, String& output);
+}
+
+#endif //FAST_HIGHLIGHT_CLI_OUTPUT_FORMAT_H
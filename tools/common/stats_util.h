@@ -0,0 +1,19 @@
+#ifndef FAST_HIGHLIGHT_TOOLS_STATS_UTIL_H
+#define FAST_HIGHLIGHT_TOOLS_STATS_UTIL_H
+
+#include "macro.h"
+
+namespace NS_FASTHIGHLIGHT {
+  /// 计算已排序数据的百分位数，取最接近的样本，没有数据时返回0
+  /// @param sorted_values 升序排列的数据
+  /// @param ratio 百分位，0到1之间
+  inline double percentile(const List<double>& sorted_values, double ratio) {
+    if (sorted_values.empty()) {
+      return 0;
+    }
+    size_t index = static_cast<size_t>(ratio * static_cast<double>(sorted_values.size() - 1) + 0.5);
+    return sorted_values[index];
+  }
+}
+
+#endif //FAST_HIGHLIGHT_TOOLS_STATS_UTIL_H